@@ -205,6 +205,7 @@ void ARaymarchVolume::OnImageInfoChangedInEditor()
 	// Info we're initialized.
 	RaymarchResources.WindowingParameters = VolumeAsset->ImageInfo.DefaultWindowingParameters;
 	SetMaterialWindowingParameters();
+	bRequestedOpacityRebuild = true;
 
 	static double LastTimeReset = 0.0f;
 	if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
@@ -268,15 +269,30 @@ void ARaymarchVolume::PostEditChangeProperty(FPropertyChangedEvent& PropertyChan
 		{
 			bRequestedRecompute = true;
 		}
+		bRequestedOpacityRebuild = true;
 		SetMaterialWindowingParameters();
 		return;
 	}
 
 	if (PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, LightVolumeHalfResolution) ||
+		PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, OpacityVolumeMode) ||
 		PropertyName == GET_MEMBER_NAME_CHECKED(ARaymarchVolume, bLightVolume32Bit))
 	{
 		InitializeRaymarchResources(RaymarchResources.DataVolumeTextureRef);
 		SetMaterialVolumeParameters();
+		SetMaterialWindowingParameters();
+		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		{
+			bRequestedRecompute = true;
+		}
+		return;
+	}
+
+	// Lights propagated differently leave a different light volume, reset them.
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, bMultiSliceLightPropagation) ||
+		PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, bBatchedLightPropagation) ||
+		PropertyName == GET_MEMBER_NAME_CHECKED(FBasicRaymarchRenderingResources, bIncrementalClippingUpdate))
+	{
 		if (SelectRaymarchMaterial == ERaymarchMaterial::Lit)
 		{
 			bRequestedRecompute = true;
@@ -348,13 +364,37 @@ void ARaymarchVolume::Tick(float DeltaTime)
 		return;
 	}
 
-	// Volume transform changed or clipping plane moved -> need full recompute.
-	if (WorldParameters != GetWorldParameters())
+	// Volume transform changed or clipping plane moved -> need full recompute, unless only the clipping plane moved and the lights
+	// can be updated from the first slice the move affects.
+	const FRaymarchWorldParameters CurrentWorldParameters = GetWorldParameters();
+	if (WorldParameters != CurrentWorldParameters)
 	{
-		bRequestedRecompute = true;
+		const bool bOnlyClippingChanged = WorldParameters.VolumeTransform.Equals(CurrentWorldParameters.VolumeTransform);
+		if (RaymarchResources.bIncrementalClippingUpdate && bOnlyClippingChanged && !bRequestedRecompute &&
+			SelectRaymarchMaterial == ERaymarchMaterial::Lit)
+		{
+			bool bUpdateWasSuccessful = false;
+			if (bLightCheckpointsValid)
+			{
+				URaymarchUtils::UpdateClippingInSingleVolume(RaymarchResources, CurrentWorldParameters, bUpdateWasSuccessful);
+			}
+			// Every light reset records the checkpoints, so they're only missing after a light changed (or the update failed)
+			// -> reset the lights, the next moves are incremental again.
+			bRequestedRecompute = !bUpdateWasSuccessful;
+			bClippingUpdatedIncrementally |= bUpdateWasSuccessful;
+		}
+		else
+		{
+			bRequestedRecompute = true;
+		}
 		UpdateWorldParameters();
 		SetMaterialClippingParameters();
 	}
+	else if (bClippingUpdatedIncrementally)
+	{
+		// The plane stopped moving, get rid of the rounding errors the incremental updates accumulated in the light volume.
+		bRequestedRecompute = true;
+	}
 
 	if (bRequestedOctreeRebuild && SelectRaymarchMaterial == ERaymarchMaterial::Octree)
 	{
@@ -423,29 +463,73 @@ void ARaymarchVolume::ResetAllLights()
 		return;
 	}
 
+	// The lights read the opacity volume, so it has to be up to date before propagating them.
+	if (bRequestedOpacityRebuild && RaymarchResources.OpacityVolumeRenderTarget)
+	{
+		URaymarchUtils::BuildOpacityVolume(RaymarchResources);
+		bRequestedOpacityRebuild = false;
+	}
+
 	// Clear Light volume to zero.
 	UVolumeTextureToolkit::ClearVolumeTexture(RaymarchResources.LightVolumeRenderTarget, 0);
 
 	// Add all lights.
 	bool bResetWasSuccessful = true;
-	for (ARaymarchLight* Light : LightsArray)
-	{
-		if (!Light)
+	bLightCheckpointsValid = false;
+	bClippingUpdatedIncrementally = false;
+	if (RaymarchResources.bBatchedLightPropagation)
+	{
+		// Lights going along the same axis get propagated together. With incremental clipping updates, the propagation is also
+		// saved into checkpoints along the way, so that moving the clipping plane can continue from them.
+		TArray<FDirLightParameters> LightParameters;
+		for (ARaymarchLight* Light : LightsArray)
 		{
-			continue;
+			if (Light)
+			{
+				LightParameters.Add(Light->GetCurrentParameters());
+			}
 		}
-		bool bLightAddWasSuccessful = false;
 
-		URaymarchUtils::AddDirLightToSingleVolume(
-			RaymarchResources, Light->GetCurrentParameters(), true, WorldParameters, bResetWasSuccessful, bFastShader);
+		if (RaymarchResources.bIncrementalClippingUpdate)
+		{
+			URaymarchUtils::AddDirLightsWithCheckpointsToSingleVolume(
+				RaymarchResources, LightParameters, WorldParameters, bResetWasSuccessful);
+			bLightCheckpointsValid = bResetWasSuccessful;
+		}
+		else
+		{
+			URaymarchUtils::AddDirLightsToSingleVolume(
+				RaymarchResources, LightParameters, true, WorldParameters, bResetWasSuccessful);
+		}
 
 		if (!bResetWasSuccessful)
 		{
-			FString log = "Error. Could not add/remove light " + Light->GetName() + " in volume " + GetName() + " .";
+			FString log = "Error. Could not add lights in volume " + GetName() + " .";
 			UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log, 3);
 			return;
 		}
 	}
+	else
+	{
+		for (ARaymarchLight* Light : LightsArray)
+		{
+			if (!Light)
+			{
+				continue;
+			}
+			bool bLightAddWasSuccessful = false;
+
+			URaymarchUtils::AddDirLightToSingleVolume(
+				RaymarchResources, Light->GetCurrentParameters(), true, WorldParameters, bResetWasSuccessful);
+
+			if (!bResetWasSuccessful)
+			{
+				FString log = "Error. Could not add/remove light " + Light->GetName() + " in volume " + GetName() + " .";
+				UE_LOG(LogRaymarchVolume, Error, TEXT("%s"), *log, 3);
+				return;
+			}
+		}
+	}
 
 	// False-out request recompute flag when we succeeded in resetting lights.
 	bRequestedRecompute = false;
@@ -454,6 +538,8 @@ void ARaymarchVolume::ResetAllLights()
 void ARaymarchVolume::UpdateSingleLight(ARaymarchLight* UpdatedLight)
 {
 	bool bLightAddWasSuccessful = false;
+	// The checkpoints hold the light before the change.
+	bLightCheckpointsValid = false;
 
 	URaymarchUtils::ChangeDirLightInSingleVolume(RaymarchResources, LightParametersMap[UpdatedLight],
 		UpdatedLight->GetCurrentParameters(), WorldParameters, bLightAddWasSuccessful);
@@ -544,15 +630,15 @@ bool ARaymarchVolume::SetVolumeAsset(UVolumeAsset* InVolumeAsset)
 
 	RaymarchResources.WindowingParameters = VolumeAsset->ImageInfo.DefaultWindowingParameters;
 
-	// Unreal units are in cm, MHD and Dicoms both have sizes in mm -> divide by 10.
-	StaticMeshComponent->SetRelativeScale3D(InVolumeAsset->ImageInfo.WorldDimensions / 10);
+	SetVolumeWorldDimensions(InVolumeAsset->ImageInfo.WorldDimensions);
 
 	// Update world, set all parameters and request recompute.
 	UpdateWorldParameters();
 	SetAllMaterialParameters();
 	bRequestedRecompute = true;
-	// Update the octree.
+	// Update the octree and the opacity volume.
 	bRequestedOctreeRebuild = true;
+	bRequestedOpacityRebuild = true;
 
 	// Notify listeners that we've loaded a new volume.
 	OnVolumeLoaded.ExecuteIfBound();
@@ -574,6 +660,7 @@ void ARaymarchVolume::SetTFCurve(UCurveLinearColor* InTFCurve)
 		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, RaymarchResources.TFTextureRef);
 		OctreeRaymarchMaterial->SetTextureParameterValue(RaymarchParams::TransferFunction, RaymarchResources.TFTextureRef);
 		bRequestedRecompute = true;
+		bRequestedOpacityRebuild = true;
 	}
 }
 
@@ -671,13 +758,26 @@ void ARaymarchVolume::SetAllMaterialParameters()
 
 void ARaymarchVolume::SetMaterialVolumeParameters()
 {
+	// Bricked volumes give the intensity and lit materials the brick atlas in place of the data volume, flagged by the windowing
+	// (see SetMaterialWindowingParameters).
+	UTexture* SampledVolume = RaymarchResources.DataVolumeTextureRef;
+	if (RaymarchResources.BrickAtlasTextureRef)
+	{
+		SampledVolume = RaymarchResources.BrickAtlasTextureRef;
+	}
 	if (IntensityRaymarchMaterial)
 	{
-		IntensityRaymarchMaterial->SetTextureParameterValue(RaymarchParams::DataVolume, RaymarchResources.DataVolumeTextureRef);
+		IntensityRaymarchMaterial->SetTextureParameterValue(RaymarchParams::DataVolume, SampledVolume);
 	}
 	if (LitRaymarchMaterial)
 	{
-		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::DataVolume, RaymarchResources.DataVolumeTextureRef);
+		// The lit material reads the colored opacity volume in place of the data volume (see PerformWindowedLitRaymarch).
+		UTexture* LitVolume = SampledVolume;
+		if (IsLitMaterialUsingOpacityVolume())
+		{
+			LitVolume = RaymarchResources.OpacityVolumeRenderTarget;
+		}
+		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::DataVolume, LitVolume);
 		LitRaymarchMaterial->SetTextureParameterValue(RaymarchParams::LightVolume, RaymarchResources.LightVolumeRenderTarget);
 	}
 	if (OctreeRaymarchMaterial)
@@ -691,13 +791,19 @@ void ARaymarchVolume::SetMaterialWindowingParameters()
 {
 	if (LitRaymarchMaterial)
 	{
-		LitRaymarchMaterial->SetVectorParameterValue(
-			RaymarchParams::WindowingParams, RaymarchResources.WindowingParameters.ToLinearColor());
+		FLinearColor LitWindowing = GetSampledVolumeWindowing(RaymarchResources);
+		if (IsLitMaterialUsingOpacityVolume())
+		{
+			// The opacity volume already has the cutoffs applied, a negative low cutoff tells the material what it's reading.
+			LitWindowing = RaymarchResources.WindowingParameters.ToLinearColor();
+			LitWindowing.B = -1.0f;
+		}
+		LitRaymarchMaterial->SetVectorParameterValue(RaymarchParams::WindowingParams, LitWindowing);
 	}
 	if (IntensityRaymarchMaterial)
 	{
 		IntensityRaymarchMaterial->SetVectorParameterValue(
-			RaymarchParams::WindowingParams, RaymarchResources.WindowingParameters.ToLinearColor());
+			RaymarchParams::WindowingParams, GetSampledVolumeWindowing(RaymarchResources));
 	}
 	if (OctreeRaymarchMaterial)
 	{
@@ -706,6 +812,13 @@ void ARaymarchVolume::SetMaterialWindowingParameters()
 	}
 }
 
+bool ARaymarchVolume::IsLitMaterialUsingOpacityVolume() const
+{
+	// Only colored opacity volumes have everything the lit material needs (see PerformWindowedLitOpacityRaymarch).
+	return RaymarchResources.OpacityVolumeMode == EOpacityVolumeMode::OpacityAndColor &&
+		   RaymarchResources.OpacityVolumeRenderTarget != nullptr;
+}
+
 void ARaymarchVolume::SetMaterialClippingParameters()
 {
 	// Get the Clipping Plane parameters and transform them to local space.
@@ -734,6 +847,19 @@ void ARaymarchVolume::GetMinMaxValues(float& Min, float& Max)
 	Max = VolumeAsset->ImageInfo.MaxValue;
 }
 
+void ARaymarchVolume::GetPercentileValues(float& Low, float& High)
+{
+	Low = VolumeAsset->ImageInfo.LowPercentileValue;
+	High = VolumeAsset->ImageInfo.HighPercentileValue;
+}
+
+void ARaymarchVolume::SetPercentileWindow()
+{
+	const FWindowingParameters PercentileParameters = VolumeAsset->ImageInfo.GetPercentileWindowingParameters();
+	SetWindowCenter(PercentileParameters.Center);
+	SetWindowWidth(PercentileParameters.Width);
+}
+
 float ARaymarchVolume::GetWindowCenter()
 {
 	return RaymarchResources.WindowingParameters.Center;
@@ -752,6 +878,7 @@ void ARaymarchVolume::SetWindowCenter(const float& Center)
 	RaymarchResources.WindowingParameters.Center = Center;
 	SetMaterialWindowingParameters();
 	bRequestedRecompute = true;
+	bRequestedOpacityRebuild = true;
 }
 
 void ARaymarchVolume::SetWindowWidth(const float& Width)
@@ -762,6 +889,7 @@ void ARaymarchVolume::SetWindowWidth(const float& Width)
 	RaymarchResources.WindowingParameters.Width = Width;
 	SetMaterialWindowingParameters();
 	bRequestedRecompute = true;
+	bRequestedOpacityRebuild = true;
 }
 
 void ARaymarchVolume::SetLowCutoff(const bool& LowCutoff)
@@ -772,6 +900,7 @@ void ARaymarchVolume::SetLowCutoff(const bool& LowCutoff)
 	RaymarchResources.WindowingParameters.LowCutoff = LowCutoff;
 	SetMaterialWindowingParameters();
 	bRequestedRecompute = true;
+	bRequestedOpacityRebuild = true;
 }
 
 void ARaymarchVolume::SetHighCutoff(const bool& HighCutoff)
@@ -782,6 +911,7 @@ void ARaymarchVolume::SetHighCutoff(const bool& HighCutoff)
 	RaymarchResources.WindowingParameters.HighCutoff = HighCutoff;
 	SetMaterialWindowingParameters();
 	bRequestedRecompute = true;
+	bRequestedOpacityRebuild = true;
 }
 
 void ARaymarchVolume::SwitchRenderer(ERaymarchMaterial InSelectRaymarchMaterial)
@@ -800,6 +930,19 @@ void ARaymarchVolume::SwitchRenderer(ERaymarchMaterial InSelectRaymarchMaterial)
 	}
 }
 
+void ARaymarchVolume::SetVolumeWorldDimensions(FVector WorldDimensions)
+{
+	if (WorldDimensions.GetMin() <= 0)
+	{
+		UE_LOG(LogRaymarchVolume, Warning, TEXT("Ignoring invalid volume world dimensions %s on %s."), *WorldDimensions.ToString(),
+			*GetName());
+		return;
+	}
+	// Unreal units are in cm, MHD and Dicoms both have sizes in mm -> divide by 10.
+	StaticMeshComponent->SetRelativeScale3D(WorldDimensions / 10);
+	UpdateWorldParameters();
+}
+
 void ARaymarchVolume::SetRaymarchSteps(float InRaymarchingSteps)
 {
 	RaymarchingSteps = InRaymarchingSteps;
@@ -843,6 +986,11 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 
 	RaymarchResources.DataVolumeTextureRef = Volume;
 
+	// Bricked volumes have the full resolution data in the brick atlas, the shaders sample it instead of the data volume.
+	const bool bBricked = VolumeAsset && VolumeAsset->DataTexture == Volume && VolumeAsset->IsBricked();
+	UVolumeTexture* BrickAtlas = bBricked ? VolumeAsset->BrickAtlasTexture : nullptr;
+	RaymarchResources.BrickAtlasTextureRef = BrickAtlas;
+
 	int X = Volume->GetSizeX();
 	int Y = Volume->GetSizeY();
 	int Z = Volume->GetSizeZ();
@@ -877,6 +1025,16 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 	RaymarchResources.OctreeVolumeRenderTarget->Init(FMath::RoundUpToPowerOfTwo(Volume->GetSizeX()),
 		FMath::RoundUpToPowerOfTwo(Volume->GetSizeY()), FMath::RoundUpToPowerOfTwo(Volume->GetSizeZ()), 4, PF_G16);
 
+	// The opacity volume has the light volume's dimensions, so that light propagation can load its voxels directly.
+	if (RaymarchResources.OpacityVolumeMode != EOpacityVolumeMode::Disabled)
+	{
+		RaymarchResources.OpacityVolumeRenderTarget = NewObject<UTextureRenderTargetVolume>(this, "Opacity Volume Render Target");
+		RaymarchResources.OpacityVolumeRenderTarget->bCanCreateUAV = true;
+		RaymarchResources.OpacityVolumeRenderTarget->bHDR = true;
+		RaymarchResources.OpacityVolumeRenderTarget->Init(X, Y, Z,
+			RaymarchResources.OpacityVolumeMode == EOpacityVolumeMode::Opacity ? PF_R16F : PF_FloatRGBA);
+	}
+
 	// Flush rendering commands so that all textures are definitely initialized with resources and we can create a UAV ref.
 	FlushRenderingCommands();
 
@@ -885,6 +1043,7 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 		[&](FRHICommandListImmediate& RHICmdList)
 		{
 			RaymarchResources.DataVolumeTextureRef = Volume;
+			RaymarchResources.BrickAtlasTextureRef = BrickAtlas;
 
 			// Make buffers fully colored if we need to support colored lights.
 			URaymarchUtils::CreateBufferTextures(XBufferSize, PixelFormat, RaymarchResources.XYZReadWriteBuffers[0]);
@@ -911,12 +1070,23 @@ void ARaymarchVolume::InitializeRaymarchResources(UVolumeTexture* Volume)
 			RaymarchResources.OctreeUAVRef =
 				RHICreateUnorderedAccessView(RaymarchResources.OctreeVolumeRenderTarget->GetResource()->TextureRHI);
 
+			if (RaymarchResources.OpacityVolumeRenderTarget && RaymarchResources.OpacityVolumeRenderTarget->GetResource() &&
+				RaymarchResources.OpacityVolumeRenderTarget->GetResource()->TextureRHI)
+			{
+				RaymarchResources.OpacityVolumeUAVRef =
+					RHICreateUnorderedAccessView(RaymarchResources.OpacityVolumeRenderTarget->GetResource()->TextureRHI);
+			}
+
+			RaymarchResources.LightCheckpoints = MakeShared<FLightPropagationCheckpoints, ESPMode::ThreadSafe>();
+
 			RaymarchResources.bIsInitialized = true;
 		});
 	FlushRenderingCommands();
+	bLightCheckpointsValid = false;
 	if (RaymarchResources.bIsInitialized)
 	{
 		SetMaterialVolumeParameters();
+		bRequestedOpacityRebuild = true;
 	}
 }
 
@@ -927,6 +1097,7 @@ void ARaymarchVolume::FreeRaymarchResources()
 		[&](FRHICommandListImmediate& RHICmdList)
 		{
 			RaymarchResources.DataVolumeTextureRef = nullptr;
+			RaymarchResources.BrickAtlasTextureRef = nullptr;
 			if (RaymarchResources.LightVolumeRenderTarget)
 			{
 				RaymarchResources.LightVolumeRenderTarget->MarkAsGarbage();
@@ -939,6 +1110,14 @@ void ARaymarchVolume::FreeRaymarchResources()
 				RaymarchResources.OctreeVolumeRenderTarget = nullptr;
 			}
 
+			if (RaymarchResources.OpacityVolumeRenderTarget)
+			{
+				RaymarchResources.OpacityVolumeRenderTarget->MarkAsGarbage();
+				RaymarchResources.OpacityVolumeRenderTarget = nullptr;
+			}
+			RaymarchResources.OpacityVolumeUAVRef.SafeRelease();
+			RaymarchResources.LightCheckpoints.Reset();
+
 			for (OneAxisReadWriteBufferResources& Buffer : RaymarchResources.XYZReadWriteBuffers)
 			{
 				URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(Buffer);
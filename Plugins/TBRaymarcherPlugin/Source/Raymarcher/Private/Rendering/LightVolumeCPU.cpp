@@ -0,0 +1,459 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Rendering/LightVolumeCPU.h"
+
+#include "Async/ParallelFor.h"
+#include "Curves/CurveLinearColor.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Engine/VolumeTexture.h"
+#include "Math/VectorRegister.h"
+#include "Rendering/LightingShaderUtils.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLightVolumeCPU, Log, All);
+
+namespace
+{
+// Same as the defines in RaymarcherCommon.usf.
+constexpr float OneOverSqrt3 = 0.57735026919f;
+constexpr float VolumeDensity = 100.0f;
+
+// Same as the sample count in URaymarchUtils::ColorCurveToTexture.
+constexpr int32 TransferFunctionSampleCount = 256;
+
+// Changes smaller than this are not written into the light volume, same as in the shaders.
+constexpr float MinLightVolumeChange = 1e-3f;
+
+// Returns mip 0 of the texture, if its data is still on the CPU.
+template <typename TextureType>
+const FTexture2DMipMap* GetCPUMip(const TextureType* Texture)
+{
+	const FTexturePlatformData* PlatformData = Texture ? Texture->GetPlatformData() : nullptr;
+	if (!PlatformData || PlatformData->Mips.Num() == 0)
+	{
+		return nullptr;
+	}
+	const FTexture2DMipMap& Mip = PlatformData->Mips[0];
+	if (!Mip.BulkData.IsBulkDataLoaded() || Mip.BulkData.GetBulkDataSize() == 0)
+	{
+		return nullptr;
+	}
+	return &Mip;
+}
+
+// Converts voxels of type T to float, multiplying them by Scale.
+template <typename T>
+void ConvertVoxels(const uint8* Data, float Scale, TArray<float>& OutVoxels)
+{
+	const T* Typed = reinterpret_cast<const T*>(Data);
+	for (int32 Index = 0; Index < OutVoxels.Num(); Index++)
+	{
+		OutVoxels[Index] = static_cast<float>(Typed[Index]) * Scale;
+	}
+}
+
+// Axes of the light volume that the X and Y of a slice and the slice index map to, when propagating along the major axis at
+// the index. Same as the permutation matrix returned by GetPermutationMatrix.
+FIntVector GetSliceAxes(const FMajorAxes& Axes, const unsigned index)
+{
+	switch ((uint8) Axes.FaceWeight[index].first / 2)
+	{
+		case 0:
+			return FIntVector(1, 2, 0);
+		case 1:
+			return FIntVector(0, 2, 1);
+		default:
+			return FIntVector(0, 1, 2);
+	}
+}
+
+// Same as FMath::Lerp, for 4 floats at once.
+VectorRegister4Float LerpVector(const VectorRegister4Float& A, const VectorRegister4Float& B, const VectorRegister4Float& Alpha)
+{
+	return VectorAdd(A, VectorMultiply(Alpha, VectorSubtract(B, A)));
+}
+
+// Propagates the light through one slice. Reads the light propagated until the previous slice from ReadBuffer, adds the light
+// reaching this slice to the light volume and writes what's left of it after the voxel into WriteBuffer. Mirrors
+// LightPropagationCommon.usf, one row per task. The bilinear read of the previous slice, the clip weights and the attenuation
+// are done 4 pixels at a time, only sampling the volume and adding to the light volume go pixel by pixel.
+void PropagateSlice(const FLightPropagationInputCPU& Input, FLightVolumeCPU& LightVolume, const FIntVector& TransposedDimensions,
+	const FIntVector& SliceAxes, const int32 Slice, const TArray<float>& ReadBuffer, TArray<float>& WriteBuffer,
+	const float BorderLightAlpha, const FVector2f& PixelOffset, const float StepSize,
+	const FClippingPlaneParameters& LocalClippingParameters, const float Sign)
+{
+	const int32 SizeX = TransposedDimensions.X;
+	const int32 SizeY = TransposedDimensions.Y;
+	const int32 PaddedSizeX = Align(SizeX, 4);
+	const FIntVector& LightDimensions = LightVolume.Dimensions;
+	const FVector3f Resolution(LightDimensions);
+	const int64 Strides[3] = {1, LightDimensions.X, int64(LightDimensions.X) * LightDimensions.Y};
+
+	const FVector3f ClipCenter(LocalClippingParameters.Center);
+	const FVector3f ClipDirection(LocalClippingParameters.Direction);
+	// The offset from a sample to the clipping plane is the clipping direction times the distance to it, so its length in voxel
+	// space is the distance times the length of the direction in voxel space.
+	const float ClipVoxelScale = OneOverSqrt3 * (ClipDirection * Resolution).Size();
+
+	// Every pixel reads the previous slice at the same offset, so the bilinear weights are the same for the whole slice.
+	const int32 OffsetX = FMath::FloorToInt32(PixelOffset.X);
+	const int32 OffsetY = FMath::FloorToInt32(PixelOffset.Y);
+	const float FracX = PixelOffset.X - OffsetX;
+	const float FracY = PixelOffset.Y - OffsetY;
+
+	// Taps of a row at these indexes come from the read buffer, the others are outside of it and read the border light alpha.
+	const int32 TapCount = PaddedSizeX + 1;
+	const int32 FirstReadTap = FMath::Clamp(-OffsetX, 0, TapCount);
+	const int32 EndReadTap = FMath::Clamp(SizeX - OffsetX, FirstReadTap, TapCount);
+
+	// Scratch rows of a task - the taps of both read rows, the light reaching the row and its clip weights, later opacities.
+	TArray<TArray<float>> TaskScratches;
+	ParallelForWithTaskContext(TaskScratches, SizeY,
+		[&](TArray<float>& Scratch, int32 PixelY)
+		{
+			Scratch.SetNumUninitialized(2 * TapCount + 2 * PaddedSizeX);
+			float* Taps[2] = {Scratch.GetData(), Scratch.GetData() + TapCount};
+			float* LightAlphas = Taps[1] + TapCount;
+			float* Opacities = LightAlphas + PaddedSizeX;
+
+			for (int32 Row = 0; Row < 2; Row++)
+			{
+				const int32 ReadY = PixelY + OffsetY + Row;
+				const bool bRowInside = ReadY >= 0 && ReadY < SizeY;
+				for (int32 Tap = 0; Tap < TapCount; Tap++)
+				{
+					const bool bTapInside = bRowInside && Tap >= FirstReadTap && Tap < EndReadTap;
+					Taps[Row][Tap] = bTapInside ? ReadBuffer[ReadY * SizeX + Tap + OffsetX] : BorderLightAlpha;
+				}
+			}
+
+			// Only the sample coordinate along the row changes from pixel to pixel, the terms of the other axes in the distance
+			// to the clipping plane are the same for the whole row.
+			VectorRegister4Float ClipTerms[3];
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				const float Coordinate = Axis == SliceAxes.Y ? PixelY : Slice;
+				ClipTerms[Axis] = VectorSetFloat1(((Coordinate + 0.5f) / Resolution[Axis] - ClipCenter[Axis]) * ClipDirection[Axis]);
+			}
+			const VectorRegister4Float LaneCoordinates = MakeVectorRegisterFloat(0.5f, 1.5f, 2.5f, 3.5f);
+			const VectorRegister4Float RowResolution = VectorSetFloat1(Resolution[SliceAxes.X]);
+			const VectorRegister4Float RowClipCenter = VectorSetFloat1(ClipCenter[SliceAxes.X]);
+			const VectorRegister4Float RowClipDirection = VectorSetFloat1(ClipDirection[SliceAxes.X]);
+			const VectorRegister4Float FracXVector = VectorSetFloat1(FracX);
+			const VectorRegister4Float FracYVector = VectorSetFloat1(FracY);
+			const VectorRegister4Float HalfVector = VectorSetFloat1(0.5f);
+			const VectorRegister4Float ClipVoxelScaleVector = VectorSetFloat1(ClipVoxelScale);
+
+			// The padding pixels at the end of the row are computed too, but never used.
+			for (int32 PixelX = 0; PixelX < PaddedSizeX; PixelX += 4)
+			{
+				const VectorRegister4Float Top =
+					LerpVector(VectorLoad(Taps[0] + PixelX), VectorLoad(Taps[0] + PixelX + 1), FracXVector);
+				const VectorRegister4Float Bottom =
+					LerpVector(VectorLoad(Taps[1] + PixelX), VectorLoad(Taps[1] + PixelX + 1), FracXVector);
+				VectorStore(LerpVector(Top, Bottom, FracYVector), LightAlphas + PixelX);
+
+				const VectorRegister4Float SampleCoordinates =
+					VectorDivide(VectorAdd(VectorSetFloat1(float(PixelX)), LaneCoordinates), RowResolution);
+				ClipTerms[SliceAxes.X] = VectorMultiply(VectorSubtract(SampleCoordinates, RowClipCenter), RowClipDirection);
+				const VectorRegister4Float DistanceToCuttingPlane = VectorAdd(VectorAdd(ClipTerms[0], ClipTerms[1]), ClipTerms[2]);
+				const VectorRegister4Float ClipWeights =
+					VectorAdd(HalfVector, VectorMultiply(ClipVoxelScaleVector, DistanceToCuttingPlane));
+				VectorStore(VectorMin(VectorMax(ClipWeights, VectorZeroFloat()), VectorOneFloat()), Opacities + PixelX);
+			}
+
+			for (int32 PixelX = 0; PixelX < SizeX; PixelX++)
+			{
+				FIntVector Pos;
+				Pos[SliceAxes.X] = PixelX;
+				Pos[SliceAxes.Y] = PixelY;
+				Pos[SliceAxes.Z] = Slice;
+
+				const float ClipWeight = Opacities[PixelX];
+				float Opacity = 0.0f;
+				if (ClipWeight > 0.0f)
+				{
+					const FVector3f SampleUVW = (FVector3f(Pos) + 0.5f) / Resolution;
+					Opacity = Input.SampleWindowedAlpha(Input.SampleVolume(SampleUVW), StepSize * VolumeDensity) * ClipWeight;
+				}
+				Opacities[PixelX] = Opacity;
+
+				const float CurrentLightAlpha = LightAlphas[PixelX];
+				if (FMath::Abs(CurrentLightAlpha) > MinLightVolumeChange)
+				{
+					LightVolume.Voxels[Pos.X * Strides[0] + Pos.Y * Strides[1] + Pos.Z * Strides[2]] += CurrentLightAlpha * Sign;
+				}
+			}
+
+			float* WriteRow = WriteBuffer.GetData() + PixelY * SizeX;
+			int32 PixelX = 0;
+			for (; PixelX + 4 <= SizeX; PixelX += 4)
+			{
+				const VectorRegister4Float Transmittance = VectorSubtract(VectorOneFloat(), VectorLoad(Opacities + PixelX));
+				VectorStore(VectorMultiply(VectorLoad(LightAlphas + PixelX), Transmittance), WriteRow + PixelX);
+			}
+			for (; PixelX < SizeX; PixelX++)
+			{
+				WriteRow[PixelX] = LightAlphas[PixelX] * (1.0f - Opacities[PixelX]);
+			}
+		});
+}
+}	 // namespace
+
+bool FLightPropagationInputCPU::InitFromResources(
+	const FBasicRaymarchRenderingResources& Resources, const UCurveLinearColor* TransferFunctionCurve /*= nullptr*/)
+{
+	const FTexture2DMipMap* VolumeMip = GetCPUMip(Resources.DataVolumeTextureRef);
+	if (!VolumeMip)
+	{
+		UE_LOG(LogLightVolumeCPU, Error, TEXT("Data volume %s has no voxels on the CPU, can't propagate light through it."),
+			Resources.DataVolumeTextureRef ? *Resources.DataVolumeTextureRef->GetName() : TEXT("(null)"));
+		return false;
+	}
+
+	const FIntVector Dimensions(VolumeMip->SizeX, VolumeMip->SizeY, VolumeMip->SizeZ);
+	const EPixelFormat PixelFormat = Resources.DataVolumeTextureRef->GetPlatformData()->PixelFormat;
+	const void* VolumeData = VolumeMip->BulkData.LockReadOnly();
+	const bool bVolumeRead = SetVolumeData(static_cast<const uint8*>(VolumeData), Dimensions, PixelFormat);
+	VolumeMip->BulkData.Unlock();
+	if (!bVolumeRead)
+	{
+		return false;
+	}
+
+	if (Resources.LightVolumeRenderTarget)
+	{
+		LightVolumeDimensions = FIntVector(Resources.LightVolumeRenderTarget->SizeX, Resources.LightVolumeRenderTarget->SizeY,
+			Resources.LightVolumeRenderTarget->SizeZ);
+	}
+	else if (Resources.LightVolumeHalfResolution)
+	{
+		LightVolumeDimensions = FIntVector(FMath::DivideAndRoundUp(Dimensions.X, 2), FMath::DivideAndRoundUp(Dimensions.Y, 2),
+			FMath::DivideAndRoundUp(Dimensions.Z, 2));
+	}
+
+	WindowingParameters = Resources.WindowingParameters;
+
+	if (TransferFunctionCurve)
+	{
+		SetTransferFunctionFromCurve(TransferFunctionCurve);
+		return true;
+	}
+
+	const FTexture2DMipMap* TFMip = GetCPUMip(Resources.TFTextureRef);
+	const EPixelFormat TFFormat = TFMip ? Resources.TFTextureRef->GetPlatformData()->PixelFormat : PF_Unknown;
+	if (!TFMip || (TFFormat != PF_FloatRGBA && TFFormat != PF_B8G8R8A8))
+	{
+		UE_LOG(LogLightVolumeCPU, Error,
+			TEXT("Transfer function texture has no data on the CPU or an unsupported format, provide the transfer function "
+				 "curve instead."));
+		return false;
+	}
+
+	// Only the first row is needed, the rest of the texture is copies of it.
+	const void* TFData = TFMip->BulkData.LockReadOnly();
+	TransferFunctionAlpha.SetNumUninitialized(TFMip->SizeX);
+	for (int32 Index = 0; Index < TFMip->SizeX; Index++)
+	{
+		TransferFunctionAlpha[Index] = TFFormat == PF_FloatRGBA
+										   ? static_cast<const FFloat16Color*>(TFData)[Index].A.GetFloat()
+										   : static_cast<const FColor*>(TFData)[Index].A / 255.0f;
+	}
+	TFMip->BulkData.Unlock();
+	return true;
+}
+
+bool FLightPropagationInputCPU::SetVolumeData(const uint8* Data, const FIntVector& Dimensions, EPixelFormat PixelFormat)
+{
+	if (PixelFormat != PF_G8 && PixelFormat != PF_G16 && PixelFormat != PF_R32_FLOAT)
+	{
+		UE_LOG(LogLightVolumeCPU, Error, TEXT("Can't propagate light through volumes of pixel format %s."),
+			GetPixelFormatString(PixelFormat));
+		return false;
+	}
+
+	VolumeDimensions = Dimensions;
+	LightVolumeDimensions = Dimensions;
+	Voxels.SetNumUninitialized(int64(Dimensions.X) * Dimensions.Y * Dimensions.Z);
+	switch (PixelFormat)
+	{
+		case PF_G8:
+			ConvertVoxels<uint8>(Data, 1.0f / MAX_uint8, Voxels);
+			break;
+		case PF_G16:
+			ConvertVoxels<uint16>(Data, 1.0f / MAX_uint16, Voxels);
+			break;
+		default:
+			ConvertVoxels<float>(Data, 1.0f, Voxels);
+	}
+	return true;
+}
+
+void FLightPropagationInputCPU::SetTransferFunctionFromCurve(const UCurveLinearColor* Curve)
+{
+	TransferFunctionAlpha.SetNumUninitialized(TransferFunctionSampleCount);
+	for (int32 Index = 0; Index < TransferFunctionSampleCount; Index++)
+	{
+		// The texture stores the samples as 16 bit floats.
+		const float Position = float(Index) / float(TransferFunctionSampleCount - 1);
+		TransferFunctionAlpha[Index] = FFloat16(Curve->GetLinearColorValue(Position).A).GetFloat();
+	}
+}
+
+bool FLightPropagationInputCPU::IsValid() const
+{
+	return VolumeDimensions.GetMin() > 0 && Voxels.Num() == int64(VolumeDimensions.X) * VolumeDimensions.Y * VolumeDimensions.Z &&
+		   TransferFunctionAlpha.Num() > 0 && LightVolumeDimensions.GetMin() > 0;
+}
+
+float FLightPropagationInputCPU::SampleVolume(const FVector3f& UVW) const
+{
+	const float BorderValue = WindowingParameters.Center - 0.5f * WindowingParameters.Width;
+	const FVector3f Position = UVW * FVector3f(VolumeDimensions) - 0.5f;
+	const FIntVector Floor(FMath::FloorToInt32(Position.X), FMath::FloorToInt32(Position.Y), FMath::FloorToInt32(Position.Z));
+	const FVector3f Frac = Position - FVector3f(Floor);
+
+	auto Fetch = [&](int32 X, int32 Y, int32 Z)
+	{
+		if (X < 0 || Y < 0 || Z < 0 || X >= VolumeDimensions.X || Y >= VolumeDimensions.Y || Z >= VolumeDimensions.Z)
+		{
+			return BorderValue;
+		}
+		return Voxels[(int64(Z) * VolumeDimensions.Y + Y) * VolumeDimensions.X + X];
+	};
+
+	float Planes[2];
+	for (int32 Z = 0; Z < 2; Z++)
+	{
+		const int32 VoxelZ = Floor.Z + Z;
+		const float Top = FMath::Lerp(Fetch(Floor.X, Floor.Y, VoxelZ), Fetch(Floor.X + 1, Floor.Y, VoxelZ), Frac.X);
+		const float Bottom = FMath::Lerp(Fetch(Floor.X, Floor.Y + 1, VoxelZ), Fetch(Floor.X + 1, Floor.Y + 1, VoxelZ), Frac.X);
+		Planes[Z] = FMath::Lerp(Top, Bottom, Frac.Y);
+	}
+	return FMath::Lerp(Planes[0], Planes[1], Frac.Z);
+}
+
+float FLightPropagationInputCPU::SampleWindowedAlpha(float Value, float StepSize) const
+{
+	const float TFPos = (Value - WindowingParameters.Center + (WindowingParameters.Width / 2.0f)) / WindowingParameters.Width;
+	if ((TFPos < 0.0f && WindowingParameters.LowCutoff) || (TFPos > 1.0f && WindowingParameters.HighCutoff))
+	{
+		return 0.0f;
+	}
+
+	// Bilinear sampling with clamping, same as the transfer function sampler.
+	const int32 SampleCount = TransferFunctionAlpha.Num();
+	const float Position = TFPos * SampleCount - 0.5f;
+	const int32 Floor = FMath::FloorToInt32(Position);
+	const float First = TransferFunctionAlpha[FMath::Clamp(Floor, 0, SampleCount - 1)];
+	const float Second = TransferFunctionAlpha[FMath::Clamp(Floor + 1, 0, SampleCount - 1)];
+	const float Alpha = FMath::Clamp(FMath::Lerp(First, Second, Position - Floor), 0.0f, 1.0f);
+	return 1.0f - FMath::Pow(1.0f - Alpha, StepSize);
+}
+
+void FLightVolumeCPU::Init(const FIntVector& InDimensions)
+{
+	Dimensions = InDimensions;
+	Voxels.SetNumZeroed(int64(Dimensions.X) * Dimensions.Y * Dimensions.Z);
+}
+
+void AddDirLightToSingleLightVolume_CPU(const FLightPropagationInputCPU& Input, FLightVolumeCPU& LightVolume,
+	const FDirLightParameters& LightParameters, const bool Added, const FRaymarchWorldParameters& WorldParameters)
+{
+	check(Input.IsValid() && LightVolume.Dimensions == Input.LightVolumeDimensions);
+
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
+	{
+		UE_LOG(LogLightVolumeCPU, Warning, TEXT("Returning because the directional light doesn't have a direction."));
+		return;
+	}
+
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+	const FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+
+	TArray<float> Buffers[2];
+	for (unsigned i = 0; i < 2; i++)
+	{
+		// Break if the axis weight == 0
+		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		{
+			break;
+		}
+
+		const FIntVector TransposedDimensions = GetTransposedDimensions(LocalMajorAxes, LightVolume.Dimensions, i);
+		const float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, i);
+		Buffers[0].Init(LightAlpha, TransposedDimensions.X * TransposedDimensions.Y);
+		Buffers[1].Init(LightAlpha, TransposedDimensions.X * TransposedDimensions.Y);
+
+		// The shader gets the offset into the read buffer in UVs, the CPU works with pixels.
+		const FVector2D UVOffset =
+			GetUVOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions);
+		const FVector2f PixelOffset(float(UVOffset.X * TransposedDimensions.X), float(UVOffset.Y * TransposedDimensions.Y));
+
+		FVector UVWOffset;
+		float StepSize;
+		GetStepSizeAndUVWOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions,
+			WorldParameters, StepSize, UVWOffset);
+
+		int Start, Stop, AxisDirection;
+		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, TransposedDimensions.Z);
+		const FIntVector SliceAxes = GetSliceAxes(LocalMajorAxes, i);
+
+		for (int j = Start; j != Stop; j += AxisDirection)
+		{
+			// Switch read and write buffers each slice.
+			const TArray<float>& ReadBuffer = Buffers[j % 2];
+			TArray<float>& WriteBuffer = Buffers[1 - j % 2];
+			PropagateSlice(Input, LightVolume, TransposedDimensions, SliceAxes, j, ReadBuffer, WriteBuffer, LightAlpha, PixelOffset,
+				StepSize, LocalClippingParameters, Added ? 1.0f : -1.0f);
+		}
+	}
+}
+
+bool ComputeLightVolume_CPU(const FLightPropagationInputCPU& Input, TArrayView<const FDirLightParameters> Lights,
+	const FRaymarchWorldParameters& WorldParameters, FLightVolumeCPU& OutLightVolume)
+{
+	if (!Input.IsValid())
+	{
+		UE_LOG(LogLightVolumeCPU, Error, TEXT("Can't compute a light volume, the light propagation input is not set up."));
+		return false;
+	}
+
+	OutLightVolume.Init(Input.LightVolumeDimensions);
+	for (const FDirLightParameters& Light : Lights)
+	{
+		AddDirLightToSingleLightVolume_CPU(Input, OutLightVolume, Light, true, WorldParameters);
+	}
+	return true;
+}
+
+bool BuildOpacityVolume_CPU(const FLightPropagationInputCPU& Input, FLightVolumeCPU& OutOpacityVolume)
+{
+	if (!Input.IsValid())
+	{
+		UE_LOG(LogLightVolumeCPU, Error, TEXT("Can't build an opacity volume, the light propagation input is not set up."));
+		return false;
+	}
+
+	OutOpacityVolume.Init(Input.LightVolumeDimensions);
+	const FIntVector& Dimensions = OutOpacityVolume.Dimensions;
+	const FVector3f Resolution(Dimensions);
+	ParallelFor(Dimensions.Z,
+		[&](int32 Z)
+		{
+			for (int32 Y = 0; Y < Dimensions.Y; Y++)
+			{
+				for (int32 X = 0; X < Dimensions.X; X++)
+				{
+					const FVector3f SampleUVW = (FVector3f(X, Y, Z) + 0.5f) / Resolution;
+					OutOpacityVolume.Voxels[(int64(Z) * Dimensions.Y + Y) * Dimensions.X + X] =
+						Input.SampleWindowedAlpha(Input.SampleVolume(SampleUVW), 1.0f);
+				}
+			}
+		});
+	return true;
+}
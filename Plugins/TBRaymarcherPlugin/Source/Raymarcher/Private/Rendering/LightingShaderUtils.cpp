@@ -46,17 +46,22 @@ FMajorAxes FMajorAxes::GetMajorAxes(FVector LightPos)
 }
 
 FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FRHITexture3D* VolumeRef, const unsigned index)
+{
+	return GetTransposedDimensions(Axes, FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeY(), VolumeRef->GetSizeZ()), index);
+}
+
+FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FIntVector& VolumeDimensions, const unsigned index)
 {
 	FCubeFace face = Axes.FaceWeight[index].first;
 	unsigned axis = (uint8) face / 2;
 	switch (axis)
 	{
 		case 0:	   // going along X -> Volume Y = x, volume Z = y
-			return FIntVector(VolumeRef->GetSizeY(), VolumeRef->GetSizeZ(), VolumeRef->GetSizeX());
+			return FIntVector(VolumeDimensions.Y, VolumeDimensions.Z, VolumeDimensions.X);
 		case 1:	   // going along Y -> Volume X = x, volume Z = y
-			return FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeZ(), VolumeRef->GetSizeY());
+			return FIntVector(VolumeDimensions.X, VolumeDimensions.Z, VolumeDimensions.Y);
 		case 2:	   // going along Z -> Volume X = x, volume Y = y
-			return FIntVector(VolumeRef->GetSizeX(), VolumeRef->GetSizeY(), VolumeRef->GetSizeZ());
+			return FIntVector(VolumeDimensions.X, VolumeDimensions.Y, VolumeDimensions.Z);
 		default:
 			check(false);
 			return FIntVector(0, 0, 0);
@@ -129,6 +134,17 @@ FVector2D GetUVOffset(FCubeFace Axis, FVector LightPosition, FIntVector Transpos
 }
 
 
+FIntPoint GetPropagationRadius(const FVector2f& PixelOffset)
+{
+	// Bilinear sampling reads the pixel at floor(Offset) and the next one, unless the offset is a whole number of pixels.
+	auto GetAxisRadius = [](float Offset)
+	{
+		const int32 Floor = FMath::FloorToInt32(Offset);
+		return FMath::Max(FMath::Abs(Floor), Offset > Floor ? FMath::Abs(Floor + 1) : 0);
+	};
+	return FIntPoint(GetAxisRadius(PixelOffset.X), GetAxisRadius(PixelOffset.Y));
+}
+
 void GetStepSizeAndUVWOffset(FCubeFace Axis, FVector LightPosition, FIntVector TransposedDimensions,
 	const FRaymarchWorldParameters WorldParameters, float& OutStepSize, FVector& OutUVWOffset)
 {
@@ -194,6 +210,33 @@ FSamplerStateRHIRef GetBufferSamplerRef(uint32 BorderColorInt)
 		FSamplerStateInitializerRHI(SF_Bilinear, AM_Border, AM_Border, AM_Border, 0, 0, 0, 1, BorderColorInt));
 }
 
+FSamplerStateRHIRef GetDataVolumeSamplerRef(const FWindowingParameters& WindowingParameters)
+{
+	// Border color is the zero point of the windowing, which gets changed to 0 on the Transfer Function - reads outside of the
+	// volume don't occlude any light.
+	const float ZeroTFValue = WindowingParameters.Center - 0.5 * WindowingParameters.Width;
+	const uint32 BorderColorInt = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0).ToFColor(false).ToPackedARGB();
+	return RHICreateSamplerState(
+		FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
+}
+
+FRHITexture* GetSampledVolume(const FBasicRaymarchRenderingResources& Resources)
+{
+	UVolumeTexture* SampledVolume =
+		Resources.BrickAtlasTextureRef ? Resources.BrickAtlasTextureRef : Resources.DataVolumeTextureRef;
+	return SampledVolume->GetResource()->TextureRHI;
+}
+
+FLinearColor GetSampledVolumeWindowing(const FBasicRaymarchRenderingResources& Resources)
+{
+	FLinearColor Windowing = Resources.WindowingParameters.ToLinearColor();
+	if (Resources.BrickAtlasTextureRef)
+	{
+		Windowing.A = -(Windowing.A + 1.0f);
+	}
+	return Windowing;
+}
+
 uint32 GetBorderColorIntSingle(FDirLightParameters LightParams, FMajorAxes MajorAxes, unsigned index)
 {
 	// Set alpha channel to the texture's red channel (when reading single-channel, only red component
@@ -264,6 +307,64 @@ void GetLoopStartStopIndexes(
 	}
 }
 
+int GetFirstClipAffectedSlice(const FMajorAxes& MajorAxes, const unsigned index, const FIntVector& VolumeDimensions,
+	const FClippingPlaneParameters& OldLocalClipping, const FClippingPlaneParameters& NewLocalClipping)
+{
+	const FIntVector TransposedDimensions = GetTransposedDimensions(MajorAxes, VolumeDimensions, index);
+	if (OldLocalClipping == NewLocalClipping)
+	{
+		return TransposedDimensions.Z;
+	}
+
+	// Clipping weight of a voxel before clamping to 0-1, same as in the propagation shaders. Weights a hair away from 0 or 1 count
+	// as partially clipped, so that float differences between here and the GPU can't hide a change.
+	constexpr double OneOverSqrt3 = 0.57735026919;
+	constexpr double WeightTolerance = 1e-3;
+	const FVector Resolution(VolumeDimensions);
+	auto GetClipWeight = [&Resolution](const FClippingPlaneParameters& Clipping, const FVector& UVW)
+	{
+		const double DistanceToPlane = FVector::DotProduct(UVW - Clipping.Center, Clipping.Direction);
+		return 0.5 + OneOverSqrt3 * DistanceToPlane * (Clipping.Direction * Resolution).Size();
+	};
+
+	int Start, Stop, AxisDirection;
+	GetLoopStartStopIndexes(Start, Stop, AxisDirection, MajorAxes, index, TransposedDimensions.Z);
+	const int Axis = (uint8) MajorAxes.FaceWeight[index].first / 2;
+
+	int SliceIndex = 0;
+	for (int j = Start; j != Stop; j += AxisDirection, SliceIndex++)
+	{
+		// The weight is linear in the position until it gets clamped, so if the voxel centers in the corners of the slice are
+		// all fully visible (or all fully clipped) with both planes, so is every voxel in between.
+		bool bVisibleInBoth = true;
+		bool bClippedInBoth = true;
+		for (int Corner = 0; Corner < 4; Corner++)
+		{
+			FVector UVW;
+			for (int Dimension = 0, SliceDimension = 0; Dimension < 3; Dimension++)
+			{
+				int Voxel = j;
+				if (Dimension != Axis)
+				{
+					Voxel = (Corner >> SliceDimension++) & 1 ? VolumeDimensions[Dimension] - 1 : 0;
+				}
+				UVW[Dimension] = (Voxel + 0.5) / Resolution[Dimension];
+			}
+
+			const double OldWeight = GetClipWeight(OldLocalClipping, UVW);
+			const double NewWeight = GetClipWeight(NewLocalClipping, UVW);
+			bVisibleInBoth &= OldWeight >= 1.0 + WeightTolerance && NewWeight >= 1.0 + WeightTolerance;
+			bClippedInBoth &= OldWeight <= -WeightTolerance && NewWeight <= -WeightTolerance;
+		}
+
+		if (!bVisibleInBoth && !bClippedInBoth)
+		{
+			break;
+		}
+	}
+	return SliceIndex;
+}
+
 void TransitionBufferResources(
 	FRHICommandListImmediate& RHICmdList, FRHITexture* NewlyReadableTexture, FRHIUnorderedAccessView* NewlyWriteableUAV)
 {
@@ -5,6 +5,8 @@
 
 #include "Rendering/LightingShaders.h"
 
+#include "Actor/RaymarchVolume.h"
+#include "Algo/AllOf.h"
 #include "DataDrivenShaderPlatformInfo.h"
 #include "Engine/TextureRenderTargetVolume.h"
 #include "Rendering/LightingShaderUtils.h"
@@ -17,76 +19,274 @@
 
 #define LOCTEXT_NAMESPACE "RaymarchPlugin"
 
-IMPLEMENT_GLOBAL_SHADER(FAddDirLightShader, "/Raymarcher/Private/AddDirLightShader.usf", "MainComputeShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(
+	FAddDirLightMultiSliceShader, "/Raymarcher/Private/AddDirLightMultiSliceShader.usf", "MainComputeShader", SF_Compute);
 
-IMPLEMENT_GLOBAL_SHADER(FChangeDirLightShader, "/Raymarcher/Private/ChangeDirLightShader.usf", "MainComputeShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(
+	FAddDirLightsBatchedShader, "/Raymarcher/Private/AddDirLightsBatchedShader.usf", "MainComputeShader", SF_Compute);
+
+IMPLEMENT_GLOBAL_SHADER(
+	FChangeClipDirLightShader, "/Raymarcher/Private/ChangeClipDirLightShader.usf", "MainComputeShader", SF_Compute);
 
 // For making statistics about GPU use - Adding Lights.
 DECLARE_FLOAT_COUNTER_STAT(TEXT("AddingLights"), STAT_GPU_AddingLights, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUAddingLights, TEXT("AddingLightsToVolume"));
+DECLARE_GPU_STAT_NAMED(GPUAddingLightsBatched, TEXT("AddingLightsToVolumeBatched"));
 
 // For making statistics about GPU use - Changing Lights.
 DECLARE_FLOAT_COUNTER_STAT(TEXT("ChangingLights"), STAT_GPU_ChangingLights, STATGROUP_GPU);
 DECLARE_GPU_STAT_NAMED(GPUChangingLights, TEXT("ChangingLightsInVolume"));
 
+// For making statistics about GPU use - Recording light checkpoints and updating lights for a moved clipping plane.
+DECLARE_GPU_STAT_NAMED(GPUAddingLightsWithCheckpoints, TEXT("AddingLightsToVolumeWithCheckpoints"));
+DECLARE_GPU_STAT_NAMED(GPUUpdatingClipping, TEXT("UpdatingClippingInVolume"));
+
 // #TODO profile with different dimensions.
 #define NUM_THREADS_PER_GROUP_DIMENSION 16	  // This has to be the same as in the compute shader's spec [X, X, 1]
 
-void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
-	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters)
+// A light propagating along one of its major axes, added to (Sign 1) or removed from (Sign -1) the light volume. LightIndex is
+// the light's index in FLightPropagationCheckpoints::Lights when recording checkpoints.
+struct FLightAxis
 {
-	check(IsInRenderingThread());
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	unsigned Index;
+	float Sign;
+	int32 LightIndex;
+};
+
+// Sorts the major axes of the light into the cube faces they propagate along.
+static void AddLightAxes(const FDirLightParameters& LightParameters, const FTransform& VolumeTransform, const float Sign,
+	TArray<FLightAxis> (&FaceLightAxes)[6], const int32 LightIndex = INDEX_NONE)
+{
+	FLightAxis LightAxis;
+	LightAxis.Sign = Sign;
+	LightAxis.LightIndex = LightIndex;
+	GetLocalLightParamsAndAxes(LightParameters, VolumeTransform, LightAxis.LocalLightParams, LightAxis.LocalMajorAxes);
+	for (LightAxis.Index = 0; LightAxis.Index < 2; LightAxis.Index++)
+	{
+		if (LightAxis.LocalMajorAxes.FaceWeight[LightAxis.Index].second == 0)
+		{
+			break;
+		}
+		FaceLightAxes[(uint8) LightAxis.LocalMajorAxes.FaceWeight[LightAxis.Index].first].Add(LightAxis);
+	}
+}
 
-	// Can't have directional light without direction...
-	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
+// Returns the number of checkpoints of a light propagating through SliceCount slices. Nothing continues from the last slice, so
+// it's never saved.
+static int32 GetCheckpointCount(const int32 SliceCount)
+{
+	return FMath::Max(1, (SliceCount - 1) / FLightPropagationCheckpoints::Interval);
+}
+
+// Returns the checkpoint the SliceIndex-th slice (counted from where the light enters the volume) gets saved into, or -1. Every
+// FLightPropagationCheckpoints::Interval-th slice is saved, except for the last one.
+static int GetWriteCheckpoint(const int SliceIndex, const int SliceCount)
+{
+	const bool bSaveCheckpoint = (SliceIndex + 1) % FLightPropagationCheckpoints::Interval == 0 && SliceIndex + 1 != SliceCount;
+	return bSaveCheckpoint ? (SliceIndex + 1) / FLightPropagationCheckpoints::Interval - 1 : -1;
+}
+
+// Propagates the light axes with FAddDirLightsBatchedShader, every face in one sweep per batch of up to
+// FAddDirLightsBatchedShader::MaxBatchedLights. With checkpoints, every face gets a texture array holding the checkpoints of all
+// its light axes, one after another. The light volume has to be transitioned to compute already.
+static void PropagateLightAxesBatched_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources& Resources, const TArray<FLightAxis> (&FaceLightAxes)[6],
+	const FClippingPlaneParameters& LocalClippingParameters, const FRaymarchWorldParameters& WorldParameters,
+	FLightPropagationCheckpoints* Checkpoints = nullptr)
+{
+	if (Algo::AllOf(FaceLightAxes, [](const TArray<FLightAxis>& LightAxes) { return LightAxes.IsEmpty(); }))
 	{
-		GEngine->AddOnScreenDebugMessage(
-			-1, 100.0f, FColor::Yellow, TEXT("Returning because the directional light doesn't have a direction."));
 		return;
 	}
 
-	FDirLightParameters LocalLightParams;
-	FMajorAxes LocalMajorAxes;
-	// Calculate local Light parameters and corresponding axes.
-	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+	TShaderMapRef<FAddDirLightsBatchedShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
+	SetComputePipelineState(RHICmdList, ShaderRHI);
+	FSamplerStateRHIRef DataVolumeSamplerRef = GetDataVolumeSamplerRef(Resources.WindowingParameters);
 
-	// Transform clipping parameters into local space.
-	FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+	for (int FaceIndex = 0; FaceIndex < 6; FaceIndex++)
+	{
+		const TArray<FLightAxis>& LightAxes = FaceLightAxes[FaceIndex];
+		if (LightAxes.IsEmpty())
+		{
+			continue;
+		}
 
-	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, AddDirLightToSingleLightVolume_RenderThread, TEXT("Adding Lights"));
-	SCOPED_GPU_STAT(RHICmdList, GPUAddingLights);
+		// The checkpoints have the buffers' format, so that continuing from them gives exactly the same light.
+		int32 CheckpointCount = 0;
+		if (Checkpoints)
+		{
+			const FLightAxis& FirstAxis = LightAxes[0];
+			const FIntVector TransposedDimensions = GetTransposedDimensions(FirstAxis.LocalMajorAxes,
+				Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), FirstAxis.Index);
+			const OneAxisReadWriteBufferResources& Buffers = GetBuffers(FirstAxis.LocalMajorAxes, FirstAxis.Index, Resources);
+			CheckpointCount = GetCheckpointCount(TransposedDimensions.Z);
+			FRHITextureCreateDesc Desc = FRHITextureCreateDesc::Create2DArray(TEXT("Light Propagation Checkpoints"),
+				TransposedDimensions.X, TransposedDimensions.Y, LightAxes.Num() * CheckpointCount,
+				Buffers.BatchedBuffers[0]->GetFormat());
+			Desc.Flags |= TexCreate_ShaderResource | TexCreate_UAV;
+			Desc.NumMips = 1;
+			Desc.NumSamples = 1;
+			Checkpoints->Textures[FaceIndex] = RHICreateTexture(Desc);
+			Checkpoints->UAVs[FaceIndex] = RHICreateUnorderedAccessView(Checkpoints->Textures[FaceIndex]);
+			for (int LightIndex = 0; LightIndex < LightAxes.Num(); LightIndex++)
+			{
+				const FLightAxis& LightAxis = LightAxes[LightIndex];
+				Checkpoints->Lights[LightAxis.LightIndex].FirstCheckpoints[LightAxis.Index] = LightIndex * CheckpointCount;
+			}
+		}
+		const FUnorderedAccessViewRHIRef CheckpointsUAV = Checkpoints ? Checkpoints->UAVs[FaceIndex] : nullptr;
 
-	// TODO create structure with 2 sets of buffers so we don't have to look for them again in the
-	// actual shader loop! Clear buffers for the two axes we will be using.
-	for (unsigned i = 0; i < 2; i++)
-	{
-		// Break if the axis weight == 0
-		if (LocalMajorAxes.FaceWeight[i].second == 0)
+		for (int BatchStart = 0; BatchStart < LightAxes.Num(); BatchStart += FAddDirLightsBatchedShader::MaxBatchedLights)
 		{
-			break;
+			const int BatchCount = FMath::Min(LightAxes.Num() - BatchStart, FAddDirLightsBatchedShader::MaxBatchedLights);
+
+			// All lights in the batch go along the same face, so they share dimensions, buffers and the loop.
+			const FLightAxis& FirstAxis = LightAxes[BatchStart];
+			const FCubeFace Face = FirstAxis.LocalMajorAxes.FaceWeight[FirstAxis.Index].first;
+			FIntVector TransposedDimensions = GetTransposedDimensions(FirstAxis.LocalMajorAxes,
+				Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), FirstAxis.Index);
+			OneAxisReadWriteBufferResources& Buffers = GetBuffers(FirstAxis.LocalMajorAxes, FirstAxis.Index, Resources);
+			FMatrix PermutationMatrix = GetPermutationMatrix(FirstAxis.LocalMajorAxes, FirstAxis.Index);
+
+			int Start, Stop, AxisDirection;
+			GetLoopStartStopIndexes(Start, Stop, AxisDirection, FirstAxis.LocalMajorAxes, FirstAxis.Index, TransposedDimensions.Z);
+
+			TArray<FVector4f, TInlineAllocator<FAddDirLightsBatchedShader::MaxBatchedLights>> LightOffsets;
+			TArray<FVector4f, TInlineAllocator<FAddDirLightsBatchedShader::MaxBatchedLights>> LightParameters;
+			for (int LightIndex = BatchStart; LightIndex < BatchStart + BatchCount; LightIndex++)
+			{
+				const FLightAxis& LightAxis = LightAxes[LightIndex];
+				FVector2D UVOffset = GetUVOffset(Face, -LightAxis.LocalLightParams.LightDirection, TransposedDimensions);
+				const FVector2f PixelOffset(float(UVOffset.X * TransposedDimensions.X), float(UVOffset.Y * TransposedDimensions.Y));
+				const FVector2f OffsetFloor(FMath::FloorToFloat(PixelOffset.X), FMath::FloorToFloat(PixelOffset.Y));
+				LightOffsets.Add(
+					FVector4f(OffsetFloor.X, OffsetFloor.Y, PixelOffset.X - OffsetFloor.X, PixelOffset.Y - OffsetFloor.Y));
+
+				FVector UVWOffset;
+				float StepSize;
+				GetStepSizeAndUVWOffset(
+					Face, -LightAxis.LocalLightParams.LightDirection, TransposedDimensions, WorldParameters, StepSize, UVWOffset);
+				const float LightAlpha = GetLightAlpha(LightAxis.LocalLightParams, LightAxis.LocalMajorAxes, LightAxis.Index);
+				LightParameters.Add(FVector4f(StepSize, LightAlpha, LightAxis.Sign, float(LightIndex * CheckpointCount)));
+			}
+
+			uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
+			uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
+
+			int SliceIndex = 0;
+			for (int j = Start; j != Stop; j += AxisDirection, SliceIndex++)
+			{
+				// Since UE 5.3, parameters set through the legacy helpers don't stay bound from one dispatch to the next (setting
+				// only the per-slice ones with SetLoop breaks the propagation), so the per-batch ones are set again for every
+				// slice. Everything they're computed from is prepared once per batch above.
+				ComputeShader->SetBatchParameters(RHICmdList, ShaderRHI, Resources, DataVolumeSamplerRef, LocalClippingParameters,
+					PermutationMatrix, LightOffsets, LightParameters);
+				// Switch read and write buffers each slice.
+				const int ReadIndex = SliceIndex % 2;
+				ComputeShader->SetLoop(RHICmdList, ShaderRHI, j, Start, Buffers.BatchedBuffers[ReadIndex],
+					Buffers.BatchedUAVs[1 - ReadIndex], CheckpointsUAV, GetWriteCheckpoint(SliceIndex, TransposedDimensions.Z));
+				RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
+			}
 		}
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, i, Resources);
+	}
+	ComputeShader->UnbindResources(RHICmdList, ShaderRHI);
+}
 
-		float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, i);
+FRHITexture* GetLightPropagationOpacityVolume(const FBasicRaymarchRenderingResources& Resources, FVector4f& OutChannel)
+{
+	if (Resources.OpacityVolumeMode == EOpacityVolumeMode::Disabled || !Resources.OpacityVolumeRenderTarget)
+	{
+		OutChannel = FVector4f::Zero();
+		return GBlackVolumeTexture->TextureRHI;
+	}
+	OutChannel = Resources.OpacityVolumeMode == EOpacityVolumeMode::Opacity ? FVector4f(1, 0, 0, 0) : FVector4f(0, 0, 0, 1);
+	return Resources.OpacityVolumeRenderTarget->GetResource()->TextureRHI;
+}
 
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[0], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), LightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[1], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), LightAlpha);
+// Propagates a light along one of its major axes with FAddDirLightMultiSliceShader, several slices per dispatch. Returns false
+// without propagating anything if multi-slice propagation is disabled or the light's halo doesn't fit into the shader's tiles,
+// the axis has to go through PropagateLightAxesBatched_RenderThread then. The light volume has to be transitioned to compute
+// already.
+static bool PropagateLightAxisMultiSlice_RenderThread(FRHICommandListImmediate& RHICmdList,
+	FBasicRaymarchRenderingResources& Resources, const FDirLightParameters& LocalLightParams, const FMajorAxes& LocalMajorAxes,
+	const unsigned AxisIndex, const bool Added, const FClippingPlaneParameters& LocalClippingParameters,
+	const FRaymarchWorldParameters& WorldParameters)
+{
+	if (!Resources.bMultiSliceLightPropagation)
+	{
+		return false;
 	}
 
-	// Find and set compute shader
-	TShaderMapRef<FAddDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
-	SetComputePipelineState(RHICmdList, ShaderRHI);
+	// Get the X, Y and Z transposed into the current axis orientation.
+	FIntVector TransposedDimensions = GetTransposedDimensions(
+		LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), AxisIndex);
 
-	// Transition the resource to Compute-shader.
-	// Otherwise the renderer might touch our textures while we're writing to them.
-	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+	FVector2D UVOffset =
+		GetUVOffset(LocalMajorAxes.FaceWeight[AxisIndex].first, -LocalLightParams.LightDirection, TransposedDimensions);
+
+	// Offset into the previous slice in pixels and how many pixels around it every pixel depends on.
+	const FVector2f PixelOffset(float(UVOffset.X * TransposedDimensions.X), float(UVOffset.Y * TransposedDimensions.Y));
+	const FIntPoint Radius = GetPropagationRadius(PixelOffset);
+	if (Radius.GetMax() > FAddDirLightMultiSliceShader::MaxHalo)
+	{
+		return false;
+	}
+
+	OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, AxisIndex, Resources);
+	FMatrix PermutationMatrix = GetPermutationMatrix(LocalMajorAxes, AxisIndex);
+
+	FVector UVWOffset;
+	float StepSize;
+	GetStepSizeAndUVWOffset(LocalMajorAxes.FaceWeight[AxisIndex].first, -LocalLightParams.LightDirection, TransposedDimensions,
+		WorldParameters, StepSize, UVWOffset);
+
+	int Start, Stop, AxisDirection;
+	GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, AxisIndex, TransposedDimensions.Z);
+
+	SCOPED_DRAW_EVENT(RHICmdList, MultiSlice);
+	TShaderMapRef<FAddDirLightMultiSliceShader> MultiSliceShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	SetComputePipelineState(RHICmdList, MultiSliceShader.GetComputeShader());
+
+	// Every slice grows the halo by the radius, go through as many slices as the largest halo allows. Without a radius, the whole
+	// axis fits into one dispatch.
+	const int SlicesPerDispatch =
+		Radius.GetMax() == 0 ? TransposedDimensions.Z : FAddDirLightMultiSliceShader::MaxHalo / Radius.GetMax();
+	const FIntPoint Halo = Radius * SlicesPerDispatch;
+	const float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, AxisIndex);
+	const uint32 TileGroupsX = FMath::DivideAndRoundUp(TransposedDimensions.X, FAddDirLightMultiSliceShader::TileSize);
+	const uint32 TileGroupsY = FMath::DivideAndRoundUp(TransposedDimensions.Y, FAddDirLightMultiSliceShader::TileSize);
+	FSamplerStateRHIRef DataVolumeSamplerRef = GetDataVolumeSamplerRef(Resources.WindowingParameters);
+
+	int DispatchIndex = 0;
+	for (int j = Start; j != Stop; DispatchIndex++)
+	{
+		const int SliceCount = FMath::Min(SlicesPerDispatch, FMath::Abs(Stop - j));
+		MultiSliceShader->SetAxisParameters(RHICmdList, MultiSliceShader.GetComputeShader(), Resources, DataVolumeSamplerRef,
+			LocalClippingParameters, Added, PermutationMatrix, PixelOffset, Halo, StepSize, AxisDirection, LightAlpha);
+		// Switch read and write buffers each dispatch.
+		const int ReadIndex = DispatchIndex % 2;
+		MultiSliceShader->SetSlices(RHICmdList, MultiSliceShader.GetComputeShader(), j, SliceCount, DispatchIndex == 0,
+			Buffers.Buffers[ReadIndex], Buffers.UAVs[1 - ReadIndex]);
+		RHICmdList.DispatchComputeShader(TileGroupsX, TileGroupsY, 1);
+		j += SliceCount * AxisDirection;
+	}
+	MultiSliceShader->UnbindResources(RHICmdList, MultiSliceShader.GetComputeShader());
+	return true;
+}
+
+// Propagates every major axis of the light that fits into FAddDirLightMultiSliceShader right away and sorts the rest into the
+// cube faces for PropagateLightAxesBatched_RenderThread.
+static void PropagateLightMultiSlice_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources& Resources,
+	const FDirLightParameters& LightParameters, const bool Added, const FClippingPlaneParameters& LocalClippingParameters,
+	const FRaymarchWorldParameters& WorldParameters, TArray<FLightAxis> (&FaceLightAxes)[6])
+{
+	FDirLightParameters LocalLightParams;
+	FMajorAxes LocalMajorAxes;
+	// Calculate local Light parameters and corresponding axes.
+	GetLocalLightParamsAndAxes(LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
 
 	for (unsigned i = 0; i < 2; i++)
 	{
@@ -95,71 +295,75 @@ void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICm
 		{
 			break;
 		}
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, i, Resources);
-
-		uint32 ColorInt = GetBorderColorIntSingle(LocalLightParams, LocalMajorAxes, i);
-		FSamplerStateRHIRef readBuffSampler = GetBufferSamplerRef(ColorInt);
+		if (!PropagateLightAxisMultiSlice_RenderThread(RHICmdList, Resources, LocalLightParams, LocalMajorAxes, i, Added,
+				LocalClippingParameters, WorldParameters))
+		{
+			const FLightAxis LightAxis{LocalLightParams, LocalMajorAxes, i, Added ? 1.0f : -1.0f, INDEX_NONE};
+			FaceLightAxes[(uint8) LocalMajorAxes.FaceWeight[i].first].Add(LightAxis);
+		}
+	}
+}
 
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
+void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters)
+{
+	check(IsInRenderingThread());
 
-		FVector2D UVOffset =
-			GetUVOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions);
-		FMatrix PermutationMatrix = GetPermutationMatrix(LocalMajorAxes, i);
+	// Can't have directional light without direction...
+	if (LightParameters.LightDirection == FVector(0.0, 0.0, 0.0))
+	{
+		GEngine->AddOnScreenDebugMessage(
+			-1, 100.0f, FColor::Yellow, TEXT("Returning because the directional light doesn't have a direction."));
+		return;
+	}
 
-		FIntVector LightVolumeSize = FIntVector(Resources.LightVolumeRenderTarget->SizeX, Resources.LightVolumeRenderTarget->SizeY,
-			Resources.LightVolumeRenderTarget->SizeZ);
+	// Transform clipping parameters into local space.
+	FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
 
-		FVector UVWOffset;
-		float StepSize;
-		GetStepSizeAndUVWOffset(LocalMajorAxes.FaceWeight[i].first, -LocalLightParams.LightDirection, TransposedDimensions,
-			WorldParameters, StepSize, UVWOffset);
+	// For GPU profiling.
+	SCOPED_DRAW_EVENTF(RHICmdList, AddDirLightToSingleLightVolume_RenderThread, TEXT("Adding Lights"));
+	SCOPED_GPU_STAT(RHICmdList, GPUAddingLights);
 
-		// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct,
-		// but consistent!)
-		int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
-		float LongestVoxelSide = 1.0f / LowestVoxelCount;
-		UVWOffset.Normalize();
-		UVWOffset *= LongestVoxelSide;
+	// Transition the resource to Compute-shader.
+	// Otherwise the renderer might touch our textures while we're writing to them.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
 
-		uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
-		uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
+	// The multi-slice shader is used for every axis the light's halo fits into its tiles, the remaining axes go through the
+	// batched shader as a batch of one. Both give the same light volume, a light can be removed by either one, whichever added it.
+	TArray<FLightAxis> FaceLightAxes[6];
+	PropagateLightMultiSlice_RenderThread(
+		RHICmdList, Resources, LightParameters, Added, LocalClippingParameters, WorldParameters, FaceLightAxes);
+	PropagateLightAxesBatched_RenderThread(RHICmdList, Resources, FaceLightAxes, LocalClippingParameters, WorldParameters);
 
-		int Start, Stop, AxisDirection;
-		GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, i, TransposedDimensions.Z);
+	// Transition resources back to the renderer.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+}
+void AddDirLightsToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters> Lights, const bool Added, const FRaymarchWorldParameters WorldParameters)
+{
+	check(IsInRenderingThread());
 
-		for (int j = Start; j != Stop; j += AxisDirection)
+	// Sort the lights by the cube faces they propagate along, every face gets propagated in one sweep per batch.
+	TArray<FLightAxis> FaceLightAxes[6];
+	for (const FDirLightParameters& LightParameters : Lights)
+	{
+		// Can't have directional light without direction...
+		if (LightParameters.LightDirection != FVector(0.0, 0.0, 0.0))
 		{
-			// Set all compute shader parameters
-			// TODO find out why this has to be set for every invocation when it was fine to just SetLoop before UE 5.3
-			ComputeShader->SetRaymarchParameters(
-				RHICmdList, ShaderRHI, LocalClippingParameters, Resources.WindowingParameters.ToLinearColor());
-			ComputeShader->SetRaymarchResources(RHICmdList, ShaderRHI,
-				Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-				Resources.TFTextureRef->GetResource()->TextureRHI->GetTexture2D(), Resources.WindowingParameters);
-			ComputeShader->SetLightAdded(RHICmdList, ShaderRHI, Added);
-			ComputeShader->SetALightVolume(RHICmdList, ShaderRHI, Resources.LightVolumeUAVRef);
-			ComputeShader->SetUVOffset(RHICmdList, ShaderRHI, UVOffset);
-			ComputeShader->SetUVWOffset(RHICmdList, ShaderRHI, UVWOffset);
-			ComputeShader->SetPermutationMatrix(RHICmdList, ShaderRHI, PermutationMatrix);
-			ComputeShader->SetStepSize(RHICmdList, ShaderRHI, StepSize);
-
-			// Switch read and write buffers each row.
-			if (j % 2 == 0)
-			{
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, j, Buffers.Buffers[0], readBuffSampler, Buffers.UAVs[1]);
-			}
-			else
-			{
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, j, Buffers.Buffers[1], readBuffSampler, Buffers.UAVs[0]);
-			}
-			RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
+			AddLightAxes(LightParameters, WorldParameters.VolumeTransform, Added ? 1.0f : -1.0f, FaceLightAxes);
 		}
 	}
 
-	// Unbind UAVs.
-	ComputeShader->UnbindResourcesLightPropagation(RHICmdList, ShaderRHI);
+	// For GPU profiling.
+	SCOPED_DRAW_EVENTF(RHICmdList, AddDirLightsToSingleLightVolume_RenderThread, TEXT("Adding Lights Batched"));
+	SCOPED_GPU_STAT(RHICmdList, GPUAddingLightsBatched);
+
+	// Transition the resource to Compute-shader.
+	// Otherwise the renderer might touch our textures while we're writing to them.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+
+	PropagateLightAxesBatched_RenderThread(
+		RHICmdList, Resources, FaceLightAxes, GetLocalClippingParameters(WorldParameters), WorldParameters);
 
 	// Transition resources back to the renderer.
 	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
@@ -178,148 +382,198 @@ void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RH
 		return;
 	}
 
-	// Create local copies of Light Params, so that if we have to fall back to 2x
-	// AddOrRemoveLight, we can just pass the original parameters.
-	FDirLightParameters RemovedLocalLightParams, AddedLocalLightParams;
-	FMajorAxes RemovedLocalMajorAxes, AddedLocalMajorAxes;
-	// Calculate local Light parameters and corresponding axes.
-	GetLocalLightParamsAndAxes(
-		RemovedLightParameters, WorldParameters.VolumeTransform, RemovedLocalLightParams, RemovedLocalMajorAxes);
-	GetLocalLightParamsAndAxes(AddedLightParameters, WorldParameters.VolumeTransform, AddedLocalLightParams, AddedLocalMajorAxes);
-
-	// If lights have different major axes, do a separate removal and addition.
-	// (Change dir light only works if it runs on the same major axes).
-	if (RemovedLocalMajorAxes.FaceWeight[0].first != AddedLocalMajorAxes.FaceWeight[0].first ||
-		RemovedLocalMajorAxes.FaceWeight[1].first != AddedLocalMajorAxes.FaceWeight[1].first)
+	// Without batches, the old light gets removed and the new one added on their own.
+	if (!Resources.bBatchedLightPropagation)
 	{
 		AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, RemovedLightParameters, false, WorldParameters);
 		AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, AddedLightParameters, true, WorldParameters);
 		return;
 	}
 
-	FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+	// For GPU profiling.
+	SCOPED_DRAW_EVENTF(RHICmdList, ChangeDirLightInSingleLightVolume_RenderThread, TEXT("Changing Lights"));
+	SCOPED_GPU_STAT(RHICmdList, GPUChangingLights);
 
-	// Clear buffers for the two axes we will be using.
-	for (unsigned i = 0; i < 2; i++)
+	// Transition the resource to Compute-shader.
+	// Otherwise the renderer might touch our textures while we're writing to them.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+
+	// Axes fitting into the multi-slice shader go through it on their own, the rest of the old and new light's axes get removed
+	// and added in one sweep for every face they go along.
+	const FClippingPlaneParameters LocalClippingParameters = GetLocalClippingParameters(WorldParameters);
+	TArray<FLightAxis> FaceLightAxes[6];
+	PropagateLightMultiSlice_RenderThread(
+		RHICmdList, Resources, RemovedLightParameters, false, LocalClippingParameters, WorldParameters, FaceLightAxes);
+	PropagateLightMultiSlice_RenderThread(
+		RHICmdList, Resources, AddedLightParameters, true, LocalClippingParameters, WorldParameters, FaceLightAxes);
+	PropagateLightAxesBatched_RenderThread(RHICmdList, Resources, FaceLightAxes, LocalClippingParameters, WorldParameters);
+
+	// Transition resources back to the renderer.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+}
+
+// Re-propagates a light along one of its major axes for a moved clipping plane with FChangeClipDirLightShader, starting at the
+// StartSliceIndex-th slice (counted from where the light enters the volume, has to be a multiple of
+// FLightPropagationCheckpoints::Interval) and continuing from the checkpoint saved right before it. Overwrites all the checkpoints
+// after the start slice. The shader has to be set in the pipeline already.
+static void ChangeClipInDirLight_RenderThread(FRHICommandListImmediate& RHICmdList, FChangeClipDirLightShader& ComputeShader,
+	FRHIComputeShader* ShaderRHI, FBasicRaymarchRenderingResources& Resources, FRHISamplerState* DataVolumeSampler,
+	const FDirLightParameters& LocalLightParams, const FMajorAxes& LocalMajorAxes, const unsigned AxisIndex,
+	const FRaymarchWorldParameters& WorldParameters, const FUnorderedAccessViewRHIRef& CheckpointsUAV, const int CheckpointBase,
+	const int StartSliceIndex, const FClippingPlaneParameters& OldLocalClipping, const FClippingPlaneParameters& NewLocalClipping)
+{
+	const FCubeFace Face = LocalMajorAxes.FaceWeight[AxisIndex].first;
+	const FIntVector TransposedDimensions = GetTransposedDimensions(
+		LocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), AxisIndex);
+	OneAxisReadWriteBufferResources& Buffers = GetBuffers(LocalMajorAxes, AxisIndex, Resources);
+	const FMatrix PermutationMatrix = GetPermutationMatrix(LocalMajorAxes, AxisIndex);
+
+	// Same offset, step size and alpha as in PropagateLightAxesBatched_RenderThread.
+	const FVector2D UVOffset = GetUVOffset(Face, -LocalLightParams.LightDirection, TransposedDimensions);
+	const FVector2f PixelOffset(float(UVOffset.X * TransposedDimensions.X), float(UVOffset.Y * TransposedDimensions.Y));
+	const FVector2f OffsetFloor(FMath::FloorToFloat(PixelOffset.X), FMath::FloorToFloat(PixelOffset.Y));
+	const FVector4f LightOffset(OffsetFloor.X, OffsetFloor.Y, PixelOffset.X - OffsetFloor.X, PixelOffset.Y - OffsetFloor.Y);
+	FVector UVWOffset;
+	float StepSize;
+	GetStepSizeAndUVWOffset(Face, -LocalLightParams.LightDirection, TransposedDimensions, WorldParameters, StepSize, UVWOffset);
+	const float LightAlpha = GetLightAlpha(LocalLightParams, LocalMajorAxes, AxisIndex);
+
+	int Start, Stop, AxisDirection;
+	GetLoopStartStopIndexes(Start, Stop, AxisDirection, LocalMajorAxes, AxisIndex, TransposedDimensions.Z);
+
+	uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
+	uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
+
+	const int FirstSlice = Start + StartSliceIndex * AxisDirection;
+	const int ReadCheckpoint = StartSliceIndex / FLightPropagationCheckpoints::Interval - 1;
+
+	int SliceIndex = StartSliceIndex;
+	for (int j = FirstSlice; j != Stop; j += AxisDirection, SliceIndex++)
+	{
+		// Parameters have to be set for every dispatch, same as in PropagateLightAxesBatched_RenderThread.
+		ComputeShader.SetLightParameters(RHICmdList, ShaderRHI, Resources, DataVolumeSampler, OldLocalClipping, NewLocalClipping,
+			PermutationMatrix, LightOffset, StepSize, LightAlpha);
+		// Switch read and write buffers each slice.
+		const int ReadIndex = SliceIndex % 2;
+		ComputeShader.SetLoop(RHICmdList, ShaderRHI, j, FirstSlice, Buffers.BatchedBuffers[ReadIndex],
+			Buffers.BatchedUAVs[1 - ReadIndex], CheckpointsUAV, CheckpointBase, ReadCheckpoint,
+			GetWriteCheckpoint(SliceIndex, TransposedDimensions.Z));
+		RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
+	}
+}
+
+void AddDirLightsWithCheckpoints_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters> Lights, const FRaymarchWorldParameters WorldParameters)
+{
+	check(IsInRenderingThread());
+	if (!Resources.LightCheckpoints)
+	{
+		return;
+	}
+
+	FLightPropagationCheckpoints& Checkpoints = *Resources.LightCheckpoints;
+	Checkpoints.WorldParameters = WorldParameters;
+	Checkpoints.Lights.Reset();
+	for (int FaceIndex = 0; FaceIndex < 6; FaceIndex++)
 	{
-		// Get the X, Y and Z transposed into the current axis orientation.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			RemovedLocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), i);
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(RemovedLocalMajorAxes, i, Resources);
-
-		float RemovedLightAlpha = GetLightAlpha(RemovedLocalLightParams, RemovedLocalMajorAxes, i);
-		float AddedLightAlpha = GetLightAlpha(AddedLocalLightParams, AddedLocalMajorAxes, i);
-
-		// Clear R/W buffers for Removed Light
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[0], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), RemovedLightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[1], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), RemovedLightAlpha);
-		// Clear R/W buffers for Added Light
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[2], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), AddedLightAlpha);
-		Clear2DTexture_RenderThread(
-			RHICmdList, Buffers.UAVs[3], FIntPoint(TransposedDimensions.X, TransposedDimensions.Y), AddedLightAlpha);
+		Checkpoints.Textures[FaceIndex] = nullptr;
+		Checkpoints.UAVs[FaceIndex] = nullptr;
+	}
+
+	// Same sweeps as AddDirLightsToSingleLightVolume_RenderThread, so that the light is the same as without checkpoints.
+	TArray<FLightAxis> FaceLightAxes[6];
+	for (const FDirLightParameters& LightParameters : Lights)
+	{
+		// Can't have directional light without direction...
+		if (LightParameters.LightDirection != FVector(0.0, 0.0, 0.0))
+		{
+			const int32 LightIndex = Checkpoints.Lights.Add({LightParameters, {0, 0}});
+			AddLightAxes(LightParameters, WorldParameters.VolumeTransform, 1.0f, FaceLightAxes, LightIndex);
+		}
 	}
 
 	// For GPU profiling.
-	SCOPED_DRAW_EVENTF(RHICmdList, ChangeDirLightInSingleLightVolume_RenderThread, TEXT("Changing Lights"));
-	SCOPED_GPU_STAT(RHICmdList, GPUChangingLights);
+	SCOPED_DRAW_EVENTF(RHICmdList, AddDirLightsWithCheckpoints_RenderThread, TEXT("Adding Lights With Checkpoints"));
+	SCOPED_GPU_STAT(RHICmdList, GPUAddingLightsWithCheckpoints);
 
-	TShaderMapRef<FChangeDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	// Transition the resource to Compute-shader.
+	// Otherwise the renderer might touch our textures while we're writing to them.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+
+	PropagateLightAxesBatched_RenderThread(
+		RHICmdList, Resources, FaceLightAxes, GetLocalClippingParameters(WorldParameters), WorldParameters, &Checkpoints);
+
+	// Transition resources back to the renderer.
+	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+}
+
+void UpdateClippingInLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const FRaymarchWorldParameters WorldParameters)
+{
+	check(IsInRenderingThread());
+	if (!Resources.LightCheckpoints)
+	{
+		return;
+	}
+
+	FLightPropagationCheckpoints& Checkpoints = *Resources.LightCheckpoints;
+	if (!Checkpoints.WorldParameters.VolumeTransform.Equals(WorldParameters.VolumeTransform))
+	{
+		UE_LOG(LogRaymarchVolume, Warning,
+			TEXT("Can't update clipping in a light volume, the volume moved since the lights were added."));
+		return;
+	}
+
+	const FClippingPlaneParameters OldLocalClipping = GetLocalClippingParameters(Checkpoints.WorldParameters);
+	const FClippingPlaneParameters NewLocalClipping = GetLocalClippingParameters(WorldParameters);
+	Checkpoints.WorldParameters = WorldParameters;
+
+	FRHITexture3D* LightVolumeRHI = Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D();
+	const FIntVector LightVolumeDimensions(LightVolumeRHI->GetSizeX(), LightVolumeRHI->GetSizeY(), LightVolumeRHI->GetSizeZ());
+
+	// For GPU profiling.
+	SCOPED_DRAW_EVENTF(RHICmdList, UpdateClippingInLightVolume_RenderThread, TEXT("Updating Clipping"));
+	SCOPED_GPU_STAT(RHICmdList, GPUUpdatingClipping);
+
+	TShaderMapRef<FChangeClipDirLightShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
 	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
 	SetComputePipelineState(RHICmdList, ShaderRHI);
+	FSamplerStateRHIRef DataVolumeSamplerRef = GetDataVolumeSamplerRef(Resources.WindowingParameters);
 
-	// Don't need barriers on these - we only ever read/write to the same pixel from one thread ->
-	// no race conditions But we definitely need to transition the resource to Compute-shader
-	// accessible, otherwise the renderer might touch our textures while we're writing them.
+	// Transition the resource to Compute-shader.
+	// Otherwise the renderer might touch our textures while we're writing to them.
 	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
 
-	for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+	for (const FDirLightCheckpoints& LightCheckpoints : Checkpoints.Lights)
 	{
-		// Get Color ints for texture borders.
-		uint32 RemovedColorInt = GetBorderColorIntSingle(RemovedLocalLightParams, RemovedLocalMajorAxes, AxisIndex);
-		uint32 AddedColorInt = GetBorderColorIntSingle(AddedLocalLightParams, AddedLocalMajorAxes, AxisIndex);
-		// Get the sampler for read buffer to use border with the proper light color.
-		FSamplerStateRHIRef RemovedReadBuffSampler = GetBufferSamplerRef(RemovedColorInt);
-		FSamplerStateRHIRef AddedReadBuffSampler = GetBufferSamplerRef(AddedColorInt);
-
-		OneAxisReadWriteBufferResources& Buffers = GetBuffers(RemovedLocalMajorAxes, AxisIndex, Resources);
-		// TODO take these from buffers.
-		FIntVector TransposedDimensions = GetTransposedDimensions(
-			RemovedLocalMajorAxes, Resources.LightVolumeRenderTarget->GetResource()->TextureRHI->GetTexture3D(), AxisIndex);
-
-		FVector2D AddedPixOffset = GetUVOffset(
-			AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection, TransposedDimensions);
-		FVector2D RemovedPixOffset = GetUVOffset(
-			RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection, TransposedDimensions);
-
-		FVector2D AddedUVOffset = GetUVOffset(
-			AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection, TransposedDimensions);
-		FVector2D RemovedUVOffset = GetUVOffset(
-			RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection, TransposedDimensions);
-
-		FVector AddedUVWOffset, RemovedUVWOffset;
-		float AddedStepSize, RemovedStepSize;
-
-		GetStepSizeAndUVWOffset(AddedLocalMajorAxes.FaceWeight[AxisIndex].first, -AddedLocalLightParams.LightDirection,
-			TransposedDimensions, WorldParameters, AddedStepSize, AddedUVWOffset);
-		GetStepSizeAndUVWOffset(RemovedLocalMajorAxes.FaceWeight[AxisIndex].first, -RemovedLocalLightParams.LightDirection,
-			TransposedDimensions, WorldParameters, RemovedStepSize, RemovedUVWOffset);
-
-		// Normalize UVW offset to length of largest voxel size to get rid of artifacts. (Not correct,
-		// but consistent!)
-		int LowestVoxelCount = FMath::Min3(TransposedDimensions.X, TransposedDimensions.Y, TransposedDimensions.Z);
-		float LongestVoxelSide = 1.0f / LowestVoxelCount;
-
-		AddedUVWOffset.Normalize();
-		AddedUVWOffset *= LongestVoxelSide;
-		RemovedUVWOffset.Normalize();
-		RemovedUVWOffset *= LongestVoxelSide;
-
-		FMatrix PermMatrix = GetPermutationMatrix(RemovedLocalMajorAxes, AxisIndex);
-
-		// Get group sizes for compute shader
-		uint32 GroupSizeX = FMath::DivideAndRoundUp(TransposedDimensions.X, NUM_THREADS_PER_GROUP_DIMENSION);
-		uint32 GroupSizeY = FMath::DivideAndRoundUp(TransposedDimensions.Y, NUM_THREADS_PER_GROUP_DIMENSION);
-
-		int Start, Stop, AxisDirection;
-		GetLoopStartStopIndexes(Start, Stop, AxisDirection, RemovedLocalMajorAxes, AxisIndex, TransposedDimensions.Z);
-
-		for (int LoopIndex = Start; LoopIndex != Stop; LoopIndex += AxisDirection)
-		{	 // Switch read and write buffers each cycle.
-			ComputeShader->SetRaymarchParameters(
-				RHICmdList, ShaderRHI, LocalClippingParameters, Resources.WindowingParameters.ToLinearColor());
-			ComputeShader->SetRaymarchResources(RHICmdList, ShaderRHI,
-				Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-				Resources.TFTextureRef->GetResource()->TextureRHI->GetTexture2D(), Resources.WindowingParameters);
-			ComputeShader->SetALightVolume(RHICmdList, ShaderRHI, Resources.LightVolumeUAVRef);
-			ComputeShader->SetStepSizes(RHICmdList, ShaderRHI, AddedStepSize, RemovedStepSize);
-			ComputeShader->SetPermutationMatrix(RHICmdList, ShaderRHI, PermMatrix);
-
-			ComputeShader->SetPixelOffsets(RHICmdList, ShaderRHI, AddedPixOffset, RemovedPixOffset);
-			ComputeShader->SetUVWOffsets(RHICmdList, ShaderRHI, AddedUVWOffset, RemovedUVWOffset);
-
-			if (LoopIndex % 2 == 0)
+		FDirLightParameters LocalLightParams;
+		FMajorAxes LocalMajorAxes;
+		GetLocalLightParamsAndAxes(
+			LightCheckpoints.LightParameters, WorldParameters.VolumeTransform, LocalLightParams, LocalMajorAxes);
+		for (unsigned AxisIndex = 0; AxisIndex < 2; AxisIndex++)
+		{
+			if (LocalMajorAxes.FaceWeight[AxisIndex].second == 0)
 			{
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[0], Buffers.UAVs[1]);
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[2], Buffers.UAVs[3]);
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, LoopIndex, Buffers.Buffers[0], RemovedReadBuffSampler,
-					Buffers.UAVs[1], Buffers.Buffers[2], AddedReadBuffSampler, Buffers.UAVs[3]);
+				break;
 			}
-			else
+
+			// Everything before the first affected slice stays the same, continue from the last checkpoint before it.
+			const int FirstAffectedSlice =
+				GetFirstClipAffectedSlice(LocalMajorAxes, AxisIndex, LightVolumeDimensions, OldLocalClipping, NewLocalClipping);
+			if (FirstAffectedSlice >= GetTransposedDimensions(LocalMajorAxes, LightVolumeDimensions, AxisIndex).Z)
 			{
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[1], Buffers.UAVs[0]);
-				TransitionBufferResources(RHICmdList, Buffers.Buffers[3], Buffers.UAVs[2]);
-				ComputeShader->SetLoop(RHICmdList, ShaderRHI, LoopIndex, Buffers.Buffers[1], RemovedReadBuffSampler,
-					Buffers.UAVs[0], Buffers.Buffers[3], AddedReadBuffSampler, Buffers.UAVs[2]);
+				continue;
 			}
-			RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, 1);
+			const int StartSliceIndex =
+				(FirstAffectedSlice / FLightPropagationCheckpoints::Interval) * FLightPropagationCheckpoints::Interval;
+
+			const uint8 FaceIndex = (uint8) LocalMajorAxes.FaceWeight[AxisIndex].first;
+			ChangeClipInDirLight_RenderThread(RHICmdList, *ComputeShader, ShaderRHI, Resources, DataVolumeSamplerRef,
+				LocalLightParams, LocalMajorAxes, AxisIndex, WorldParameters, Checkpoints.UAVs[FaceIndex],
+				LightCheckpoints.FirstCheckpoints[AxisIndex], StartSliceIndex, OldLocalClipping, NewLocalClipping);
 		}
 	}
-
-	// Unbind Resources.
-	ComputeShader->UnbindResourcesChangeDirLight(RHICmdList, ShaderRHI);
+	ComputeShader->UnbindResources(RHICmdList, ShaderRHI);
 
 	// Transition resources back to the renderer.
 	RHICmdList.Transition(FRHITransitionInfo(Resources.LightVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
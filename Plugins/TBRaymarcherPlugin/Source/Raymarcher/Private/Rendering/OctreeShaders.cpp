@@ -6,6 +6,7 @@
 #include "Rendering/OctreeShaders.h"
 
 #include "Engine/TextureRenderTargetVolume.h"
+#include "Rendering/LightingShaderUtils.h"
 #include "Runtime/RenderCore/Public/RenderUtils.h"
 #include "Util/UtilityShaders.h"
 
@@ -39,10 +40,11 @@ void GenerateOctreeForVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
 	SetComputePipelineState(RHICmdList, ShaderRHI);
 	RHICmdList.Transition(FRHITransitionInfo(Resources.OctreeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
 
-	ComputeShader->SetGeneratingResources(RHICmdList, ShaderRHI,
-		Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetTexture3D(),
-		Resources.OctreeVolumeRenderTarget->MippedTexture3DRTResource, LEAF_NODE_SIZE,
-		Resources.OctreeVolumeRenderTarget->GetNumMips());
+	// Bricked volumes are sampled from their full resolution bricks, but at the voxels of the data volume.
+	const FIntVector VolumeDimensions = Resources.DataVolumeTextureRef->GetResource()->TextureRHI->GetSizeXYZ();
+	ComputeShader->SetGeneratingResources(RHICmdList, ShaderRHI, GetSampledVolume(Resources),
+		Resources.BrickAtlasTextureRef != nullptr, VolumeDimensions, Resources.OctreeVolumeRenderTarget->MippedTexture3DRTResource,
+		LEAF_NODE_SIZE, Resources.OctreeVolumeRenderTarget->GetNumMips());
 
 	const uint32 GroupSizeX = FMath::DivideAndRoundUp(Resources.OctreeVolumeRenderTarget->SizeX, GroupSizePerDimension);
 	const uint32 GroupSizeY = FMath::DivideAndRoundUp(Resources.OctreeVolumeRenderTarget->SizeY, GroupSizePerDimension);
@@ -0,0 +1,46 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Rendering/OpacityVolumeShaders.h"
+
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Runtime/RenderCore/Public/RenderUtils.h"
+
+#define LOCTEXT_NAMESPACE "RaymarchPlugin"
+
+IMPLEMENT_GLOBAL_SHADER(
+	FBuildOpacityVolumeShader, "/Raymarcher/Private/BuildOpacityVolumeShader.usf", "MainComputeShader", SF_Compute);
+
+// For making statistics about GPU use - Building the opacity volume.
+DECLARE_GPU_STAT_NAMED(GPUBuildingOpacityVolume, TEXT("BuildingOpacityVolume"));
+
+void BuildOpacityVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources)
+{
+	check(IsInRenderingThread());
+	if (!Resources.OpacityVolumeRenderTarget || !Resources.OpacityVolumeUAVRef)
+	{
+		return;
+	}
+
+	// For GPU profiling.
+	SCOPED_DRAW_EVENTF(RHICmdList, BuildOpacityVolume_RenderThread, TEXT("BuildingOpacityVolume"));
+	SCOPED_GPU_STAT(RHICmdList, GPUBuildingOpacityVolume);
+
+	TShaderMapRef<FBuildOpacityVolumeShader> ComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	FRHIComputeShader* ShaderRHI = ComputeShader.GetComputeShader();
+	SetComputePipelineState(RHICmdList, ShaderRHI);
+	RHICmdList.Transition(FRHITransitionInfo(Resources.OpacityVolumeUAVRef, ERHIAccess::UAVGraphics, ERHIAccess::UAVCompute));
+
+	ComputeShader->SetBuildParameters(RHICmdList, ShaderRHI, Resources);
+
+	constexpr int32 GroupSize = FBuildOpacityVolumeShader::ThreadsPerGroupDimension;
+	const uint32 GroupSizeX = FMath::DivideAndRoundUp(Resources.OpacityVolumeRenderTarget->SizeX, GroupSize);
+	const uint32 GroupSizeY = FMath::DivideAndRoundUp(Resources.OpacityVolumeRenderTarget->SizeY, GroupSize);
+	const uint32 GroupSizeZ = FMath::DivideAndRoundUp(Resources.OpacityVolumeRenderTarget->SizeZ, GroupSize);
+	RHICmdList.DispatchComputeShader(GroupSizeX, GroupSizeY, GroupSizeZ);
+
+	ComputeShader->UnbindResources(RHICmdList, ShaderRHI);
+	RHICmdList.Transition(FRHITransitionInfo(Resources.OpacityVolumeUAVRef, ERHIAccess::UAVCompute, ERHIAccess::UAVGraphics));
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -18,6 +18,7 @@
 #include "SceneUtils.h"
 #include "ShaderParameterUtils.h"
 #include "Rendering/OctreeShaders.h"
+#include "Rendering/OpacityVolumeShaders.h"
 #include "VolumeTextureToolkit/Public/TextureUtilities.h"
 
 #include <Engine/TextureRenderTargetVolume.h>
@@ -48,23 +49,33 @@ void URaymarchUtils::AddDirLightToSingleVolume(const FBasicRaymarchRenderingReso
 		LightAdded = true;
 	}
 
-	if (bGPUSync)
-	{
-		// Call the actual rendering code on RenderThread.
-		// #todo fix GPUSync'd version of shader.
-		//ENQUEUE_RENDER_COMMAND(CaptureCommand)
-		//([=](FRHICommandListImmediate& RHICmdList) {
-		//	AddDirLightToSingleLightVolume_GPUSync_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
-		//});
-	}
-	else
+	// bGPUSync is ignored - the GPU synced shader (see LightingShadersExperimental.h) is disabled until it's fixed.
+	// #todo fix GPUSync'd version of shader.
+
+	// Call the actual rendering code on RenderThread.
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
+	});
+}
+
+void URaymarchUtils::AddDirLightsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const TArray<FDirLightParameters>& Lights, const bool Added, const FRaymarchWorldParameters WorldParameters, bool& LightsAdded)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI)
 	{
-		// Call the actual rendering code on RenderThread.
-		ENQUEUE_RENDER_COMMAND(CaptureCommand)
-		([=](FRHICommandListImmediate& RHICmdList) {
-			AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, LightParameters, Added, WorldParameters);
-		});
+		LightsAdded = false;
+		return;
 	}
+	LightsAdded = true;
+
+	// Call the actual rendering code on RenderThread.
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddDirLightsToSingleLightVolume_RenderThread(RHICmdList, Resources, Lights, Added, WorldParameters);
+	});
 }
 
 void URaymarchUtils::ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResources& Resources,
@@ -91,6 +102,46 @@ void URaymarchUtils::ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResourc
 	});
 }
 
+void URaymarchUtils::AddDirLightsWithCheckpointsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const TArray<FDirLightParameters>& Lights, const FRaymarchWorldParameters WorldParameters, bool& LightsAdded)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI ||
+		!Resources.LightCheckpoints)
+	{
+		LightsAdded = false;
+		return;
+	}
+	LightsAdded = true;
+
+	// Call the actual rendering code on RenderThread.
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		AddDirLightsWithCheckpoints_RenderThread(RHICmdList, Resources, Lights, WorldParameters);
+	});
+}
+
+void URaymarchUtils::UpdateClippingInSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+	const FRaymarchWorldParameters WorldParameters, bool& LightsUpdated)
+{
+	if (!Resources.DataVolumeTextureRef || !Resources.DataVolumeTextureRef->GetResource() || !Resources.TFTextureRef->GetResource() ||
+		!Resources.LightVolumeRenderTarget->GetResource() || !Resources.DataVolumeTextureRef->GetResource()->TextureRHI ||
+		!Resources.TFTextureRef->GetResource()->TextureRHI || !Resources.LightVolumeRenderTarget->GetResource()->TextureRHI ||
+		!Resources.LightCheckpoints)
+	{
+		LightsUpdated = false;
+		return;
+	}
+	LightsUpdated = true;
+
+	// Call the actual rendering code on RenderThread.
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList) {
+		UpdateClippingInLightVolume_RenderThread(RHICmdList, Resources, WorldParameters);
+	});
+}
+
 void URaymarchUtils::GenerateOctree(FBasicRaymarchRenderingResources& Resources)
 {
 	// Call the actual rendering code on RenderThread. We capture by value so that if
@@ -101,6 +152,21 @@ void URaymarchUtils::GenerateOctree(FBasicRaymarchRenderingResources& Resources)
 	});
 }
 
+void URaymarchUtils::BuildOpacityVolume(const FBasicRaymarchRenderingResources& Resources)
+{
+	if (!Resources.OpacityVolumeRenderTarget)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can't build an opacity volume, the resources don't have one."));
+		return;
+	}
+
+	ENQUEUE_RENDER_COMMAND(CaptureCommand)
+	([=](FRHICommandListImmediate& RHICmdList)
+	{
+		BuildOpacityVolume_RenderThread(RHICmdList, Resources);
+	});
+}
+
 void URaymarchUtils::ClearResourceLightVolumes(const FBasicRaymarchRenderingResources Resources, float ClearValue)
 {
 	if (!Resources.LightVolumeRenderTarget)
@@ -193,6 +259,18 @@ void URaymarchUtils::CreateBufferTextures(FIntPoint Size, EPixelFormat PixelForm
 			RHICreateTexture(Desc);
 		RWBuffers.UAVs[i] = GetCmdList().CreateUnorderedAccessView(RWBuffers.Buffers[i]);
 	}
+
+	FRHITextureCreateDesc BatchedDesc = FRHITextureCreateDesc::Create2DArray(
+		TEXT("Batched Illumination Buffer"), Size.X, Size.Y, FAddDirLightsBatchedShader::MaxBatchedLights, PixelFormat);
+	BatchedDesc.Flags |= TexCreate_ShaderResource | TexCreate_UAV;
+	BatchedDesc.NumMips = 1;
+	BatchedDesc.NumSamples = 1;
+
+	for (int i = 0; i < 2; i++)
+	{
+		RWBuffers.BatchedBuffers[i] = RHICreateTexture(BatchedDesc);
+		RWBuffers.BatchedUAVs[i] = GetCmdList().CreateUnorderedAccessView(RWBuffers.BatchedBuffers[i]);
+	}
 }
 
 void URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(OneAxisReadWriteBufferResources& Buffer)
@@ -214,6 +292,16 @@ void URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(OneAxisReadWriteBuff
 		}
 		TextureRef = nullptr;
 	}
+
+	for (FUnorderedAccessViewRHIRef& UAV : Buffer.BatchedUAVs)
+	{
+		UAV.SafeRelease();
+	}
+
+	for (FTextureRHIRef& TextureRef : Buffer.BatchedBuffers)
+	{
+		TextureRef.SafeRelease();
+	}
 }
 
 void URaymarchUtils::GetVolumeTextureDimensions(UVolumeTexture* Texture, FIntVector& Dimensions)
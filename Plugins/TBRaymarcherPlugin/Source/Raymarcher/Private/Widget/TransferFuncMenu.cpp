@@ -16,6 +16,12 @@ bool UTransferFuncMenu::Initialize()
 		SaveButton->OnClicked.AddDynamic(this, &UTransferFuncMenu::OnSaveClicked);
 	}
 
+	if (AutoWindowButton)
+	{
+		AutoWindowButton->OnClicked.Clear();
+		AutoWindowButton->OnClicked.AddDynamic(this, &UTransferFuncMenu::OnAutoWindowClicked);
+	}
+
 	if (WindowCenterBox)
 	{
 		WindowCenterBox->OnValueChanged.BindDynamic(this, &UTransferFuncMenu::OnCenterChanged);
@@ -61,6 +67,19 @@ void UTransferFuncMenu::OnSaveClicked()
 	}
 }
 
+void UTransferFuncMenu::OnAutoWindowClicked()
+{
+	for (ARaymarchVolume* ListenerVolume : ListenerVolumes)
+	{
+		ListenerVolume->SetPercentileWindow();
+	}
+
+	if (RangeProviderVolume)
+	{
+		SetWindowSliders(RangeProviderVolume->VolumeAsset->ImageInfo.GetPercentileWindowingParameters());
+	}
+}
+
 void UTransferFuncMenu::OnCenterChanged(float Value)
 {
 	// Set Center in Raymarch volume
@@ -124,21 +143,7 @@ void UTransferFuncMenu::OnNewVolumeLoaded()
 	if (RangeProviderVolume)
 	{
 		FWindowingParameters DefaultParameters = RangeProviderVolume->VolumeAsset->ImageInfo.DefaultWindowingParameters;
-		if (WindowCenterBox)
-		{
-			WindowCenterBox->MinMax =
-				FVector2D(RangeProviderVolume->VolumeAsset->ImageInfo.MinValue, RangeProviderVolume->VolumeAsset->ImageInfo.MaxValue);
-			WindowCenterBox->SetValue(RangeProviderVolume->VolumeAsset->ImageInfo.DenormalizeValue(DefaultParameters.Center));
-
-			WindowCenterBox->SetAllLabelsFromSlider();
-		}
-
-		if (WindowWidthBox)
-		{
-			WindowWidthBox->MinMax = FVector2D(-1000, 4000);
-			WindowWidthBox->SetValue(RangeProviderVolume->VolumeAsset->ImageInfo.DenormalizeRange(DefaultParameters.Width));
-			WindowWidthBox->SetAllLabelsFromSlider();
-		}
+		SetWindowSliders(DefaultParameters);
 
 		if (LowCutOffCheckBox)
 		{
@@ -164,6 +169,31 @@ void UTransferFuncMenu::OnNewVolumeLoaded()
 	}
 }
 
+void UTransferFuncMenu::SetWindowSliders(const FWindowingParameters& Parameters)
+{
+	// Span the sliders around the percentiles instead of the whole value range, so that a few outliers (e.g. metal in CT) don't
+	// leave the interesting values in a sliver of the slider. Values outside get the slider range extended by SetValue.
+	// Volumes loaded before the histogram existed only have the value range.
+	FVolumeInfo& ImageInfo = RangeProviderVolume->VolumeAsset->ImageInfo;
+	const float Low = ImageInfo.HasHistogram() ? ImageInfo.LowPercentileValue : ImageInfo.MinValue;
+	const float High = ImageInfo.HasHistogram() ? ImageInfo.HighPercentileValue : ImageInfo.MaxValue;
+	const float PercentileRange = High - Low;
+	if (WindowCenterBox)
+	{
+		WindowCenterBox->MinMax = FVector2D(FMath::Max(ImageInfo.MinValue, Low - PercentileRange / 2),
+			FMath::Min(ImageInfo.MaxValue, High + PercentileRange / 2));
+		WindowCenterBox->SetValue(ImageInfo.DenormalizeValue(Parameters.Center));
+		WindowCenterBox->SetAllLabelsFromSlider();
+	}
+
+	if (WindowWidthBox)
+	{
+		WindowWidthBox->MinMax = FVector2D(0, 2 * PercentileRange);
+		WindowWidthBox->SetValue(ImageInfo.DenormalizeRange(Parameters.Width));
+		WindowWidthBox->SetAllLabelsFromSlider();
+	}
+}
+
 void UTransferFuncMenu::SetRangeProviderVolume(ARaymarchVolume* NewRangeProviderVolume)
 {
 	if (NewRangeProviderVolume)
@@ -38,6 +38,7 @@ bool UVolumeLoadMenu::Initialize()
 		AssetSelectionComboBox->OnSelectionChanged.AddDynamic(this, &UVolumeLoadMenu::OnAssetSelected);
 	}
 
+	UpdateLoadWidgets();
 	return true;
 }
 
@@ -53,22 +54,43 @@ void UVolumeLoadMenu::OnLoadF32Clicked()
 
 void UVolumeLoadMenu::PerformLoad(bool bNormalized)
 {
-	if (ListenerVolumes.Num() > 0)
+	if (LoadHandle)
 	{
-		UVolumeAsset* OutAsset = UVolumeTextureToolkitBPLibrary::LoadVolumeFromFileDialog(bNormalized);
+		UE_LOG(VolumeLoadMenu, Warning, TEXT("A volume is already being loaded, wait for it to finish."));
+		return;
+	}
 
-		if (OutAsset)
+	if (ListenerVolumes.Num() > 0)
+	{
+		FString FileName;
+		if (!UVolumeTextureToolkitBPLibrary::OpenVolumeFileDialog(FileName))
 		{
-			// Add the asset to list of already loaded assets and select it through the combobox. This will call
-			// OnAssetSelected().
-			AssetArray.Add(OutAsset);
-			AssetSelectionComboBox->AddOption(GetNameSafe(OutAsset));
-			AssetSelectionComboBox->SetSelectedOption(GetNameSafe(OutAsset));
+			return;
 		}
-		else
+
+		// Load on a worker thread, so that the game (and the headset) keep running while the file is read and converted.
+		IVolumeLoader* Loader = UVolumeTextureToolkitBPLibrary::GetLoaderForFile(FileName);
+
+		// Show a downsampled preview right away if the file has one, the full volume replaces it once it's loaded.
+		if (UVolumeAsset* PreviewAsset = Loader->CreatePreviewVolumeFromFile(FileName, bNormalized, !bNormalized))
 		{
-			UE_LOG(VolumeLoadMenu, Error, TEXT("Loading Volume From file dialog failed"));
+			for (ARaymarchVolume* ListenerVolume : ListenerVolumes)
+			{
+				ListenerVolume->SetVolumeAsset(PreviewAsset);
+			}
 		}
+
+		LoadHandle = Loader->CreateVolumeFromFileAsync(FileName, bNormalized, !bNormalized,
+			FOnVolumeLoadProgress::CreateWeakLambda(this,
+				[this](const FVolumeLoadProgress& Progress)
+				{
+					if (LoadProgressBar)
+					{
+						LoadProgressBar->SetPercent(Progress.GetFraction());
+					}
+				}),
+			FOnVolumeLoadFinished::CreateUObject(this, &UVolumeLoadMenu::OnVolumeLoaded));
+		UpdateLoadWidgets();
 	}
 	else
 	{
@@ -77,6 +99,43 @@ void UVolumeLoadMenu::PerformLoad(bool bNormalized)
 	}
 }
 
+void UVolumeLoadMenu::OnVolumeLoaded(UVolumeAsset* VolumeAsset)
+{
+	LoadHandle.Reset();
+	UpdateLoadWidgets();
+
+	if (VolumeAsset)
+	{
+		// Add the asset to list of already loaded assets and select it through the combobox. This will call
+		// OnAssetSelected().
+		AssetArray.Add(VolumeAsset);
+		AssetSelectionComboBox->AddOption(GetNameSafe(VolumeAsset));
+		AssetSelectionComboBox->SetSelectedOption(GetNameSafe(VolumeAsset));
+	}
+	else
+	{
+		UE_LOG(VolumeLoadMenu, Error, TEXT("Loading Volume From file dialog failed"));
+	}
+}
+
+void UVolumeLoadMenu::UpdateLoadWidgets()
+{
+	const bool bIsLoading = LoadHandle.IsValid();
+	if (LoadG16Button)
+	{
+		LoadG16Button->SetIsEnabled(!bIsLoading);
+	}
+	if (LoadF32Button)
+	{
+		LoadF32Button->SetIsEnabled(!bIsLoading);
+	}
+	if (LoadProgressBar)
+	{
+		LoadProgressBar->SetPercent(0.0f);
+		LoadProgressBar->SetVisibility(bIsLoading ? ESlateVisibility::Visible : ESlateVisibility::Collapsed);
+	}
+}
+
 void UVolumeLoadMenu::OnAssetSelected(FString AssetName, ESelectInfo::Type SelectType)
 {
 	UVolumeAsset* SelectedAsset = nullptr;
@@ -60,7 +60,8 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool SetVolumeAsset(UVolumeAsset* InVolumeAsset);
 
-	/** Use faster shader for light calculation. Leads to instability with more lights.*/
+	/** Unused. Used to switch to the GPU synced light propagation shader, which is disabled until it's fixed. How the lights
+	 * get propagated is set by bMultiSliceLightPropagation and bBatchedLightPropagation in RaymarchResources.*/
 	UPROPERTY(EditAnywhere)
 	bool bFastShader = true;
 
@@ -81,11 +82,11 @@ protected:
 	/** Updates the world parameters to the current state of the volume and clipping plane**/
 	void UpdateWorldParameters();
 
+public:
 	/** Recalculates all lights in the LightsArray. **/
 	UFUNCTION()
 	void ResetAllLights();
 
-public:
 #if WITH_EDITOR
 	/** Fired when curve gradient is updated.*/
 	FDelegateHandle CurveGradientUpdateDelegateHandle;
@@ -168,6 +169,16 @@ public:
 	/** If set to true, octree will be recomputed on next tick.**/
 	bool bRequestedOctreeRebuild = false;
 
+	/** If set to true, the opacity volume (if there is one) will be rebuilt before the lights get reset.**/
+	bool bRequestedOpacityRebuild = false;
+
+	/** True while the light checkpoints match the lights and the volume transform in the light volume. Every light reset
+		records them with incremental clipping updates, see FBasicRaymarchRenderingResources::bIncrementalClippingUpdate.**/
+	bool bLightCheckpointsValid = false;
+
+	/** True if the clipping plane was updated incrementally since the last light reset.**/
+	bool bClippingUpdatedIncrementally = false;
+
 	/** Raymarch the volume based on defined material. **/
 	UPROPERTY(EditAnywhere)
 	ERaymarchMaterial SelectRaymarchMaterial;
@@ -222,9 +233,14 @@ public:
 	/** Sets material Windowing Parameters. Called after changing Window Center or Width.**/
 	void SetMaterialVolumeParameters();
 
-	/** Sets material Windowing Parameters. Called after changing Window Center or Width.**/
+	/** Sets material Windowing Parameters. Called after changing Window Center or Width. The lit material gets a negative low
+	 * cutoff if it's given the colored opacity volume, see IsColoredOpacityVolume in WindowedSampling.usf. The lit and intensity
+	 * materials get a negative high cutoff if they're given a brick atlas, see IsBrickedVolume in BrickedSampling.usf.**/
 	void SetMaterialWindowingParameters();
 
+	/** Returns true if the lit material reads the colored opacity volume instead of the data volume and transfer function.**/
+	bool IsLitMaterialUsingOpacityVolume() const;
+
 	/** Sets material Clipping Parameters. Called when the clip plane moves relative to the volume. The parameters are to be
 	 * provided in Volume-Local space. **/
 	void SetMaterialClippingParameters();
@@ -233,6 +249,15 @@ public:
 	UFUNCTION(BlueprintPure)
 	void GetMinMaxValues(float& Min, float& Max);
 
+	/** API function to get the 0.5th and 99.5th percentile of the current VolumeAsset's values, computed when it was loaded.**/
+	UFUNCTION(BlueprintPure)
+	void GetPercentileValues(float& Low, float& High);
+
+	/** Sets the window to span the percentiles of the current VolumeAsset (see FVolumeInfo::GetPercentileWindowingParameters).
+	 * Cutoffs are left as they are.**/
+	UFUNCTION(BlueprintCallable)
+	void SetPercentileWindow();
+
 	/** Gets window center in the Lit Raymarch Material. **/
 	UFUNCTION(BlueprintCallable)
 	float GetWindowCenter();
@@ -264,4 +289,9 @@ public:
 	/** Sets the maximum amount of steps to be taken when raymarching.**/
 	UFUNCTION(BlueprintCallable)
 	void SetRaymarchSteps(float InRaymarchingSteps);
+
+	/** Scales the volume mesh to the size of the volume in mm (FVolumeInfo::WorldDimensions). Called by SetVolumeAsset, useful
+	 * for textures set up without a volume asset.**/
+	UFUNCTION(BlueprintCallable)
+	void SetVolumeWorldDimensions(FVector WorldDimensions);
 };
@@ -0,0 +1,87 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "Rendering/RaymarchTypes.h"
+
+class UCurveLinearColor;
+
+/// CPU copy of everything the light propagation shaders read - the data volume, the transfer function and the windowing
+/// parameters - and the dimensions of the light volume they write into. Lets lights be propagated without a GPU (e.g. in
+/// -nullrhi batch jobs) and serves as a ground truth for the compute shaders in tests.
+struct RAYMARCHER_API FLightPropagationInputCPU
+{
+	/// Dimensions of the data volume.
+	FIntVector VolumeDimensions = FIntVector::ZeroValue;
+
+	/// Data volume voxels, X fastest, as the shaders sample them - G8 and G16 data is normalized to [0, 1].
+	TArray<float> Voxels;
+
+	/// Alpha of the transfer function, sampled at evenly spaced positions over [0, 1], same as the transfer function texture.
+	TArray<float> TransferFunctionAlpha;
+
+	FWindowingParameters WindowingParameters;
+
+	/// Dimensions of the light volume. Same as the data volume, or half of it (rounded up) for half resolution light volumes.
+	FIntVector LightVolumeDimensions = FIntVector::ZeroValue;
+
+	/// Reads the data volume and the transfer function of the resources. This only works while the texture data is still on the
+	/// CPU, which is the case for transient textures created by the volume loaders. If TransferFunctionCurve is provided, it gets
+	/// sampled instead of the transfer function texture. Returns false (and logs why) if something couldn't be read.
+	bool InitFromResources(
+		const FBasicRaymarchRenderingResources& Resources, const UCurveLinearColor* TransferFunctionCurve = nullptr);
+
+	/// Sets the data volume from voxels of the provided pixel format (G8, G16 or R32 float). The light volume gets the same
+	/// dimensions. Returns false for other pixel formats.
+	bool SetVolumeData(const uint8* Data, const FIntVector& Dimensions, EPixelFormat PixelFormat);
+
+	/// Samples the curve the same way URaymarchUtils::ColorCurveToTexture does when creating transfer function textures.
+	void SetTransferFunctionFromCurve(const UCurveLinearColor* Curve);
+
+	/// Returns true if the volume, transfer function and light volume dimensions are all set up.
+	bool IsValid() const;
+
+	/// Samples the data volume at the UVW position with trilinear filtering. Outside of the volume, the value at the bottom
+	/// of the window is returned, so that it maps to the start of the transfer function (same as the volume sampler border color).
+	float SampleVolume(const FVector3f& UVW) const;
+
+	/// Same as SampleWindowedTransferFunction in WindowedSampling.usf - returns the alpha of the value after windowing, corrected
+	/// for the provided StepSize.
+	float SampleWindowedAlpha(float Value, float StepSize) const;
+};
+
+/// Light volume propagated on the CPU. Voxels are X fastest, same as the light volume render target.
+struct RAYMARCHER_API FLightVolumeCPU
+{
+	FIntVector Dimensions = FIntVector::ZeroValue;
+
+	TArray<float> Voxels;
+
+	/// Resizes the light volume and sets all voxels to zero.
+	void Init(const FIntVector& InDimensions);
+
+	float GetVoxel(const FIntVector& Voxel) const
+	{
+		return Voxels[(int64(Voxel.Z) * Dimensions.Y + Voxel.Y) * Dimensions.X + Voxel.X];
+	}
+};
+
+/// CPU version of AddDirLightToSingleLightVolume_RenderThread - propagates the light slice-by-slice along its major axes and adds
+/// it to (or removes it from) the light volume, which has to have Input.LightVolumeDimensions. The rows of every slice are
+/// propagated in parallel and 4 pixels at a time, except for sampling the volume. Same formulation as the shaders (see
+/// LightPropagationCommon.usf). The CPU works in 32 bit floats everywhere, while the GPU quantizes the light volume to 8 bits
+/// unless it's 32 bit.
+RAYMARCHER_API void AddDirLightToSingleLightVolume_CPU(const FLightPropagationInputCPU& Input, FLightVolumeCPU& LightVolume,
+	const FDirLightParameters& LightParameters, const bool Added, const FRaymarchWorldParameters& WorldParameters);
+
+/// Creates a light volume for the input and adds all the provided lights to it. Returns false if the input is not valid.
+RAYMARCHER_API bool ComputeLightVolume_CPU(const FLightPropagationInputCPU& Input, TArrayView<const FDirLightParameters> Lights,
+	const FRaymarchWorldParameters& WorldParameters, FLightVolumeCPU& OutLightVolume);
+
+/// CPU version of BuildOpacityVolume_RenderThread for opacity only volumes - the windowed transfer function opacity for a unit
+/// step at the center of every voxel of a volume with Input.LightVolumeDimensions. The voxels have the same layout as the light
+/// volume's. Returns false if the input is not valid.
+RAYMARCHER_API bool BuildOpacityVolume_CPU(const FLightPropagationInputCPU& Input, FLightVolumeCPU& OutOpacityVolume);
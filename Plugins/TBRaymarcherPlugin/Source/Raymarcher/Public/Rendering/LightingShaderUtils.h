@@ -56,6 +56,7 @@ struct FMajorAxes
 
 /// Returns the dimensions of the plane cutting through the volume when going along an axis at the given indes.
 FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FRHITexture3D* VolumeRef, const unsigned index);
+FIntVector GetTransposedDimensions(const FMajorAxes& Axes, const FIntVector& VolumeDimensions, const unsigned index);
 
 /// Returns +1 if going along the specified axis index means increasing the index.
 /// Returns -1 if going along the axis decreases the index.
@@ -71,6 +72,10 @@ static bool SortDescendingWeights(const std::pair<FCubeFace, float>& a, const st
 
 FVector2D GetUVOffset(FCubeFace Axis, FVector LightPosition, FIntVector TransposedDimensions);
 
+/// Returns how many pixels away (along X and Y of the slice) from a pixel the light propagated to it comes from, for the offset
+/// into the previous slice in pixels (GetUVOffset multiplied by the slice size). Bilinear taps with zero weight are not counted.
+FIntPoint GetPropagationRadius(const FVector2f& PixelOffset);
+
 /// For the given axis, light position and volume dimensions and world parameters, return the StepSize and UVW offset.
 ///
 /// StepSize is the distance the light has to travel between 2 layers (in world units) and UVW offset is the offset between a voxel
@@ -86,6 +91,18 @@ void GetLocalLightParamsAndAxes(const FDirLightParameters& LightParameters, cons
 /// The color read from outside the buffer is specified by the BorderColorInt.
 FSamplerStateRHIRef GetBufferSamplerRef(uint32 BorderColorInt);
 
+/// Creates the trilinear SamplerState RHI the propagation shaders sample the data volume with.
+/// Reads outside of the volume return the zero point of the windowing, so they don't occlude any light.
+FSamplerStateRHIRef GetDataVolumeSamplerRef(const FWindowingParameters& WindowingParameters);
+
+/// Returns the texture the propagation shaders sample the data from - the brick atlas of bricked volumes (see
+/// BrickedSampling.usf), otherwise the data volume.
+FRHITexture* GetSampledVolume(const FBasicRaymarchRenderingResources& Resources);
+
+/// Returns the windowing parameters for the texture returned by GetSampledVolume. For a brick atlas, the high cutoff is flagged
+/// by moving it below zero (HighCutoff becomes -(HighCutoff + 1)), see IsBrickedVolume in BrickedSampling.usf.
+FLinearColor GetSampledVolumeWindowing(const FBasicRaymarchRenderingResources& Resources);
+
 /// Returns the integer specifying the color needed for the border sampler.
 /// Used for sampling the light outside the edge of the Read buffer.
 uint32 GetBorderColorIntSingle(FDirLightParameters LightParams, FMajorAxes MajorAxes, unsigned index);
@@ -104,6 +121,13 @@ FMatrix GetPermutationMatrix(FMajorAxes MajorAxes, unsigned index);
 void GetLoopStartStopIndexes(
 	int& OutStart, int& OutStop, int& OutAxisDirection, const FMajorAxes& MajorAxes, const unsigned& index, const int zDimension);
 
+/// Returns the first slice along the axis at the given index (counted along the propagation direction, so 0 is the slice the
+/// light enters the volume through) whose voxels get clipped differently by the two clipping planes (in local space), or the
+/// number of slices along the axis if the planes clip all voxels the same. The light reaching that slice is the same for both
+/// planes, so propagation can continue from there.
+RAYMARCHER_API int GetFirstClipAffectedSlice(const FMajorAxes& MajorAxes, const unsigned index, const FIntVector& VolumeDimensions,
+	const FClippingPlaneParameters& OldLocalClipping, const FClippingPlaneParameters& NewLocalClipping);
+
 // Used for swapping read/write buffers - transitions one to Readable and other to Writable.
 void TransitionBufferResources(
 	FRHICommandListImmediate& RHICmdList, FRHITexture* NewlyReadableTexture, FRHIUnorderedAccessView* NewlyWriteableUAV);
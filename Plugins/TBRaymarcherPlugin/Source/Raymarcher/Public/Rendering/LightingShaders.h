@@ -7,241 +7,227 @@
 
 #include "CoreMinimal.h"
 #include "DataDrivenShaderPlatformInfo.h"
+#include "Engine/TextureRenderTargetVolume.h"
 #include "GlobalShader.h"
 #include "RHICommandList.h"
+#include "Rendering/LightingShaderUtils.h"
 #include "Rendering/RaymarchTypes.h"
+#include "RenderUtils.h"
 #include "ShaderParameterUtils.h"
 #include "ShaderParameters.h"
 #include "VolumeAsset/WindowingParameters.h"
 
+/// Adds (or removes) a single light. With batched light propagation, the light goes through FAddDirLightsBatchedShader as a batch
+/// of one, so that it's removed exactly as AddDirLightsToSingleLightVolume_RenderThread added it. Otherwise it's propagated by
+/// FAddDirLightMultiSliceShader along the axes whose halo fits into its tiles. All of them give the same light, see
+/// LightPropagationCommon.usf.
 void AddDirLightToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
 	const FDirLightParameters LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters);
 
+/// Adds (or removes) all the lights at once. Lights propagating along the same major axis go through the volume together, in
+/// batches of up to FAddDirLightsBatchedShader::MaxBatchedLights.
+void AddDirLightsToSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters> Lights, const bool Added, const FRaymarchWorldParameters WorldParameters);
+
+/// Removes the old light and adds the new one. With batched light propagation, both go through the volume in the same sweep.
 void ChangeDirLightInSingleLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList,
 	FBasicRaymarchRenderingResources Resources, const FDirLightParameters OldLightParameters,
 	const FDirLightParameters NewLightParameters, const FRaymarchWorldParameters WorldParameters);
 
-// A shader implementing adding or removing a single directional light.
-// (As opposed to changing [e.g. add and remove at the same time] a directional light)
-// Only adds the bAdded boolean for toggling adding/removing a light.
-class FAddDirLightShader : public FGlobalShader
+/// Adds all the lights at once like AddDirLightsToSingleLightVolume_RenderThread, saving their propagation into the resources'
+/// light checkpoints along the way (see FLightPropagationCheckpoints). The light volume has to be cleared before.
+void AddDirLightsWithCheckpoints_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const TArray<FDirLightParameters> Lights, const FRaymarchWorldParameters WorldParameters);
+
+/// Updates the lights recorded in the resources' light checkpoints for the clipping plane in WorldParameters. Every light is
+/// re-propagated from the last checkpoint before the first slice whose clipping changed. The volume transform has to be the same
+/// the checkpoints were recorded with.
+void UpdateClippingInLightVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources,
+	const FRaymarchWorldParameters WorldParameters);
+
+/// Returns the opacity volume the light propagation shaders read the opacity from and sets the mask of its channel holding the
+/// opacity (R in opacity only volumes, A in colored ones). Without an opacity volume, that's a black volume and a zero mask.
+FRHITexture* GetLightPropagationOpacityVolume(const FBasicRaymarchRenderingResources& Resources, FVector4f& OutChannel);
+
+// A shader adding or removing a single directional light, propagating it through several slices per dispatch.
+// The light between slices stays in groupshared memory, see AddDirLightMultiSliceShader.usf.
+class FAddDirLightMultiSliceShader : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FAddDirLightShader, Global, RAYMARCHER_API);
+	DECLARE_EXPORTED_SHADER_TYPE(FAddDirLightMultiSliceShader, Global, RAYMARCHER_API);
 
 public:
-	FAddDirLightShader() : FGlobalShader()
+	// Have to be the same as in AddDirLightMultiSliceShader.usf
+	static constexpr int32 TileSize = 32;
+	static constexpr int32 MaxHalo = 8;
+	static constexpr int32 ThreadsPerGroupDimension = 16;
+
+	FAddDirLightMultiSliceShader() : FGlobalShader()
 	{
 	}
 
-	~FAddDirLightShader(){};
-
-	FAddDirLightShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
+	FAddDirLightMultiSliceShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
 	{
 		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
 		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
-
 		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
 		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
 
 		LocalClippingCenter.Bind(Initializer.ParameterMap, TEXT("LocalClippingCenter"), SPF_Mandatory);
 		LocalClippingDirection.Bind(Initializer.ParameterMap, TEXT("LocalClippingDirection"), SPF_Mandatory);
-
 		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
 		StepSize.Bind(Initializer.ParameterMap, TEXT("StepSize"), SPF_Mandatory);
-
 		PermutationMatrix.Bind(Initializer.ParameterMap, TEXT("PermutationMatrix"), SPF_Mandatory);
-		// Actual light volume
 		ALightVolume.Bind(Initializer.ParameterMap, TEXT("ALightVolume"), SPF_Mandatory);
-
-		// Offsets to get location to read from from previous layer.
-		PrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffset"), SPF_Mandatory);
-		UVWOffset.Bind(Initializer.ParameterMap, TEXT("UVWOffset"), SPF_Mandatory);
-
-		// Multiplier for adding or removing light.
 		bAdded.Bind(Initializer.ParameterMap, TEXT("bAdded"), SPF_Mandatory);
-		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Mandatory);
-		// Read buffer and sampler.
+
+		// Propagation through the slices of one dispatch.
+		PrevPixelOffsetFloor.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffsetFloor"), SPF_Mandatory);
+		PrevPixelOffsetFrac.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffsetFrac"), SPF_Mandatory);
+		Halo.Bind(Initializer.ParameterMap, TEXT("Halo"), SPF_Mandatory);
+		FirstSlice.Bind(Initializer.ParameterMap, TEXT("FirstSlice"), SPF_Mandatory);
+		SliceCount.Bind(Initializer.ParameterMap, TEXT("SliceCount"), SPF_Mandatory);
+		AxisDirection.Bind(Initializer.ParameterMap, TEXT("AxisDirection"), SPF_Mandatory);
+		bFirstDispatch.Bind(Initializer.ParameterMap, TEXT("bFirstDispatch"), SPF_Mandatory);
+		BorderLightAlpha.Bind(Initializer.ParameterMap, TEXT("BorderLightAlpha"), SPF_Mandatory);
 		ReadBuffer.Bind(Initializer.ParameterMap, TEXT("ReadBuffer"), SPF_Mandatory);
-		ReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("ReadBufferSampler"), SPF_Mandatory);
-		// Write buffer.
 		WriteBuffer.Bind(Initializer.ParameterMap, TEXT("WriteBuffer"), SPF_Mandatory);
+
+		OpacityVolume.Bind(Initializer.ParameterMap, TEXT("OpacityVolume"), SPF_Mandatory);
+		OpacityChannel.Bind(Initializer.ParameterMap, TEXT("OpacityChannel"), SPF_Mandatory);
 	}
 
-	void SetLightAdded(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, bool bLightAdded)
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetShaderValue(RHICmdList, ShaderRHI, bAdded, bLightAdded ? 1 : -1);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 
-	void SetRaymarchResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture2DRHIRef pTransferFunc, FWindowingParameters WindowingParams)
+	// Sets the parameters that stay the same for all dispatches of one propagation axis. They still have to be set before every
+	// dispatch, so the volume sampler is created once per axis by the caller.
+	void SetAxisParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
+		const FBasicRaymarchRenderingResources& Resources, FRHISamplerState* DataVolumeSampler,
+		FClippingPlaneParameters LocalClippingParams, const bool bLightAdded, const FMatrix& PermMatrix,
+		const FVector2f& PixelOffset, const FIntPoint& HaloSize, const float pStepSize, const int pAxisDirection,
+		const float LightAlpha)
 	{
-		// Set the zero color to fit the zero point of the windowing parameters (Center - Width/2)
-		// so that after sampling out of bounds, it gets changed to 0 on the Transfer Function in
-		// GetTransferFuncPosition() hlsl function.
-		float ZeroTFValue = WindowingParams.Center - 0.5 * WindowingParams.Width;
-
-		FLinearColor VolumeClearColor = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0);
-		const uint32 BorderColorInt = VolumeClearColor.ToFColor(false).ToPackedARGB();
-
-		// Create a static sampler reference and bind it together with the volume texture.
-		FSamplerStateRHIRef DataVolumeSamplerRef = RHICreateSamplerState(
-			FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
-
 		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSamplerRef, pVolume);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef, pTransferFunc);
-	}
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSampler,
+			GetSampledVolume(Resources));
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef,
+			Resources.TFTextureRef->GetResource()->TextureRHI);
 
-	// Sets the shader uniforms in the pipeline.
-	void SetRaymarchParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
-		FClippingPlaneParameters LocalClippingParams, FLinearColor pWindowingParameters)
-	{
 		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingCenter, FVector3f(LocalClippingParams.Center));
 		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingDirection, FVector3f(LocalClippingParams.Direction));
-		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, pWindowingParameters);
-	}
-
-	// Sets the step-size. This is a crucial parameter, because when raymarching, we need to know how long our step was,
-	// so that we can calculate how large an effect the volume's density has.
-	void SetStepSize(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pStepSize)
-	{
+		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, GetSampledVolumeWindowing(Resources));
 		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pStepSize);
-	}
+		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
+		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, Resources.LightVolumeUAVRef);
+		SetShaderValue(RHICmdList, ShaderRHI, bAdded, bLightAdded ? 1 : -1);
 
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
-	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
+		const FIntPoint OffsetFloor(FMath::FloorToInt32(PixelOffset.X), FMath::FloorToInt32(PixelOffset.Y));
+		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffsetFloor, OffsetFloor);
+		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffsetFrac, PixelOffset - FVector2f(OffsetFloor));
+		SetShaderValue(RHICmdList, ShaderRHI, Halo, HaloSize);
+		SetShaderValue(RHICmdList, ShaderRHI, AxisDirection, pAxisDirection);
+		SetShaderValue(RHICmdList, ShaderRHI, BorderLightAlpha, LightAlpha);
 
-	void SetALightVolume(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FUnorderedAccessViewRHIRef pALightVolume)
-	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, pALightVolume);
+		FVector4f Channel;
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, GetLightPropagationOpacityVolume(Resources, Channel));
+		SetShaderValue(RHICmdList, ShaderRHI, OpacityChannel, Channel);
 	}
 
-	void SetPermutationMatrix(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FMatrix PermMatrix)
+	// Sets the slices to propagate through in one dispatch and the buffers to continue from and write into. The first dispatch of
+	// an axis starts with the border light alpha instead of the read buffer.
+	void SetSlices(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int pFirstSlice, const int pSliceCount,
+		const bool bFirst, const FTexture2DRHIRef pReadBuffer, const FUnorderedAccessViewRHIRef pWriteBuffer)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
+		SetShaderValue(RHICmdList, ShaderRHI, FirstSlice, pFirstSlice);
+		SetShaderValue(RHICmdList, ShaderRHI, SliceCount, pSliceCount);
+		SetShaderValue(RHICmdList, ShaderRHI, bFirstDispatch, bFirst ? 1 : 0);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, pReadBuffer);
+		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
 	}
 
-	void UnbindResourcesRaymarch(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
+	void UnbindResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
 	{
 		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
 		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
-	}
-
-	void UnbindResourcesLightPropagation(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
-	{
-		// Unbind volume buffer.
-		UnbindResourcesRaymarch(RHICmdList, ShaderRHI);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, nullptr);
 		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
 		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, nullptr);
-	}
-
-	void SetUVOffset(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector2D PixelOffset)
-	{
-		auto fPixelOffset = FVector2f(PixelOffset);
-		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffset, fPixelOffset);
-	}
-
-	void SetUVWOffset(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector pUVWOffset)
-	{
-		auto fUVWOffset = FVector3f(pUVWOffset);
-		SetShaderValue(RHICmdList, ShaderRHI, UVWOffset, fUVWOffset);
 	}
 
 protected:
-	// Volume texture + transfer function resource parameters
 	LAYOUT_FIELD(FShaderResourceParameter, Volume);
 	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
 	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
 	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
-	// Clipping uniforms
 	LAYOUT_FIELD(FShaderParameter, LocalClippingCenter);
 	LAYOUT_FIELD(FShaderParameter, LocalClippingDirection);
-	// TF intensity Domain
 	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
-	// Step size taken each iteration
 	LAYOUT_FIELD(FShaderParameter, StepSize);
-	// Permutation matrix - used to get position in the volume from axis-aligned X,Y and loop index.
 	LAYOUT_FIELD(FShaderParameter, PermutationMatrix);
-	// Light volume to modify.
 	LAYOUT_FIELD(FShaderResourceParameter, ALightVolume);
-	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, PrevPixelOffset);
-	// And the offset in the volume from the previous volume sample.
-	LAYOUT_FIELD(FShaderParameter, UVWOffset);
-	// Parameter for the added/removed multiplier.
 	LAYOUT_FIELD(FShaderParameter, bAdded);
-	// The current loop index of this shader run.
-	LAYOUT_FIELD(FShaderParameter, Loop);
-	// Read buffer texture and sampler.
+	// Whole pixel and bilinear part of the offset into the previous slice.
+	LAYOUT_FIELD(FShaderParameter, PrevPixelOffsetFloor);
+	LAYOUT_FIELD(FShaderParameter, PrevPixelOffsetFrac);
+	// Pixels around the tile the light gets propagated through, so that the tile is correct after all slices.
+	LAYOUT_FIELD(FShaderParameter, Halo);
+	LAYOUT_FIELD(FShaderParameter, FirstSlice);
+	LAYOUT_FIELD(FShaderParameter, SliceCount);
+	LAYOUT_FIELD(FShaderParameter, AxisDirection);
+	LAYOUT_FIELD(FShaderParameter, bFirstDispatch);
+	// Light outside of the buffers.
+	LAYOUT_FIELD(FShaderParameter, BorderLightAlpha);
 	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBufferSampler);
-	// Write buffer UAV.
 	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffer);
+	// Opacity volume and the mask of its channel holding the opacity (zero if there's no opacity volume).
+	LAYOUT_FIELD(FShaderResourceParameter, OpacityVolume);
+	LAYOUT_FIELD(FShaderParameter, OpacityChannel);
 };
 
-// A shader implementing changing a light in one pass.
-// Works by subtracting the old light and adding the new one.
-// Notice the UE macro DECLARE_SHADER_TYPE, unlike the shaders above (which are abstract)
-// this one actually gets implemented.
-class FChangeDirLightShader : public FGlobalShader
+// A shader adding and removing several directional lights propagating along the same axis in one sweep through the volume.
+// The volume and transfer function are sampled once per voxel for all the lights, see AddDirLightsBatchedShader.usf.
+class FAddDirLightsBatchedShader : public FGlobalShader
 {
-	DECLARE_EXPORTED_SHADER_TYPE(FChangeDirLightShader, Global, RAYMARCHER_API);
+	DECLARE_EXPORTED_SHADER_TYPE(FAddDirLightsBatchedShader, Global, RAYMARCHER_API);
 
 public:
-	FChangeDirLightShader() : FGlobalShader()
+	// Has to be the same as in AddDirLightsBatchedShader.usf
+	static constexpr int32 MaxBatchedLights = 8;
+
+	FAddDirLightsBatchedShader() : FGlobalShader()
 	{
 	}
-	~FChangeDirLightShader(){};
 
-	FChangeDirLightShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
+	FAddDirLightsBatchedShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
 	{
 		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
 		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
-
 		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
 		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
 
 		LocalClippingCenter.Bind(Initializer.ParameterMap, TEXT("LocalClippingCenter"), SPF_Mandatory);
 		LocalClippingDirection.Bind(Initializer.ParameterMap, TEXT("LocalClippingDirection"), SPF_Mandatory);
-
 		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
-		StepSize.Bind(Initializer.ParameterMap, TEXT("StepSize"), SPF_Mandatory);
-
-		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Optional);
 		PermutationMatrix.Bind(Initializer.ParameterMap, TEXT("PermutationMatrix"), SPF_Mandatory);
-
-		// Read buffer and sampler.
-		ReadBuffer.Bind(Initializer.ParameterMap, TEXT("ReadBuffer"), SPF_Optional);
-		ReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("ReadBufferSampler"), SPF_Optional);
-		// Write buffer.
-		WriteBuffer.Bind(Initializer.ParameterMap, TEXT("WriteBuffer"), SPF_Optional);
-		// Actual light volume
 		ALightVolume.Bind(Initializer.ParameterMap, TEXT("ALightVolume"), SPF_Mandatory);
 
-		// Offsets to get location to read from from previous layer.
-		PrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("PrevPixelOffset"), SPF_Mandatory);
-		UVWOffset.Bind(Initializer.ParameterMap, TEXT("UVWOffset"), SPF_Mandatory);
-
-		// Volume texture + Transfer function uniforms
-		RemovedPrevPixelOffset.Bind(Initializer.ParameterMap, TEXT("RemovedPrevPixelOffset"), SPF_Mandatory);
-		RemovedReadBuffer.Bind(Initializer.ParameterMap, TEXT("RemovedReadBuffer"), SPF_Mandatory);
-		RemovedReadBufferSampler.Bind(Initializer.ParameterMap, TEXT("RemovedReadBufferSampler"), SPF_Mandatory);
-		RemovedWriteBuffer.Bind(Initializer.ParameterMap, TEXT("RemovedWriteBuffer"), SPF_Mandatory);
-		RemovedUVWOffset.Bind(Initializer.ParameterMap, TEXT("RemovedUVWOffset"), SPF_Mandatory);
-		RemovedStepSize.Bind(Initializer.ParameterMap, TEXT("RemovedStepSize"), SPF_Mandatory);
+		// Per-light parameters of the batch.
+		LightCount.Bind(Initializer.ParameterMap, TEXT("LightCount"), SPF_Mandatory);
+		LightOffsets.Bind(Initializer.ParameterMap, TEXT("LightOffsets"), SPF_Mandatory);
+		LightParameters.Bind(Initializer.ParameterMap, TEXT("LightParameters"), SPF_Mandatory);
+
+		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Mandatory);
+		FirstSlice.Bind(Initializer.ParameterMap, TEXT("FirstSlice"), SPF_Mandatory);
+		ReadBuffers.Bind(Initializer.ParameterMap, TEXT("ReadBuffers"), SPF_Mandatory);
+		WriteBuffers.Bind(Initializer.ParameterMap, TEXT("WriteBuffers"), SPF_Mandatory);
+		Checkpoints.Bind(Initializer.ParameterMap, TEXT("Checkpoints"), SPF_Mandatory);
+		WriteCheckpoint.Bind(Initializer.ParameterMap, TEXT("WriteCheckpoint"), SPF_Mandatory);
+
+		OpacityVolume.Bind(Initializer.ParameterMap, TEXT("OpacityVolume"), SPF_Mandatory);
+		OpacityChannel.Bind(Initializer.ParameterMap, TEXT("OpacityChannel"), SPF_Mandatory);
 	}
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
@@ -249,179 +235,227 @@ public:
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoopAdd(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
+	// Sets everything that stays the same for all slices of one batch. Offsets are the whole pixels (XY) and bilinear weights (ZW)
+	// of every light's offset into the previous slice, parameters are its step size (X), alpha outside of the buffers (Y), +1
+	// or -1 for adding or removing it (Z) and the first array slice of its checkpoints (W). Parameters have to be set before every
+	// dispatch, so the volume sampler is created once per propagation by the caller.
+	void SetBatchParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
+		const FBasicRaymarchRenderingResources& Resources, FRHISamplerState* DataVolumeSampler,
+		FClippingPlaneParameters LocalClippingParams, const FMatrix& PermMatrix, TArrayView<const FVector4f> pLightOffsets,
+		TArrayView<const FVector4f> pLightParameters)
 	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
+		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSampler,
+			GetSampledVolume(Resources));
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef,
+			Resources.TFTextureRef->GetResource()->TextureRHI);
 
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pRemovedReadBuffer, const FSamplerStateRHIRef pRemovedReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pRemovedWriteBuffer, const FTexture2DRHIRef pAddedReadBuffer,
-		const FSamplerStateRHIRef pAddedReadBuffSampler, const FUnorderedAccessViewRHIRef pAddedWriteBuffer)
-	{
-		// Actually sets the shader uniforms in the pipeline.
-		SetLoopAdd(RHICmdList, ShaderRHI, loopIndex, pAddedReadBuffer, pAddedReadBuffSampler, pAddedWriteBuffer);
-		// Set read/write buffers for removed light.
-		SetUAVParameter(RHICmdList, ShaderRHI, RemovedWriteBuffer, pRemovedWriteBuffer);
-		SetTextureParameter(
-			RHICmdList, ShaderRHI, RemovedReadBuffer, RemovedReadBufferSampler, pRemovedReadBuffSampler, pRemovedReadBuffer);
-	}
+		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingCenter, FVector3f(LocalClippingParams.Center));
+		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingDirection, FVector3f(LocalClippingParams.Direction));
+		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, GetSampledVolumeWindowing(Resources));
+		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
+		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, Resources.LightVolumeUAVRef);
 
-	// Sets loop-dependent uniforms in the pipeline.
-	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int loopIndex,
-		const FTexture2DRHIRef pReadBuffer, const FSamplerStateRHIRef pReadBuffSampler,
-		const FUnorderedAccessViewRHIRef pWriteBuffer)
-	{
-		// Update the Loop index.
-		SetShaderValue(RHICmdList, ShaderRHI, Loop, loopIndex);
-		// Set read/write buffers.
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, pWriteBuffer);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, ReadBufferSampler, pReadBuffSampler, pReadBuffer);
-	}
+		FVector4f Channel;
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, GetLightPropagationOpacityVolume(Resources, Channel));
+		SetShaderValue(RHICmdList, ShaderRHI, OpacityChannel, Channel);
 
-	void SetALightVolume(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FUnorderedAccessViewRHIRef pALightVolume)
-	{
-		// Set the multiplier to -1 if we're removing the light. Set to 1 if adding it.
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, pALightVolume);
+		check(pLightOffsets.Num() == pLightParameters.Num() && pLightOffsets.Num() <= MaxBatchedLights);
+		SetShaderValue(RHICmdList, ShaderRHI, LightCount, pLightOffsets.Num());
+		SetShaderValueArray(RHICmdList, ShaderRHI, LightOffsets, pLightOffsets.GetData(), pLightOffsets.Num());
+		SetShaderValueArray(RHICmdList, ShaderRHI, LightParameters, pLightParameters.GetData(), pLightParameters.Num());
 	}
 
-	void SetPermutationMatrix(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FMatrix PermMatrix)
+	// Sets the slice to propagate through, the first slice of the axis (where the light comes from outside of the volume), the
+	// buffers to read the previous slice from and write this slice into and the checkpoints to save this slice into. Without
+	// checkpoints, the write checkpoint is -1 and the write buffers are bound in their place, as they're never written to then.
+	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int LoopIndex, const int pFirstSlice,
+		const FTextureRHIRef pReadBuffers, const FUnorderedAccessViewRHIRef pWriteBuffers,
+		const FUnorderedAccessViewRHIRef pCheckpoints, const int pWriteCheckpoint)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
+		SetShaderValue(RHICmdList, ShaderRHI, Loop, LoopIndex);
+		SetShaderValue(RHICmdList, ShaderRHI, FirstSlice, pFirstSlice);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffers, pReadBuffers);
+		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffers, pWriteBuffers);
+		SetUAVParameter(RHICmdList, ShaderRHI, Checkpoints, pCheckpoints ? pCheckpoints : pWriteBuffers);
+		SetShaderValue(RHICmdList, ShaderRHI, WriteCheckpoint, pCheckpoints ? pWriteCheckpoint : -1);
 	}
 
-	void SetPixelOffsets(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector2D AddedPixelOffset,
-		FVector2D RemovedPixelOffset)
+	void UnbindResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, PrevPixelOffset, FVector2f(AddedPixelOffset));
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedPrevPixelOffset, FVector2f(RemovedPixelOffset));
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffers, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffers, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, Checkpoints, nullptr);
 	}
 
-	void SetUVWOffsets(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FVector pAddedUVWOffset, FVector pRemovedUVWOffset)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, UVWOffset, FVector3f(pAddedUVWOffset));
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedUVWOffset, FVector3f(pRemovedUVWOffset));
-	}
+protected:
+	LAYOUT_FIELD(FShaderResourceParameter, Volume);
+	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
+	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
+	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
+	LAYOUT_FIELD(FShaderParameter, LocalClippingCenter);
+	LAYOUT_FIELD(FShaderParameter, LocalClippingDirection);
+	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
+	LAYOUT_FIELD(FShaderParameter, PermutationMatrix);
+	LAYOUT_FIELD(FShaderResourceParameter, ALightVolume);
+	// Number of lights in the batch and their offsets and parameters.
+	LAYOUT_FIELD(FShaderParameter, LightCount);
+	LAYOUT_FIELD(FShaderParameter, LightOffsets);
+	LAYOUT_FIELD(FShaderParameter, LightParameters);
+	LAYOUT_FIELD(FShaderParameter, Loop);
+	LAYOUT_FIELD(FShaderParameter, FirstSlice);
+	// Texture array read buffer and its UAV write counterpart, one slice per light.
+	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffers);
+	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffers);
+	// Checkpoints of the lights along the axis and the one to save this slice into.
+	LAYOUT_FIELD(FShaderResourceParameter, Checkpoints);
+	LAYOUT_FIELD(FShaderParameter, WriteCheckpoint);
+	// Opacity volume and the mask of its channel holding the opacity (zero if there's no opacity volume).
+	LAYOUT_FIELD(FShaderResourceParameter, OpacityVolume);
+	LAYOUT_FIELD(FShaderParameter, OpacityChannel);
+};
 
-	void SetStepSizes(
-		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pAddedStepSize, float pRemovedStepSize)
-	{
-		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pAddedStepSize);
-		SetShaderValue(RHICmdList, ShaderRHI, RemovedStepSize, pRemovedStepSize);
-	}
+// A shader propagating a light through one slice while changing the clipping plane, see ChangeClipDirLightShader.usf.
+class FChangeClipDirLightShader : public FGlobalShader
+{
+	DECLARE_EXPORTED_SHADER_TYPE(FChangeClipDirLightShader, Global, RAYMARCHER_API);
 
-	void UnbindResourcesRaymarch(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
+public:
+	FChangeClipDirLightShader() : FGlobalShader()
 	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
 	}
 
-	void UnbindResourcesLightPropagation(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
+	FChangeClipDirLightShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
 	{
-		// Unbind volume buffer.
-		UnbindResourcesRaymarch(RHICmdList, ShaderRHI);
-		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
-		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffer, nullptr);
+		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
+		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
+		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
+		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
+		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
+		PermutationMatrix.Bind(Initializer.ParameterMap, TEXT("PermutationMatrix"), SPF_Mandatory);
+		ALightVolume.Bind(Initializer.ParameterMap, TEXT("ALightVolume"), SPF_Mandatory);
+
+		// Old and new clipping planes.
+		OldClippingCenter.Bind(Initializer.ParameterMap, TEXT("OldClippingCenter"), SPF_Mandatory);
+		OldClippingDirection.Bind(Initializer.ParameterMap, TEXT("OldClippingDirection"), SPF_Mandatory);
+		NewClippingCenter.Bind(Initializer.ParameterMap, TEXT("NewClippingCenter"), SPF_Mandatory);
+		NewClippingDirection.Bind(Initializer.ParameterMap, TEXT("NewClippingDirection"), SPF_Mandatory);
+
+		LightOffset.Bind(Initializer.ParameterMap, TEXT("LightOffset"), SPF_Mandatory);
+		StepSize.Bind(Initializer.ParameterMap, TEXT("StepSize"), SPF_Mandatory);
+		LightAlpha.Bind(Initializer.ParameterMap, TEXT("LightAlpha"), SPF_Mandatory);
+
+		Loop.Bind(Initializer.ParameterMap, TEXT("Loop"), SPF_Mandatory);
+		FirstSlice.Bind(Initializer.ParameterMap, TEXT("FirstSlice"), SPF_Mandatory);
+		ReadBuffers.Bind(Initializer.ParameterMap, TEXT("ReadBuffers"), SPF_Mandatory);
+		WriteBuffers.Bind(Initializer.ParameterMap, TEXT("WriteBuffers"), SPF_Mandatory);
+		Checkpoints.Bind(Initializer.ParameterMap, TEXT("Checkpoints"), SPF_Mandatory);
+		CheckpointBase.Bind(Initializer.ParameterMap, TEXT("CheckpointBase"), SPF_Mandatory);
+		ReadCheckpoint.Bind(Initializer.ParameterMap, TEXT("ReadCheckpoint"), SPF_Mandatory);
+		WriteCheckpoint.Bind(Initializer.ParameterMap, TEXT("WriteCheckpoint"), SPF_Mandatory);
+
+		OpacityVolume.Bind(Initializer.ParameterMap, TEXT("OpacityVolume"), SPF_Mandatory);
+		OpacityChannel.Bind(Initializer.ParameterMap, TEXT("OpacityChannel"), SPF_Mandatory);
 	}
 
-	void UnbindResourcesChangeDirLight(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		// Unbind parent and also our added parameters.
-		UnbindResourcesLightPropagation(RHICmdList, ShaderRHI);
-		SetUAVParameter(RHICmdList, ShaderRHI, RemovedWriteBuffer, nullptr);
-		SetTextureParameter(RHICmdList, ShaderRHI, RemovedReadBuffer, nullptr);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 
-	void SetRaymarchResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture2DRHIRef pTransferFunc, FWindowingParameters WindowingParams)
+	// Sets everything that stays the same for all slices of one light axis. The light offset holds the whole pixels (XY) and
+	// bilinear weights (ZW) of the offset into the previous slice. Parameters have to be set before every dispatch, so the volume
+	// sampler is created once per update by the caller.
+	void SetLightParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
+		const FBasicRaymarchRenderingResources& Resources, FRHISamplerState* DataVolumeSampler,
+		const FClippingPlaneParameters& OldLocalClipping, const FClippingPlaneParameters& NewLocalClipping,
+		const FMatrix& PermMatrix, const FVector4f& pLightOffset, const float pStepSize, const float pLightAlpha)
 	{
-		// Set the zero color to fit the zero point of the windowing parameters (Center - Width/2)
-		// so that after sampling out of bounds, it gets changed to 0 on the Transfer Function in
-		// GetTransferFuncPosition() hlsl function.
-		float ZeroTFValue = WindowingParams.Center - 0.5 * WindowingParams.Width;
+		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSampler,
+			GetSampledVolume(Resources));
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef,
+			Resources.TFTextureRef->GetResource()->TextureRHI);
+
+		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, GetSampledVolumeWindowing(Resources));
+		SetShaderValue(RHICmdList, ShaderRHI, PermutationMatrix, FMatrix44f(PermMatrix));
+		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, Resources.LightVolumeUAVRef);
 
-		FLinearColor VolumeClearColor = FLinearColor(ZeroTFValue, 0.0, 0.0, 0.0);
-		const uint32 BorderColorInt = VolumeClearColor.ToFColor(false).ToPackedARGB();
+		FVector4f Channel;
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, GetLightPropagationOpacityVolume(Resources, Channel));
+		SetShaderValue(RHICmdList, ShaderRHI, OpacityChannel, Channel);
 
-		// Create a static sampler reference and bind it together with the volume texture.
-		FSamplerStateRHIRef DataVolumeSamplerRef = RHICreateSamplerState(
-			FSamplerStateInitializerRHI(SF_Trilinear, AM_Border, AM_Border, AM_Border, 0, 1, 0, 0, BorderColorInt));
+		SetShaderValue(RHICmdList, ShaderRHI, OldClippingCenter, FVector3f(OldLocalClipping.Center));
+		SetShaderValue(RHICmdList, ShaderRHI, OldClippingDirection, FVector3f(OldLocalClipping.Direction));
+		SetShaderValue(RHICmdList, ShaderRHI, NewClippingCenter, FVector3f(NewLocalClipping.Center));
+		SetShaderValue(RHICmdList, ShaderRHI, NewClippingDirection, FVector3f(NewLocalClipping.Direction));
 
-		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSamplerRef, pVolume);
-		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef, pTransferFunc);
+		SetShaderValue(RHICmdList, ShaderRHI, LightOffset, pLightOffset);
+		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pStepSize);
+		SetShaderValue(RHICmdList, ShaderRHI, LightAlpha, pLightAlpha);
 	}
 
-	// Sets the shader uniforms in the pipeline.
-	void SetRaymarchParameters(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI,
-		FClippingPlaneParameters LocalClippingParams, FLinearColor pWindowingParameters)
+	// Sets the slice to propagate through, the slice the propagation started at, the buffers to read the previous slice from and
+	// write this slice into, the checkpoints of the axis with the first array slice of the light's checkpoints and the checkpoints
+	// to start from and to save this slice into (-1 for none).
+	void SetLoop(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const int LoopIndex, const int pFirstSlice,
+		const FTextureRHIRef pReadBuffers, const FUnorderedAccessViewRHIRef pWriteBuffers,
+		const FUnorderedAccessViewRHIRef pCheckpoints, const int pCheckpointBase, const int pReadCheckpoint,
+		const int pWriteCheckpoint)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingCenter, FVector3f(LocalClippingParams.Center));
-		SetShaderValue(RHICmdList, ShaderRHI, LocalClippingDirection, FVector3f(LocalClippingParams.Direction));
-		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, pWindowingParameters);
+		SetShaderValue(RHICmdList, ShaderRHI, Loop, LoopIndex);
+		SetShaderValue(RHICmdList, ShaderRHI, FirstSlice, pFirstSlice);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffers, pReadBuffers);
+		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffers, pWriteBuffers);
+		SetUAVParameter(RHICmdList, ShaderRHI, Checkpoints, pCheckpoints);
+		SetShaderValue(RHICmdList, ShaderRHI, CheckpointBase, pCheckpointBase);
+		SetShaderValue(RHICmdList, ShaderRHI, ReadCheckpoint, pReadCheckpoint);
+		SetShaderValue(RHICmdList, ShaderRHI, WriteCheckpoint, pWriteCheckpoint);
 	}
 
-	// Sets the step-size. This is a crucial parameter, because when raymarching, we need to know how long our step was,
-	// so that we can calculate how large an effect the volume's density has.
-	void SetStepSize(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, float pStepSize)
+	void UnbindResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
 	{
-		SetShaderValue(RHICmdList, ShaderRHI, StepSize, pStepSize);
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, ReadBuffers, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, OpacityVolume, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, ALightVolume, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, WriteBuffers, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, Checkpoints, nullptr);
 	}
 
 protected:
-	// Volume texture + transfer function resource parameters
 	LAYOUT_FIELD(FShaderResourceParameter, Volume);
 	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
 	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
 	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
-	// Clipping uniforms
-	LAYOUT_FIELD(FShaderParameter, LocalClippingCenter);
-	LAYOUT_FIELD(FShaderParameter, LocalClippingDirection);
-	// TF intensity Domain
 	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
-	// Step size taken each iteration
-	LAYOUT_FIELD(FShaderParameter, StepSize);
-
-	// The current loop index of this shader run.
-	LAYOUT_FIELD(FShaderParameter, Loop);
-	// Permutation matrix - used to get position in the volume from axis-aligned X,Y and loop index.
 	LAYOUT_FIELD(FShaderParameter, PermutationMatrix);
-	// Read buffer texture and sampler.
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, ReadBufferSampler);
-	// Write buffer UAV.
-	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffer);
-	// Light volume to modify.
 	LAYOUT_FIELD(FShaderResourceParameter, ALightVolume);
-
-	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, PrevPixelOffset);
-	// And the offset in the volume from the previous volume sample.
-	LAYOUT_FIELD(FShaderParameter, UVWOffset);
-
-	// Same collection of parameters as for a "add dir light" shader, but these ones are the ones of
-	// the removed light.
-
-	// Tells the shader the pixel offset for reading from the previous loop's buffer
-	LAYOUT_FIELD(FShaderParameter, RemovedPrevPixelOffset);
-
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedReadBuffer);
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedReadBufferSampler);
-	// Write buffer UAV.
-	LAYOUT_FIELD(FShaderResourceParameter, RemovedWriteBuffer);
-	// Removed light step size (is different than added one's)
-	LAYOUT_FIELD(FShaderParameter, RemovedStepSize);
-	// Removed light UVW offset
-	LAYOUT_FIELD(FShaderParameter, RemovedUVWOffset);
-};
\ No newline at end of file
+	// Clipping planes to remove the light with and to add it with.
+	LAYOUT_FIELD(FShaderParameter, OldClippingCenter);
+	LAYOUT_FIELD(FShaderParameter, OldClippingDirection);
+	LAYOUT_FIELD(FShaderParameter, NewClippingCenter);
+	LAYOUT_FIELD(FShaderParameter, NewClippingDirection);
+	// The light's offset into the previous slice, step size and alpha outside of the buffers.
+	LAYOUT_FIELD(FShaderParameter, LightOffset);
+	LAYOUT_FIELD(FShaderParameter, StepSize);
+	LAYOUT_FIELD(FShaderParameter, LightAlpha);
+	LAYOUT_FIELD(FShaderParameter, Loop);
+	LAYOUT_FIELD(FShaderParameter, FirstSlice);
+	// Texture array read buffer and its UAV write counterpart, old light in slice 0, new one in slice 1.
+	LAYOUT_FIELD(FShaderResourceParameter, ReadBuffers);
+	LAYOUT_FIELD(FShaderResourceParameter, WriteBuffers);
+	// Checkpoints of the lights along the axis, where the light's ones start and the ones to read and write in this slice.
+	LAYOUT_FIELD(FShaderResourceParameter, Checkpoints);
+	LAYOUT_FIELD(FShaderParameter, CheckpointBase);
+	LAYOUT_FIELD(FShaderParameter, ReadCheckpoint);
+	LAYOUT_FIELD(FShaderParameter, WriteCheckpoint);
+	// Opacity volume and the mask of its channel holding the opacity (zero if there's no opacity volume).
+	LAYOUT_FIELD(FShaderResourceParameter, OpacityVolume);
+	LAYOUT_FIELD(FShaderParameter, OpacityChannel);
+};
@@ -8,6 +8,7 @@
 #include "CoreMinimal.h"
 #include "GlobalShader.h"
 #include "RHICommandList.h"
+#include "RHIStaticStates.h"
 #include "Rendering/RaymarchTypes.h"
 #include "ShaderParameterUtils.h"
 #include "ShaderParameters.h"
@@ -29,6 +30,9 @@ public:
 	FGenerateOctreeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
 	{
 		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
+		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
+		bBrickedVolume.Bind(Initializer.ParameterMap, TEXT("bBrickedVolume"), SPF_Mandatory);
+		VolumeDimensions.Bind(Initializer.ParameterMap, TEXT("VolumeDimensions"), SPF_Mandatory);
 		OctreeVolume0.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip0"), SPF_Mandatory);
 		OctreeVolume1.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip1"), SPF_Mandatory);
 		OctreeVolume2.Bind(Initializer.ParameterMap, TEXT("OctreeVolumeMip2"), SPF_Mandatory);
@@ -38,10 +42,16 @@ public:
 		NumberOfMips.Bind(Initializer.ParameterMap, TEXT("NumberOfMips"), SPF_Mandatory);
 	}
 		
-	void SetGeneratingResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FTexture3DRHIRef pVolume,
-		const FTexture3DComputeResource* ComputeResource, int InLeafNodeSize, int InNumberOfMips)
+	// pVolume is either the data volume or the brick atlas of a bricked volume (see BrickedSampling.usf). Either way, the octree
+	// is generated for a volume of InVolumeDimensions.
+	void SetGeneratingResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, FRHITexture* pVolume,
+		const bool bBricked, const FIntVector& InVolumeDimensions, const FTexture3DComputeResource* ComputeResource,
+		int InLeafNodeSize, int InNumberOfMips)
 	{
-		SetTextureParameter(RHICmdList, ShaderRHI, Volume, pVolume);
+		FSamplerStateRHIRef VolumeSamplerRef = TStaticSamplerState<SF_Trilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, VolumeSamplerRef, pVolume);
+		SetShaderValue(RHICmdList, ShaderRHI, bBrickedVolume, bBricked ? 1 : 0);
+		SetShaderValue(RHICmdList, ShaderRHI, VolumeDimensions, InVolumeDimensions);
 		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume0, ComputeResource->UnorderedAccessViewRHIs[0]);
 		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume1, ComputeResource->UnorderedAccessViewRHIs[1]);
 		SetUAVParameter(RHICmdList, ShaderRHI, OctreeVolume2, ComputeResource->UnorderedAccessViewRHIs[2]);
@@ -63,6 +73,11 @@ public:
 protected:
 	// Volume texture + transfer function resource parameters
 	LAYOUT_FIELD(FShaderResourceParameter, Volume);
+	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
+
+	// 1 if Volume is a brick atlas, the dimensions of the data volume.
+	LAYOUT_FIELD(FShaderParameter, bBrickedVolume);
+	LAYOUT_FIELD(FShaderParameter, VolumeDimensions);
 
 	// OctreeVolume volume mips to modify.
 	LAYOUT_FIELD(FShaderResourceParameter, OctreeVolume0);
@@ -0,0 +1,81 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "GlobalShader.h"
+#include "RHICommandList.h"
+#include "Rendering/LightingShaderUtils.h"
+#include "Rendering/RaymarchTypes.h"
+#include "ShaderParameterUtils.h"
+#include "ShaderParameters.h"
+
+/// Applies the windowing and transfer function of the resources to every voxel of their opacity volume.
+void BuildOpacityVolume_RenderThread(FRHICommandListImmediate& RHICmdList, FBasicRaymarchRenderingResources Resources);
+
+// A shader classifying every voxel of a volume into the opacity volume, see BuildOpacityVolumeShader.usf.
+class FBuildOpacityVolumeShader : public FGlobalShader
+{
+	DECLARE_EXPORTED_SHADER_TYPE(FBuildOpacityVolumeShader, Global, RAYMARCHER_API);
+
+public:
+	// Has to be the same as in BuildOpacityVolumeShader.usf
+	static constexpr int32 ThreadsPerGroupDimension = 4;
+
+	FBuildOpacityVolumeShader() : FGlobalShader()
+	{
+	}
+
+	FBuildOpacityVolumeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
+	{
+		Volume.Bind(Initializer.ParameterMap, TEXT("Volume"), SPF_Mandatory);
+		VolumeSampler.Bind(Initializer.ParameterMap, TEXT("VolumeSampler"), SPF_Mandatory);
+		TransferFunc.Bind(Initializer.ParameterMap, TEXT("TransferFunc"), SPF_Mandatory);
+		TransferFuncSampler.Bind(Initializer.ParameterMap, TEXT("TransferFuncSampler"), SPF_Mandatory);
+		WindowingParameters.Bind(Initializer.ParameterMap, TEXT("WindowingParameters"), SPF_Mandatory);
+		bStoreColor.Bind(Initializer.ParameterMap, TEXT("bStoreColor"), SPF_Mandatory);
+		OpacityVolume.Bind(Initializer.ParameterMap, TEXT("OpacityVolume"), SPF_Mandatory);
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	void SetBuildParameters(
+		FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI, const FBasicRaymarchRenderingResources& Resources)
+	{
+		// Same samplers as the light propagation shaders.
+		FSamplerStateRHIRef DataVolumeSamplerRef = GetDataVolumeSamplerRef(Resources.WindowingParameters);
+		FSamplerStateRHIRef TFSamplerRef = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, VolumeSampler, DataVolumeSamplerRef,
+			GetSampledVolume(Resources));
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, TransferFuncSampler, TFSamplerRef,
+			Resources.TFTextureRef->GetResource()->TextureRHI);
+
+		SetShaderValue(RHICmdList, ShaderRHI, WindowingParameters, GetSampledVolumeWindowing(Resources));
+		const bool bColored = Resources.OpacityVolumeMode == EOpacityVolumeMode::OpacityAndColor;
+		SetShaderValue(RHICmdList, ShaderRHI, bStoreColor, bColored ? 1 : 0);
+		SetUAVParameter(RHICmdList, ShaderRHI, OpacityVolume, Resources.OpacityVolumeUAVRef);
+	}
+
+	void UnbindResources(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ShaderRHI)
+	{
+		SetTextureParameter(RHICmdList, ShaderRHI, Volume, nullptr);
+		SetTextureParameter(RHICmdList, ShaderRHI, TransferFunc, nullptr);
+		SetUAVParameter(RHICmdList, ShaderRHI, OpacityVolume, nullptr);
+	}
+
+protected:
+	LAYOUT_FIELD(FShaderResourceParameter, Volume);
+	LAYOUT_FIELD(FShaderResourceParameter, VolumeSampler);
+	LAYOUT_FIELD(FShaderResourceParameter, TransferFunc);
+	LAYOUT_FIELD(FShaderResourceParameter, TransferFuncSampler);
+	LAYOUT_FIELD(FShaderParameter, WindowingParameters);
+	// Whether to store the transfer function color next to the opacity.
+	LAYOUT_FIELD(FShaderParameter, bStoreColor);
+	// Opacity volume to fill.
+	LAYOUT_FIELD(FShaderResourceParameter, OpacityVolume);
+};
@@ -78,6 +78,23 @@ struct OneAxisReadWriteBufferResources
 	FTexture2DRHIRef Buffers[4];
 	// UAV refs to the Buffers, when we need to make a RWTexture out of them.
 	FUnorderedAccessViewRHIRef UAVs[4];
+	// Read-write pair of 2D texture arrays with a slice for every light propagated in one batch.
+	FTextureRHIRef BatchedBuffers[2];
+	FUnorderedAccessViewRHIRef BatchedUAVs[2];
+};
+
+struct FLightPropagationCheckpoints;
+
+/** What the opacity volume of a raymarchable volume holds, see FBasicRaymarchRenderingResources::OpacityVolumeRenderTarget. */
+UENUM(BlueprintType)
+enum class EOpacityVolumeMode : uint8
+{
+	/// No opacity volume, the transfer function is evaluated for every sample.
+	Disabled,
+	/// Opacity only (R16F), read by the batched light propagation.
+	Opacity,
+	/// Transfer function color and opacity (RGBA16F), read by the batched light propagation and the opacity lit material.
+	OpacityAndColor
 };
 
 /** A structure holding all resources related to a single raymarchable volume - its texture ref, the
@@ -96,6 +113,11 @@ struct FBasicRaymarchRenderingResources
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	UVolumeTexture* DataVolumeTextureRef = nullptr;
 
+	/// Brick atlas of bricked volumes (see FVolumeBrickLayout), nullptr otherwise. If set, the light propagation, opacity volume and
+	/// octree shaders sample the full resolution data from it instead of the data volume (see BrickedSampling.usf).
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
+	UVolumeTexture* BrickAtlasTextureRef = nullptr;
+
 	/// Pointer to the Transfer Function Volume texture.
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	UTexture2D* TFTextureRef = nullptr;
@@ -108,10 +130,42 @@ struct FBasicRaymarchRenderingResources
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
 	URenderTargetVolumeMipped* OctreeVolumeRenderTarget = nullptr;
 
+	/// Volume with the windowed transfer function applied to every voxel (see BuildOpacityVolumeShader.usf). Has the dimensions of
+	/// the light volume. Only created if OpacityVolumeMode isn't Disabled.
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Transient, Category = "Basic Raymarch Rendering Resources")
+	UTextureRenderTargetVolume* OpacityVolumeRenderTarget = nullptr;
+
 	/// If true, Light Volume texture will be created with it's side scaled down by 1/2 (-> 1/8 total voxels!)
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
 	bool LightVolumeHalfResolution = false;
 
+	/// If true, adding, removing and changing single lights propagates them through several slices per compute shader dispatch
+	/// (see AddDirLightMultiSliceShader.usf) instead of one dispatch per slice. Lights too far off their major axis fall back to
+	/// the batched shader. With bBatchedLightPropagation, resetting all lights still goes through the batched shader.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
+	bool bMultiSliceLightPropagation = true;
+
+	/// If true, resetting all lights propagates all lights going along the same major axis in one sweep, sampling the volume only
+	/// once per voxel (see AddDirLightsBatchedShader.usf), and changing a light removes the old and adds the new one in one sweep
+	/// for every axis not propagated by bMultiSliceLightPropagation. Otherwise every light goes through the volume on its own.
+	/// All the light propagation shaders give the same light volume, so this can be toggled without leaving light behind.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
+	bool bBatchedLightPropagation = true;
+
+	/// If not disabled, the windowed transfer function gets applied to every voxel once (whenever the windowing, transfer
+	/// function or data change) and the light propagation reads the opacity from the opacity volume instead. Costs 2
+	/// (opacity) or 8 (opacity and color) bytes per light volume voxel.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
+	EOpacityVolumeMode OpacityVolumeMode = EOpacityVolumeMode::Disabled;
+
+	/// If true, moving only the clipping plane re-propagates every light only from the first slice the move affects, instead of
+	/// recomputing the whole light volume. Needs the light propagation saved every FLightPropagationCheckpoints::Interval slices
+	/// (see ChangeClipDirLightShader.usf), which is recorded along the way whenever all the lights get reset. Only used with
+	/// bBatchedLightPropagation, the checkpoints are recorded by the same sweeps. Once the plane stops, the lights get reset to
+	/// get rid of the rounding errors accumulated by the updates.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Basic Raymarch Rendering Resources")
+	bool bIncrementalClippingUpdate = true;
+
 	/// Windowing parameters that dictate how a value read from the volume is transferred onto the transfer function.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	FWindowingParameters WindowingParameters;
@@ -123,9 +177,16 @@ struct FBasicRaymarchRenderingResources
 	
 	// Unordered access view to the Light Volume. Used in our compute shaders as a RWTexture.
 	FUnorderedAccessViewRHIRef LightVolumeUAVRef;
+
+	// Unordered access view to the opacity volume, written when building it.
+	FUnorderedAccessViewRHIRef OpacityVolumeUAVRef;
 	
 	// Read-write buffers for all 3 major axes. Used in compute shaders.
 	OneAxisReadWriteBufferResources XYZReadWriteBuffers[3];
+
+	// Light propagation checkpoints for incremental clipping plane updates. Shared by all copies of the resources, only accessed
+	// on the render thread.
+	TSharedPtr<FLightPropagationCheckpoints, ESPMode::ThreadSafe> LightCheckpoints;
 };
 
 /** Structure containing the world parameters required for light propagation shaders - these include
@@ -151,3 +212,33 @@ struct FRaymarchWorldParameters
 		return !(lhs == rhs);
 	}
 };
+
+// A light recorded in the light propagation checkpoints. Its checkpoints along each of its major axes are in the checkpoints of
+// the cube face the axis goes along, starting at array slice FirstCheckpoints[AxisIndex]. Checkpoint K holds the light leaving the
+// ((K + 1) * FLightPropagationCheckpoints::Interval - 1)th slice, counted from where the light enters the volume.
+struct FDirLightCheckpoints
+{
+	// The light (in world space) the checkpoints were recorded for.
+	FDirLightParameters LightParameters;
+	int32 FirstCheckpoints[2];
+};
+
+// Checkpoints of all the lights in a light volume. Recorded by AddDirLightsWithCheckpoints_RenderThread (the same sweeps as
+// adding the lights without them) and kept up to date by UpdateClippingInLightVolume_RenderThread, which continues propagating
+// the lights from the last checkpoint before the first slice a moved clipping plane affects.
+struct FLightPropagationCheckpoints
+{
+	// Slices between two checkpoints. Fewer means fewer slices to re-propagate from a checkpoint, but more memory - every
+	// checkpoint is as big as a propagation buffer.
+	static constexpr int32 Interval = 16;
+
+	// World parameters the light volume was last propagated with.
+	FRaymarchWorldParameters WorldParameters;
+
+	// 2D texture arrays matching the propagation buffers of every cube face, holding the checkpoints of all the lights going
+	// along it.
+	FTextureRHIRef Textures[6];
+	FUnorderedAccessViewRHIRef UAVs[6];
+
+	TArray<FDirLightCheckpoints> Lights;
+};
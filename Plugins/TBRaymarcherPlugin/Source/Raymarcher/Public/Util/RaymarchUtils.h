@@ -28,21 +28,48 @@ public:
 	//
 	//
 
-	/** Adds a light to light volume. Also works for removing a light by setting bLightAdded to false.*/
+	/** Adds a light to light volume. Also works for removing a light by setting bLightAdded to false. bGPUSync is ignored, the
+	 * GPU synced shader is disabled.*/
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void AddDirLightToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
 		const FDirLightParameters& LightParameters, const bool Added, const FRaymarchWorldParameters WorldParameters,
 		bool& LightAdded, bool bGPUSync = false);
 
-	/** Changes a light in the light volume.	 */
+	/** Adds all the lights to light volume in as few sweeps through the volume as possible (one per major axis and batch of
+	 * lights). Also works for removing the lights by setting Added to false.*/
+	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
+	static RAYMARCHER_API void AddDirLightsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const TArray<FDirLightParameters>& Lights, const bool Added, const FRaymarchWorldParameters WorldParameters,
+		bool& LightsAdded);
+
+	/** Changes a light in the light volume. With batched light propagation, the old light gets removed and the new one added in
+	 * one sweep, otherwise one after another. bGPUSync is ignored, the GPU synced shader is disabled.*/
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void ChangeDirLightInSingleVolume(FBasicRaymarchRenderingResources& Resources,
 		const FDirLightParameters OldLightParameters, const FDirLightParameters NewLightParameters,
 		const FRaymarchWorldParameters WorldParameters, bool& LightAdded, bool bGPUSync = false);
 
+	/** Adds all the lights to the light volume like AddDirLightsToSingleVolume, saving checkpoints of their propagation into the
+	 * resources, so that a clipping plane move can be handled by UpdateClippingInSingleVolume afterwards. The light volume has to
+	 * be cleared before.*/
+	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
+	static RAYMARCHER_API void AddDirLightsWithCheckpointsToSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const TArray<FDirLightParameters>& Lights, const FRaymarchWorldParameters WorldParameters, bool& LightsAdded);
+
+	/** Updates the lights added by AddDirLightsWithCheckpointsToSingleVolume for a moved clipping plane, re-propagating them only
+	 * from the first slice the move affects. The lights and the volume transform have to stay the same. */
+	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
+	static RAYMARCHER_API void UpdateClippingInSingleVolume(const FBasicRaymarchRenderingResources& Resources,
+		const FRaymarchWorldParameters WorldParameters, bool& LightsUpdated);
+
 	/** Generates an octree in the provided resources to accelerate raymarching through the volume.	 */
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
 	static RAYMARCHER_API void GenerateOctree(FBasicRaymarchRenderingResources& Resources);
+
+	/** Applies the windowing and transfer function to every voxel of the opacity volume in the provided resources. Has to be
+	 * called again whenever the windowing parameters, the transfer function or the data volume change. */
+	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
+	static RAYMARCHER_API void BuildOpacityVolume(const FBasicRaymarchRenderingResources& Resources);
 	
 	/** Clears a light volume in provided raymarch resources. */
 	UFUNCTION(BlueprintCallable, Category = "Raymarcher")
@@ -37,6 +37,10 @@ public:
 	UPROPERTY(meta = (BindWidget))
 	USliderAndValueBox* WindowWidthBox;
 
+	/// Button that windows the volumes to the percentiles of the range provider volume's values, ignoring outliers.
+	UPROPERTY(meta = (BindWidgetOptional))
+	UButton* AutoWindowButton;
+
 	/// Combobox for selecting transfer functions.
 	UPROPERTY(meta = (BindWidget))
 	UComboBoxString* TFSelectionComboBox;
@@ -57,6 +61,10 @@ public:
 	UFUNCTION()
 	void OnSaveClicked();
 
+	/// Called when AutoWindowButton is clicked.
+	UFUNCTION()
+	void OnAutoWindowClicked();
+
 	/// Called when Window Center is clicked.
 	UFUNCTION()
 	void OnCenterChanged(float Value);
@@ -91,6 +99,9 @@ public:
 	UPROPERTY(EditAnywhere)
 	TArray<ARaymarchVolume*> ListenerVolumes;
 
+	/// Sets the window sliders to the (normalized) windowing parameters of the range provider volume.
+	void SetWindowSliders(const FWindowingParameters& Parameters);
+
 	/// Sets a new volume to be this menu's sliders range provider.
 	UFUNCTION(BlueprintCallable)
 	void SetRangeProviderVolume(ARaymarchVolume* NewRaymarchVolume);
@@ -8,6 +8,7 @@
 #include "Actor/RaymarchVolume.h"
 #include "Blueprint/UserWidget.h"
 #include "Components/Button.h"
+#include "Components/ProgressBar.h"
 #include "CoreMinimal.h"
 #include "Widget/SliderAndValueBox.h"
 
@@ -43,6 +44,10 @@ public:
 	UPROPERTY(meta = (BindWidget))
 	UComboBoxString* AssetSelectionComboBox;
 
+	/// Optional progress bar showing the progress of the volume being loaded.
+	UPROPERTY(meta = (BindWidgetOptional))
+	UProgressBar* LoadProgressBar;
+
 	/// Array of existing MHD Assets that can be set immediately. Will populate the AssetSelection combo box.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	TArray<UVolumeAsset*> AssetArray;
@@ -55,10 +60,14 @@ public:
 	UFUNCTION()
 	void OnLoadF32Clicked();
 
-	/// Unified function for loading F32 or normalized.
+	/// Unified function for loading F32 or normalized. The volume gets loaded asynchronously, OnVolumeLoaded is called once done.
 	UFUNCTION()
 	void PerformLoad(bool bNormalized);
 
+	/// Called when an asynchronous load started by PerformLoad finished. VolumeAsset is null if the load failed.
+	UFUNCTION()
+	void OnVolumeLoaded(UVolumeAsset* VolumeAsset);
+
 	/// Called when AssetSelectionComboBox has a new value selected.
 	UFUNCTION()
 	void OnAssetSelected(FString AssetName, ESelectInfo::Type SelectType);
@@ -75,4 +84,11 @@ public:
 	/// Sets a new volume to be affected by this menu.
 	UFUNCTION(BlueprintCallable)
 	void RemoveListenerVolume(ARaymarchVolume* RemovedRaymarchVolume);
+
+private:
+	/// Handle of the load in progress, if any. Only one volume gets loaded at a time.
+	TSharedPtr<FVolumeLoadHandle> LoadHandle;
+
+	/// Enables the load buttons and hides the progress bar when no load is in progress.
+	void UpdateLoadWidgets();
 };
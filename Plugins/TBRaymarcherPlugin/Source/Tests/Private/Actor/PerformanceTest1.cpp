@@ -7,6 +7,9 @@
 #include "GameFramework/PlayerController.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "GameFramework/GameUserSettings.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
 #include "VolumeTextureToolkit/Public/VolumeAsset/VolumeInfo.h"
 
 #include <cstdlib>	  // For system function
@@ -27,6 +30,7 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 	static constexpr float FirstRecomputeDuration = 1.0f;
 	static constexpr float WindowCenterMoveDuration = 2.0f;
 	static constexpr float SecondRecomputeDuration = 1.0f;
+	static constexpr float RecomputePerLightCountDuration = 1.0f;
 	static constexpr float RotateCameraDuration = 4.0f;
 	static constexpr float RotateVolumeYawDuration = 4.0f;
 	static constexpr float RotateVolumeRollDuration = 4.0f;
@@ -37,7 +41,8 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 	static constexpr float RecomputeTimeEnd = InitializationEnd + FirstRecomputeDuration;
 	static constexpr float WindowCenterMovingEnd = RecomputeTimeEnd + WindowCenterMoveDuration;
 	static constexpr float SecondRecomputeEnd = WindowCenterMovingEnd + SecondRecomputeDuration;
-	static constexpr float RotateCameraEnd = SecondRecomputeEnd + RotateCameraDuration;
+	static constexpr float RecomputePerLightCountEnd = SecondRecomputeEnd + RecomputePerLightCountDuration;
+	static constexpr float RotateCameraEnd = RecomputePerLightCountEnd + RotateCameraDuration;
 	static constexpr float RotateVolumeYawEnd = RotateCameraEnd + RotateVolumeYawDuration;
 	static constexpr float RotateVolumeRollEnd = RotateVolumeYawEnd + RotateVolumeRollDuration;
 	static constexpr float RotatePlaneRollEnd = RotateVolumeRollEnd + RotatePlaneRollDuration;
@@ -95,6 +100,15 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 			ListenerVolume->bRequestedRecompute = true;
 		}
 	}
+	else if (CurrentTime < RecomputePerLightCountEnd)
+	{
+		const FString CurrentTestName = TEXT("PerformanceTest1 RecomputeLightsPerLightCount");
+		if (IsBookmarkNew(CurrentTestName))
+		{
+			TRACE_BOOKMARK(*CurrentTestName);
+			MeasureRecomputeTimes();
+		}
+	}
 	else if (CurrentTime < RotateCameraEnd)
 	{
 		const FString CurrentTestName = TEXT("PerformanceTest1 RotateCameraAroundVolume");
@@ -161,11 +175,16 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 	}
 	else if (CurrentTime < RotatePlaneRollEnd)
 	{
-		const FString CurrentTestName = TEXT("PerformanceTest1 RotatePlaneRoll");
+		// First half recomputes the lights every frame, second half updates them incrementally.
+		const bool bIncremental = CurrentTime >= RotatePlaneRollEnd - RotatePlaneRollDuration / 2;
+		const FString CurrentTestName = FString::Printf(
+			TEXT("PerformanceTest1 RotatePlaneRoll %s"), bIncremental ? TEXT("Incremental") : TEXT("FullRecompute"));
 		if (IsBookmarkNew(CurrentTestName))
 		{
 			TRACE_BOOKMARK(*CurrentTestName);
+			SetIncrementalClippingUpdate(bIncremental);
 		}
+		RecordFrameTime(CurrentTestName, DeltaSeconds);
 
 		// Change the rotation of the plane.
 		AActor* Plane = PlaneToRotate;
@@ -179,11 +198,15 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 	}
 	else if (CurrentTime < RotatePlaneYawEnd)
 	{
-		const FString CurrentTestName = TEXT("PerformanceTest1 RotatePlaneYaw");
+		const bool bIncremental = CurrentTime >= RotatePlaneYawEnd - RotatePlaneYawDuration / 2;
+		const FString CurrentTestName = FString::Printf(
+			TEXT("PerformanceTest1 RotatePlaneYaw %s"), bIncremental ? TEXT("Incremental") : TEXT("FullRecompute"));
 		if (IsBookmarkNew(CurrentTestName))
 		{
 			TRACE_BOOKMARK(*CurrentTestName);
+			SetIncrementalClippingUpdate(bIncremental);
 		}
+		RecordFrameTime(CurrentTestName, DeltaSeconds);
 
 		// Change the rotation of the plane.
 		AActor* Plane = PlaneToRotate;
@@ -198,6 +221,10 @@ void APerformanceTest1::Tick(float DeltaSeconds)
 	else
 	{
 		TRACE_BOOKMARK(TEXT("PerformanceTest1 End"));
+		if (IsBookmarkNew(TEXT("PerformanceTest1 End")))
+		{
+			SaveFrameTimes();
+		}
 
 		if (UWorld* World = GetWorld())
 		{
@@ -239,6 +266,7 @@ void APerformanceTest1::RunTest(const TArray<FString>& Params)
 
 	// Clear the bookmarks to log them properly this test run.
 	BookmarksApplied.Empty();
+	PhaseFrameTimes.Empty();
 }
 
 void APerformanceTest1::SetWindowCenter(float Value)
@@ -267,3 +295,98 @@ bool APerformanceTest1::IsBookmarkNew(FString Name)
 	}
 	return false;
 }
+
+void APerformanceTest1::MeasureRecomputeTimes()
+{
+	static constexpr int32 Repetitions = 5;
+
+	// Wall-clock time including waiting for the GPU to finish the light propagation.
+	auto WaitForGPU = []()
+	{
+		ENQUEUE_RENDER_COMMAND(WaitForLightsRecompute)
+		([](FRHICommandListImmediate& RHICmdList) { RHICmdList.BlockUntilGPUIdle(); });
+		FlushRenderingCommands();
+	};
+
+	FString Results = TEXT("Volume,LightCount,Batched,Milliseconds\n");
+	for (ARaymarchVolume* ListenerVolume : ListenerVolumes)
+	{
+		if (!ListenerVolume)
+		{
+			continue;
+		}
+
+		const TArray<ARaymarchLight*> AllLights = ListenerVolume->LightsArray;
+		const bool bWasBatched = ListenerVolume->RaymarchResources.bBatchedLightPropagation;
+		for (int32 LightCount = 1; LightCount <= AllLights.Num(); LightCount++)
+		{
+			ListenerVolume->LightsArray = TArray<ARaymarchLight*>(AllLights.GetData(), LightCount);
+			for (const bool bBatched : {false, true})
+			{
+				ListenerVolume->RaymarchResources.bBatchedLightPropagation = bBatched;
+				TRACE_BOOKMARK(*FString::Printf(
+					TEXT("PerformanceTest1 RecomputeLights %s %d"), bBatched ? TEXT("Batched") : TEXT("PerLight"), LightCount));
+
+				WaitForGPU();
+				const double StartTime = FPlatformTime::Seconds();
+				for (int32 Repetition = 0; Repetition < Repetitions; Repetition++)
+				{
+					ListenerVolume->ResetAllLights();
+				}
+				WaitForGPU();
+				const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Repetitions;
+
+				Results += FString::Printf(
+					TEXT("%s,%d,%d,%f\n"), *ListenerVolume->GetName(), LightCount, bBatched ? 1 : 0, Milliseconds);
+			}
+		}
+
+		// Put the volume back the way it was.
+		ListenerVolume->LightsArray = AllLights;
+		ListenerVolume->RaymarchResources.bBatchedLightPropagation = bWasBatched;
+		ListenerVolume->bRequestedRecompute = true;
+	}
+
+	FFileHelper::SaveStringToFile(Results, *(FPaths::ProfilingDir() / TEXT("PerformanceTest1") / TEXT("RecomputeLights.csv")));
+}
+
+void APerformanceTest1::SetIncrementalClippingUpdate(bool bIncremental)
+{
+	for (ARaymarchVolume* ListenerVolume : ListenerVolumes)
+	{
+		if (ListenerVolume)
+		{
+			ListenerVolume->RaymarchResources.bIncrementalClippingUpdate = bIncremental;
+		}
+	}
+}
+
+void APerformanceTest1::RecordFrameTime(const FString& Phase, float DeltaSeconds)
+{
+	PhaseFrameTimes.FindOrAdd(Phase).Add(DeltaSeconds * 1000.0f);
+}
+
+void APerformanceTest1::SaveFrameTimes()
+{
+	FString Results = TEXT("Phase,Frames,AverageMilliseconds,MaxMilliseconds\n");
+	for (const TPair<FString, TArray<float>>& Phase : PhaseFrameTimes)
+	{
+		// The first frame of a phase still carries the previous phase's work, leave it out.
+		TArrayView<const float> FrameTimes = MakeArrayView(Phase.Value).RightChop(1);
+		if (FrameTimes.IsEmpty())
+		{
+			continue;
+		}
+
+		float Sum = 0.0f;
+		float Max = 0.0f;
+		for (const float FrameTime : FrameTimes)
+		{
+			Sum += FrameTime;
+			Max = FMath::Max(Max, FrameTime);
+		}
+		Results += FString::Printf(TEXT("%s,%d,%f,%f\n"), *Phase.Key, FrameTimes.Num(), Sum / FrameTimes.Num(), Max);
+	}
+
+	FFileHelper::SaveStringToFile(Results, *(FPaths::ProfilingDir() / TEXT("PerformanceTest1") / TEXT("FrameTimes.csv")));
+}
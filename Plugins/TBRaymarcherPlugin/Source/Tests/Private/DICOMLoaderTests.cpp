@@ -0,0 +1,251 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Algo/Reverse.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/DCMTKLoader.h"
+
+#include <atomic>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+constexpr int32 DICOMPerfSliceCount = 1000;
+constexpr int32 DICOMPerfSliceSize = 512;
+
+/// Value of the voxel in the synthetic series, spans a CT-like [-1000, 1000) range.
+int16 GetDICOMPerfVoxel(const int32 X, const int32 Y, const int32 Slice)
+{
+	return static_cast<int16>((X + Y + Slice * 7) % 2000 - 1000);
+}
+
+/// Appends the value in little endian, or big endian if bBigEndian is true.
+template <typename T>
+void AppendValue(TArray<uint8>& Out, const T Value, const bool bBigEndian = false)
+{
+	const int32 Start = Out.Num();
+	Out.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+	if (bBigEndian)
+	{
+		Algo::Reverse(Out.GetData() + Start, sizeof(T));
+	}
+}
+
+/// Appends the header of an explicit VR data element. OB and OW have a 4 byte length after 2 reserved bytes.
+void AppendElementHeader(TArray<uint8>& Out, const uint16 Group, const uint16 Element, const ANSICHAR* VR, const uint32 Length,
+	const bool bBigEndian = false)
+{
+	AppendValue(Out, Group, bBigEndian);
+	AppendValue(Out, Element, bBigEndian);
+	Out.Append(reinterpret_cast<const uint8*>(VR), 2);
+	if (FCStringAnsi::Strcmp(VR, "OB") == 0 || FCStringAnsi::Strcmp(VR, "OW") == 0)
+	{
+		AppendValue(Out, uint16(0));
+		AppendValue(Out, Length, bBigEndian);
+	}
+	else
+	{
+		AppendValue(Out, static_cast<uint16>(Length), bBigEndian);
+	}
+}
+
+/// Appends a string element, padded to an even length with a zero for UIs and a space otherwise.
+void AppendString(TArray<uint8>& Out, const uint16 Group, const uint16 Element, const ANSICHAR* VR, const FString& Value,
+	const bool bBigEndian = false)
+{
+	TArray<uint8> Bytes;
+	const FTCHARToUTF8 ValueUTF8(*Value);
+	Bytes.Append(reinterpret_cast<const uint8*>(ValueUTF8.Get()), ValueUTF8.Length());
+	if (Bytes.Num() % 2 == 1)
+	{
+		Bytes.Add(FCStringAnsi::Strcmp(VR, "UI") == 0 ? '\0' : ' ');
+	}
+	AppendElementHeader(Out, Group, Element, VR, Bytes.Num(), bBigEndian);
+	Out.Append(Bytes);
+}
+
+void AppendUnsignedShort(TArray<uint8>& Out, const uint16 Group, const uint16 Element, const uint16 Value, const bool bBigEndian)
+{
+	AppendElementHeader(Out, Group, Element, "US", sizeof(uint16), bBigEndian);
+	AppendValue(Out, Value, bBigEndian);
+}
+
+/// Returns an uncompressed single-frame CT file holding the slice of the synthetic series. The file meta information is always
+/// explicit VR little endian, the rest of the file is explicit VR big endian if bBigEndian is true.
+TArray<uint8> MakeDICOMPerfSlice(const int32 Slice, const FString& SeriesInstanceUID, const bool bBigEndian)
+{
+	const FString SOPClassUID = TEXT("1.2.840.10008.5.1.4.1.1.2");
+	const FString SOPInstanceUID = FString::Printf(TEXT("%s.%d"), *SeriesInstanceUID, Slice + 1);
+
+	TArray<uint8> Meta;
+	AppendElementHeader(Meta, 0x0002, 0x0001, "OB", 2);
+	AppendValue(Meta, uint16(0x0100));
+	AppendString(Meta, 0x0002, 0x0002, "UI", SOPClassUID);
+	AppendString(Meta, 0x0002, 0x0003, "UI", SOPInstanceUID);
+	AppendString(Meta, 0x0002, 0x0010, "UI", bBigEndian ? TEXT("1.2.840.10008.1.2.2") : TEXT("1.2.840.10008.1.2.1"));
+
+	TArray<uint8> File;
+	File.SetNumZeroed(128);
+	File.Append(reinterpret_cast<const uint8*>("DICM"), 4);
+	AppendElementHeader(File, 0x0002, 0x0000, "UL", sizeof(uint32));
+	AppendValue(File, static_cast<uint32>(Meta.Num()));
+	File.Append(Meta);
+
+	const double Location = Slice * 0.625;
+	AppendString(File, 0x0008, 0x0016, "UI", SOPClassUID, bBigEndian);
+	AppendString(File, 0x0008, 0x0018, "UI", SOPInstanceUID, bBigEndian);
+	AppendString(File, 0x0008, 0x0060, "CS", TEXT("CT"), bBigEndian);
+	AppendString(File, 0x0018, 0x0050, "DS", TEXT("0.625"), bBigEndian);
+	AppendString(File, 0x0020, 0x000E, "UI", SeriesInstanceUID, bBigEndian);
+	AppendString(File, 0x0020, 0x0013, "IS", FString::FromInt(Slice + 1), bBigEndian);
+	AppendString(File, 0x0020, 0x0032, "DS", FString::Printf(TEXT("0\\0\\%g"), Location), bBigEndian);
+	AppendString(File, 0x0020, 0x1041, "DS", FString::Printf(TEXT("%g"), Location), bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0002, 1, bBigEndian);
+	AppendString(File, 0x0028, 0x0004, "CS", TEXT("MONOCHROME2"), bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0010, DICOMPerfSliceSize, bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0011, DICOMPerfSliceSize, bBigEndian);
+	AppendString(File, 0x0028, 0x0030, "DS", TEXT("0.5\\0.5"), bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0100, 16, bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0101, 16, bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0102, 15, bBigEndian);
+	AppendUnsignedShort(File, 0x0028, 0x0103, 1, bBigEndian);
+
+	const uint32 PixelDataSize = DICOMPerfSliceSize * DICOMPerfSliceSize * sizeof(int16);
+	AppendElementHeader(File, 0x7FE0, 0x0010, "OW", PixelDataSize, bBigEndian);
+	File.Reserve(File.Num() + PixelDataSize);
+	for (int32 Y = 0; Y < DICOMPerfSliceSize; Y++)
+	{
+		for (int32 X = 0; X < DICOMPerfSliceSize; X++)
+		{
+			AppendValue(File, GetDICOMPerfVoxel(X, Y, Slice), bBigEndian);
+		}
+	}
+	return File;
+}
+
+/// Writes the synthetic series, loads it with every worker count and returns how many seconds each load took, or an empty array
+/// if the series couldn't be written or loaded. Little endian slices get copied straight from the pixel data offset in the
+/// folder index, the index doesn't know where the pixel data of big endian slices starts, so those get decoded by DCMTK.
+TArray<double> RunDICOMDecodeSweep(FAutomationTestBase& Test, const bool bBigEndian, const TArray<int32>& WorkerCounts)
+{
+	const TCHAR* PathName = bBigEndian ? TEXT("DCMTK decode") : TEXT("Raw read");
+
+	// Write the synthetic series. The files are in the OS file cache afterwards, so the timings show how decoding scales with the
+	// workers, not how fast the disk is.
+	const FString FolderName = FPaths::ConvertRelativePathToFull(FPaths::AutomationTransientDir() / TEXT("DICOMPerf"));
+	const FString SeriesInstanceUID = TEXT("1.2.826.0.1.3680043.2.1125.1");
+	IFileManager::Get().MakeDirectory(*FolderName, true);
+	std::atomic<bool> bWritten = true;
+	ParallelFor(DICOMPerfSliceCount,
+		[&](const int32 Slice)
+		{
+			const FString FilePath = FolderName / FString::Printf(TEXT("slice_%04d.dcm"), Slice);
+			if (!FFileHelper::SaveArrayToFile(MakeDICOMPerfSlice(Slice, SeriesInstanceUID, bBigEndian), *FilePath))
+			{
+				bWritten = false;
+			}
+		});
+
+	TArray<double> Timings;
+	UDCMTKLoader* Loader = NewObject<UDCMTKLoader>();
+	Loader->bUseFolderIndexCache = false;
+	const FString FirstFilePath = FolderName / TEXT("slice_0000.dcm");
+	const FVolumeInfo VolumeInfo = Loader->ParseVolumeInfoFromHeader(FirstFilePath);
+	if (Test.TestTrue(FString::Printf(TEXT("%s series written"), PathName), bWritten.load()) &&
+		Test.TestTrue(FString::Printf(TEXT("%s header parsed"), PathName), VolumeInfo.bParseWasSuccessful) &&
+		Test.TestTrue(FString::Printf(TEXT("%s dimensions"), PathName),
+			VolumeInfo.Dimensions == FIntVector(DICOMPerfSliceSize, DICOMPerfSliceSize, DICOMPerfSliceCount)))
+	{
+		const FDICOMFolderIndex& FolderIndex = Loader->GetFolderIndex(FolderName, TEXT("dcm"));
+		int32 SlicesWithoutOffset = 0;
+		for (const FDICOMFileRecord& Record : FolderIndex.Files)
+		{
+			SlicesWithoutOffset += Record.PixelDataOffset == INDEX_NONE;
+		}
+		Test.TestEqual(FString::Printf(TEXT("%s slices without pixel data offset"), PathName), SlicesWithoutOffset,
+			bBigEndian ? DICOMPerfSliceCount : 0);
+
+		const double GigaBytes = VolumeInfo.GetByteSize() / (1024.0 * 1024.0 * 1024.0);
+		TUniquePtr<uint8[]> Reference;
+		for (const int32 Workers : WorkerCounts)
+		{
+			FVolumeInfo LoadedInfo = VolumeInfo;
+			const double StartTime = FPlatformTime::Seconds();
+			TUniquePtr<uint8[]> Loaded = UDCMTKLoader::LoadSingleFrameDICOMFolder(
+				FolderIndex, SeriesInstanceUID, LoadedInfo, false, false, false, true, Workers);
+			const double Seconds = FPlatformTime::Seconds() - StartTime;
+			if (!Test.TestNotNull(FString::Printf(TEXT("%s with %d workers"), PathName, Workers), Loaded.Get()))
+			{
+				Timings.Reset();
+				break;
+			}
+
+			if (!Reference)
+			{
+				// Check the single worker load voxel by voxel, the others only have to match it.
+				const int16* Voxels = reinterpret_cast<const int16*>(Loaded.Get());
+				int64 Mismatches = 0;
+				for (int64 Index = 0; Index < VolumeInfo.GetTotalVoxels(); Index++)
+				{
+					const int32 X = static_cast<int32>(Index % DICOMPerfSliceSize);
+					const int32 Y = static_cast<int32>((Index / DICOMPerfSliceSize) % DICOMPerfSliceSize);
+					const int32 Slice = static_cast<int32>(Index / (DICOMPerfSliceSize * DICOMPerfSliceSize));
+					Mismatches += Voxels[Index] != GetDICOMPerfVoxel(X, Y, Slice);
+				}
+				Test.TestEqual(FString::Printf(TEXT("%s mismatching voxels"), PathName), Mismatches, int64(0));
+				Reference = MoveTemp(Loaded);
+			}
+			else
+			{
+				Test.TestTrue(FString::Printf(TEXT("%s with %d workers matches a single worker"), PathName, Workers),
+					FMemory::Memcmp(Loaded.Get(), Reference.Get(), VolumeInfo.GetByteSize()) == 0);
+			}
+
+			Timings.Add(Seconds);
+			Test.AddInfo(FString::Printf(TEXT("%s, %d slices, %2d workers: %8.1f ms, %7.0f slices/s, %.2f GB/s, speedup %.1fx"),
+				PathName, DICOMPerfSliceCount, Workers, Seconds * 1000.0, DICOMPerfSliceCount / Seconds, GigaBytes / Seconds,
+				Timings[0] / Seconds));
+		}
+	}
+
+	IFileManager::Get().DeleteDirectory(*FolderName, false, true);
+	return Timings;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDICOMParallelDecodePerfTest, "TBRaymarcher.VolumeTextureToolkit.DICOMLoader.ParallelDecodePerf",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FDICOMParallelDecodePerfTest::RunTest(const FString& Parameters)
+{
+	// 1, 2, 4, ... workers up to all of them.
+	const int32 MaxWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	TArray<int32> WorkerCounts;
+	for (int32 Workers = 1; Workers < MaxWorkers; Workers *= 2)
+	{
+		WorkerCounts.Add(Workers);
+	}
+	WorkerCounts.Add(MaxWorkers);
+
+	// The raw reads are mostly bound by memory copies, the DCMTK decode parses every file again and shows how the CPU bound path
+	// scales.
+	const TArray<double> RawReadTimings = RunDICOMDecodeSweep(*this, false, WorkerCounts);
+	const TArray<double> DCMTKTimings = RunDICOMDecodeSweep(*this, true, WorkerCounts);
+	if (RawReadTimings.Num() == WorkerCounts.Num() && DCMTKTimings.Num() == WorkerCounts.Num())
+	{
+		for (int32 Index = 0; Index < WorkerCounts.Num(); Index++)
+		{
+			AddInfo(FString::Printf(TEXT("%2d workers: raw read %8.1f ms (speedup %.1fx), DCMTK decode %8.1f ms (speedup %.1fx)"),
+				WorkerCounts[Index], RawReadTimings[Index] * 1000.0, RawReadTimings[0] / RawReadTimings[Index],
+				DCMTKTimings[Index] * 1000.0, DCMTKTimings[0] / DCMTKTimings[Index]));
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,584 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Curves/CurveLinearColor.h"
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Engine/VolumeTexture.h"
+#include "Misc/App.h"
+#include "Misc/AutomationTest.h"
+#include "RHIGPUReadback.h"
+#include "Rendering/LightVolumeCPU.h"
+#include "Rendering/LightingShaders.h"
+#include "TextureUtilities.h"
+#include "Util/RaymarchUtils.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+const FIntVector GPULightTestDimensions(48, 40, 36);
+
+/// Creates everything the light propagation shaders need for the volume. The light volume is 32 bit, so that it can be compared
+/// to the CPU without quantization. Single lights go through the multi-slice shader if bMultiSlice is true and through the
+/// batched shader as a batch of one otherwise.
+bool CreateGPULightTestResources(
+	TArray<uint8>& Voxels, UCurveLinearColor* Curve, bool bMultiSlice, FBasicRaymarchRenderingResources& OutResources)
+{
+	UVolumeTextureToolkit::CreateVolumeTextureTransient(
+		OutResources.DataVolumeTextureRef, PF_G8, GPULightTestDimensions, Voxels.GetData(), true);
+	URaymarchUtils::ColorCurveToTexture(Curve, OutResources.TFTextureRef);
+	OutResources.bMultiSliceLightPropagation = bMultiSlice;
+	OutResources.bBatchedLightPropagation = false;
+
+	const FIntVector& Size = GPULightTestDimensions;
+	OutResources.LightVolumeRenderTarget = NewObject<UTextureRenderTargetVolume>();
+	OutResources.LightVolumeRenderTarget->bCanCreateUAV = true;
+	OutResources.LightVolumeRenderTarget->bHDR = true;
+	OutResources.LightVolumeRenderTarget->Init(Size.X, Size.Y, Size.Z, PF_R32_FLOAT);
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(CreateLightTestBuffers)
+	(
+		[&OutResources, Size](FRHICommandListImmediate& RHICmdList)
+		{
+			URaymarchUtils::CreateBufferTextures(FIntPoint(Size.Y, Size.Z), PF_R32_FLOAT, OutResources.XYZReadWriteBuffers[0]);
+			URaymarchUtils::CreateBufferTextures(FIntPoint(Size.X, Size.Z), PF_R32_FLOAT, OutResources.XYZReadWriteBuffers[1]);
+			URaymarchUtils::CreateBufferTextures(FIntPoint(Size.X, Size.Y), PF_R32_FLOAT, OutResources.XYZReadWriteBuffers[2]);
+			OutResources.LightVolumeUAVRef =
+				RHICreateUnorderedAccessView(OutResources.LightVolumeRenderTarget->GetResource()->TextureRHI);
+			OutResources.bIsInitialized = true;
+		});
+	FlushRenderingCommands();
+	return OutResources.bIsInitialized;
+}
+
+void ReleaseGPULightTestResources(FBasicRaymarchRenderingResources& Resources)
+{
+	ENQUEUE_RENDER_COMMAND(ReleaseLightTestBuffers)
+	(
+		[&Resources](FRHICommandListImmediate& RHICmdList)
+		{
+			for (OneAxisReadWriteBufferResources& Buffer : Resources.XYZReadWriteBuffers)
+			{
+				URaymarchUtils::ReleaseOneAxisReadWriteBufferResources(Buffer);
+			}
+			Resources.LightVolumeUAVRef.SafeRelease();
+			Resources.OpacityVolumeUAVRef.SafeRelease();
+			Resources.LightCheckpoints.Reset();
+		});
+	FlushRenderingCommands();
+}
+
+/// Adds an opacity only volume to the resources, the same way ARaymarchVolume creates it.
+bool CreateGPUOpacityVolume(FBasicRaymarchRenderingResources& Resources)
+{
+	const FIntVector& Size = GPULightTestDimensions;
+	Resources.OpacityVolumeMode = EOpacityVolumeMode::Opacity;
+	Resources.OpacityVolumeRenderTarget = NewObject<UTextureRenderTargetVolume>();
+	Resources.OpacityVolumeRenderTarget->bCanCreateUAV = true;
+	Resources.OpacityVolumeRenderTarget->bHDR = true;
+	Resources.OpacityVolumeRenderTarget->Init(Size.X, Size.Y, Size.Z, PF_R16F);
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(CreateOpacityTestVolume)
+	(
+		[&Resources](FRHICommandListImmediate& RHICmdList)
+		{
+			Resources.OpacityVolumeUAVRef =
+				RHICreateUnorderedAccessView(Resources.OpacityVolumeRenderTarget->GetResource()->TextureRHI);
+		});
+	FlushRenderingCommands();
+	return Resources.OpacityVolumeUAVRef.IsValid();
+}
+
+/// Copies a R32F or R16F volume render target to the CPU.
+void ReadBackVolume(UTextureRenderTargetVolume* RenderTarget, FLightVolumeCPU& OutVolume)
+{
+	OutVolume.Init(GPULightTestDimensions);
+	ENQUEUE_RENDER_COMMAND(ReadBackTestVolume)
+	(
+		[RenderTarget, &OutVolume](FRHICommandListImmediate& RHICmdList)
+		{
+			const FIntVector& Size = OutVolume.Dimensions;
+			const bool bHalf = RenderTarget->OverrideFormat == PF_R16F;
+			FRHIGPUTextureReadback Readback(TEXT("TestVolumeReadback"));
+			Readback.EnqueueCopy(RHICmdList, RenderTarget->GetResource()->TextureRHI, FIntVector::ZeroValue, 0, Size);
+			RHICmdList.BlockUntilGPUIdle();
+
+			int32 RowPitch = 0;
+			int32 BufferHeight = 0;
+			const uint8* Data = static_cast<const uint8*>(Readback.Lock(RowPitch, &BufferHeight));
+			for (int32 Z = 0; Z < Size.Z; Z++)
+			{
+				for (int32 Y = 0; Y < Size.Y; Y++)
+				{
+					const int64 Row = int64(Z) * BufferHeight + Y;
+					float* Voxels = &OutVolume.Voxels[(int64(Z) * Size.Y + Y) * Size.X];
+					for (int32 X = 0; X < Size.X; X++)
+					{
+						Voxels[X] = bHalf ? reinterpret_cast<const FFloat16*>(Data)[Row * RowPitch + X].GetFloat()
+										  : reinterpret_cast<const float*>(Data)[Row * RowPitch + X];
+					}
+				}
+			}
+			Readback.Unlock();
+		});
+	FlushRenderingCommands();
+}
+
+/// Copies the light volume of the resources to the CPU.
+void ReadBackLightVolume(FBasicRaymarchRenderingResources& Resources, FLightVolumeCPU& OutLightVolume)
+{
+	ReadBackVolume(Resources.LightVolumeRenderTarget, OutLightVolume);
+}
+
+/// Clears the light volume, adds the light Repeats times (removing it in between) and reads the light volume back.
+/// Returns the seconds it took on average to add or remove the light, including waiting for the GPU.
+double PropagateAndReadBack(FBasicRaymarchRenderingResources& Resources, const FDirLightParameters& Light,
+	const FRaymarchWorldParameters& World, int32 Repeats, FLightVolumeCPU& OutLightVolume)
+{
+	URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+	FlushRenderingCommands();
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < 2 * Repeats - 1; Index++)
+	{
+		const bool bAdded = Index % 2 == 0;
+		ENQUEUE_RENDER_COMMAND(PropagateTestLight)
+		(
+			[Resources, Light, World, bAdded](FRHICommandListImmediate& RHICmdList)
+			{
+				AddDirLightToSingleLightVolume_RenderThread(RHICmdList, Resources, Light, bAdded, World);
+				RHICmdList.BlockUntilGPUIdle();
+			});
+	}
+	FlushRenderingCommands();
+	const double Seconds = (FPlatformTime::Seconds() - StartTime) / (2 * Repeats - 1);
+
+	ReadBackLightVolume(Resources, OutLightVolume);
+	return Seconds;
+}
+
+TArray<uint8> MakeRandomVolume(int32 Seed)
+{
+	FRandomStream Random(Seed);
+	TArray<uint8> Voxels;
+	Voxels.SetNumUninitialized(GPULightTestDimensions.X * GPULightTestDimensions.Y * GPULightTestDimensions.Z);
+	for (uint8& Voxel : Voxels)
+	{
+		Voxel = static_cast<uint8>(Random.RandRange(0, MAX_uint8));
+	}
+	return Voxels;
+}
+
+float GetMaxDifference(const FLightVolumeCPU& First, const FLightVolumeCPU& Second)
+{
+	float MaxDifference = 0.0f;
+	for (int32 Index = 0; Index < First.Voxels.Num(); Index++)
+	{
+		MaxDifference = FMath::Max(MaxDifference, FMath::Abs(First.Voxels[Index] - Second.Voxels[Index]));
+	}
+	return MaxDifference;
+}
+
+float GetMaxAbsVoxel(const FLightVolumeCPU& Volume)
+{
+	float MaxVoxel = 0.0f;
+	for (const float Voxel : Volume.Voxels)
+	{
+		MaxVoxel = FMath::Max(MaxVoxel, FMath::Abs(Voxel));
+	}
+	return MaxVoxel;
+}
+
+/// Clears the light volume, adds all the lights in batches and reads the light volume back.
+void ResetBatchedAndReadBack(FBasicRaymarchRenderingResources& Resources, const TArray<FDirLightParameters>& Lights,
+	const FRaymarchWorldParameters& World, FLightVolumeCPU& OutLightVolume)
+{
+	URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+	FlushRenderingCommands();
+	bool bLightsAdded = false;
+	URaymarchUtils::AddDirLightsToSingleVolume(Resources, Lights, true, World, bLightsAdded);
+	FlushRenderingCommands();
+	ReadBackLightVolume(Resources, OutLightVolume);
+}
+
+/// Lights exercising the single dispatch and the halo paths of the multi-slice shader and lights going along two faces.
+TArray<FDirLightParameters> MakeMixedLights()
+{
+	TArray<FDirLightParameters> Lights;
+	Lights.Add(FDirLightParameters(FVector(0, 0, -1), 0.6f));
+	Lights.Add(FDirLightParameters(FVector(0.1, 0.05, -1).GetSafeNormal(), 0.5f));
+	Lights.Add(FDirLightParameters(FVector(1, 0.7, 0).GetSafeNormal(), 0.4f));
+	Lights.Add(FDirLightParameters(FVector(-0.3, -1, 0.2).GetSafeNormal(), 0.3f));
+	return Lights;
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationGPUTest, "TBRaymarcher.Raymarcher.LightPropagationGPU.SingleLight",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationGPUTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI to propagate light on, only the CPU light volume tests apply."));
+		return true;
+	}
+
+	TArray<uint8> Voxels = MakeRandomVolume(22);
+	UCurveLinearColor* Curve = NewObject<UCurveLinearColor>();
+	Curve->FloatCurves[3].AddKey(0.0f, 0.0f);
+	Curve->FloatCurves[3].AddKey(1.0f, 0.1f);
+
+	FLightPropagationInputCPU Input;
+	Input.SetVolumeData(Voxels.GetData(), GPULightTestDimensions, PF_G8);
+	Input.SetTransferFunctionFromCurve(Curve);
+
+	FRaymarchWorldParameters World;
+	World.VolumeTransform = FTransform(FRotator::ZeroRotator, FVector::ZeroVector, FVector(100));
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(10, 0, 0), FVector(1, 0.2, 0));
+
+	// One light straight along an axis, which the multi-slice mode does in a single dispatch, and one slightly off it, which
+	// needs halos.
+	const FDirLightParameters Lights[] = {
+		FDirLightParameters(FVector(0, 0, -1), 1.0f), FDirLightParameters(FVector(0.05, 0.03, -1).GetSafeNormal(), 1.0f)};
+
+	for (int32 Mode = 0; Mode < 2; Mode++)
+	{
+		const bool bMultiSlice = Mode == 1;
+		FBasicRaymarchRenderingResources Resources;
+		if (!TestTrue(TEXT("Resources created"), CreateGPULightTestResources(Voxels, Curve, bMultiSlice, Resources)))
+		{
+			return false;
+		}
+		Input.WindowingParameters = Resources.WindowingParameters;
+
+		for (int32 LightIndex = 0; LightIndex < UE_ARRAY_COUNT(Lights); LightIndex++)
+		{
+			FLightVolumeCPU Expected;
+			ComputeLightVolume_CPU(Input, MakeArrayView(&Lights[LightIndex], 1), World, Expected);
+
+			FLightVolumeCPU LightVolume;
+			const double Seconds = PropagateAndReadBack(Resources, Lights[LightIndex], World, 8, LightVolume);
+			const float MaxDifference = GetMaxDifference(LightVolume, Expected);
+			AddInfo(FString::Printf(TEXT("%s light %d: %.3f ms per propagation, max difference to the CPU %g"),
+				bMultiSlice ? TEXT("Multi-slice") : TEXT("Batch of one"), LightIndex, Seconds * 1000.0, MaxDifference));
+
+			// The GPU filters with lower precision than the CPU, so light volumes only match up to that.
+			TestTrue(TEXT("GPU light volume matches the CPU"), MaxDifference < 0.01f);
+		}
+		ReleaseGPULightTestResources(Resources);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationGPUBatchedTest, "TBRaymarcher.Raymarcher.LightPropagationGPU.Batched",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationGPUBatchedTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI to propagate light on, only the CPU light volume tests apply."));
+		return true;
+	}
+
+	// Less opaque than the single light test, so that the lights get through most of the volume.
+	TArray<uint8> Voxels = MakeRandomVolume(23);
+	UCurveLinearColor* Curve = NewObject<UCurveLinearColor>();
+	Curve->FloatCurves[3].AddKey(0.0f, 0.0f);
+	Curve->FloatCurves[3].AddKey(1.0f, 0.002f);
+
+	FLightPropagationInputCPU Input;
+	Input.SetVolumeData(Voxels.GetData(), GPULightTestDimensions, PF_G8);
+	Input.SetTransferFunctionFromCurve(Curve);
+
+	FRaymarchWorldParameters World;
+	World.VolumeTransform = FTransform(FRotator::ZeroRotator, FVector::ZeroVector, FVector(100));
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(10, 0, 0), FVector(1, 0.2, 0));
+
+	// More lights going down Z than fit into one batch and one going up.
+	TArray<FDirLightParameters> Lights;
+	for (int32 LightIndex = 0; LightIndex <= FAddDirLightsBatchedShader::MaxBatchedLights; LightIndex++)
+	{
+		Lights.Add(FDirLightParameters(FVector(0.02 * LightIndex, 0, -1).GetSafeNormal(), 0.1f));
+	}
+	Lights.Add(FDirLightParameters(FVector(0, 0, 1), 0.5f));
+
+	FBasicRaymarchRenderingResources Resources;
+	if (!TestTrue(TEXT("Resources created"), CreateGPULightTestResources(Voxels, Curve, true, Resources)))
+	{
+		return false;
+	}
+	Resources.bBatchedLightPropagation = true;
+	Input.WindowingParameters = Resources.WindowingParameters;
+
+	FLightVolumeCPU Expected;
+	ComputeLightVolume_CPU(Input, Lights, World, Expected);
+
+	URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+	FlushRenderingCommands();
+	bool bLightsAdded = false;
+	URaymarchUtils::AddDirLightsToSingleVolume(Resources, Lights, true, World, bLightsAdded);
+	FlushRenderingCommands();
+	TestTrue(TEXT("Lights added"), bLightsAdded);
+
+	FLightVolumeCPU LightVolume;
+	ReadBackLightVolume(Resources, LightVolume);
+	const float MaxDifference = GetMaxDifference(LightVolume, Expected);
+	AddInfo(FString::Printf(TEXT("Batched lights: max difference to the CPU %g"), MaxDifference));
+
+	// The GPU filters with lower precision than the CPU, so light volumes only match up to that.
+	TestTrue(TEXT("Batched light volume matches the CPU"), MaxDifference < 0.01f);
+
+	// Same lights, with the opacity read from an opacity volume. It only differs by storing the opacity in 16 bits.
+	if (!TestTrue(TEXT("Opacity volume created"), CreateGPUOpacityVolume(Resources)))
+	{
+		ReleaseGPULightTestResources(Resources);
+		return false;
+	}
+	URaymarchUtils::BuildOpacityVolume(Resources);
+	FLightVolumeCPU OpacityVolume;
+	ReadBackVolume(Resources.OpacityVolumeRenderTarget, OpacityVolume);
+	FLightVolumeCPU ExpectedOpacity;
+	BuildOpacityVolume_CPU(Input, ExpectedOpacity);
+	const float MaxOpacityDifference = GetMaxDifference(OpacityVolume, ExpectedOpacity);
+	TestTrue(FString::Printf(TEXT("GPU opacity volume matches the CPU (max difference %g)"), MaxOpacityDifference),
+		MaxOpacityDifference < 1e-4f);
+
+	URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+	FlushRenderingCommands();
+	URaymarchUtils::AddDirLightsToSingleVolume(Resources, Lights, true, World, bLightsAdded);
+	FlushRenderingCommands();
+	FLightVolumeCPU OpacityLightVolume;
+	ReadBackLightVolume(Resources, OpacityLightVolume);
+	const float MaxOpacityLightDifference = GetMaxDifference(OpacityLightVolume, LightVolume);
+	AddInfo(FString::Printf(TEXT("Batched lights with an opacity volume: max difference %g"), MaxOpacityLightDifference));
+	TestTrue(TEXT("Opacity volume light volume matches sampling the transfer function"), MaxOpacityLightDifference < 0.01f);
+
+	ReleaseGPULightTestResources(Resources);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationGPUIncrementalClippingTest,
+	"TBRaymarcher.Raymarcher.LightPropagationGPU.IncrementalClipping",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationGPUIncrementalClippingTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI to propagate light on, only the CPU light volume tests apply."));
+		return true;
+	}
+
+	TArray<uint8> Voxels = MakeRandomVolume(29);
+	UCurveLinearColor* Curve = NewObject<UCurveLinearColor>();
+	Curve->FloatCurves[3].AddKey(0.0f, 0.0f);
+	Curve->FloatCurves[3].AddKey(1.0f, 0.002f);
+
+	// Lights along all three axes, one of them going along two faces.
+	TArray<FDirLightParameters> Lights;
+	Lights.Add(FDirLightParameters(FVector(0.1, 0, -1).GetSafeNormal(), 0.4f));
+	Lights.Add(FDirLightParameters(FVector(1, 0.7, 0).GetSafeNormal(), 0.3f));
+	Lights.Add(FDirLightParameters(FVector(0, -1, 0.2).GetSafeNormal(), 0.3f));
+
+	// Once sampling the transfer function, once reading the opacity volume.
+	for (int32 Mode = 0; Mode < 2; Mode++)
+	{
+		const bool bOpacityVolume = Mode == 1;
+		FBasicRaymarchRenderingResources Resources;
+		if (!TestTrue(TEXT("Resources created"), CreateGPULightTestResources(Voxels, Curve, true, Resources)))
+		{
+			return false;
+		}
+		Resources.bBatchedLightPropagation = true;
+		Resources.LightCheckpoints = MakeShared<FLightPropagationCheckpoints, ESPMode::ThreadSafe>();
+		if (bOpacityVolume)
+		{
+			if (!TestTrue(TEXT("Opacity volume created"), CreateGPUOpacityVolume(Resources)))
+			{
+				ReleaseGPULightTestResources(Resources);
+				return false;
+			}
+			URaymarchUtils::BuildOpacityVolume(Resources);
+		}
+		const TCHAR* ModeName = bOpacityVolume ? TEXT("with an opacity volume") : TEXT("sampling the transfer function");
+
+		FRaymarchWorldParameters World;
+		World.VolumeTransform = FTransform(FRotator::ZeroRotator, FVector::ZeroVector, FVector(100));
+		World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(-20, 0, 0), FVector(1, 0.2, 0.1).GetSafeNormal());
+
+		// Recording the checkpoints is the same sweep as adding the lights without them, so switching between the two doesn't
+		// change the light volume.
+		URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+		FlushRenderingCommands();
+		bool bLightsAdded = false;
+		URaymarchUtils::AddDirLightsToSingleVolume(Resources, Lights, true, World, bLightsAdded);
+		FlushRenderingCommands();
+		FLightVolumeCPU Batched;
+		ReadBackLightVolume(Resources, Batched);
+
+		URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+		FlushRenderingCommands();
+		URaymarchUtils::AddDirLightsWithCheckpointsToSingleVolume(Resources, Lights, World, bLightsAdded);
+		FlushRenderingCommands();
+		TestTrue(TEXT("Lights added with checkpoints"), bLightsAdded);
+		FLightVolumeCPU WithCheckpoints;
+		ReadBackLightVolume(Resources, WithCheckpoints);
+		const float MaxResetDifference = GetMaxDifference(WithCheckpoints, Batched);
+		TestTrue(FString::Printf(TEXT("Adding lights with checkpoints %s matches adding them batched (max difference %g)"),
+					 ModeName, MaxResetDifference),
+			MaxResetDifference == 0.0f);
+
+		// Drag the plane through the volume, tilting it along the way.
+		for (int32 Step = 1; Step <= 6; Step++)
+		{
+			World.ClippingPlaneParameters = FClippingPlaneParameters(
+				FVector(-20 + 8 * Step, 3 * Step, 0), FVector(1, 0.2 - 0.1 * Step, 0.1 + 0.05 * Step).GetSafeNormal());
+			bool bLightsUpdated = false;
+			URaymarchUtils::UpdateClippingInSingleVolume(Resources, World, bLightsUpdated);
+			FlushRenderingCommands();
+			TestTrue(FString::Printf(TEXT("Clipping updated in step %d"), Step), bLightsUpdated);
+		}
+		FLightVolumeCPU Incremental;
+		ReadBackLightVolume(Resources, Incremental);
+
+		// Same formulation as the batched propagation, so it gives the same light volume at the final plane.
+		URaymarchUtils::ClearResourceLightVolumes(Resources, 0.0f);
+		FlushRenderingCommands();
+		URaymarchUtils::AddDirLightsToSingleVolume(Resources, Lights, true, World, bLightsAdded);
+		FlushRenderingCommands();
+		FLightVolumeCPU Recomputed;
+		ReadBackLightVolume(Resources, Recomputed);
+
+		const float MaxDifference = GetMaxDifference(Incremental, Recomputed);
+		TestTrue(FString::Printf(TEXT("Incrementally updated light volume %s matches a recompute (max difference %g)"), ModeName,
+					 MaxDifference),
+			MaxDifference < 1e-4f);
+
+		ReleaseGPULightTestResources(Resources);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationGPURemoveTest, "TBRaymarcher.Raymarcher.LightPropagationGPU.RemoveBatchedLights",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationGPURemoveTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI to propagate light on, only the CPU light volume tests apply."));
+		return true;
+	}
+
+	TArray<uint8> Voxels = MakeRandomVolume(31);
+	UCurveLinearColor* Curve = NewObject<UCurveLinearColor>();
+	Curve->FloatCurves[3].AddKey(0.0f, 0.0f);
+	Curve->FloatCurves[3].AddKey(1.0f, 0.01f);
+
+	FRaymarchWorldParameters World;
+	World.VolumeTransform = FTransform(FRotator::ZeroRotator, FVector::ZeroVector, FVector(100));
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(10, 0, 0), FVector(1, 0.2, 0));
+	const TArray<FDirLightParameters> Lights = MakeMixedLights();
+
+	// Lights added in batches get removed one by one, by the multi-slice shader and as batches of one.
+	for (int32 Mode = 0; Mode < 2; Mode++)
+	{
+		const bool bMultiSlice = Mode == 1;
+		FBasicRaymarchRenderingResources Resources;
+		if (!TestTrue(TEXT("Resources created"), CreateGPULightTestResources(Voxels, Curve, bMultiSlice, Resources)))
+		{
+			return false;
+		}
+
+		Resources.bBatchedLightPropagation = true;
+		FLightVolumeCPU LightVolume;
+		ResetBatchedAndReadBack(Resources, Lights, World, LightVolume);
+		TestTrue(TEXT("Lights added"), GetMaxAbsVoxel(LightVolume) > 0.1f);
+
+		// Single lights don't go through the batched sweep if they fit into the multi-slice shader, even with batches enabled.
+		for (const FDirLightParameters& Light : Lights)
+		{
+			bool bLightRemoved = false;
+			URaymarchUtils::AddDirLightToSingleVolume(Resources, Light, false, World, bLightRemoved);
+			TestTrue(TEXT("Light removed"), bLightRemoved);
+		}
+		FlushRenderingCommands();
+		ReadBackLightVolume(Resources, LightVolume);
+
+		const float MaxLeftover = GetMaxAbsVoxel(LightVolume);
+		TestTrue(FString::Printf(TEXT("%s removal leaves no light behind (max %g)"),
+					 bMultiSlice ? TEXT("Multi-slice") : TEXT("Batch of one"), MaxLeftover),
+			MaxLeftover < 1e-4f);
+		ReleaseGPULightTestResources(Resources);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightPropagationGPUChangeTest, "TBRaymarcher.Raymarcher.LightPropagationGPU.ChangeLight",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightPropagationGPUChangeTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GUsingNullRHI)
+	{
+		AddInfo(TEXT("No RHI to propagate light on, only the CPU light volume tests apply."));
+		return true;
+	}
+
+	TArray<uint8> Voxels = MakeRandomVolume(37);
+	UCurveLinearColor* Curve = NewObject<UCurveLinearColor>();
+	Curve->FloatCurves[3].AddKey(0.0f, 0.0f);
+	Curve->FloatCurves[3].AddKey(1.0f, 0.01f);
+
+	FRaymarchWorldParameters World;
+	World.VolumeTransform = FTransform(FRotator::ZeroRotator, FVector::ZeroVector, FVector(100));
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(10, 0, 0), FVector(1, 0.2, 0));
+
+	TArray<FDirLightParameters> Lights = MakeMixedLights();
+	const FDirLightParameters OldLight = Lights[1];
+	const FDirLightParameters NewLight(FVector(0.6, -0.2, -1).GetSafeNormal(), 0.7f);
+
+	// Changing a light after a batched reset has to give the same light volume as a reset with the changed light, whether the
+	// change is batched or not and whether the axes fitting into the multi-slice shader go through it or not.
+	for (int32 Mode = 0; Mode < 3; Mode++)
+	{
+		const bool bBatchedChange = Mode != 0;
+		const bool bMultiSlice = Mode != 2;
+		FBasicRaymarchRenderingResources Resources;
+		if (!TestTrue(TEXT("Resources created"), CreateGPULightTestResources(Voxels, Curve, bMultiSlice, Resources)))
+		{
+			return false;
+		}
+
+		Resources.bBatchedLightPropagation = true;
+		FLightVolumeCPU Changed;
+		ResetBatchedAndReadBack(Resources, Lights, World, Changed);
+
+		Resources.bBatchedLightPropagation = bBatchedChange;
+		bool bLightChanged = false;
+		URaymarchUtils::ChangeDirLightInSingleVolume(Resources, OldLight, NewLight, World, bLightChanged);
+		FlushRenderingCommands();
+		TestTrue(TEXT("Light changed"), bLightChanged);
+		ReadBackLightVolume(Resources, Changed);
+
+		Resources.bBatchedLightPropagation = true;
+		Lights[1] = NewLight;
+		FLightVolumeCPU Reset;
+		ResetBatchedAndReadBack(Resources, Lights, World, Reset);
+		Lights[1] = OldLight;
+
+		const float MaxDifference = GetMaxDifference(Changed, Reset);
+		TestTrue(FString::Printf(TEXT("%s%s change matches a reset (max difference %g)"),
+					 bBatchedChange ? TEXT("Batched") : TEXT("Per-light"), bMultiSlice ? TEXT(" multi-slice") : TEXT(""),
+					 MaxDifference),
+			MaxDifference < 1e-4f);
+		ReleaseGPULightTestResources(Resources);
+	}
+	return true;
+}
+
+#endif
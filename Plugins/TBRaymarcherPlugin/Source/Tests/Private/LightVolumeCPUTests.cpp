@@ -0,0 +1,270 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Misc/AutomationTest.h"
+#include "Rendering/LightVolumeCPU.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+constexpr int32 LightTestSize = 8;
+
+/// Returns input with a LightTestSize^3 volume where every voxel is Value and a transfer function with a constant Alpha.
+FLightPropagationInputCPU MakeUniformLightInput(float Value, float Alpha)
+{
+	TArray<float> Voxels;
+	Voxels.Init(Value, LightTestSize * LightTestSize * LightTestSize);
+	FLightPropagationInputCPU Input;
+	Input.SetVolumeData(reinterpret_cast<const uint8*>(Voxels.GetData()), FIntVector(LightTestSize), PF_R32_FLOAT);
+	Input.TransferFunctionAlpha.Init(Alpha, 256);
+	return Input;
+}
+
+/// Identity transform, with the clipping plane far enough from the volume to not clip anything.
+FRaymarchWorldParameters MakeUnclippedWorld()
+{
+	FRaymarchWorldParameters World;
+	World.VolumeTransform = FTransform::Identity;
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(-100, 0, 0), FVector(1, 0, 0));
+	return World;
+}
+
+/// Light left after going through Slices voxels of a uniform volume with the provided alpha, with the light shining along an axis.
+float GetAxisAlignedLight(float Alpha, int32 Slices)
+{
+	// Light going along an axis steps one voxel per slice, 1 / LightTestSize in UVW.
+	const float SliceOpacity = 1.0f - FMath::Pow(1.0f - Alpha, 100.0f / LightTestSize);
+	return FMath::Pow(1.0f - SliceOpacity, float(Slices));
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeCPUTransparentTest, "TBRaymarcher.Raymarcher.LightVolumeCPU.Transparent",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeCPUTransparentTest::RunTest(const FString& Parameters)
+{
+	const FLightPropagationInputCPU Input = MakeUniformLightInput(0.5f, 0.0f);
+
+	// Nothing occludes the light, so every voxel gets all of it - an oblique light split between 2 axes, too.
+	const FDirLightParameters Lights[] = {FDirLightParameters(FVector(0, 0, -1), 1.0f),
+		FDirLightParameters(FVector(1, 1, 0).GetSafeNormal(), 1.0f), FDirLightParameters(FVector(0.2, -1, 0.4), 0.5f)};
+	const float Expected[] = {1.0f, 1.0f, 0.5f};
+	for (int32 LightIndex = 0; LightIndex < UE_ARRAY_COUNT(Lights); LightIndex++)
+	{
+		FLightVolumeCPU LightVolume;
+		ComputeLightVolume_CPU(Input, MakeArrayView(&Lights[LightIndex], 1), MakeUnclippedWorld(), LightVolume);
+		float MaxError = 0.0f;
+		for (const float Voxel : LightVolume.Voxels)
+		{
+			MaxError = FMath::Max(MaxError, FMath::Abs(Voxel - Expected[LightIndex]));
+		}
+		TestTrue(FString::Printf(TEXT("Light %d reaches every voxel (max error %f)"), LightIndex, MaxError), MaxError < 1e-5f);
+	}
+
+	// G16 data gets normalized like the shaders see it.
+	const uint16 G16Voxels[] = {0, MAX_uint16, MAX_uint16 / 2};
+	FLightPropagationInputCPU G16Input;
+	TestTrue(TEXT("G16 volume set"),
+		G16Input.SetVolumeData(reinterpret_cast<const uint8*>(G16Voxels), FIntVector(3, 1, 1), PF_G16));
+	TestEqual(TEXT("G16 maximum"), G16Input.Voxels[1], 1.0f);
+	TestEqual(TEXT("G16 middle"), G16Input.Voxels[2], 32767.0f / MAX_uint16);
+
+	AddExpectedError(TEXT("not set up"), EAutomationExpectedErrorFlags::Contains, 1);
+	FLightVolumeCPU Unused;
+	TestFalse(TEXT("Input without a transfer function is rejected"),
+		ComputeLightVolume_CPU(G16Input, MakeArrayView(Lights, 1), MakeUnclippedWorld(), Unused));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeCPUAttenuationTest, "TBRaymarcher.Raymarcher.LightVolumeCPU.Attenuation",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeCPUAttenuationTest::RunTest(const FString& Parameters)
+{
+	constexpr float Alpha = 0.01f;
+	const FLightPropagationInputCPU Input = MakeUniformLightInput(0.5f, Alpha);
+
+	// Light shining down from +Z - the top slice gets all of it, every slice below it is attenuated by one more voxel.
+	const FDirLightParameters Light(FVector(0, 0, -1), 1.0f);
+	FLightVolumeCPU LightVolume;
+	ComputeLightVolume_CPU(Input, MakeArrayView(&Light, 1), MakeUnclippedWorld(), LightVolume);
+
+	int32 Mismatches = 0;
+	for (int32 Z = 0; Z < LightTestSize; Z++)
+	{
+		const float Expected = GetAxisAlignedLight(Alpha, LightTestSize - 1 - Z);
+		for (int32 Y = 0; Y < LightTestSize; Y++)
+		{
+			for (int32 X = 0; X < LightTestSize; X++)
+			{
+				Mismatches += !FMath::IsNearlyEqual(LightVolume.GetVoxel(FIntVector(X, Y, Z)), Expected, 1e-5f);
+			}
+		}
+	}
+	TestEqual(TEXT("Attenuated voxel mismatches"), Mismatches, 0);
+
+	// Half resolution light volumes step over twice the voxels of the data volume per slice.
+	FLightPropagationInputCPU HalfInput = Input;
+	HalfInput.LightVolumeDimensions = FIntVector(LightTestSize / 2);
+	ComputeLightVolume_CPU(HalfInput, MakeArrayView(&Light, 1), MakeUnclippedWorld(), LightVolume);
+	TestTrue(TEXT("Half resolution light volume size"), LightVolume.Dimensions == FIntVector(LightTestSize / 2));
+	TestTrue(TEXT("Half resolution top slice"), FMath::IsNearlyEqual(LightVolume.GetVoxel(FIntVector(1, 1, 3)), 1.0f, 1e-5f));
+	TestTrue(TEXT("Half resolution attenuation"),
+		FMath::IsNearlyEqual(LightVolume.GetVoxel(FIntVector(1, 1, 2)), GetAxisAlignedLight(Alpha, 2), 1e-3f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeCPUClippingTest, "TBRaymarcher.Raymarcher.LightVolumeCPU.Clipping",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeCPUClippingTest::RunTest(const FString& Parameters)
+{
+	constexpr float Alpha = 0.01f;
+	const FLightPropagationInputCPU Input = MakeUniformLightInput(0.5f, Alpha);
+
+	// Clip away everything with X below the center of the volume.
+	FRaymarchWorldParameters World = MakeUnclippedWorld();
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(0, 0, 0), FVector(1, 0, 0));
+	const FDirLightParameters Light(FVector(0, 0, -1), 1.0f);
+	FLightVolumeCPU LightVolume;
+	ComputeLightVolume_CPU(Input, MakeArrayView(&Light, 1), World, LightVolume);
+
+	// Voxels further than sqrt(3) / 2 voxels from the plane are fully clipped or fully kept, the ones closer get partially
+	// occluded.
+	int32 ClippedMismatches = 0;
+	int32 KeptMismatches = 0;
+	for (int32 Z = 0; Z < LightTestSize; Z++)
+	{
+		for (int32 Y = 0; Y < LightTestSize; Y++)
+		{
+			for (int32 X = 0; X < LightTestSize; X++)
+			{
+				const float Voxel = LightVolume.GetVoxel(FIntVector(X, Y, Z));
+				if (X < LightTestSize / 2 - 1)
+				{
+					ClippedMismatches += !FMath::IsNearlyEqual(Voxel, 1.0f, 1e-5f);
+				}
+				else if (X > LightTestSize / 2)
+				{
+					KeptMismatches += !FMath::IsNearlyEqual(Voxel, GetAxisAlignedLight(Alpha, LightTestSize - 1 - Z), 1e-5f);
+				}
+			}
+		}
+	}
+	TestEqual(TEXT("Clipped voxels occlude nothing"), ClippedMismatches, 0);
+	TestEqual(TEXT("Kept voxels occlude as without clipping"), KeptMismatches, 0);
+
+	const float NearPlaneClipped = LightVolume.GetVoxel(FIntVector(LightTestSize / 2 - 1, 0, 0));
+	const float NearPlaneKept = LightVolume.GetVoxel(FIntVector(LightTestSize / 2, 0, 0));
+	TestTrue(TEXT("Partially clipped voxels occlude partially"), NearPlaneClipped < 1.0f && NearPlaneKept < NearPlaneClipped);
+	TestTrue(TEXT("Partially kept voxels occlude less"), NearPlaneKept > GetAxisAlignedLight(Alpha, LightTestSize - 1));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeCPUAddRemoveTest, "TBRaymarcher.Raymarcher.LightVolumeCPU.AddRemove",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeCPUAddRemoveTest::RunTest(const FString& Parameters)
+{
+	// Noisy volume with a ramp transfer function, lit from an oblique angle, so that both major axes and all the interpolation
+	// get exercised.
+	FRandomStream Random(21);
+	TArray<float> Voxels;
+	Voxels.SetNumUninitialized(LightTestSize * LightTestSize * LightTestSize);
+	for (float& Voxel : Voxels)
+	{
+		Voxel = Random.GetFraction();
+	}
+	FLightPropagationInputCPU Input;
+	Input.SetVolumeData(reinterpret_cast<const uint8*>(Voxels.GetData()), FIntVector(LightTestSize), PF_R32_FLOAT);
+	Input.TransferFunctionAlpha.SetNumUninitialized(256);
+	for (int32 Index = 0; Index < 256; Index++)
+	{
+		Input.TransferFunctionAlpha[Index] = Index / 255.0f * 0.05f;
+	}
+
+	FRaymarchWorldParameters World = MakeUnclippedWorld();
+	World.VolumeTransform = FTransform(FRotator(10, 20, 30), FVector(5, 0, 0), FVector(100, 200, 100));
+	World.ClippingPlaneParameters = FClippingPlaneParameters(FVector(5, 0, 0), FVector(1, 1, 0));
+	const FDirLightParameters Light(FVector(0.3, -0.5, -0.8), 0.8f);
+
+	FLightVolumeCPU LightVolume;
+	LightVolume.Init(Input.LightVolumeDimensions);
+	AddDirLightToSingleLightVolume_CPU(Input, LightVolume, Light, true, World);
+	float MinLight = TNumericLimits<float>::Max();
+	float MaxLight = TNumericLimits<float>::Lowest();
+	for (const float Voxel : LightVolume.Voxels)
+	{
+		MinLight = FMath::Min(MinLight, Voxel);
+		MaxLight = FMath::Max(MaxLight, Voxel);
+	}
+	TestTrue(TEXT("Light is attenuated"), MinLight < MaxLight);
+	TestTrue(TEXT("Light stays within its intensity"), MinLight >= 0.0f && MaxLight <= Light.LightIntensity + 1e-5f);
+
+	AddDirLightToSingleLightVolume_CPU(Input, LightVolume, Light, false, World);
+	float MaxRemainder = 0.0f;
+	for (const float Voxel : LightVolume.Voxels)
+	{
+		MaxRemainder = FMath::Max(MaxRemainder, FMath::Abs(Voxel));
+	}
+	TestTrue(FString::Printf(TEXT("Removing the light leaves nothing (max %g)"), MaxRemainder), MaxRemainder < 1e-6f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightVolumeCPUOpacityVolumeTest, "TBRaymarcher.Raymarcher.LightVolumeCPU.OpacityVolume",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLightVolumeCPUOpacityVolumeTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(24);
+	TArray<float> Voxels;
+	Voxels.SetNumUninitialized(LightTestSize * LightTestSize * LightTestSize);
+	for (float& Voxel : Voxels)
+	{
+		Voxel = Random.GetFraction();
+	}
+	FLightPropagationInputCPU Input;
+	Input.SetVolumeData(reinterpret_cast<const uint8*>(Voxels.GetData()), FIntVector(LightTestSize), PF_R32_FLOAT);
+	Input.TransferFunctionAlpha.SetNumUninitialized(256);
+	for (int32 Index = 0; Index < 256; Index++)
+	{
+		Input.TransferFunctionAlpha[Index] = Index / 255.0f * 0.05f;
+	}
+	// Narrow window with both cutoffs, so that some voxels are cut off on either side.
+	Input.WindowingParameters.Center = 0.5f;
+	Input.WindowingParameters.Width = 0.5f;
+	Input.WindowingParameters.LowCutoff = true;
+	Input.WindowingParameters.HighCutoff = true;
+
+	FLightVolumeCPU OpacityVolume;
+	TestTrue(TEXT("Opacity volume built"), BuildOpacityVolume_CPU(Input, OpacityVolume));
+	TestTrue(TEXT("Opacity volume has the light volume size"), OpacityVolume.Dimensions == Input.LightVolumeDimensions);
+
+	// Voxel centers sample the voxels exactly, correcting the stored opacity for a step size has to give the same as evaluating
+	// the transfer function for that step size.
+	constexpr float StepSize = 100.0f / LightTestSize;
+	int32 Mismatches = 0;
+	int32 CutOff = 0;
+	for (int32 Index = 0; Index < Voxels.Num(); Index++)
+	{
+		const float Opacity = OpacityVolume.Voxels[Index];
+		Mismatches += !FMath::IsNearlyEqual(Opacity, Input.SampleWindowedAlpha(Voxels[Index], 1.0f), 1e-6f);
+		const float StepOpacity = 1.0f - FMath::Pow(1.0f - Opacity, StepSize);
+		Mismatches += !FMath::IsNearlyEqual(StepOpacity, Input.SampleWindowedAlpha(Voxels[Index], StepSize), 1e-5f);
+		CutOff += Opacity == 0.0f;
+	}
+	TestEqual(TEXT("Opacity mismatches"), Mismatches, 0);
+	TestTrue(TEXT("Voxels outside of the window are cut off"), CutOff > 0 && CutOff < Voxels.Num());
+
+	FLightPropagationInputCPU HalfInput = Input;
+	HalfInput.LightVolumeDimensions = FIntVector(LightTestSize / 2);
+	BuildOpacityVolume_CPU(HalfInput, OpacityVolume);
+	TestTrue(TEXT("Half resolution opacity volume size"), OpacityVolume.Dimensions == FIntVector(LightTestSize / 2));
+
+	AddExpectedError(TEXT("not set up"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Input without a volume is rejected"), BuildOpacityVolume_CPU(FLightPropagationInputCPU(), OpacityVolume));
+	return true;
+}
+
+#endif
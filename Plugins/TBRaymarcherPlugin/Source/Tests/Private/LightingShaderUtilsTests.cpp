@@ -0,0 +1,133 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Misc/AutomationTest.h"
+#include "Rendering/LightingShaderUtils.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+constexpr int32 ClipTestSize = 32;
+
+/// Major axes of a light going only along the provided face.
+FMajorAxes MakeSingleFaceAxes(FCubeFace Face)
+{
+	FMajorAxes Axes;
+	Axes.FaceWeight.push_back(std::make_pair(Face, 1.0f));
+	Axes.FaceWeight.push_back(std::make_pair(Face == FCubeFace::XPositive ? FCubeFace::YPositive : FCubeFace::XPositive, 0.0f));
+	return Axes;
+}
+
+/// Clipping weight of a voxel, as the propagation shaders compute it.
+float GetVoxelClipWeight(const FClippingPlaneParameters& Clipping, const FIntVector& Voxel, const FIntVector& Dimensions)
+{
+	const FVector Resolution(Dimensions);
+	const FVector UVW = (FVector(Voxel) + 0.5) / Resolution;
+	const double Distance = FVector::DotProduct(UVW - Clipping.Center, Clipping.Direction);
+	return FMath::Clamp(0.5 + 0.57735026919 * Distance * (Clipping.Direction * Resolution).Size(), 0.0, 1.0);
+}
+
+/// Brute force version of GetFirstClipAffectedSlice, compares the weights of every voxel of every slice.
+int GetFirstClipAffectedSliceBruteForce(FCubeFace Face, const FIntVector& Dimensions, const FClippingPlaneParameters& OldClipping,
+	const FClippingPlaneParameters& NewClipping)
+{
+	// Odd faces propagate with increasing index along their axis.
+	const int Axis = (uint8) Face / 2;
+	const bool bIncreasing = (uint8) Face % 2 == 1;
+	const int SliceAxisX = Axis == 0 ? 1 : 0;
+	const int SliceAxisY = Axis == 2 ? 1 : 2;
+
+	for (int SliceIndex = 0; SliceIndex < Dimensions[Axis]; SliceIndex++)
+	{
+		FIntVector Voxel = FIntVector::ZeroValue;
+		Voxel[Axis] = bIncreasing ? SliceIndex : Dimensions[Axis] - 1 - SliceIndex;
+		for (Voxel[SliceAxisY] = 0; Voxel[SliceAxisY] < Dimensions[SliceAxisY]; Voxel[SliceAxisY]++)
+		{
+			for (Voxel[SliceAxisX] = 0; Voxel[SliceAxisX] < Dimensions[SliceAxisX]; Voxel[SliceAxisX]++)
+			{
+				if (GetVoxelClipWeight(OldClipping, Voxel, Dimensions) != GetVoxelClipWeight(NewClipping, Voxel, Dimensions))
+				{
+					return SliceIndex;
+				}
+			}
+		}
+	}
+	return Dimensions[Axis];
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstClipAffectedSliceAxisAlignedTest,
+	"TBRaymarcher.Raymarcher.LightingShaderUtils.FirstClipAffectedSliceAxisAligned",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FFirstClipAffectedSliceAxisAlignedTest::RunTest(const FString& Parameters)
+{
+	const FIntVector Dimensions(ClipTestSize);
+	// Plane perpendicular to Z moving from the middle of the volume to a quarter of it. Only the voxels of Z slices 7, 8, 15 and
+	// 16 are partially clipped by either of the planes.
+	const FClippingPlaneParameters OldClipping(FVector(0.5, 0.5, 0.5), FVector(0, 0, 1));
+	const FClippingPlaneParameters NewClipping(FVector(0.5, 0.5, 0.25), FVector(0, 0, 1));
+
+	TestEqual(TEXT("Unchanged plane affects no slice"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::ZNegative), 0, Dimensions, OldClipping, OldClipping),
+		ClipTestSize);
+
+	// Going up Z, slices 0 - 6 are clipped away by both planes.
+	TestEqual(TEXT("Going up Z starts at the new plane"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::ZNegative), 0, Dimensions, OldClipping, NewClipping), 7);
+	// Going down Z, slices 31 - 17 are visible with both planes.
+	TestEqual(TEXT("Going down Z starts at the old plane"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::ZPositive), 0, Dimensions, OldClipping, NewClipping), 15);
+	// Moving the plane back affects the same slices.
+	TestEqual(TEXT("Affected slices don't depend on the direction of the move"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::ZNegative), 0, Dimensions, NewClipping, OldClipping), 7);
+
+	// The plane crosses every slice going along X or Y.
+	TestEqual(TEXT("Going along X starts at the first slice"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::XPositive), 0, Dimensions, OldClipping, NewClipping), 0);
+	TestEqual(TEXT("Going along Y starts at the first slice"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::YNegative), 0, Dimensions, OldClipping, NewClipping), 0);
+
+	// Moving a plane that doesn't cut through the volume changes nothing inside of it.
+	const FClippingPlaneParameters FarClipping(FVector(0.5, 0.5, -2.0), FVector(0, 0, 1));
+	const FClippingPlaneParameters FartherClipping(FVector(0.5, 0.5, -3.0), FVector(0, 0, 1));
+	TestEqual(TEXT("Plane outside of the volume affects no slice"),
+		GetFirstClipAffectedSlice(MakeSingleFaceAxes(FCubeFace::XPositive), 0, Dimensions, FarClipping, FartherClipping),
+		ClipTestSize);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFirstClipAffectedSliceObliqueTest,
+	"TBRaymarcher.Raymarcher.LightingShaderUtils.FirstClipAffectedSliceOblique",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FFirstClipAffectedSliceObliqueTest::RunTest(const FString& Parameters)
+{
+	const FIntVector Dimensions(ClipTestSize, ClipTestSize / 2, ClipTestSize + 8);
+	const FCubeFace Faces[6] = {FCubeFace::XPositive, FCubeFace::XNegative, FCubeFace::YPositive, FCubeFace::YNegative,
+		FCubeFace::ZPositive, FCubeFace::ZNegative};
+
+	// A plane rotating and moving around the volume, like when dragging it around.
+	FClippingPlaneParameters OldClipping(FVector(0.3, 0.5, 0.6), FVector(1, 0.2, 0.4).GetSafeNormal());
+	for (int32 Step = 1; Step <= 8; Step++)
+	{
+		const FVector Direction = FVector(1, 0.2 + 0.1 * Step, 0.4 - 0.15 * Step).GetSafeNormal();
+		const FClippingPlaneParameters NewClipping(FVector(0.3 + 0.05 * Step, 0.5, 0.6 - 0.03 * Step), Direction);
+
+		for (const FCubeFace Face : Faces)
+		{
+			const FMajorAxes Axes = MakeSingleFaceAxes(Face);
+			const int FirstAffected = GetFirstClipAffectedSlice(Axes, 0, Dimensions, OldClipping, NewClipping);
+			const int FirstChanged = GetFirstClipAffectedSliceBruteForce(Face, Dimensions, OldClipping, NewClipping);
+			// Starting earlier only costs time, starting later would leave a stale light volume.
+			TestTrue(FString::Printf(TEXT("Step %d face %d starts no later than the first changed slice (%d <= %d)"), Step,
+						 (int32) Face, FirstAffected, FirstChanged),
+				FirstAffected <= FirstChanged);
+		}
+		OldClipping = NewClipping;
+	}
+	return true;
+}
+
+#endif
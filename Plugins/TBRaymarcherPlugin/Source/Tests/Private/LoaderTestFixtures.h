@@ -0,0 +1,65 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+// Fixtures shared by the volume loader tests - files written into the automation transient folder and a small volume where
+// every voxel holds its index.
+
+#pragma once
+
+#include "Algo/Reverse.h"
+#include "CoreMinimal.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace LoaderTestFixtures
+{
+/// Dimensions of the index volume (see MakeIndexVolume).
+inline const FIntVector IndexVolumeDimensions(7, 5, 3);
+
+/// Every voxel of the index volume holds its index minus this, to get negatives too.
+constexpr int32 IndexVolumeOffset = 50;
+
+/// Writes Header followed by Data into a file in the automation transient folder and returns its path.
+inline FString WriteTestFile(const FString& Name, const FString& Header, const TArray<uint8>& Data = {})
+{
+	TArray<uint8> FileBytes;
+	const FTCHARToUTF8 HeaderUTF8(*Header);
+	FileBytes.Append(reinterpret_cast<const uint8*>(HeaderUTF8.Get()), HeaderUTF8.Length());
+	FileBytes.Append(Data);
+
+	const FString FilePath = FPaths::ConvertRelativePathToFull(FPaths::AutomationTransientDir() / Name);
+	FFileHelper::SaveArrayToFile(FileBytes, *FilePath);
+	return FilePath;
+}
+
+/// Returns the bytes of the index volume with voxels of type T, optionally big-endian.
+template <typename T>
+TArray<uint8> MakeIndexVolume(const bool bBigEndian = false)
+{
+	const int32 VoxelCount = IndexVolumeDimensions.X * IndexVolumeDimensions.Y * IndexVolumeDimensions.Z;
+	TArray<uint8> Bytes;
+	Bytes.Reserve(VoxelCount * sizeof(T));
+	for (int32 Index = 0; Index < VoxelCount; Index++)
+	{
+		const T Value = static_cast<T>(Index - IndexVolumeOffset);
+		const int32 Start = Bytes.Num();
+		Bytes.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+		if (bBigEndian)
+		{
+			Algo::Reverse(Bytes.GetData() + Start, sizeof(T));
+		}
+	}
+	return Bytes;
+}
+
+/// Returns how many voxels of an index volume loaded as float don't hold their index minus IndexVolumeOffset.
+inline int32 CountIndexVolumeMismatches(const float* Voxels, const int64 VoxelCount)
+{
+	int32 Mismatches = 0;
+	for (int64 Index = 0; Index < VoxelCount; Index++)
+	{
+		Mismatches += Voxels[Index] != float(Index - IndexVolumeOffset);
+	}
+	return Mismatches;
+}
+}	 // namespace LoaderTestFixtures
@@ -0,0 +1,351 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "HAL/FileManager.h"
+#include "LoaderTestFixtures.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "TextureUtilities.h"
+#include "VolumeAsset/Loaders/MHDLoader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+using namespace LoaderTestFixtures;
+
+// Where the corpus headers pretend to be, nothing gets read from there.
+const TCHAR* CorpusHeaderPath = TEXT("/Corpus/Volume.mhd");
+
+/// A header and the dimensions it has to be parsed with. Malformed headers have zero dimensions and have to be rejected.
+struct FMHDCorpusEntry
+{
+	const TCHAR* Name;
+	const TCHAR* Header;
+	FIntVector Dimensions;
+};
+
+const FMHDCorpusEntry MHDHeaderCorpus[] = {
+	{TEXT("ITK"),
+		TEXT("ObjectType = Image\nNDims = 3\nBinaryData = True\nBinaryDataByteOrderMSB = False\nCompressedData = False\n")
+		TEXT("TransformMatrix = 0 1 0 -1 0 0 0 0 1\nOffset = -120.5 -98 42\nCenterOfRotation = 0 0 0\n")
+		TEXT("AnatomicalOrientation = RAI\n")
+		TEXT("ElementSpacing = 0.5 0.75 2.5\nDimSize = 512 400 120\nElementType = MET_SHORT\nElementDataFile = CT.raw\n"),
+		FIntVector(512, 400, 120)},
+	{TEXT("Reverse key order"),
+		TEXT("ElementType = MET_UCHAR\nElementSpacing = 1 1 1\nDimSize = 7 5 3\nNDims = 3\nElementDataFile = Reverse.raw"),
+		FIntVector(7, 5, 3)},
+	{TEXT("CRLF and whitespace"),
+		TEXT("\r\n  NDims=3\r\n\tDimSize =\t7  5 3 \r\nElementType= MET_FLOAT\r\nComment = a = b\r\n")
+		TEXT("ElementDataFile =  Spaced Name.raw \r\n"),
+		FIntVector(7, 5, 3)},
+	{TEXT("2D"),
+		TEXT("NDims = 2\nDimSize = 64 32\nElementSpacing = 0.5 0.25\nElementType = MET_UINT\nElementDataFile = Slice.raw\n"),
+		FIntVector(64, 32, 1)},
+	{TEXT("NDims inferred"), TEXT("DimSize = 4 4 4\nElementType = MET_CHAR\nElementDataFile = Inferred.raw\n"),
+		FIntVector(4, 4, 4)},
+	{TEXT("ElementSize only"),
+		TEXT("NDims = 3\nDimSize = 2 2 2\nElementSize = 3 3 3\nElementType = MET_INT\nElementDataFile = Size.raw\n"),
+		FIntVector(2, 2, 2)},
+	{TEXT("Compressed size only"),
+		TEXT("NDims = 3\nDimSize = 8 8 8\nElementType = MET_USHORT\nCompressedDataSize = 1234\n")
+		TEXT("ElementDataFile = Compressed.zraw\n"),
+		FIntVector(8, 8, 8)},
+	{TEXT("Local"),
+		TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_USHORT\nElementByteOrderMSB = True\nHeaderSize = 16\n")
+		TEXT("ElementDataFile = LOCAL\n\x01\x02") TEXT("binary"),
+		FIntVector(7, 5, 3)},
+	{TEXT("List"),
+		TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nElementDataFile = LIST 2D\n")
+		TEXT("Slice0.raw\nSlice1.raw Slice2.raw\n\n"),
+		FIntVector(4, 4, 3)},
+	{TEXT("Pattern"),
+		TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nHeaderSize = -1\nElementDataFile = Slice%03d.raw 10 6 -2\n"),
+		FIntVector(4, 4, 3)},
+
+	{TEXT("Empty"), TEXT(""), FIntVector::ZeroValue},
+	{TEXT("No data file"), TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_UCHAR\n"), FIntVector::ZeroValue},
+	{TEXT("Empty data file"), TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_UCHAR\nElementDataFile =\n"),
+		FIntVector::ZeroValue},
+	{TEXT("No element type"), TEXT("NDims = 3\nDimSize = 7 5 3\nElementDataFile = Data.raw\n"), FIntVector::ZeroValue},
+	{TEXT("Double"), TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_DOUBLE\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Channels"),
+		TEXT("NDims = 3\nDimSize = 7 5 3\nElementNumberOfChannels = 3\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("4D"), TEXT("NDims = 4\nDimSize = 7 5 3 2\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Too few sizes"), TEXT("NDims = 3\nDimSize = 7 5\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Zero size"), TEXT("NDims = 3\nDimSize = 7 0 3\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Garbage size"), TEXT("NDims = 3\nDimSize = 7 5x 3\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Huge size"),
+		TEXT("NDims = 3\nDimSize = 2000000000 2000000000 2000000000\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("ASCII"), TEXT("NDims = 3\nDimSize = 7 5 3\nBinaryData = False\nElementType = MET_UCHAR\nElementDataFile = Data.txt\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Not an image"),
+		TEXT("ObjectType = Tube\nNDims = 3\nDimSize = 7 5 3\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Negative header size"),
+		TEXT("NDims = 3\nDimSize = 7 5 3\nHeaderSize = -2\nElementType = MET_UCHAR\nElementDataFile = Data.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Short list"),
+		TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nElementDataFile = LIST\nSlice0.raw\nSlice1.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("3D list"), TEXT("NDims = 3\nDimSize = 4 4 1\nElementType = MET_UCHAR\nElementDataFile = LIST 3D\nVolume.raw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Compressed list"),
+		TEXT("NDims = 3\nDimSize = 4 4 1\nCompressedData = True\nElementType = MET_UCHAR\nElementDataFile = LIST\nSlice0.zraw\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Pattern range"), TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nElementDataFile = Slice%d.raw 1 2 1\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Pattern step"), TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nElementDataFile = Slice%d.raw 1 3 0\n"),
+		FIntVector::ZeroValue},
+	{TEXT("Pattern conversion"), TEXT("NDims = 3\nDimSize = 4 4 3\nElementType = MET_UCHAR\nElementDataFile = Slice%s.raw 1 3 1\n"),
+		FIntVector::ZeroValue},
+};
+
+/// Parses and loads the file as float and checks that it holds the index volume. Files that can be memory mapped have
+/// to convert into the same texture mip as well (see IVolumeLoader::LoadMappedVolumeMip).
+void TestMHDLoad(FAutomationTestBase& Test, const FString& Name, const FString& FilePath)
+{
+	FMHDHeader Header;
+	if (!Test.TestTrue(Name + TEXT(" header parsed"), UMHDLoader::ParseHeader(FilePath, Header)))
+	{
+		return;
+	}
+	Test.TestTrue(Name + TEXT(" dimensions"), Header.VolumeInfo.Dimensions == IndexVolumeDimensions);
+
+	FVolumeInfo Info;
+	TUniquePtr<uint8[]> Loaded = UMHDLoader::Get()->LoadAndConvertMHDData(Header, Info, false, true);
+	if (!Test.TestNotNull(Name + TEXT(" data loaded"), Loaded.Get()))
+	{
+		return;
+	}
+	const float* Voxels = reinterpret_cast<const float*>(Loaded.Get());
+	Test.TestEqual(Name + TEXT(" mismatching voxels"), CountIndexVolumeMismatches(Voxels, Info.GetTotalVoxels()), 0);
+
+	FVolumeInfo MappedInfo;
+	FString MappedName;
+	FTexture2DMipMap* Mip = UMHDLoader::Get()->LoadMappedVolumeMip(FilePath, false, true, MappedInfo, MappedName);
+	if (Header.IsSliceList())
+	{
+		Test.TestNull(Name + TEXT(" slices aren't mapped"), Mip);
+		delete Mip;
+		return;
+	}
+	if (!Test.TestNotNull(Name + TEXT(" mapped into a mip"), Mip))
+	{
+		return;
+	}
+	Test.TestTrue(Name + TEXT(" mapped dimensions"), MappedInfo.Dimensions == IndexVolumeDimensions);
+	Test.TestTrue(Name + TEXT(" mapped format"), MappedInfo.ActualFormat == EVolumeVoxelFormat::Float);
+	const float* MipVoxels = static_cast<const float*>(Mip->BulkData.Lock(LOCK_READ_ONLY));
+	int32 MipMismatches = 0;
+	for (int64 Index = 0; Index < Info.GetTotalVoxels(); Index++)
+	{
+		MipMismatches += MipVoxels[Index] != Voxels[Index];
+	}
+	Mip->BulkData.Unlock();
+	delete Mip;
+	Test.TestEqual(Name + TEXT(" mismatching mip voxels"), MipMismatches, 0);
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMHDHeaderCorpusTest, "TBRaymarcher.VolumeTextureToolkit.MHDLoader.HeaderCorpus",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMHDHeaderCorpusTest::RunTest(const FString& Parameters)
+{
+	AddExpectedError(TEXT("MetaIO header"), EAutomationExpectedErrorFlags::Contains, 0);
+	for (const FMHDCorpusEntry& Entry : MHDHeaderCorpus)
+	{
+		const bool bValid = Entry.Dimensions != FIntVector::ZeroValue;
+		FMHDHeader Header;
+		const bool bParsed = UMHDLoader::ParseHeaderText(Entry.Header, CorpusHeaderPath, Header);
+		TestEqual(FString(Entry.Name) + TEXT(" parsed"), bParsed, bValid);
+		TestEqual(FString(Entry.Name) + TEXT(" parse success flag"), Header.VolumeInfo.bParseWasSuccessful, bParsed);
+		if (bParsed && bValid)
+		{
+			TestTrue(FString(Entry.Name) + TEXT(" dimensions"), Header.VolumeInfo.Dimensions == Entry.Dimensions);
+		}
+	}
+
+	FMHDHeader Header;
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[0].Header, CorpusHeaderPath, Header))
+	{
+		const FVolumeInfo& Info = Header.VolumeInfo;
+		TestEqual(TEXT("ITK spacing"), Info.Spacing, FVector(0.5, 0.75, 2.5));
+		TestEqual(TEXT("ITK world size"), Info.WorldDimensions, FVector(256, 300, 300));
+		TestEqual(TEXT("ITK origin"), Info.Origin, FVector(-120.5, -98, 42));
+		TestEqual(TEXT("ITK X direction"), Info.Direction.GetScaledAxis(EAxis::X), FVector(0, 1, 0));
+		TestEqual(TEXT("ITK Y direction"), Info.Direction.GetScaledAxis(EAxis::Y), FVector(-1, 0, 0));
+		TestTrue(TEXT("ITK signed short"), Info.OriginalFormat == EVolumeVoxelFormat::SignedShort);
+		TestFalse(TEXT("ITK little-endian"), Info.bIsBigEndian);
+		TestEqual(TEXT("ITK data file"), FPaths::GetCleanFilename(Header.DataFilePath), FString(TEXT("CT.raw")));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[2].Header, CorpusHeaderPath, Header))
+	{
+		TestEqual(TEXT("Data file name with spaces"), Header.VolumeInfo.DataFileName, FString(TEXT("Spaced Name.raw")));
+		TestEqual(TEXT("Default spacing"), Header.VolumeInfo.Spacing, FVector(1, 1, 1));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[3].Header, CorpusHeaderPath, Header))
+	{
+		TestEqual(TEXT("2D spacing"), Header.VolumeInfo.Spacing, FVector(0.5, 0.25, 1));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[5].Header, CorpusHeaderPath, Header))
+	{
+		TestEqual(TEXT("ElementSize spacing"), Header.VolumeInfo.Spacing, FVector(3, 3, 3));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[6].Header, CorpusHeaderPath, Header))
+	{
+		TestTrue(TEXT("Compressed"), Header.VolumeInfo.bIsCompressed);
+		TestEqual(TEXT("Compressed size"), Header.VolumeInfo.CompressedByteSize, int64(1234));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[7].Header, CorpusHeaderPath, Header))
+	{
+		// The header is 118 bytes up to and including the ElementDataFile line, followed by HeaderSize skipped bytes.
+		TestEqual(TEXT("Local data offset"), Header.VolumeInfo.DataFileOffset, int64(118 + 16));
+		TestEqual(TEXT("Local data file"), Header.DataFilePath, FString(CorpusHeaderPath));
+		TestTrue(TEXT("Local big-endian"), Header.VolumeInfo.bIsBigEndian);
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[8].Header, CorpusHeaderPath, Header) &&
+		TestEqual(TEXT("List slices"), Header.SliceFilePaths.Num(), 3))
+	{
+		TestEqual(TEXT("Last listed slice"), FPaths::GetCleanFilename(Header.SliceFilePaths[2]), FString(TEXT("Slice2.raw")));
+	}
+	if (UMHDLoader::ParseHeaderText(MHDHeaderCorpus[9].Header, CorpusHeaderPath, Header) &&
+		TestEqual(TEXT("Pattern slices"), Header.SliceFilePaths.Num(), 3))
+	{
+		TestEqual(TEXT("First pattern slice"), FPaths::GetCleanFilename(Header.SliceFilePaths[0]), FString(TEXT("Slice010.raw")));
+		TestEqual(TEXT("Last pattern slice"), FPaths::GetCleanFilename(Header.SliceFilePaths[2]), FString(TEXT("Slice006.raw")));
+		TestEqual(TEXT("Pattern header size"), Header.HeaderSize, int64(-1));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMHDHeaderFuzzTest, "TBRaymarcher.VolumeTextureToolkit.MHDLoader.HeaderFuzz",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMHDHeaderFuzzTest::RunTest(const FString& Parameters)
+{
+	AddExpectedError(TEXT("MetaIO header"), EAutomationExpectedErrorFlags::Contains, 0);
+
+	// Fixed seed, so that a failure can be reproduced.
+	FRandomStream Random(0x4D484421);
+	const TCHAR Replacements[] = TEXT("= \n\r\t-0123456789.%LISTOCAx");
+	int32 Parsed = 0;
+	int32 InvalidParsed = 0;
+	for (const FMHDCorpusEntry& Entry : MHDHeaderCorpus)
+	{
+		const FString Original = Entry.Header;
+
+		// Every truncation of the header.
+		for (int32 Length = 0; Length < Original.Len(); Length++)
+		{
+			FMHDHeader Header;
+			Parsed += UMHDLoader::ParseHeaderText(Original.Left(Length), CorpusHeaderPath, Header);
+		}
+
+		// Random replacements, insertions and deletions. Whatever gets parsed has to describe a loadable volume.
+		for (int32 Iteration = 0; Iteration < 200; Iteration++)
+		{
+			FString Mutated = Original;
+			const int32 MutationCount = Random.RandRange(1, 4);
+			for (int32 Mutation = 0; Mutation < MutationCount; Mutation++)
+			{
+				const int32 Position = Random.RandRange(0, FMath::Max(Mutated.Len() - 1, 0));
+				const TCHAR Character = Random.RandBool() ? Replacements[Random.RandRange(0, UE_ARRAY_COUNT(Replacements) - 2)]
+														  : TCHAR(Random.RandRange(1, 255));
+				switch (Random.RandRange(0, 2))
+				{
+					case 0:
+						if (Position < Mutated.Len())
+						{
+							Mutated[Position] = Character;
+						}
+						break;
+					case 1:
+						Mutated.InsertAt(Position, Character);
+						break;
+					default:
+						Mutated.RemoveAt(Position, FMath::Min(Random.RandRange(1, 8), Mutated.Len() - Position));
+				}
+			}
+
+			FMHDHeader Header;
+			if (!UMHDLoader::ParseHeaderText(Mutated, CorpusHeaderPath, Header))
+			{
+				continue;
+			}
+			Parsed++;
+			const FVolumeInfo& Info = Header.VolumeInfo;
+			const bool bSlicesMatch = !Header.IsSliceList() || Header.SliceFilePaths.Num() == Info.Dimensions.Z;
+			const bool bHasData = Header.IsSliceList() || !Header.DataFilePath.IsEmpty();
+			InvalidParsed += Info.Dimensions.GetMin() <= 0 || Info.BytesPerVoxel <= 0 || Info.Spacing.GetMin() <= 0 ||
+							 Info.DataFileOffset < 0 || !bSlicesMatch || !bHasData;
+		}
+	}
+	AddInfo(FString::Printf(TEXT("%d fuzzed headers parsed."), Parsed));
+	TestEqual(TEXT("Parsed headers describing invalid volumes"), InvalidParsed, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMHDLoaderTest, "TBRaymarcher.VolumeTextureToolkit.MHDLoader.Load",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMHDLoaderTest::RunTest(const FString& Parameters)
+{
+	TArray<FString> WrittenFiles;
+
+	// Attached data, skipping a few bytes after the header.
+	TArray<uint8> LocalData;
+	LocalData.Init(0xCD, 5);
+	LocalData.Append(MakeIndexVolume<int16>());
+	WrittenFiles.Add(WriteTestFile(TEXT("Local.mha"),
+		TEXT("ObjectType = Image\r\nNDims = 3\r\nDimSize = 7 5 3\r\nElementType = MET_SHORT\r\nHeaderSize = 5\r\n")
+		TEXT("ElementDataFile = LOCAL\r\n"),
+		LocalData));
+	TestMHDLoad(*this, TEXT("Local"), WrittenFiles.Last());
+
+	// Big-endian detached data at the end of the data file.
+	TArray<uint8> DetachedData;
+	DetachedData.Init(0xAB, 123);
+	DetachedData.Append(MakeIndexVolume<int16>(true));
+	WrittenFiles.Add(WriteTestFile(TEXT("Detached.raw"), TEXT(""), DetachedData));
+	WrittenFiles.Add(WriteTestFile(TEXT("Detached.mhd"),
+		TEXT("HeaderSize = -1\nBinaryDataByteOrderMSB = True\nElementType = MET_SHORT\nDimSize = 7 5 3\nNDims = 3\n")
+		TEXT("ElementDataFile = Detached.raw\n"),
+		{}));
+	TestMHDLoad(*this, TEXT("Detached"), WrittenFiles.Last());
+
+	// One file per slice, listed and as a pattern.
+	const TArray<uint8> Volume = MakeIndexVolume<int16>();
+	const int32 SliceByteSize = Volume.Num() / IndexVolumeDimensions.Z;
+	FString SliceList;
+	for (int32 Slice = 0; Slice < IndexVolumeDimensions.Z; Slice++)
+	{
+		const FString SliceName = FString::Printf(TEXT("Slice%02d.raw"), Slice + 1);
+		const TArray<uint8> SliceData(Volume.GetData() + Slice * SliceByteSize, SliceByteSize);
+		WrittenFiles.Add(WriteTestFile(SliceName, TEXT(""), SliceData));
+		SliceList += SliceName + TEXT("\n");
+	}
+	WrittenFiles.Add(WriteTestFile(
+		TEXT("List.mhd"), TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_SHORT\nElementDataFile = LIST\n") + SliceList, {}));
+	TestMHDLoad(*this, TEXT("List"), WrittenFiles.Last());
+	WrittenFiles.Add(WriteTestFile(TEXT("Pattern.mhd"),
+		TEXT("NDims = 3\nDimSize = 7 5 3\nElementType = MET_SHORT\nElementDataFile = Slice%02d.raw 1 3 1\n"), {}));
+	TestMHDLoad(*this, TEXT("Pattern"), WrittenFiles.Last());
+
+	for (const FString& FilePath : WrittenFiles)
+	{
+		IFileManager::Get().Delete(*FilePath);
+	}
+	return true;
+}
+
+#endif
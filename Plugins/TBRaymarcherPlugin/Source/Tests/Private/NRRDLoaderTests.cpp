@@ -0,0 +1,107 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "HAL/FileManager.h"
+#include "LoaderTestFixtures.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/NRRDLoader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+using namespace LoaderTestFixtures;
+
+/// Loads the file as float and checks that it holds the index volume.
+void TestNRRDLoad(FAutomationTestBase& Test, const FString& Name, const FString& FilePath, const FVector& ExpectedSpacing)
+{
+	FNRRDHeader Header;
+	if (!Test.TestTrue(Name + TEXT(" header parsed"), UNRRDLoader::ParseHeader(FilePath, Header)))
+	{
+		return;
+	}
+	Test.TestTrue(Name + TEXT(" dimensions"), Header.VolumeInfo.Dimensions == IndexVolumeDimensions);
+	Test.TestEqual(Name + TEXT(" spacing"), Header.VolumeInfo.Spacing, ExpectedSpacing);
+
+	FVolumeInfo Info;
+	TUniquePtr<uint8[]> Loaded = UNRRDLoader::Get()->LoadAndConvertNRRDData(Header, Info, false, true);
+	if (!Test.TestNotNull(Name + TEXT(" data loaded"), Loaded.Get()))
+	{
+		return;
+	}
+	const float* Voxels = reinterpret_cast<const float*>(Loaded.Get());
+	Test.TestEqual(Name + TEXT(" mismatching voxels"), CountIndexVolumeMismatches(Voxels, Info.GetTotalVoxels()), 0);
+	Test.TestEqual(Name + TEXT(" minimum"), Info.MinValue, float(-IndexVolumeOffset));
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNRRDLoaderTest, "TBRaymarcher.VolumeTextureToolkit.NRRDLoader",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FNRRDLoaderTest::RunTest(const FString& Parameters)
+{
+	// Attached header, 64bit voxels narrowed to float, line skip and RAS space directions and origin.
+	const FString AttachedPath = WriteTestFile(TEXT("Attached.nrrd"),
+		TEXT("NRRD0004\n# Comment\ntype: double\ndimension: 3\nsizes: 7 5 3\nencoding: raw\nendian: little\n")
+		TEXT("space: right-anterior-superior\nspace directions: (0.5,0,0) (0,0.5,0) (0,0,2)\nspace origin: (10, 20, 30)\n")
+		TEXT("line skip: 1\nunit key:=ignored\n\nskipped line\n"),
+		MakeIndexVolume<double>());
+	TestNRRDLoad(*this, TEXT("Attached double"), AttachedPath, FVector(0.5, 0.5, 2));
+	FNRRDHeader AttachedHeader;
+	if (UNRRDLoader::ParseHeader(AttachedPath, AttachedHeader))
+	{
+		// Orientation gets converted to LPS.
+		TestEqual(TEXT("Attached origin"), AttachedHeader.VolumeInfo.Origin, FVector(-10, -20, 30));
+		TestEqual(TEXT("Attached X direction"), AttachedHeader.VolumeInfo.Direction.GetScaledAxis(EAxis::X), FVector(-1, 0, 0));
+		TestEqual(TEXT("Attached Z direction"), AttachedHeader.VolumeInfo.Direction.GetScaledAxis(EAxis::Z), FVector(0, 0, 1));
+		TestEqual(TEXT("Attached world size"), AttachedHeader.VolumeInfo.WorldDimensions, FVector(3.5, 2.5, 6));
+	}
+
+	// Detached header with the data at the end of the data file.
+	TArray<uint8> Data;
+	Data.Init(0xAB, 123);
+	Data.Append(MakeIndexVolume<int16>());
+	WriteTestFile(TEXT("Detached.raw"), TEXT(""), Data);
+	const FString DetachedPath = WriteTestFile(TEXT("Detached.nhdr"),
+		TEXT("NRRD0005\r\ntype: short\r\ndimension: 3\r\nsizes: 7 5 3\r\nspacings: 1.5 1.5 3\r\nencoding: raw\r\n")
+		TEXT("endian: little\r\nbyte skip: -1\r\ndata file: Detached.raw\r\n"),
+		{});
+	TestNRRDLoad(*this, TEXT("Detached short"), DetachedPath, FVector(1.5, 1.5, 3));
+
+	// Pyramid levels written by the converter, listed out of order.
+	TArray<int16> LevelVoxels;
+	LevelVoxels.Init(-7, 2 * 2 * 1);
+	const FString LevelPath = WriteTestFile(TEXT("Pyramid_l2.raw"), TEXT(""),
+		TArray<uint8>(reinterpret_cast<const uint8*>(LevelVoxels.GetData()), LevelVoxels.Num() * sizeof(int16)));
+	const FString PyramidPath = WriteTestFile(TEXT("Pyramid.nhdr"),
+		TEXT("NRRD0004\ntype: short\ndimension: 3\nsizes: 7 5 3\nspacings: 1 1 2\nencoding: raw\nendian: little\n")
+		TEXT("pyramid reduction:=mean\npyramid level 2:=Pyramid_l2.raw 2 2 1\npyramid level 1:=Pyramid_l1.raw 4 3 2\n")
+		TEXT("data file: Detached.raw\n"),
+		{});
+	FNRRDHeader PyramidHeader;
+	if (TestTrue(TEXT("Pyramid header parsed"), UNRRDLoader::ParseHeader(PyramidPath, PyramidHeader)) &&
+		TestEqual(TEXT("Pyramid levels"), PyramidHeader.PyramidLevels.Num(), 2))
+	{
+		TestEqual(TEXT("Finest level factor"), PyramidHeader.PyramidLevels[0].Factor, 2);
+		const FNRRDHeader LevelHeader = PyramidHeader.GetPyramidLevelHeader(1);
+		TestTrue(TEXT("Coarsest level dimensions"), LevelHeader.VolumeInfo.Dimensions == FIntVector(2, 2, 1));
+		TestEqual(TEXT("Coarsest level spacing"), LevelHeader.VolumeInfo.Spacing, FVector(4, 4, 8));
+
+		FVolumeInfo LevelInfo;
+		TUniquePtr<uint8[]> LevelData = UNRRDLoader::Get()->LoadAndConvertNRRDData(LevelHeader, LevelInfo, false, true);
+		if (TestNotNull(TEXT("Coarsest level loaded"), LevelData.Get()))
+		{
+			TestEqual(TEXT("Coarsest level voxel"), reinterpret_cast<const float*>(LevelData.Get())[3], -7.0f);
+		}
+	}
+
+	IFileManager::Get().Delete(*AttachedPath);
+	IFileManager::Get().Delete(*DetachedPath);
+	IFileManager::Get().Delete(*(FPaths::GetPath(DetachedPath) / TEXT("Detached.raw")));
+	IFileManager::Get().Delete(*LevelPath);
+	IFileManager::Get().Delete(*PyramidPath);
+	return true;
+}
+
+#endif
@@ -0,0 +1,281 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Misc/AutomationTest.h"
+#include "TextureUtilities.h"
+#include "VolumeAsset/VolumeBrickLayout.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+// Not a multiple of the brick size along any axis, so that the short bricks on the far borders get tested too.
+const FIntVector BrickTestDimensions(10, 7, 5);
+constexpr int32 BrickTestSize = 4;
+
+/// Returns a G16 volume of BrickTestDimensions where every voxel holds its index + 1, except for the first brick, which is all 0.
+TArray<uint16> MakeBrickTestVolume()
+{
+	TArray<uint16> Volume;
+	Volume.SetNumUninitialized(BrickTestDimensions.X * BrickTestDimensions.Y * BrickTestDimensions.Z);
+	for (int32 Z = 0; Z < BrickTestDimensions.Z; Z++)
+	{
+		for (int32 Y = 0; Y < BrickTestDimensions.Y; Y++)
+		{
+			for (int32 X = 0; X < BrickTestDimensions.X; X++)
+			{
+				const int32 Index = (Z * BrickTestDimensions.Y + Y) * BrickTestDimensions.X + X;
+				const bool bInFirstBrick = X < BrickTestSize && Y < BrickTestSize && Z < BrickTestSize;
+				Volume[Index] = bInFirstBrick ? 0 : static_cast<uint16>(Index + 1);
+			}
+		}
+	}
+	return Volume;
+}
+
+uint16 GetClampedVoxel(const TArray<uint16>& Volume, const FIntVector& Voxel)
+{
+	const FIntVector Clamped(FMath::Clamp(Voxel.X, 0, BrickTestDimensions.X - 1),
+		FMath::Clamp(Voxel.Y, 0, BrickTestDimensions.Y - 1), FMath::Clamp(Voxel.Z, 0, BrickTestDimensions.Z - 1));
+	return Volume[(Clamped.Z * BrickTestDimensions.Y + Clamped.Y) * BrickTestDimensions.X + Clamped.X];
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeBrickLayoutIndexTest, "TBRaymarcher.VolumeTextureToolkit.BrickLayout.Indexing",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeBrickLayoutIndexTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("2049 needs bricking"), FVolumeBrickLayout::NeedsBricking(FIntVector(2049, 1, 1)));
+	TestFalse(TEXT("2048 doesn't need bricking"), FVolumeBrickLayout::NeedsBricking(FIntVector(2048, 2048, 2048)));
+
+	const FVolumeBrickLayout Layout(BrickTestDimensions, BrickTestSize);
+	TestTrue(TEXT("Brick counts"), Layout.BrickCounts == FIntVector(3, 2, 2));
+	TestEqual(TEXT("Padded brick size"), Layout.GetPaddedBrickSize(), BrickTestSize + 2 * FVolumeBrickLayout::Apron);
+
+	int32 Mismatches = 0;
+	for (int32 BrickIndex = 0; BrickIndex < Layout.GetBrickCount(); BrickIndex++)
+	{
+		const FIntVector Coordinates = Layout.GetBrickCoordinatesFromIndex(BrickIndex);
+		Mismatches += Layout.GetBrickIndex(Coordinates) != BrickIndex;
+		Mismatches += Layout.GetBrickCoordinates(Layout.GetBrickOrigin(BrickIndex)) != Coordinates;
+	}
+	TestEqual(TEXT("Brick index round trip mismatches"), Mismatches, 0);
+
+	TestTrue(TEXT("Last voxel brick"), Layout.GetBrickCoordinates(BrickTestDimensions - FIntVector(1)) == FIntVector(2, 1, 1));
+	TestTrue(TEXT("Voxel past the border is clamped"), Layout.GetBrickCoordinates(BrickTestDimensions) == FIntVector(2, 1, 1));
+	TestTrue(TEXT("Short brick extent"), Layout.GetBrickExtent(Layout.GetBrickCount() - 1) == FIntVector(2, 3, 1));
+	TestTrue(TEXT("Full brick extent"), Layout.GetBrickExtent(0) == FIntVector(BrickTestSize));
+
+	// Bricks this large only fit 2 per axis into the atlas, and the header takes a slot.
+	FVolumeBrickLayout LargeLayout(FIntVector(1022 * 3, 1022 * 3, 1), 1022);
+	TestEqual(TEXT("Header slots"), LargeLayout.GetHeaderSlotCount(), 1);
+	AddExpectedError(TEXT("don't fit into"), EAutomationExpectedErrorFlags::Contains, 2);
+	TestFalse(TEXT("9 large bricks don't fit"), LargeLayout.AssignSlots([](int32) { return true; }));
+	TestEqual(TEXT("Nothing assigned after a failure"), LargeLayout.GetResidentBrickCount(), 0);
+	TestFalse(TEXT("8 large bricks don't fit next to the header"),
+		LargeLayout.AssignSlots([](int32 BrickIndex) { return BrickIndex != 4; }));
+	TestTrue(TEXT("7 large bricks fit next to the header"),
+		LargeLayout.AssignSlots([](int32 BrickIndex) { return BrickIndex < 7; }));
+	TestEqual(TEXT("Resident large bricks"), LargeLayout.GetResidentBrickCount(), 7);
+	TestTrue(TEXT("Full atlas"), LargeLayout.GetAtlasDimensions() == FIntVector(FVolumeBrickLayout::MaxTextureSize));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeBrickLayoutAtlasSizeTest, "TBRaymarcher.VolumeTextureToolkit.BrickLayout.AtlasSize",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeBrickLayoutAtlasSizeTest::RunTest(const FString& Parameters)
+{
+	// A CT series too deep for a single volume texture, all bricks resident. The atlas can only be larger than the volume by the
+	// aprons, the bricks cut short by the volume border and the header, not by (more than a few) unused slots.
+	const FIntVector Dimensions(512, 512, 2400);
+	FVolumeBrickLayout Layout(Dimensions);
+	if (!TestTrue(TEXT("Slots assigned"), Layout.AssignSlots([](int32) { return true; })))
+	{
+		return false;
+	}
+	const FIntVector AtlasDimensions = Layout.GetAtlasDimensions();
+	const int32 UsedSlots = Layout.GetBrickCount() + Layout.GetHeaderSlotCount();
+	const double SlotOverhead = double(Layout.SlotCounts.X * Layout.SlotCounts.Y * Layout.SlotCounts.Z) / UsedSlots;
+	TestTrue(FString::Printf(TEXT("At most 1%% unused slots (%.4f)"), SlotOverhead), SlotOverhead <= 1.01);
+	TestTrue(TEXT("Atlas fits into a volume texture"), AtlasDimensions.GetMax() <= FVolumeBrickLayout::MaxTextureSize);
+
+	const int64 VolumeBytes = int64(Dimensions.X) * Dimensions.Y * Dimensions.Z * sizeof(uint16);
+	const int64 AtlasBytes = int64(AtlasDimensions.X) * AtlasDimensions.Y * AtlasDimensions.Z * sizeof(uint16);
+	AddInfo(FString::Printf(TEXT("%s G16 volume: %lld MB, atlas %s: %lld MB"), *Dimensions.ToString(), VolumeBytes >> 20,
+		*AtlasDimensions.ToString(), AtlasBytes >> 20));
+	const int64 PaddedBrickVoxels = int64(Layout.GetPaddedBrickSize()) * Layout.GetPaddedBrickSize() * Layout.GetPaddedBrickSize();
+	const double ApronOverhead = double(PaddedBrickVoxels) / (int64(Layout.BrickSize) * Layout.BrickSize * Layout.BrickSize);
+	const FVector BorderOverhead = FVector(Layout.BrickCounts * Layout.BrickSize) / FVector(Dimensions);
+	const double HeaderOverhead = double(UsedSlots) / Layout.GetBrickCount();
+	const double MaxAtlasBytes =
+		VolumeBytes * ApronOverhead * BorderOverhead.X * BorderOverhead.Y * BorderOverhead.Z * HeaderOverhead * 1.01;
+	TestTrue(FString::Printf(TEXT("Atlas is at most %.0f MB"), MaxAtlasBytes / (1 << 20)), AtlasBytes <= MaxAtlasBytes + 1.0);
+
+	// Any number of resident bricks leaves only a few slots unused.
+	FVolumeBrickLayout FullLayout(FIntVector(FVolumeBrickLayout::DefaultBrickSize * 32));
+	int32 WorstCount = 0;
+	double WorstRatio = 1.0;
+	for (int32 Count = 1; Count <= FullLayout.GetBrickCount(); Count += 97)
+	{
+		FullLayout.AssignSlots([Count](int32 BrickIndex) { return BrickIndex < Count; });
+		const double Ratio = double(FullLayout.SlotCounts.X * FullLayout.SlotCounts.Y * FullLayout.SlotCounts.Z) /
+							 (Count + FullLayout.GetHeaderSlotCount());
+		if (Ratio > WorstRatio)
+		{
+			WorstRatio = Ratio;
+			WorstCount = Count;
+		}
+	}
+	TestTrue(FString::Printf(TEXT("At most 5%% unused slots (worst %.3f with %d bricks)"), WorstRatio, WorstCount),
+		WorstRatio <= 1.05);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeBrickLayoutAtlasTest, "TBRaymarcher.VolumeTextureToolkit.BrickLayout.Atlas",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeBrickLayoutAtlasTest::RunTest(const FString& Parameters)
+{
+	const TArray<uint16> Volume = MakeBrickTestVolume();
+	const uint8* VolumeData = reinterpret_cast<const uint8*>(Volume.GetData());
+
+	FVolumeBrickLayout Layout(BrickTestDimensions, BrickTestSize);
+	Layout.ComputeBrickRanges(VolumeData, PF_G16);
+	TestEqual(TEXT("Empty brick maximum"), Layout.BrickMaxValues[0], 0.0f);
+	TestEqual(TEXT("Last brick maximum"), Layout.BrickMaxValues.Last(), float(Volume.Last()) / MAX_uint16);
+	if (!TestTrue(TEXT("Slots assigned"), Layout.AssignNonEmptySlots()))
+	{
+		return false;
+	}
+	TestEqual(TEXT("Empty brick isn't resident"), Layout.BrickToSlot[0], int32(INDEX_NONE));
+	TestEqual(TEXT("Resident bricks"), Layout.GetResidentBrickCount(), Layout.GetBrickCount() - 1);
+
+	const FIntVector AtlasDimensions = Layout.GetAtlasDimensions();
+	TArray<uint16> Atlas;
+	Atlas.SetNumZeroed(AtlasDimensions.X * AtlasDimensions.Y * AtlasDimensions.Z);
+	Layout.CopyBricksToAtlas(VolumeData, reinterpret_cast<uint8*>(Atlas.GetData()), sizeof(uint16));
+	auto GetAtlasVoxel = [&](const FIntVector& Voxel)
+	{ return Atlas[(Voxel.Z * AtlasDimensions.Y + Voxel.Y) * AtlasDimensions.X + Voxel.X]; };
+
+	// Every voxel of a resident brick can be found in the atlas.
+	int32 Mismatches = 0;
+	for (int32 Z = 0; Z < BrickTestDimensions.Z; Z++)
+	{
+		for (int32 Y = 0; Y < BrickTestDimensions.Y; Y++)
+		{
+			for (int32 X = 0; X < BrickTestDimensions.X; X++)
+			{
+				const FIntVector Voxel(X, Y, Z);
+				FIntVector AtlasVoxel;
+				const bool bResident = Layout.VolumeToAtlas(Voxel, AtlasVoxel);
+				const bool bInFirstBrick = Layout.GetBrickIndex(Layout.GetBrickCoordinates(Voxel)) == 0;
+				Mismatches += bResident == bInFirstBrick;
+				Mismatches += bResident && GetAtlasVoxel(AtlasVoxel) != GetClampedVoxel(Volume, Voxel);
+			}
+		}
+	}
+	TestEqual(TEXT("Atlas voxel mismatches"), Mismatches, 0);
+
+	// Aprons hold the neighbouring voxels, clamped to the volume border.
+	int32 ApronMismatches = 0;
+	for (int32 Slot = Layout.GetHeaderSlotCount(); Slot < Layout.SlotToBrick.Num(); Slot++)
+	{
+		const int32 BrickIndex = Layout.SlotToBrick[Slot];
+		const FIntVector Origin = Layout.GetBrickOrigin(BrickIndex) - FIntVector(FVolumeBrickLayout::Apron);
+		const FIntVector Extent = Layout.GetBrickExtent(BrickIndex) + FIntVector(2 * FVolumeBrickLayout::Apron);
+		const FIntVector SlotOrigin = Layout.GetSlotOrigin(Slot);
+		for (int32 Z = 0; Z < Extent.Z; Z++)
+		{
+			for (int32 Y = 0; Y < Extent.Y; Y++)
+			{
+				for (int32 X = 0; X < Extent.X; X++)
+				{
+					const FIntVector Offset(X, Y, Z);
+					ApronMismatches += GetAtlasVoxel(SlotOrigin + Offset) != GetClampedVoxel(Volume, Origin + Offset);
+				}
+			}
+		}
+	}
+	TestEqual(TEXT("Apron mismatches"), ApronMismatches, 0);
+
+	// The header decodes back into the layout, the same way BrickedSampling.usf does it.
+	if (!TestTrue(TEXT("Header written"), Layout.WriteAtlasHeader(reinterpret_cast<uint8*>(Atlas.GetData()), PF_G16)))
+	{
+		return false;
+	}
+	const FIntVector FirstBrickVoxel = Layout.GetSlotOrigin(Layout.GetHeaderSlotCount()) + FIntVector(FVolumeBrickLayout::Apron);
+	TestTrue(TEXT("Header leaves the bricks alone"), GetAtlasVoxel(FirstBrickVoxel) != 0);
+	auto GetHeaderVoxel = [&](int64 Index) { return GetAtlasVoxel(Layout.GetHeaderVoxel(Index)); };
+	auto GetHeaderNumber = [&](int64 Index) { return GetHeaderVoxel(Index) + GetHeaderVoxel(Index + 1) * (MAX_uint16 + 1); };
+	TestEqual(TEXT("Header unit"), int32(GetHeaderVoxel(FVolumeBrickLayout::HeaderUnit)), 1);
+	TestEqual(TEXT("Header padded brick size"), GetHeaderNumber(FVolumeBrickLayout::HeaderPaddedBrickSize),
+		Layout.GetPaddedBrickSize());
+	TestEqual(TEXT("Header brick size"), GetHeaderNumber(FVolumeBrickLayout::HeaderBrickSize), BrickTestSize);
+	const FIntVector HeaderDimensions(GetHeaderNumber(FVolumeBrickLayout::HeaderVolumeDimensions),
+		GetHeaderNumber(FVolumeBrickLayout::HeaderVolumeDimensions + 2),
+		GetHeaderNumber(FVolumeBrickLayout::HeaderVolumeDimensions + 4));
+	TestTrue(TEXT("Header volume dimensions"), HeaderDimensions == BrickTestDimensions);
+
+	const int64 LastEntry = FVolumeBrickLayout::HeaderBricks +
+							int64(FVolumeBrickLayout::HeaderVoxelsPerBrick) * (Layout.GetBrickCount() - 1);
+	TestEqual(TEXT("Empty brick isn't resident in the header"), GetHeaderNumber(FVolumeBrickLayout::HeaderBricks), 0);
+	TestEqual(TEXT("Empty brick value"), int32(GetHeaderVoxel(FVolumeBrickLayout::HeaderBricks + 2)), 0);
+	TestEqual(TEXT("Last brick slot"), GetHeaderNumber(LastEntry), Layout.BrickToSlot.Last());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDownsampleDataTo2KTest, "TBRaymarcher.VolumeTextureToolkit.BrickLayout.DownsampleTo2K",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FDownsampleDataTo2KTest::RunTest(const FString& Parameters)
+{
+	const FIntVector Dimensions(4100, 3, 2);
+	TArray<uint8> Volume;
+	Volume.SetNumUninitialized(Dimensions.X * Dimensions.Y * Dimensions.Z);
+	for (int32 Index = 0; Index < Volume.Num(); Index++)
+	{
+		Volume[Index] = static_cast<uint8>(Index * 7);
+	}
+	const TArray<uint8> Original = Volume;
+
+	FIntVector NewDimensions = Dimensions;
+	UVolumeTextureToolkit::DownsampleDataTo2K(Volume.GetData(), NewDimensions, PF_G8);
+	if (!TestTrue(TEXT("Downsampled dimensions"), NewDimensions == FIntVector(1367, 3, 2)))
+	{
+		return false;
+	}
+
+	// Every third voxel along X is kept, so the last one is still close to the far border.
+	int32 Mismatches = 0;
+	for (int32 Z = 0; Z < NewDimensions.Z; Z++)
+	{
+		for (int32 Y = 0; Y < NewDimensions.Y; Y++)
+		{
+			for (int32 X = 0; X < NewDimensions.X; X++)
+			{
+				Mismatches += Volume[(Z * NewDimensions.Y + Y) * NewDimensions.X + X] !=
+							  Original[(Z * Dimensions.Y + Y) * Dimensions.X + X * 3];
+			}
+		}
+	}
+	TestEqual(TEXT("Downsampled voxel mismatches"), Mismatches, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOversizedVolumeTextureTest, "TBRaymarcher.VolumeTextureToolkit.BrickLayout.OversizedTexture",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOversizedVolumeTextureTest::RunTest(const FString& Parameters)
+{
+	// Volumes too large for a single texture have to be bricked or downsampled explicitly, never quietly.
+	AddExpectedError(TEXT("volume textures can't be larger than 2048"), EAutomationExpectedErrorFlags::Contains, 1);
+	UVolumeTexture* Texture = nullptr;
+	TestFalse(TEXT("Oversized transient texture rejected"),
+		UVolumeTextureToolkit::CreateVolumeTextureTransient(Texture, PF_G8, FIntVector(4100, 3, 2)));
+	TestNull(TEXT("No oversized texture"), Texture);
+	return true;
+}
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "HAL/FileManager.h"
+#include "LoaderTestFixtures.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "VolumeAsset/Loaders/VolumeManifest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+using namespace LoaderTestFixtures;
+
+/// Manifest as written by dicom_to_nrrd.py --batch, with one converted and one failed series.
+const TCHAR* ManifestTestText = TEXT(R"({
+  "version": 1,
+  "source": "/data/dicom",
+  "series": [
+    {
+      "uid": "1.2.3",
+      "nhdr": "series_000.nhdr",
+      "raw": "series_000.raw",
+      "dimensions": [512, 512, 1000],
+      "spacing": [0.5, 0.5, 0.625],
+      "origin": [-128.0, -100.5, 30.0],
+      "direction": [[1.0, 0.0, 0.0], [0.0, 1.0, 0.0], [0.0, 0.0, 1.0]],
+      "min": -1024,
+      "max": 3071,
+      "histogram": {
+        "mean": -350.25,
+        "percentiles": {"0.5": -1000, "50": -40, "99.5": 1200},
+        "range": [-1024, 3071],
+        "counts": [100, 0, 5000000000]
+      },
+      "pyramid": [],
+      "seconds": 12.5
+    },
+    {
+      "uid": "4.5.6",
+      "nhdr": "series_001.nhdr",
+      "raw": "series_001.raw",
+      "error": "Slices 64+ are 256x256, expected 512x512",
+      "seconds": 0.4
+    }
+  ]
+})");
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeManifestTest, "TBRaymarcher.VolumeTextureToolkit.VolumeManifest",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeManifestTest::RunTest(const FString& Parameters)
+{
+	const FString ManifestPath = WriteTestFile(TEXT("manifest.json"), ManifestTestText);
+	FVolumeManifest Manifest;
+	if (TestTrue(TEXT("Manifest read"), FVolumeManifest::Read(ManifestPath, Manifest)) &&
+		TestEqual(TEXT("Series count"), Manifest.Series.Num(), 2))
+	{
+		TestEqual(TEXT("Source folder"), Manifest.SourceFolder, FString(TEXT("/data/dicom")));
+
+		const FVolumeManifestSeries& Converted = Manifest.Series[0];
+		TestTrue(TEXT("Converted series valid"), Converted.IsValid());
+		TestEqual(TEXT("UID"), Converted.SeriesInstanceUID, FString(TEXT("1.2.3")));
+		TestEqual(TEXT("Header path next to the manifest"), Converted.HeaderFilePath,
+			FPaths::GetPath(ManifestPath) / TEXT("series_000.nhdr"));
+		TestEqual(TEXT("Data path next to the manifest"), Converted.DataFilePath,
+			FPaths::GetPath(ManifestPath) / TEXT("series_000.raw"));
+		TestTrue(TEXT("Dimensions"), Converted.Dimensions == FIntVector(512, 512, 1000));
+		TestEqual(TEXT("Spacing"), Converted.Spacing, FVector(0.5, 0.5, 0.625));
+		TestEqual(TEXT("Origin"), Converted.Origin, FVector(-128.0, -100.5, 30.0));
+		TestEqual(TEXT("Minimum"), Converted.MinValue, -1024.0f);
+		TestEqual(TEXT("Maximum"), Converted.MaxValue, 3071.0f);
+		TestEqual(TEXT("Mean"), Converted.MeanValue, -350.25f);
+		TestEqual(TEXT("Low percentile"), Converted.LowPercentileValue, -1000.0f);
+		TestEqual(TEXT("Median"), Converted.MedianValue, -40.0f);
+		TestEqual(TEXT("High percentile"), Converted.HighPercentileValue, 1200.0f);
+		TestEqual(TEXT("Histogram minimum"), Converted.HistogramMin, -1024.0f);
+		TestEqual(TEXT("Histogram maximum"), Converted.HistogramMax, 3071.0f);
+		// Counts of large series don't fit into 32 bits.
+		TestTrue(TEXT("Histogram counts"), Converted.HistogramCounts == TArray<int64>({100, 0, 5000000000}));
+
+		const FVolumeManifestSeries* Failed = Manifest.FindSeries(TEXT("4.5.6"));
+		if (TestNotNull(TEXT("Failed series found"), Failed))
+		{
+			TestFalse(TEXT("Failed series invalid"), Failed->IsValid());
+			TestEqual(TEXT("Failed series error"), Failed->Error, FString(TEXT("Slices 64+ are 256x256, expected 512x512")));
+		}
+		TestNull(TEXT("Unknown series"), Manifest.FindSeries(TEXT("7.8.9")));
+	}
+
+	// Unknown versions, broken JSON and series missing their statistics are rejected.
+	AddExpectedError(TEXT("unsupported version"), EAutomationExpectedErrorFlags::Contains, 1);
+	AddExpectedError(TEXT("isn't valid JSON"), EAutomationExpectedErrorFlags::Contains, 1);
+	AddExpectedError(TEXT("is malformed"), EAutomationExpectedErrorFlags::Contains, 1);
+	FString NewerVersion = ManifestTestText;
+	NewerVersion.ReplaceInline(TEXT("\"version\": 1"), TEXT("\"version\": 2"));
+	FString MissingStatistics = ManifestTestText;
+	MissingStatistics.ReplaceInline(TEXT("\"mean\": -350.25,"), TEXT(""));
+	const FString NewerVersionPath = WriteTestFile(TEXT("manifest_v2.json"), NewerVersion);
+	const FString BrokenPath = WriteTestFile(TEXT("manifest_broken.json"), FString(ManifestTestText).LeftChop(10));
+	const FString MissingStatisticsPath = WriteTestFile(TEXT("manifest_no_mean.json"), MissingStatistics);
+	TestFalse(TEXT("Newer version rejected"), FVolumeManifest::Read(NewerVersionPath, Manifest));
+	TestFalse(TEXT("Broken JSON rejected"), FVolumeManifest::Read(BrokenPath, Manifest));
+	TestFalse(TEXT("Missing statistics rejected"), FVolumeManifest::Read(MissingStatisticsPath, Manifest));
+
+	IFileManager::Get().Delete(*ManifestPath);
+	IFileManager::Get().Delete(*NewerVersionPath);
+	IFileManager::Get().Delete(*BrokenPath);
+	IFileManager::Get().Delete(*MissingStatisticsPath);
+	return true;
+}
+
+#endif
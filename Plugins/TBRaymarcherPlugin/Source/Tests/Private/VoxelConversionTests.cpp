@@ -0,0 +1,325 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "Misc/AutomationTest.h"
+#include "TextureUtilities.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+#include "VolumeAsset/VolumeConversionStage.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+// Not a multiple of any SIMD width or chunk size, so that all the leftover paths get tested too.
+constexpr int64 BitExactVoxelCount = 3 * (1 << 20) + 37;
+
+constexpr int64 BenchmarkDimension = 512;
+
+template <typename T>
+TArray<T> MakeRandomVolume(const int64 VoxelCount, const T Min, const T Max)
+{
+	FRandomStream Stream(1920);
+	TArray<T> Volume;
+	Volume.SetNumUninitialized(VoxelCount);
+	for (T& Voxel : Volume)
+	{
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			Voxel = Stream.FRandRange(Min, Max);
+		}
+		else
+		{
+			Voxel = static_cast<T>(double(Min) + (double(Max) - double(Min)) * Stream.GetFraction());
+		}
+	}
+	return Volume;
+}
+
+/// Compares the *ByFormat kernels with the scalar reference templates.
+template <typename InType, typename OutType>
+void TestBitExact(FAutomationTestBase& Test, const EVolumeVoxelFormat Format, const InType Min, const InType Max)
+{
+	const TArray<InType> Volume = MakeRandomVolume<InType>(BitExactVoxelCount, Min, Max);
+	const uint8* Data = reinterpret_cast<const uint8*>(Volume.GetData());
+	const int64 ByteSize = Volume.Num() * sizeof(InType);
+
+	float ReferenceMin, ReferenceMax;
+	TArray<OutType> Reference;
+	Reference.SetNumUninitialized(Volume.Num());
+	UVolumeTextureToolkit::ConvertArrayToNormalizedArray<InType, OutType>(
+		Data, reinterpret_cast<uint8*>(Reference.GetData()), ByteSize, ReferenceMin, ReferenceMax);
+
+	float KernelMin, KernelMax;
+	TArray<OutType> Result;
+	Result.SetNumUninitialized(Volume.Num());
+	UVolumeTextureToolkit::NormalizeArrayByFormat(
+		Format, Data, ByteSize, reinterpret_cast<uint8*>(Result.GetData()), KernelMin, KernelMax);
+
+	const FString FormatName = StaticEnum<EVolumeVoxelFormat>()->GetNameStringByValue(static_cast<int64>(Format));
+	Test.TestEqual(FString::Printf(TEXT("%s minimum"), *FormatName), KernelMin, ReferenceMin);
+	Test.TestEqual(FString::Printf(TEXT("%s maximum"), *FormatName), KernelMax, ReferenceMax);
+	Test.TestTrue(FString::Printf(TEXT("%s normalized values"), *FormatName),
+		FMemory::Memcmp(Result.GetData(), Reference.GetData(), Result.Num() * sizeof(OutType)) == 0);
+}
+
+/// Times the scalar reference and the *ByFormat kernels normalizing a 512^3 volume.
+template <typename InType, typename OutType>
+void Benchmark(FAutomationTestBase& Test, const EVolumeVoxelFormat Format, const InType Min, const InType Max)
+{
+	const TArray<InType> Volume = MakeRandomVolume<InType>(BenchmarkDimension * BenchmarkDimension * BenchmarkDimension, Min, Max);
+	const uint8* Data = reinterpret_cast<const uint8*>(Volume.GetData());
+	const int64 ByteSize = Volume.Num() * sizeof(InType);
+
+	TArray<OutType> Result;
+	Result.SetNumUninitialized(Volume.Num());
+	float OutMin, OutMax;
+
+	double StartTime = FPlatformTime::Seconds();
+	UVolumeTextureToolkit::ConvertArrayToNormalizedArray<InType, OutType>(
+		Data, reinterpret_cast<uint8*>(Result.GetData()), ByteSize, OutMin, OutMax);
+	const double ScalarSeconds = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	UVolumeTextureToolkit::NormalizeArrayByFormat(
+		Format, Data, ByteSize, reinterpret_cast<uint8*>(Result.GetData()), OutMin, OutMax);
+	const double KernelSeconds = FPlatformTime::Seconds() - StartTime;
+
+	const FString FormatName = StaticEnum<EVolumeVoxelFormat>()->GetNameStringByValue(static_cast<int64>(Format));
+	const double GigaBytes = ByteSize / (1024.0 * 1024.0 * 1024.0);
+	Test.AddInfo(FString::Printf(TEXT("%s 512^3: scalar %.1f ms (%.2f GB/s), kernel %.1f ms (%.2f GB/s), speedup %.1fx"),
+		*FormatName, ScalarSeconds * 1000.0, GigaBytes / ScalarSeconds, KernelSeconds * 1000.0, GigaBytes / KernelSeconds,
+		ScalarSeconds / KernelSeconds));
+}
+
+/// Compares ConvertArrayToFloat with the scalar ConvertArrayToFloatTemplated.
+template <typename InType>
+void TestFloatConversionExact(FAutomationTestBase& Test, const EVolumeVoxelFormat Format, const InType Min, const InType Max)
+{
+	const TArray<InType> Volume = MakeRandomVolume<InType>(BitExactVoxelCount, Min, Max);
+	const uint8* Data = reinterpret_cast<const uint8*>(Volume.GetData());
+
+	TArray<float> Reference, Result;
+	Reference.SetNumUninitialized(Volume.Num());
+	Result.SetNumUninitialized(Volume.Num());
+	UVolumeTextureToolkit::ConvertArrayToFloatTemplated<InType>(Data, Reference.GetData(), Volume.Num());
+	UVolumeTextureToolkit::ConvertArrayToFloat(Format, Data, Volume.Num(), Result.GetData());
+
+	const FString FormatName = StaticEnum<EVolumeVoxelFormat>()->GetNameStringByValue(static_cast<int64>(Format));
+	Test.TestTrue(FString::Printf(TEXT("%s float values"), *FormatName),
+		FMemory::Memcmp(Result.GetData(), Reference.GetData(), Result.Num() * sizeof(float)) == 0);
+}
+
+/// Measures the float conversion throughput (bytes read + written per second) of a 512^3 volume. Reported next to a memcpy of
+/// the float output, which is the most the conversion could reach if it was fully memory bound.
+template <typename InType>
+void BenchmarkFloatConversion(FAutomationTestBase& Test, const EVolumeVoxelFormat Format, const double MemcpyGigaBytesPerSecond)
+{
+	const int64 VoxelCount = BenchmarkDimension * BenchmarkDimension * BenchmarkDimension;
+	const TArray<InType> Volume = MakeRandomVolume<InType>(VoxelCount, 0, 100);
+	const uint8* Data = reinterpret_cast<const uint8*>(Volume.GetData());
+	TArray<float> Result;
+	Result.SetNumUninitialized(VoxelCount);
+
+	// Touch the output once, so that page faults don't get measured.
+	UVolumeTextureToolkit::ConvertArrayToFloat(Format, Data, VoxelCount, Result.GetData());
+
+	const double StartTime = FPlatformTime::Seconds();
+	UVolumeTextureToolkit::ConvertArrayToFloat(Format, Data, VoxelCount, Result.GetData());
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	const double GigaBytes = VoxelCount * (sizeof(InType) + sizeof(float)) / (1024.0 * 1024.0 * 1024.0);
+	const FString FormatName = StaticEnum<EVolumeVoxelFormat>()->GetNameStringByValue(static_cast<int64>(Format));
+	Test.AddInfo(FString::Printf(TEXT("%s -> float 512^3: %.1f ms, %.2f GB/s (%.0f%% of memcpy)"), *FormatName, Seconds * 1000.0,
+		GigaBytes / Seconds, 100.0 * GigaBytes / Seconds / MemcpyGigaBytesPerSecond));
+}
+
+/// Runs the conversion stage on a volume with values spread evenly over [0, 1000) plus a single bright outlier, which defines the
+/// maximum, but must not move the percentiles.
+void TestConversionStageStatistics(FAutomationTestBase& Test, const bool bNormalize, const bool bConvertToFloat)
+{
+	constexpr uint16 Outlier = 60000;
+	FVolumeInfo Info;
+	Info.Dimensions = FIntVector(100, 100, 100);
+	Info.OriginalFormat = EVolumeVoxelFormat::UnsignedShort;
+	Info.BytesPerVoxel = sizeof(uint16);
+
+	TArray<uint16> Volume;
+	Volume.SetNumUninitialized(Info.GetTotalVoxels());
+	for (int32 Index = 0; Index < Volume.Num(); Index++)
+	{
+		Volume[Index] = Index % 1000;
+	}
+	Volume.Last() = Outlier;
+
+	TArray<uint8> Converted;
+	Converted.SetNumUninitialized(Info.GetTotalVoxels() * sizeof(float));
+	FVolumeConversionStage::Run(
+		reinterpret_cast<const uint8*>(Volume.GetData()), Converted.GetData(), Info, bNormalize, bConvertToFloat);
+
+	int64 HistogramTotal = 0;
+	for (const int64 Count : Info.Histogram)
+	{
+		HistogramTotal += Count;
+	}
+	const float BinWidth = float(Outlier) / FVolumeConversionStage::HistogramBinCount;
+	const FString Mode = bNormalize ? TEXT("Normalized") : (bConvertToFloat ? TEXT("Float") : TEXT("Original"));
+	Test.TestEqual(FString::Printf(TEXT("%s minimum"), *Mode), Info.MinValue, 0.0f);
+	Test.TestEqual(FString::Printf(TEXT("%s maximum"), *Mode), Info.MaxValue, float(Outlier));
+	Test.TestEqual(FString::Printf(TEXT("%s histogram bins"), *Mode), Info.Histogram.Num(), FVolumeConversionStage::HistogramBinCount);
+	Test.TestEqual(FString::Printf(TEXT("%s histogram total"), *Mode), HistogramTotal, Info.GetTotalVoxels());
+	Test.TestEqual(FString::Printf(TEXT("%s outlier bin"), *Mode), Info.Histogram.Last(), int64(1));
+	Test.TestEqual(FString::Printf(TEXT("%s low percentile"), *Mode), Info.LowPercentileValue, 5.0f, 2 * BinWidth);
+	Test.TestEqual(FString::Printf(TEXT("%s high percentile"), *Mode), Info.HighPercentileValue, 995.0f, 2 * BinWidth);
+
+	// The default window spans the percentiles, in the units of the converted data.
+	const float WindowScale = bNormalize ? 1.0f / Outlier : 1.0f;
+	const FWindowingParameters& Window = Info.DefaultWindowingParameters;
+	const float WindowTolerance = 2 * BinWidth * WindowScale;
+	Test.TestEqual(FString::Printf(TEXT("%s window center"), *Mode), Window.Center, 500.0f * WindowScale, WindowTolerance);
+	Test.TestEqual(FString::Printf(TEXT("%s window width"), *Mode), Window.Width, 990.0f * WindowScale, 2 * WindowTolerance);
+}
+
+/// Runs the conversion stage on a volume and on a byte swapped copy of it marked as big-endian, both must give the same result.
+/// The big-endian copy gets converted in place whenever the output isn't larger, so that the in-place paths get tested too.
+template <typename T>
+void TestBigEndianConversion(FAutomationTestBase& Test, const EVolumeVoxelFormat Format, const T Min, const T Max,
+	const bool bNormalize, const bool bConvertToFloat)
+{
+	FVolumeInfo NativeInfo;
+	NativeInfo.Dimensions = FIntVector(BitExactVoxelCount, 1, 1);
+	NativeInfo.OriginalFormat = Format;
+	NativeInfo.BytesPerVoxel = sizeof(T);
+	FVolumeInfo BigEndianInfo = NativeInfo;
+	BigEndianInfo.bIsBigEndian = true;
+
+	const TArray<T> Volume = MakeRandomVolume<T>(BitExactVoxelCount, Min, Max);
+	const int64 InByteSize = NativeInfo.GetByteSize();
+	const int64 OutByteSize = NativeInfo.GetTotalVoxels() *
+							  FVolumeInfo::VoxelFormatByteSize(IVolumeLoader::GetConvertedFormat(Format, bNormalize, bConvertToFloat));
+
+	TArray<uint8> Native;
+	Native.SetNumUninitialized(OutByteSize);
+	FVolumeConversionStage::Run(
+		reinterpret_cast<const uint8*>(Volume.GetData()), Native.GetData(), NativeInfo, bNormalize, bConvertToFloat);
+
+	TArray<uint8> BigEndian;
+	BigEndian.SetNumUninitialized(InByteSize);
+	const uint8* VolumeBytes = reinterpret_cast<const uint8*>(Volume.GetData());
+	for (int64 Index = 0; Index < InByteSize; Index++)
+	{
+		// Reverse the bytes within every voxel.
+		const int64 VoxelStart = Index - Index % sizeof(T);
+		BigEndian[Index] = VolumeBytes[VoxelStart + (sizeof(T) - 1) - (Index - VoxelStart)];
+	}
+	TArray<uint8> BigEndianConverted;
+	uint8* OutArray = BigEndian.GetData();
+	if (OutByteSize > InByteSize)
+	{
+		BigEndianConverted.SetNumUninitialized(OutByteSize);
+		OutArray = BigEndianConverted.GetData();
+	}
+	FVolumeConversionStage::Run(BigEndian.GetData(), OutArray, BigEndianInfo, bNormalize, bConvertToFloat);
+
+	const FString Name = FString::Printf(TEXT("%s %s"), *StaticEnum<EVolumeVoxelFormat>()->GetNameStringByValue(int64(Format)),
+		bNormalize ? TEXT("normalized") : (bConvertToFloat ? TEXT("float") : TEXT("original")));
+	Test.TestEqual(FString::Printf(TEXT("%s minimum"), *Name), BigEndianInfo.MinValue, NativeInfo.MinValue);
+	Test.TestEqual(FString::Printf(TEXT("%s maximum"), *Name), BigEndianInfo.MaxValue, NativeInfo.MaxValue);
+	Test.TestTrue(FString::Printf(TEXT("%s histogram"), *Name), BigEndianInfo.Histogram == NativeInfo.Histogram);
+	Test.TestTrue(FString::Printf(TEXT("%s converted values"), *Name),
+		FMemory::Memcmp(OutArray, Native.GetData(), OutByteSize) == 0);
+}
+}	 // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelNormalizeBitExactTest, "TBRaymarcher.VolumeTextureToolkit.Normalize.BitExact",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVoxelNormalizeBitExactTest::RunTest(const FString& Parameters)
+{
+	TestBitExact<uint8, uint8>(*this, EVolumeVoxelFormat::UnsignedChar, 3, 250);
+	TestBitExact<int8, uint8>(*this, EVolumeVoxelFormat::SignedChar, -100, 120);
+	TestBitExact<uint16, uint16>(*this, EVolumeVoxelFormat::UnsignedShort, 10, 60000);
+	TestBitExact<int16, uint16>(*this, EVolumeVoxelFormat::SignedShort, -1024, 3071);
+	TestBitExact<uint32, uint16>(*this, EVolumeVoxelFormat::UnsignedInt, 5, 4000000000u);
+	TestBitExact<int32, uint16>(*this, EVolumeVoxelFormat::SignedInt, -2000000000, 2000000000);
+	TestBitExact<float, uint16>(*this, EVolumeVoxelFormat::Float, -1000.0f, 3000.5f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelNormalizeBenchmark, "TBRaymarcher.VolumeTextureToolkit.Normalize.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FVoxelNormalizeBenchmark::RunTest(const FString& Parameters)
+{
+	Benchmark<int16, uint16>(*this, EVolumeVoxelFormat::SignedShort, -1024, 3071);
+	Benchmark<float, uint16>(*this, EVolumeVoxelFormat::Float, -1000.0f, 3000.5f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelFloatConversionExactTest, "TBRaymarcher.VolumeTextureToolkit.ConvertToFloat.Exact",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVoxelFloatConversionExactTest::RunTest(const FString& Parameters)
+{
+	TestFloatConversionExact<uint8>(*this, EVolumeVoxelFormat::UnsignedChar, 0, 255);
+	TestFloatConversionExact<int8>(*this, EVolumeVoxelFormat::SignedChar, -128, 127);
+	TestFloatConversionExact<uint16>(*this, EVolumeVoxelFormat::UnsignedShort, 0, 65535);
+	TestFloatConversionExact<int16>(*this, EVolumeVoxelFormat::SignedShort, -32768, 32767);
+	TestFloatConversionExact<uint32>(*this, EVolumeVoxelFormat::UnsignedInt, 0, 4294967295u);
+	TestFloatConversionExact<int32>(*this, EVolumeVoxelFormat::SignedInt, -2147483647, 2147483647);
+	TestFloatConversionExact<float>(*this, EVolumeVoxelFormat::Float, -1000.0f, 3000.5f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelFloatConversionBenchmark, "TBRaymarcher.VolumeTextureToolkit.ConvertToFloat.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FVoxelFloatConversionBenchmark::RunTest(const FString& Parameters)
+{
+	// Reference bandwidth - a single threaded memcpy of the float output.
+	const int64 ByteSize = BenchmarkDimension * BenchmarkDimension * BenchmarkDimension * sizeof(float);
+	TArray<uint8> Source, Destination;
+	Source.SetNumZeroed(ByteSize);
+	Destination.SetNumZeroed(ByteSize);
+	const double StartTime = FPlatformTime::Seconds();
+	FMemory::Memcpy(Destination.GetData(), Source.GetData(), ByteSize);
+	const double MemcpyGigaBytesPerSecond = 2.0 * ByteSize / (1024.0 * 1024.0 * 1024.0) / (FPlatformTime::Seconds() - StartTime);
+	AddInfo(FString::Printf(TEXT("memcpy: %.2f GB/s"), MemcpyGigaBytesPerSecond));
+
+	BenchmarkFloatConversion<uint8>(*this, EVolumeVoxelFormat::UnsignedChar, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<int8>(*this, EVolumeVoxelFormat::SignedChar, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<uint16>(*this, EVolumeVoxelFormat::UnsignedShort, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<int16>(*this, EVolumeVoxelFormat::SignedShort, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<uint32>(*this, EVolumeVoxelFormat::UnsignedInt, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<int32>(*this, EVolumeVoxelFormat::SignedInt, MemcpyGigaBytesPerSecond);
+	BenchmarkFloatConversion<float>(*this, EVolumeVoxelFormat::Float, MemcpyGigaBytesPerSecond);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeConversionStageStatisticsTest,
+	"TBRaymarcher.VolumeTextureToolkit.ConversionStage.Statistics", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeConversionStageStatisticsTest::RunTest(const FString& Parameters)
+{
+	TestConversionStageStatistics(*this, true, false);
+	TestConversionStageStatistics(*this, false, true);
+	TestConversionStageStatistics(*this, false, false);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVolumeConversionStageBigEndianTest,
+	"TBRaymarcher.VolumeTextureToolkit.ConversionStage.BigEndian", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVolumeConversionStageBigEndianTest::RunTest(const FString& Parameters)
+{
+	for (const bool bNormalize : {true, false})
+	{
+		for (const bool bConvertToFloat : {true, false})
+		{
+			TestBigEndianConversion<int16>(*this, EVolumeVoxelFormat::SignedShort, -1024, 3071, bNormalize, bConvertToFloat);
+			TestBigEndianConversion<float>(*this, EVolumeVoxelFormat::Float, -1000.0f, 3000.5f, bNormalize, bConvertToFloat);
+		}
+	}
+	return true;
+}
+
+#endif
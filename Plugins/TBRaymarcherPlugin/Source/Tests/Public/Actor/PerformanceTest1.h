@@ -36,6 +36,20 @@ class TESTS_API APerformanceTest1 : public AActor
 	// Return true if the bookmark was not yet added to the trace.
 	bool IsBookmarkNew(FString Name);
 
+	// Times recomputing all lights of each volume for 1 to all of its lights, with and without batched light propagation.
+	// The times are saved to <Engine>/Saved/Profiling/PerformanceTest1/RecomputeLights.csv
+	void MeasureRecomputeTimes();
+
+	// Sets whether moving the clipping plane updates the lights of each volume incrementally instead of recomputing them.
+	void SetIncrementalClippingUpdate(bool bIncremental);
+
+	// Adds the frame time to the phase's frame times.
+	void RecordFrameTime(const FString& Phase, float DeltaSeconds);
+
+	// Saves the average and maximum frame time of every phase with recorded frame times to
+	// <Engine>/Saved/Profiling/PerformanceTest1/FrameTimes.csv
+	void SaveFrameTimes();
+
 	// Define if the test was started by calling 'RunTest'
 	bool bRunning = false;
 
@@ -58,4 +72,7 @@ class TESTS_API APerformanceTest1 : public AActor
 
 	// List of all applied bookmarks in current test run.
 	TSet<FString> BookmarksApplied;
+
+	// Frame times (in milliseconds) of the phases comparing full light recomputes to incremental clipping updates.
+	TMap<FString, TArray<float>> PhaseFrameTimes;
 };
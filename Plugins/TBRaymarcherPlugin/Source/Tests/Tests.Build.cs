@@ -19,6 +19,8 @@ public class Tests : ModuleRules
             {
                 "CoreUObject",
                 "Engine",
+                "RenderCore",
+                "RHI",
                 "Slate",
                 "SlateCore",
                 "VolumeTextureToolkit",
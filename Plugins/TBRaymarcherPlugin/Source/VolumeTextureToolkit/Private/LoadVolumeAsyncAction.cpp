@@ -0,0 +1,41 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "LoadVolumeAsyncAction.h"
+
+#include "VolumeTextureToolkitBPLibrary.h"
+
+ULoadVolumeAsyncAction* ULoadVolumeAsyncAction::LoadVolumeFromFileAsync(
+	UObject* WorldContextObject, const FString& FileName, bool bNormalize)
+{
+	ULoadVolumeAsyncAction* Action = NewObject<ULoadVolumeAsyncAction>();
+	Action->FileName = FileName;
+	Action->bNormalize = bNormalize;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void ULoadVolumeAsyncAction::Activate()
+{
+	FOnVolumeLoadProgress OnLoadProgress = FOnVolumeLoadProgress::CreateWeakLambda(
+		this, [this](const FVolumeLoadProgress& Progress) { OnProgress.Broadcast(Progress.GetFraction()); });
+
+	FOnVolumeLoadFinished OnLoadFinished = FOnVolumeLoadFinished::CreateWeakLambda(this,
+		[this](UVolumeAsset* VolumeAsset)
+		{
+			if (VolumeAsset)
+			{
+				OnVolumeLoaded.Broadcast(VolumeAsset);
+			}
+			else
+			{
+				OnFailed.Broadcast(nullptr);
+			}
+			Handle.Reset();
+			SetReadyToDestroy();
+		});
+
+	// Not normalized volumes get converted to float, same as LoadVolumeFromFileDialog does.
+	Handle = UVolumeTextureToolkitBPLibrary::GetLoaderForFile(FileName)->CreateVolumeFromFileAsync(
+		FileName, bNormalize, !bNormalize, MoveTemp(OnLoadProgress), MoveTemp(OnLoadFinished));
+}
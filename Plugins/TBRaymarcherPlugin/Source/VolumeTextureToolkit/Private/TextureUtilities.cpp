@@ -9,9 +9,14 @@
 #include "Util/UtilityShaders.h"
 #include "VolumeAsset/DICOMParser/DICOMTypes.h"
 #include "VolumeAsset/VolumeAsset.h"
+#include "VoxelKernels.h"
 
 #include <Engine/TextureRenderTargetVolume.h>
-#include <Misc/Compression.h>
+#include <Tasks/Task.h>
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
 
 DEFINE_LOG_CATEGORY(LogTextureUtils);
 
@@ -43,84 +48,199 @@ void UVolumeTextureToolkit::SetVolumeTextureDetails(UVolumeTexture*& VolumeTextu
 
 void UVolumeTextureToolkit::CreateVolumeTextureMip(
 	UVolumeTexture*& VolumeTexture, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData /*= nullptr*/)
+{
+	// Newly created Volume textures have this null'd
+	if (!VolumeTexture->GetPlatformData())
+	{
+		VolumeTexture->SetPlatformData(new FTexturePlatformData());
+	}
+	VolumeTexture->GetPlatformData()->Mips.Add(CreateVolumeMip(PixelFormat, Dimensions, static_cast<const uint8*>(BulkData)));
+}
+
+void UVolumeTextureToolkit::CreateVolumeTextureMip(UVolumeTexture*& VolumeTexture, EPixelFormat PixelFormat, FIntVector Dimensions,
+	TFunctionRef<void(uint8* MipData)> FillMip)
+{
+	// Create the one and only mip in this texture.
+	FTexture2DMipMap* mip = CreateVolumeMip(PixelFormat, Dimensions, FillMip);
+
+	// Newly created Volume textures have this null'd
+	if (!VolumeTexture->GetPlatformData())
+	{
+		VolumeTexture->SetPlatformData(new FTexturePlatformData());
+	}
+	// Add the new MIP to the list of mips.
+	VolumeTexture->GetPlatformData()->Mips.Add(mip);
+}
+
+FTexture2DMipMap* UVolumeTextureToolkit::CreateVolumeMip(
+	EPixelFormat PixelFormat, FIntVector Dimensions, TFunctionRef<void(uint8* MipData)> FillMip)
 {
 	int PixelByteSize = GPixelFormats[PixelFormat].BlockBytes;
 	const long long TotalSize = (long long) Dimensions.X * Dimensions.Y * Dimensions.Z * PixelByteSize;
 
-	// Create the one and only mip in this texture.
 	FTexture2DMipMap* mip = new FTexture2DMipMap();
 	mip->SizeX = Dimensions.X;
 	mip->SizeY = Dimensions.Y;
 	mip->SizeZ = Dimensions.Z;
 
 	mip->BulkData.Lock(LOCK_READ_WRITE);
-	// Allocate memory in the mip and copy the actual texture data inside
+	// Allocate memory in the mip and let the caller fill it.
 	uint8* ByteArray = (uint8*) mip->BulkData.Realloc(TotalSize);
+	FillMip(ByteArray);
+	mip->BulkData.Unlock();
+	return mip;
+}
 
-	if (BulkData)
+FTexture2DMipMap* UVolumeTextureToolkit::CreateVolumeMip(EPixelFormat PixelFormat, FIntVector Dimensions, const uint8* BulkData)
+{
+	const int64 TotalSize = int64(Dimensions.X) * Dimensions.Y * Dimensions.Z * GPixelFormats[PixelFormat].BlockBytes;
+	return CreateVolumeMip(PixelFormat, Dimensions,
+		[BulkData, TotalSize](uint8* MipData)
+		{
+			if (BulkData)
+			{
+				FMemory::Memcpy(MipData, BulkData, TotalSize);
+			}
+			else
+			{
+				// If no data is provided, memset to zero
+				FMemory::Memset(MipData, 0, TotalSize);
+			}
+		});
+}
+
+UVolumeTexture* UVolumeTextureToolkit::CreateVolumeTextureTransientFromMip(
+	EPixelFormat PixelFormat, FIntVector Dimensions, FTexture2DMipMap* Mip, bool ShouldUpdateResource /*= true*/)
+{
+	UVolumeTexture* VolumeTexture = NewObject<UVolumeTexture>(GetTransientPackage(), NAME_None, RF_Transient);
+	SetVolumeTextureDetails(VolumeTexture, PixelFormat, Dimensions);
+	VolumeTexture->GetPlatformData()->Mips.Add(Mip);
+	if (ShouldUpdateResource)
 	{
-		FMemory::Memcpy(ByteArray, BulkData, TotalSize);
+		VolumeTexture->UpdateResource();
 	}
-	else
+	return VolumeTexture;
+}
+
+void UVolumeTextureToolkit::DownsampleDataTo2K(uint8* BulkData, FIntVector& Dimensions, EPixelFormat PixelFormat)
+{
+	const int64 VoxelByteSize = GPixelFormats[PixelFormat].BlockBytes;
+	constexpr int32 MaxSize = FVolumeBrickLayout::MaxTextureSize;
+	const FIntVector Strides(FMath::DivideAndRoundUp(Dimensions.X, MaxSize), FMath::DivideAndRoundUp(Dimensions.Y, MaxSize),
+		FMath::DivideAndRoundUp(Dimensions.Z, MaxSize));
+	const FIntVector NewDimensions(FMath::DivideAndRoundUp(Dimensions.X, Strides.X),
+		FMath::DivideAndRoundUp(Dimensions.Y, Strides.Y), FMath::DivideAndRoundUp(Dimensions.Z, Strides.Z));
+	if (NewDimensions == Dimensions)
 	{
-		// If no data is provided, memset to zero
-		FMemory::Memset(ByteArray, 0, TotalSize);
+		return;
 	}
+	UE_LOG(LogTextureUtils, Log, TEXT("Downsampling %s volume to %s to fit into a single volume texture."),
+		*Dimensions.ToString(), *NewDimensions.ToString());
 
-	mip->BulkData.Unlock();
+	if (!BulkData)
+	{
+		Dimensions = NewDimensions;
+		return;
+	}
 
-	// Newly created Volume textures have this null'd
-	if (!VolumeTexture->GetPlatformData())
+	// Every voxel moves "forward" (or stays), so going through the voxels in order never overwrites a voxel that's still needed.
+	for (int64 Z = 0; Z < NewDimensions.Z; Z++)
 	{
-		VolumeTexture->SetPlatformData(new FTexturePlatformData());
+		for (int64 Y = 0; Y < NewDimensions.Y; Y++)
+		{
+			uint8* NewRow = BulkData + ((Z * NewDimensions.Y + Y) * NewDimensions.X) * VoxelByteSize;
+			const uint8* OldRow = BulkData + ((Z * Strides.Z * Dimensions.Y + Y * Strides.Y) * Dimensions.X) * VoxelByteSize;
+			if (Strides.X == 1)
+			{
+				FMemory::Memmove(NewRow, OldRow, NewDimensions.X * VoxelByteSize);
+				continue;
+			}
+			for (int64 X = 0; X < NewDimensions.X; X++)
+			{
+				FMemory::Memmove(NewRow + X * VoxelByteSize, OldRow + X * Strides.X * VoxelByteSize, VoxelByteSize);
+			}
+		}
 	}
-	// Add the new MIP to the list of mips.
-	VolumeTexture->GetPlatformData()->Mips.Add(mip);
+	Dimensions = NewDimensions;
 }
 
-void UVolumeTextureToolkit::CropDataTo2K(uint8* BulkData, FIntVector& Dimensions, EPixelFormat PixelFormat)
+bool UVolumeTextureToolkit::CreateBrickedVolumeMips(const uint8* BulkData, FIntVector Dimensions, EPixelFormat PixelFormat,
+	FVolumeBrickLayout& OutLayout, FTexture2DMipMap*& OutAtlasMip)
 {
-	int VoxelByteSize = GPixelFormats[PixelFormat].BlockBytes;
+	FVolumeBrickLayout Layout(Dimensions);
+	if (!Layout.IsValid() || FVolumeBrickLayout::NeedsBricking(Layout.BrickCounts))
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Cannot split a %s volume into bricks."), *Dimensions.ToString());
+		return false;
+	}
+	Layout.ComputeBrickRanges(BulkData, PixelFormat);
+	if (!Layout.AssignNonEmptySlots())
+	{
+		return false;
+	}
+	UE_LOG(LogTextureUtils, Log, TEXT("Split %s volume into %d bricks, %d of them resident in a %s atlas."),
+		*Dimensions.ToString(), Layout.GetBrickCount(), Layout.GetResidentBrickCount(), *Layout.GetAtlasDimensions().ToString());
 
-	UE_LOG(LogTextureUtils, Warning, TEXT("Unreal doesn't support 3D textures larger than 2048 in any dimension"));
-	if (Dimensions.Z > 2048)
+	bool bHeaderWritten = false;
+	OutAtlasMip = CreateVolumeMip(PixelFormat, Layout.GetAtlasDimensions(),
+		[&](uint8* MipData)
+		{
+			const int32 VoxelByteSize = GPixelFormats[PixelFormat].BlockBytes;
+			const FIntVector AtlasDimensions = Layout.GetAtlasDimensions();
+			FMemory::Memzero(MipData, int64(AtlasDimensions.X) * AtlasDimensions.Y * AtlasDimensions.Z * VoxelByteSize);
+			Layout.CopyBricksToAtlas(BulkData, MipData, VoxelByteSize);
+			bHeaderWritten = Layout.WriteAtlasHeader(MipData, PixelFormat);
+		});
+	if (!bHeaderWritten)
 	{
-		UE_LOG(LogTextureUtils, Warning, TEXT("Z dimension has been clipped to 2048"));
-		// No need to do anything else, the back of the BulkData will just be unused when the texture gets created and then it will
-		// get freed.
-		Dimensions.Z = 2048;
+		delete OutAtlasMip;
+		OutAtlasMip = nullptr;
+		return false;
 	}
+	OutLayout = MoveTemp(Layout);
+	return true;
+}
 
-	if (Dimensions.Y > 2048 || Dimensions.X > 2048)
+bool UVolumeTextureToolkit::CreateBrickedVolumeTransient(
+	UVolumeAsset* OutAsset, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData)
+{
+	FTexture2DMipMap* AtlasMip = nullptr;
+	if (!OutAsset || !CreateBrickedVolumeMips(BulkData, Dimensions, PixelFormat, OutAsset->BrickLayout, AtlasMip))
 	{
-		// Need to reshuffle the data "forward" in BulkData to match clamped dimensions.
-		// TODO test this
-		// This could be optimized so that for Y it only does the copies for Y dimension and not per-row...
+		return false;
+	}
+	OutAsset->BrickAtlasTexture =
+		CreateVolumeTextureTransientFromMip(PixelFormat, OutAsset->BrickLayout.GetAtlasDimensions(), AtlasMip);
 
-		int ClampedX = std::clamp(Dimensions.X, 0, 2048);
-		int ClampedY = std::clamp(Dimensions.Y, 0, 2048);
+	// The bricks are done with the full resolution data, so it can get downsampled in place for the DataTexture.
+	DownsampleDataTo2K(BulkData, Dimensions, PixelFormat);
+	return CreateVolumeTextureTransient(OutAsset->DataTexture, PixelFormat, Dimensions, BulkData);
+}
 
-		for (int Z = 0; Z < Dimensions.Z; Z++)
-		{
-			for (int Y = 0; Y < ClampedY; Y++)
-			{
-				int RowLength = ClampedX * VoxelByteSize;
-				int NewOffset = ((ClampedX * Y) + (ClampedX * ClampedY * Z)) * VoxelByteSize;
-				int OldOffset = ((Dimensions.X * Y) + (Dimensions.X * Dimensions.Y * Z)) * VoxelByteSize;
-				FMemory::Memcpy(BulkData + NewOffset, BulkData + OldOffset, RowLength);
-			}
-		}
-		if (Dimensions.Y != ClampedY)
-		{
-			UE_LOG(LogTextureUtils, Warning, TEXT("Y dimension has been clipped to 2048"));
-			Dimensions.Y = ClampedY;
-		}
-		if (Dimensions.X != ClampedX)
-		{
-			UE_LOG(LogTextureUtils, Warning, TEXT("X dimension has been clipped to 2048"));
-			Dimensions.X = ClampedX;
-		}
+bool UVolumeTextureToolkit::CreateBrickedVolumeAsset(UVolumeAsset* OutAsset, const FString& DataTextureName,
+	const FString& AtlasTextureName, const FString& FolderName, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData)
+{
+	FTexture2DMipMap* AtlasMip = nullptr;
+	if (!OutAsset || !CreateBrickedVolumeMips(BulkData, Dimensions, PixelFormat, OutAsset->BrickLayout, AtlasMip))
+	{
+		return false;
 	}
+
+	// Persistent textures keep their voxels as source data, so the atlas asset gets created from the mip's data.
+	FIntVector AtlasDimensions = OutAsset->BrickLayout.GetAtlasDimensions();
+	uint8* AtlasData = static_cast<uint8*>(AtlasMip->BulkData.Lock(LOCK_READ_WRITE));
+	const bool bAtlasCreated = CreateVolumeTextureAsset(
+		OutAsset->BrickAtlasTexture, AtlasTextureName, FolderName, PixelFormat, AtlasDimensions, AtlasData, true);
+	AtlasMip->BulkData.Unlock();
+	delete AtlasMip;
+	if (!bAtlasCreated)
+	{
+		return false;
+	}
+
+	// The bricks are done with the full resolution data, so it can get downsampled in place for the DataTexture.
+	DownsampleDataTo2K(BulkData, Dimensions, PixelFormat);
+	return CreateVolumeTextureAsset(OutAsset->DataTexture, DataTextureName, FolderName, PixelFormat, Dimensions, BulkData, true);
 }
 
 bool UVolumeTextureToolkit::CreateVolumeTextureAsset(UVolumeTexture*& OutTexture, const FString& AssetName,
@@ -132,10 +252,14 @@ bool UVolumeTextureToolkit::CreateVolumeTextureAsset(UVolumeTexture*& OutTexture
 		return false;
 	}
 
-	if (Dimensions.X > 2048 || Dimensions.Y > 2048 || Dimensions.Z > 2048)
+	if (FVolumeBrickLayout::NeedsBricking(Dimensions))
 	{
-		// Current RHI limitations make it impossible to create 3D textures larger than 2k in each dimension -> crop data.
-		CropDataTo2K(BulkData, Dimensions, PixelFormat);
+		// Current RHI limitations make it impossible to create 3D textures larger than 2k in each dimension.
+		UE_LOG(LogTextureUtils, Error,
+			TEXT("Cannot create a %s volume texture asset, volume textures can't be larger than 2048 in any dimension. Split the "
+				 "volume into bricks with CreateBrickedVolumeAsset or downsample it with DownsampleDataTo2K."),
+			*Dimensions.ToString());
+		return false;
 	}
 
 	FString PackageName = MakePackageName(AssetName, FolderName);
@@ -256,6 +380,15 @@ bool UVolumeTextureToolkit::Create2DTextureTransient(UTexture2D*& OutTexture, EP
 bool UVolumeTextureToolkit::CreateVolumeTextureTransient(
 	UVolumeTexture*& OutTexture, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData, bool ShouldUpdateResource)
 {
+	if (FVolumeBrickLayout::NeedsBricking(Dimensions))
+	{
+		UE_LOG(LogTextureUtils, Error,
+			TEXT("Cannot create a %s volume texture, volume textures can't be larger than 2048 in any dimension. Split the volume "
+				 "into bricks with CreateBrickedVolumeTransient or downsample it with DownsampleDataTo2K."),
+			*Dimensions.ToString());
+		return false;
+	}
+
 	UVolumeTexture* VolumeTexture = nullptr;
 	VolumeTexture = NewObject<UVolumeTexture>(GetTransientPackage(), NAME_None, RF_Transient);
 
@@ -273,7 +406,8 @@ bool UVolumeTextureToolkit::CreateVolumeTextureTransient(
 	return true;
 }
 
-uint8* UVolumeTextureToolkit::LoadRawFileIntoArray(const FString FileName, const int64 BytesToLoad)
+uint8* UVolumeTextureToolkit::LoadRawFileIntoArray(const FString FileName, const int64 BytesToLoad,
+	TFunction<void(int64 BytesRead)> OnBytesRead /*= nullptr*/, const int64 FileOffset /*= 0*/)
 {
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
 	// Try opening as absolute path.
@@ -291,13 +425,13 @@ uint8* UVolumeTextureToolkit::LoadRawFileIntoArray(const FString FileName, const
 		UE_LOG(LogTextureUtils, Error, TEXT("Raw file could not be opened."));
 		return nullptr;
 	}
-	else if (FileHandle->Size() < BytesToLoad)
+	else if (FileHandle->Size() - FileOffset < BytesToLoad)
 	{
 		UE_LOG(LogTextureUtils, Error, TEXT("Raw file is smaller than expected, cannot read volume."));
 		delete FileHandle;
 		return nullptr;
 	}
-	else if (FileHandle->Size() > BytesToLoad)
+	else if (FileHandle->Size() - FileOffset > BytesToLoad)
 	{
 		UE_LOG(LogTextureUtils, Warning,
 			TEXT("Raw File is larger than expected,	check your dimensions and pixel format. (nonfatal, but the texture will "
@@ -305,24 +439,94 @@ uint8* UVolumeTextureToolkit::LoadRawFileIntoArray(const FString FileName, const
 	}
 
 	uint8* LoadedArray = new uint8[BytesToLoad];
-	FileHandle->Read(LoadedArray, BytesToLoad);
+	bool bReadSucceeded = FileHandle->Seek(FileOffset);
+	if (!OnBytesRead)
+	{
+		bReadSucceeded = bReadSucceeded && FileHandle->Read(LoadedArray, BytesToLoad);
+	}
+	else
+	{
+		// Read in blocks, so that the caller can follow the progress.
+		constexpr int64 BlockSize = 16 * 1024 * 1024;
+		for (int64 Offset = 0; Offset < BytesToLoad && bReadSucceeded; Offset += BlockSize)
+		{
+			const int64 BlockByteSize = FMath::Min(BlockSize, BytesToLoad - Offset);
+			bReadSucceeded = FileHandle->Read(LoadedArray + Offset, BlockByteSize);
+			if (bReadSucceeded)
+			{
+				OnBytesRead(BlockByteSize);
+			}
+		}
+	}
 	delete FileHandle;
 
+	// Don't hand out a partially filled array, the rest of it is uninitialized.
+	if (!bReadSucceeded)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Reading raw file %s failed, cannot read volume."), *FileName);
+		delete[] LoadedArray;
+		return nullptr;
+	}
 	return LoadedArray;
 }
 
-uint8* UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(
-	const FString FileName, const int64 UncompressedByteSize, const int64 CompressedByteSize)
+bool UVolumeTextureToolkit::MapRawFile(
+	const FString& FileName, const int64 ByteSize, FMappedRawFile& OutMappedFile, const int64 FileOffset /*= 0*/)
 {
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
 	// Try opening as absolute path.
-	IFileHandle* FileHandle = PlatformFile.OpenRead(*FileName);
+	TUniquePtr<IMappedFileHandle> Handle(PlatformFile.OpenMapped(*FileName));
+
+	// If opening as absolute path failed, open as relative to content directory.
+	if (!Handle)
+	{
+		FString FullPath = FPaths::ProjectContentDir() + FileName;
+		Handle.Reset(PlatformFile.OpenMapped(*FullPath));
+	}
+
+	if (!Handle)
+	{
+		UE_LOG(LogTextureUtils, Warning, TEXT("Raw file could not be memory mapped."));
+		return false;
+	}
+	else if (Handle->GetFileSize() - FileOffset < ByteSize)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Raw file is smaller than expected, cannot read volume."));
+		return false;
+	}
+	else if (Handle->GetFileSize() - FileOffset > ByteSize)
+	{
+		UE_LOG(LogTextureUtils, Warning,
+			TEXT("Raw File is larger than expected,	check your dimensions and pixel format. (nonfatal, but the texture will "
+				 "probably be screwed up)"));
+	}
+
+	TUniquePtr<IMappedFileRegion> Region(Handle->MapRegion(FileOffset, ByteSize));
+	if (!Region)
+	{
+		UE_LOG(LogTextureUtils, Warning, TEXT("Raw file could not be memory mapped."));
+		return false;
+	}
+
+	OutMappedFile.Handle = MoveTemp(Handle);
+	OutMappedFile.Region = MoveTemp(Region);
+	return true;
+}
+
+uint8* UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(const FString FileName, const int64 UncompressedByteSize,
+	const int64 CompressedByteSize, const int64 SlabByteSize /*= 0*/,
+	TFunction<void(const uint8* SlabData, int64 SlabOffset, int64 SlabSize)> OnSlabInflated /*= nullptr*/,
+	const int64 FileOffset /*= 0*/)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	// Try opening as absolute path.
+	TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenRead(*FileName));
 
 	// If opening as absolute path failed, open as relative to content directory.
 	if (!FileHandle)
 	{
 		FString FullPath = FPaths::ProjectContentDir() + FileName;
-		FileHandle = PlatformFile.OpenRead(*FullPath);
+		FileHandle.Reset(PlatformFile.OpenRead(*FullPath));
 	}
 
 	if (!FileHandle)
@@ -330,13 +534,12 @@ uint8* UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(
 		UE_LOG(LogTextureUtils, Error, TEXT("Raw compressed file could not be opened."));
 		return nullptr;
 	}
-	else if (FileHandle->Size() < CompressedByteSize)
+	else if (FileHandle->Size() - FileOffset < CompressedByteSize)
 	{
 		UE_LOG(LogTextureUtils, Error, TEXT("Raw compressed file is smaller than expected, cannot read volume."));
-		delete FileHandle;
 		return nullptr;
 	}
-	else if (FileHandle->Size() > CompressedByteSize)
+	else if (CompressedByteSize > 0 && FileHandle->Size() - FileOffset > CompressedByteSize)
 	{
 		UE_LOG(LogTextureUtils, Warning,
 			TEXT("Raw compressed file is larger than expected, check your dimensions and pixel format. (nonfatal, but the texture "
@@ -344,68 +547,154 @@ uint8* UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(
 				 "probably be screwed up)"));
 	}
 
-	uint8* LoadedArray = new uint8[CompressedByteSize];
-	FileHandle->Read(LoadedArray, CompressedByteSize);
+	// If the compressed size is unknown, just inflate until the stream ends.
+	const int64 BytesToRead = CompressedByteSize > 0 ? CompressedByteSize : FileHandle->Size() - FileOffset;
+	if (!FileHandle->Seek(FileOffset))
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Seeking to the compressed data in the raw file failed, cannot read volume."));
+		return nullptr;
+	}
+
+	z_stream Stream;
+	FMemory::Memzero(Stream);
+	// +32 enables automatic detection of zlib and gzip headers.
+	if (inflateInit2(&Stream, MAX_WBITS + 32) != Z_OK)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Failed initializing zlib inflate."));
+		return nullptr;
+	}
 
-	uint8* UncompressedArray = new uint8[UncompressedByteSize];
-	FCompression::UncompressMemory(NAME_Zlib, UncompressedArray, UncompressedByteSize, LoadedArray, CompressedByteSize);
+	TUniquePtr<uint8[]> UncompressedArray(new uint8[UncompressedByteSize]);
+	Stream.next_out = UncompressedArray.Get();
 
-	delete[] LoadedArray;
-	return UncompressedArray;
+	constexpr int64 ChunkSize = 4 * 1024 * 1024;
+	TArray<uint8> Chunk;
+	Chunk.SetNumUninitialized(FMath::Min(ChunkSize, BytesToRead));
+
+	TArray<UE::Tasks::FTask> SlabTasks;
+	int64 NotifiedByteSize = 0;
+	int64 InflatedByteSize = 0;
+	int64 ReadByteSize = 0;
+	int Result = Z_OK;
+	while (Result != Z_STREAM_END && InflatedByteSize < UncompressedByteSize)
+	{
+		if (Stream.avail_in == 0)
+		{
+			const int64 ChunkByteSize = FMath::Min(ChunkSize, BytesToRead - ReadByteSize);
+			if (ChunkByteSize <= 0 || !FileHandle->Read(Chunk.GetData(), ChunkByteSize))
+			{
+				break;
+			}
+			ReadByteSize += ChunkByteSize;
+			Stream.next_in = Chunk.GetData();
+			Stream.avail_in = static_cast<uInt>(ChunkByteSize);
+		}
+
+		// zlib counts in 32bit, so hand out the output in <4GB pieces.
+		Stream.avail_out = static_cast<uInt>(FMath::Min<int64>(UncompressedByteSize - InflatedByteSize, MAX_uint32));
+		Result = inflate(&Stream, Z_NO_FLUSH);
+		if (Result != Z_OK && Result != Z_STREAM_END)
+		{
+			break;
+		}
+		InflatedByteSize = Stream.next_out - UncompressedArray.Get();
+
+		// Hand out all slabs that got completed. The last slab can be shorter.
+		const bool bFinished = Result == Z_STREAM_END || InflatedByteSize == UncompressedByteSize;
+		while (OnSlabInflated && SlabByteSize > 0 &&
+			   (NotifiedByteSize + SlabByteSize <= InflatedByteSize || (bFinished && NotifiedByteSize < InflatedByteSize)))
+		{
+			const int64 SlabOffset = NotifiedByteSize;
+			const int64 SlabSize = FMath::Min(SlabByteSize, InflatedByteSize - SlabOffset);
+			const uint8* SlabData = UncompressedArray.Get() + SlabOffset;
+			SlabTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[&OnSlabInflated, SlabData, SlabOffset, SlabSize] { OnSlabInflated(SlabData, SlabOffset, SlabSize); }));
+			NotifiedByteSize += SlabSize;
+		}
+	}
+	inflateEnd(&Stream);
+	UE::Tasks::Wait(SlabTasks);
+
+	if (InflatedByteSize < UncompressedByteSize)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Failed inflating compressed file, only got %lld out of %lld bytes (zlib result %d)."),
+			InflatedByteSize, UncompressedByteSize, Result);
+		return nullptr;
+	}
+
+	return UncompressedArray.Release();
 }
 
 uint8* UVolumeTextureToolkit::NormalizeArrayByFormat(
 	const EVolumeVoxelFormat VoxelFormat, uint8* InArray, const int64 ByteSize, float& OutInMin, float& OutInMax)
 {
-	switch (VoxelFormat)
-	{
-		case EVolumeVoxelFormat::UnsignedChar:
-			return ConvertArrayToNormalizedArray<uint8, uint8>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::SignedChar:
-			return ConvertArrayToNormalizedArray<int8, uint8>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::UnsignedShort:
-			return ConvertArrayToNormalizedArray<uint16, uint16>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::SignedShort:
-			return ConvertArrayToNormalizedArray<int16, uint16>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::UnsignedInt:
-			return ConvertArrayToNormalizedArray<uint32, uint16>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::SignedInt:
-			return ConvertArrayToNormalizedArray<int32, uint16>(InArray, ByteSize, OutInMin, OutInMax);
-		case EVolumeVoxelFormat::Float:
-			return ConvertArrayToNormalizedArray<float, uint16>(InArray, ByteSize, OutInMin, OutInMax);
-		default:
-			ensure(false);
-			return nullptr;
+	const int32 VoxelByteSize = FVolumeInfo::VoxelFormatByteSize(VoxelFormat);
+	if (!ensure(VoxelByteSize > 0))
+	{
+		return nullptr;
 	}
+
+	// 8bit formats normalize to 8bit, everything else to 16bit.
+	uint8* OutArray = new uint8[(ByteSize / VoxelByteSize) * (VoxelByteSize == 1 ? 1 : 2)];
+	NormalizeArrayByFormat(VoxelFormat, InArray, ByteSize, OutArray, OutInMin, OutInMax);
+	return OutArray;
+}
+
+void UVolumeTextureToolkit::FindMinMaxByFormat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ByteSize,
+	float& OutMin, float& OutMax, const bool bSwapBytes)
+{
+	const int32 VoxelByteSize = FVolumeInfo::VoxelFormatByteSize(VoxelFormat);
+	if (!ensure(VoxelByteSize > 0))
+	{
+		return;
+	}
+	VoxelKernels::FindMinMax(VoxelFormat, InArray, ByteSize / VoxelByteSize, OutMin, OutMax, bSwapBytes);
+}
+
+void UVolumeTextureToolkit::NormalizeArrayByFormatWithRange(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray,
+	const int64 ByteSize, uint8* OutArray, const float InMin, const float InMax)
+{
+	const int32 VoxelByteSize = FVolumeInfo::VoxelFormatByteSize(VoxelFormat);
+	if (!ensure(VoxelByteSize > 0))
+	{
+		return;
+	}
+	VoxelKernels::Normalize(VoxelFormat, InArray, ByteSize / VoxelByteSize, OutArray, InMin, InMax);
+}
+
+void UVolumeTextureToolkit::NormalizeArrayByFormat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ByteSize,
+	uint8* OutArray, float& OutInMin, float& OutInMax)
+{
+	FindMinMaxByFormat(VoxelFormat, InArray, ByteSize, OutInMin, OutInMax);
+	NormalizeArrayByFormatWithRange(VoxelFormat, InArray, ByteSize, OutArray, OutInMin, OutInMax);
 }
 
 float* UVolumeTextureToolkit::ConvertArrayToFloat(const EVolumeVoxelFormat VoxelFormat, uint8* InArray, uint64 VoxelCount)
 {
-	switch (VoxelFormat)
-	{
-		case EVolumeVoxelFormat::UnsignedChar:
-			return ConvertArrayToFloatTemplated<uint8>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::SignedChar:
-			return ConvertArrayToFloatTemplated<int8>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::UnsignedShort:
-			return ConvertArrayToFloatTemplated<uint16>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::SignedShort:
-			return ConvertArrayToFloatTemplated<int16>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::UnsignedInt:
-			return ConvertArrayToFloatTemplated<uint32>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::SignedInt:
-			return ConvertArrayToFloatTemplated<int32>(InArray, VoxelCount);
-		case EVolumeVoxelFormat::Float:	   // fall through
-		default:
-			ensure(false);
-			return nullptr;
+	float* OutArray = new float[VoxelCount];
+	if (!ConvertArrayToFloat(VoxelFormat, InArray, VoxelCount, OutArray))
+	{
+		delete[] OutArray;
+		return nullptr;
 	}
+	return OutArray;
+}
+
+bool UVolumeTextureToolkit::ConvertArrayToFloat(
+	const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, uint64 VoxelCount, float* OutArray)
+{
+	if (!ensure(FVolumeInfo::VoxelFormatByteSize(VoxelFormat) > 0))
+	{
+		return false;
+	}
+	VoxelKernels::ConvertToFloat(VoxelFormat, InArray, static_cast<int64>(VoxelCount), OutArray);
+	return true;
 }
 
 void UVolumeTextureToolkit::LoadRawIntoNewVolumeTextureAsset(FString RawFileName, FString FolderName, FString TextureName,
 	FIntVector Dimensions, uint32 BytexPerVoxel, EPixelFormat OutPixelFormat, bool Persistent, UVolumeTexture*& LoadedTexture)
 {
-	const int64 TotalSize = Dimensions.X * Dimensions.Y * Dimensions.Z * BytexPerVoxel;
+	const int64 TotalSize = int64(Dimensions.X) * Dimensions.Y * Dimensions.Z * BytexPerVoxel;
 
 	uint8* TempArray = UVolumeTextureToolkit::LoadRawFileIntoArray(RawFileName, TotalSize);
 	if (!TempArray)
@@ -424,7 +713,7 @@ void UVolumeTextureToolkit::LoadRawIntoNewVolumeTextureAsset(FString RawFileName
 void UVolumeTextureToolkit::LoadRawIntoVolumeTextureAsset(FString RawFileName, UVolumeTexture* inTexture, FIntVector Dimensions,
 	uint32 BytexPerVoxel, EPixelFormat OutPixelFormat, bool Persistent)
 {
-	const int64 TotalSize = Dimensions.X * Dimensions.Y * Dimensions.Z * BytexPerVoxel;
+	const int64 TotalSize = int64(Dimensions.X) * Dimensions.Y * Dimensions.Z * BytexPerVoxel;
 
 	uint8* TempArray = UVolumeTextureToolkit::LoadRawFileIntoArray(RawFileName, TotalSize);
 	if (!TempArray)
@@ -2,6 +2,8 @@
 // Licensed under MIT license - See License.txt for details.
 #include "VolumeAsset/Loaders/DCMTKLoader.h"
 
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
 #include "TextureUtilities.h"
 
 // DCMTK uses their own verify and check macros.
@@ -17,6 +19,7 @@
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmdata/dcpixel.h"
 
+#include <atomic>
 #include <vector>
 
 #pragma pop_macro("verify")
@@ -35,6 +38,8 @@ UDCMTKLoader::UDCMTKLoader()
 	, bIgnoreIrregularThickness(false)
 	, bSetPixelSpacingX(false)
 	, bSetPixelSpacingY(false)
+	, bParallelSliceDecode(true)
+	, bUseFolderIndexCache(true)
 {
 }
 
@@ -43,16 +48,13 @@ UDCMTKLoader* UDCMTKLoader::Get()
 	return NewObject<UDCMTKLoader>();
 }
 
-int GetSliceNumber(DcmDataset* SliceDataset)
+const FDICOMFolderIndex& UDCMTKLoader::GetFolderIndex(const FString& FolderName, const FString& Extension)
 {
-	OFString SliceInstanceNumberOfString;
-	if (SliceDataset->findAndGetOFString(DCM_InstanceNumber, SliceInstanceNumberOfString).bad())
+	if (!FolderIndex.IsIndexOf(FolderName, Extension))
 	{
-		UE_LOG(LogDCMTK, Error, TEXT("Error getting Instance Number!"));
-		return -1;
+		FolderIndex = FDICOMFolderIndex::Build(FolderName, Extension, bUseFolderIndexCache);
 	}
-	const FString SliceInstanceNumberString = FString(UTF8_TO_TCHAR(SliceInstanceNumberOfString.c_str()));
-	return FCString::Atoi(*SliceInstanceNumberString);
+	return FolderIndex;
 }
 
 void Dump(DcmDataset* Dataset)
@@ -86,8 +88,11 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 	FVolumeInfo Info;
 	Info.DataFileName = FileName;
 
-	DcmFileFormat Format;
-	if (Format.loadFile(TCHAR_TO_UTF8(*FileName)).bad())
+	FString FolderName, FileNameDummy, Extension;
+	FPaths::Split(FileName, FolderName, FileNameDummy, Extension);
+
+	const FDICOMFileRecord* Record = GetFolderIndex(FolderName, Extension).FindFile(FileName);
+	if (Record == nullptr)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
 		return Info;
@@ -95,58 +100,20 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 
 	// TODO - Sanity check that this DICOM is even a 2D/3D image
 
-	DcmDataset* Dataset = Format.getDataset();
-	OFString SeriesInstanceUIDOfString;
-	if (Dataset->findAndGetOFString(DCM_SeriesInstanceUID, SeriesInstanceUIDOfString).bad())
+	uint32 NumberOfFrames = Record->NumberOfFrames;
 	{
-		UE_LOG(LogDCMTK, Error, TEXT("Error getting Series Instance UID!"));
-		return Info;
-	}
-
-	uint32 NumberOfFrames = 1;
-	{
-		OFString NumberOfFramesOfString;
-		if (Dataset->findAndGetOFString(DCM_NumberOfFrames, NumberOfFramesOfString).good())
-		{
-			NumberOfFrames = FCString::Atoi(*FString(UTF8_TO_TCHAR(NumberOfFramesOfString.c_str())));
-		}
-
 		if (NumberOfFrames == 1)
 		{
-			FString FolderName, FileNameDummy, Extension;
-			FPaths::Split(FileName, FolderName, FileNameDummy, Extension);
-			TArray<FString> FilesInDir = GetFilesInFolder(FolderName, Extension);
-
-			NumberOfFrames = 0;
-			for (const FString& File : FilesInDir)
+			const TArray<const FDICOMFileRecord*> Series = FolderIndex.GetSeries(Record->SeriesInstanceUID);
+			NumberOfFrames = Series.Num();
+			for (const FDICOMFileRecord* Slice : Series)
 			{
-				DcmFileFormat SliceDataFormat;
-				if (SliceDataFormat.loadFile(TCHAR_TO_UTF8(*(FolderName / File))).bad())
+				if (Slice->InstanceNumber == INDEX_NONE)
 				{
-					continue;
-				}
-
-				DcmDataset* SliceDataSet = SliceDataFormat.getDataset();
-				OFString FileSeriesInstanceUIDOfString;
-				if (SliceDataSet->findAndGetOFString(DCM_SeriesInstanceUID, FileSeriesInstanceUIDOfString).bad())
-				{
-					// Series UID not matching -> different image than what we're loading.
-					continue;
-				}
-
-				if (FileSeriesInstanceUIDOfString == SeriesInstanceUIDOfString)
-				{
-					++NumberOfFrames;
-					if (int SliceNumber = GetSliceNumber(SliceDataSet); SliceNumber != -1)
-					{
-						Info.UpdateMinMaxSliceNumber(SliceNumber);
-					}
-					else
-					{
-						UE_LOG(LogDCMTK, Error, TEXT("Failed getting slice numbers when reading DICOM folder headers"));
-						return Info;	
-					}
+					UE_LOG(LogDCMTK, Error, TEXT("Failed getting slice numbers when reading DICOM folder headers"));
+					return Info;
 				}
+				Info.UpdateMinMaxSliceNumber(Slice->InstanceNumber);
 			}
 		}
 		else
@@ -171,53 +138,43 @@ FVolumeInfo UDCMTKLoader::ParseVolumeInfoFromHeader(FString FileName)
 		}
 	}
 
-	Uint16 Rows = 0, Columns = 0;
-	if (Dataset->findAndGetUint16(DCM_Rows, Rows).bad() || Dataset->findAndGetUint16(DCM_Columns, Columns).bad())
+	if (Record->Rows == 0 || Record->Columns == 0)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error getting Rows and Columns!"));
 		return Info;
 	}
-	Info.Dimensions = FIntVector(Columns, Rows, NumberOfFrames);
+	Info.Dimensions = FIntVector(Record->Columns, Record->Rows, NumberOfFrames);
 
 	double PixelSpacingX = DefaultPixelSpacingX, PixelSpacingY = DefaultPixelSpacingY;
 	if (!bSetPixelSpacingX || !bSetPixelSpacingY)
 	{
-		OFString OfPixelSpacingOfString;
-		if (Dataset->findAndGetOFString(DCM_PixelSpacing, OfPixelSpacingOfString).bad())
+		if (!Record->PixelSpacing.IsSet())
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error getting Pixel Spacing!"));
 			return Info;
 		}
 
-		int ScanfResult = sscanf(OfPixelSpacingOfString.c_str(), "%lf\\%lf", &PixelSpacingX, &PixelSpacingY);
-		if (ScanfResult == 0)
-		{
-			UE_LOG(LogDCMTK, Error, TEXT("Error parsing Pixel Spacing!"));
-			return Info;
-		}
-		else if (ScanfResult == 1)
-		{
-			PixelSpacingY = PixelSpacingX;
-		}
+		PixelSpacingX = Record->PixelSpacing->X;
+		PixelSpacingY = Record->PixelSpacing->Y;
 	}
 
 	double SliceThickness = DefaultSliceThickness;
 	if (bReadSliceThickness)
 	{
-		if (Dataset->findAndGetFloat64(DCM_SliceThickness, SliceThickness).bad())
+		if (!Record->SliceThickness.IsSet())
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error getting Slice Thickness!"));
 			return Info;
 		}
+		SliceThickness = Record->SliceThickness.GetValue();
 	}
 
 	Info.Spacing = FVector(PixelSpacingX, PixelSpacingY, SliceThickness);
 	Info.WorldDimensions = Info.Spacing * FVector(Info.Dimensions);
 
-	Uint16 BitsAllocated = 0, PixelRepresentation = 0, SamplesPerPixel = 0;
-	if (Dataset->findAndGetUint16(DCM_BitsAllocated, BitsAllocated).bad() ||
-		Dataset->findAndGetUint16(DCM_PixelRepresentation, PixelRepresentation).bad() ||
-		Dataset->findAndGetUint16(DCM_SamplesPerPixel, SamplesPerPixel).bad())
+	const uint16 BitsAllocated = Record->BitsAllocated, PixelRepresentation = Record->PixelRepresentation,
+				 SamplesPerPixel = Record->SamplesPerPixel;
+	if (BitsAllocated == 0 || SamplesPerPixel == 0)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error getting Pixel Data parameters!"));
 		return Info;
@@ -284,11 +241,8 @@ UVolumeAsset* UDCMTKLoader::CreateVolumeFromFile(FString FileName, bool bNormali
 	// Perform complete load and conversion of data.
 	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FileName, VolumeInfo, bNormalize, bConvertToFloat);
 
-	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
-	const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
-
-	// Create the transient Volume texture.
-	UVolumeTextureToolkit::CreateVolumeTextureTransient(OutAsset->DataTexture, PixelFormat, VolumeInfo.Dimensions, LoadedArray.Get());
+	// Create the transient Volume texture (or the bricks, for volumes too large for a single texture).
+	CreateTransientTextures(OutAsset, VolumeInfo, LoadedArray.Get());
 
 	// Check that the texture got created properly.
 	if (OutAsset->DataTexture)
@@ -302,6 +256,21 @@ UVolumeAsset* UDCMTKLoader::CreateVolumeFromFile(FString FileName, bool bNormali
 	}
 }
 
+TUniquePtr<uint8[]> UDCMTKLoader::LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+	FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	OutVolumeInfo = ParseVolumeInfoFromHeader(FileName);
+	if (!OutVolumeInfo.bParseWasSuccessful)
+	{
+		return nullptr;
+	}
+
+	// Get a nice name from the folder we're in to name the asset.
+	GetValidPackageNameFromFolderName(FileName, OutVolumeName);
+
+	return LoadAndConvertData(FileName, OutVolumeInfo, bNormalize, bConvertToFloat, Progress);
+}
+
 UVolumeAsset* UDCMTKLoader::CreatePersistentVolumeFromFile(
 	const FString& FileName, const FString& OutFolder, bool bNormalize /*= true*/)
 {
@@ -328,15 +297,8 @@ UVolumeAsset* UDCMTKLoader::CreatePersistentVolumeFromFile(
 		return nullptr;
 	}
 
-	const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
-	// Create the persistent volume texture.
-	const FString VolumeTextureName = "VA_" + VolumeName + "_Data";
-	UVolumeTextureToolkit::CreateVolumeTextureAsset(
-		OutAsset->DataTexture, VolumeTextureName, OutFolder, PixelFormat, VolumeInfo.Dimensions, LoadedArray.Get(), true);
-	OutAsset->ImageInfo = VolumeInfo;
-
-	// Check that the texture got created properly.
-	if (OutAsset->DataTexture)
+	// Create the persistent volume textures.
+	if (CreatePersistentTextures(OutAsset, VolumeName, OutFolder, VolumeInfo, LoadedArray.Get()))
 	{
 		OutAsset->ImageInfo = VolumeInfo;
 		return OutAsset;
@@ -398,10 +360,11 @@ bool LoadPixelData(DcmDataset* Dataset, uint8* FrameData, uint64 FrameSize, uint
 	return DicomPixelData->getUncompressedFrame(Dataset, FrameIndex, *InOutFragmentIndex, FrameData, FrameSize, Dummy).bad();
 }
 
-TUniquePtr<uint8[]> LoadMultiFrameDICOM(DcmDataset* Dataset, uint32 NumberOfFrames, const FVolumeInfo& VolumeInfo)
+TUniquePtr<uint8[]> LoadMultiFrameDICOM(
+	DcmDataset* Dataset, uint32 NumberOfFrames, const FVolumeInfo& VolumeInfo, FVolumeLoadProgress* Progress)
 {
-	const unsigned long FullDataSize = VolumeInfo.GetByteSize();
-	const unsigned long SliceByteSize = VolumeInfo.Dimensions.X * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
+	const uint64 FullDataSize = VolumeInfo.GetByteSize();
+	const uint64 SliceByteSize = uint64(VolumeInfo.Dimensions.X) * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
 
 	TUniquePtr<uint8[]> Data(new uint8[FullDataSize]);
 	memset(Data.Get(), 0, FullDataSize);
@@ -414,6 +377,11 @@ TUniquePtr<uint8[]> LoadMultiFrameDICOM(DcmDataset* Dataset, uint32 NumberOfFram
 			UE_LOG(LogDCMTK, Error, TEXT("Error Loading Pixel data from file! Most likely unsupported compression type."));
 			return nullptr;
 		}
+		if (Progress)
+		{
+			Progress->AddBytesRead(SliceByteSize);
+			Progress->AddSlicesDecoded(1);
+		}
 	}
 
 	return Data;
@@ -431,74 +399,119 @@ void PrintDebugData(const Uint8* PixelData, unsigned long DataLength)
 	UE_LOG(LogTemp, Warning, TEXT("Debug data : %ls"), *DebugString);
 }
 
-TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FString& FilePath, const OFString& SeriesInstanceUIDOfString, FVolumeInfo& VolumeInfo,
-	bool bCalculateSliceThickness, bool bVerifySliceThickness, bool bIgnoreIrregularThickness)
+// Reads the pixel data of a single-frame file. Native little endian data is read straight from the indexed offset, anything else
+// gets decoded by DCMTK.
+bool LoadSlicePixelData(const FString& FilePath, const FDICOMFileRecord& Record, uint8* SliceData, uint64 SliceByteSize)
 {
-	const unsigned long FullDataSize = VolumeInfo.GetByteSize();
-	const unsigned long SliceByteSize = VolumeInfo.Dimensions.X * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
+	if (Record.PixelDataOffset != INDEX_NONE && Record.GetPixelDataByteSize() == SliceByteSize)
+	{
+		TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FilePath));
+		return FileHandle && FileHandle->Seek(Record.PixelDataOffset) && FileHandle->Read(SliceData, SliceByteSize);
+	}
 
-	FString FolderName, FileNameDummy, Extension;
-	FPaths::Split(FilePath, FolderName, FileNameDummy, Extension);
+	DcmFileFormat SliceFormat;
+	if (SliceFormat.loadFile(TCHAR_TO_UTF8(*FilePath)).bad())
+	{
+		return false;
+	}
+
+	uint32 FragmentIndex = 1;
+	return !LoadPixelData(SliceFormat.getDataset(), SliceData, SliceByteSize, 0, &FragmentIndex);
+}
+
+TUniquePtr<uint8[]> UDCMTKLoader::LoadSingleFrameDICOMFolder(const FDICOMFolderIndex& FolderIndex,
+	const FString& SeriesInstanceUID, FVolumeInfo& VolumeInfo, bool bCalculateSliceThickness, bool bVerifySliceThickness,
+	bool bIgnoreIrregularThickness, bool bParallelDecode, int32 MaxDecodeWorkers, FVolumeLoadProgress* Progress)
+{
+	const uint64 FullDataSize = VolumeInfo.GetByteSize();
+	const uint64 SliceByteSize = uint64(VolumeInfo.Dimensions.X) * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel;
 
 	TUniquePtr<uint8[]> FullData(new uint8[FullDataSize]);
 	memset(FullData.Get(), 0, FullDataSize);
 
-	TArray<double> SliceLocations;
-	SliceLocations.Reserve(VolumeInfo.Dimensions.Z);
-	uint32 NumberOfFrames = 0;
-	const TArray<FString> FilesInDir = IVolumeLoader::GetFilesInFolder(FolderName, Extension);
-	for (const FString& SliceFileName : FilesInDir)
+	const TArray<const FDICOMFileRecord*> Slices = FolderIndex.GetSeries(SeriesInstanceUID);
+	if (Progress)
 	{
-		DcmFileFormat SliceFormat;
-		if (SliceFormat.loadFile(TCHAR_TO_UTF8(*(FolderName / SliceFileName))).bad())
-		{
-			continue;
-		}
-
-		DcmDataset* SliceDataset = SliceFormat.getDataset();
-		OFString SliceSeriesInstanceUIDOfString;
-		if (SliceDataset->findAndGetOFString(DCM_SeriesInstanceUID, SliceSeriesInstanceUIDOfString).bad())
-		{
-			continue;
-		}
-
-		if (SliceSeriesInstanceUIDOfString != SeriesInstanceUIDOfString)
-		{
-			continue;
-		}
+		Progress->TotalBytes = FullDataSize;
+		Progress->TotalSlices = Slices.Num();
+	}
 
-		const int SliceNumber = GetSliceNumber(SliceDataset);
-		// Slices can be numbered from 0 or 1 (or another, random number?), so always offset from the min slice number instead of 0 or 1.
-		const int SliceOffset = SliceNumber - VolumeInfo.minSliceNumber;
-		
-		if (bCalculateSliceThickness || bVerifySliceThickness)
+	TArray<double> SliceLocations;
+	if (bCalculateSliceThickness || bVerifySliceThickness)
+	{
+		SliceLocations.Reserve(Slices.Num());
+		for (const FDICOMFileRecord* Slice : Slices)
 		{
-			double SliceLocation;
-			if (SliceDataset->findAndGetFloat64(DCM_SliceLocation, SliceLocation).bad())
+			if (!Slice->SliceLocation.IsSet())
 			{
 				UE_LOG(LogDCMTK, Error, TEXT("Error getting Slice Location!"));
 				return nullptr;
 			}
-
-			SliceLocations.Add(SliceLocation);
+			SliceLocations.Add(Slice->SliceLocation.GetValue());
 		}
+	}
+
+	std::atomic<uint32> NumberOfFrames = 0;
+	std::atomic<bool> bFailed = false;
+
+	// Every slice is decoded straight into its place in FullData, so workers never touch the same memory.
+	auto LoadSlice = [&](const FDICOMFileRecord& Slice) {
+		// Slices can be numbered from 0 or 1 (or another, random number?), so always offset from the min slice number instead of 0 or 1.
+		const int SliceOffset = Slice.InstanceNumber - VolumeInfo.minSliceNumber;
 
-		uint32 FragmentIndex = 1;
-		if ((SliceByteSize * (SliceOffset + 1)) > FullDataSize)
+		if (SliceOffset < 0 || (SliceByteSize * (SliceOffset + 1)) > FullDataSize)
 		{
 			UE_LOG(LogTemp, Warning,
 				TEXT("DICOM Loader error when attempting memcpy (SliceNumber * Data exceeds total array length), some data will be "
 					 "missing"));
 		}
-		else if (LoadPixelData(SliceDataset, FullData.Get() + SliceByteSize * SliceOffset, SliceByteSize, 0, &FragmentIndex))
+		else if (!LoadSlicePixelData(
+					 FolderIndex.FolderName / Slice.FileName, Slice, FullData.Get() + SliceByteSize * SliceOffset, SliceByteSize))
 		{
 			UE_LOG(LogDCMTK, Error, TEXT("Error Loading Pixel data from file! JPEG2000 - compressed files require custom licensing."));
-			return nullptr;
+			bFailed = true;
+			return;
 		}
 
 		++NumberOfFrames;
+		if (Progress)
+		{
+			Progress->AddBytesRead(SliceByteSize);
+			Progress->AddSlicesDecoded(1);
+		}
+	};
+
+	// Split the slices into one contiguous chunk per worker. Limiting the worker count is mostly useful for measuring how the
+	// load scales with the number of threads.
+	int32 NumWorkers = 1;
+	if (bParallelDecode)
+	{
+		NumWorkers = MaxDecodeWorkers > 0 ? MaxDecodeWorkers : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	}
+	NumWorkers = FMath::Clamp(NumWorkers, 1, FMath::Max(Slices.Num(), 1));
+	const int32 SlicesPerWorker = FMath::DivideAndRoundUp(Slices.Num(), NumWorkers);
+
+	const double StartTime = FPlatformTime::Seconds();
+	ParallelFor(
+		NumWorkers,
+		[&](int32 WorkerIndex) {
+			const int32 FirstSlice = WorkerIndex * SlicesPerWorker;
+			const int32 LastSlice = FMath::Min(FirstSlice + SlicesPerWorker, Slices.Num());
+			for (int32 SliceIndex = FirstSlice; SliceIndex < LastSlice && !bFailed; ++SliceIndex)
+			{
+				LoadSlice(*Slices[SliceIndex]);
+			}
+		},
+		NumWorkers == 1 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::Unbalanced);
+
+	if (bFailed)
+	{
+		return nullptr;
 	}
 
+	UE_LOG(LogDCMTK, Log, TEXT("Decoded %u DICOM slices using %d workers in %.3f s."), NumberOfFrames.load(), NumWorkers,
+		FPlatformTime::Seconds() - StartTime);
+
 	if (bCalculateSliceThickness || bVerifySliceThickness)
 	{
 		SliceLocations.Sort();
@@ -543,40 +556,39 @@ TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FString& FilePath, const OF
 	return FullData;
 }
 
-TUniquePtr<uint8[]> UDCMTKLoader::LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+TUniquePtr<uint8[]> UDCMTKLoader::LoadAndConvertData(
+	FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat, FVolumeLoadProgress* Progress /*= nullptr*/)
 {
-	DcmFileFormat Format;
-	if (Format.loadFile(TCHAR_TO_UTF8(*FilePath)).bad())
+	FString FolderName, FileNameDummy, Extension;
+	FPaths::Split(FilePath, FolderName, FileNameDummy, Extension);
+
+	const FDICOMFileRecord* Record = GetFolderIndex(FolderName, Extension).FindFile(FilePath);
+	if (Record == nullptr)
 	{
 		UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
 		return nullptr;
 	}
 
-	DcmDataset* Dataset = Format.getDataset();
-
-	int32 NumberOfFrames = 1;
-	OFString NumberOfFramesOfString;
-	if (Dataset->findAndGetOFString(DCM_NumberOfFrames, NumberOfFramesOfString).good())
-	{
-		NumberOfFrames = FCString::Atoi(*FString(UTF8_TO_TCHAR(NumberOfFramesOfString.c_str())));
-	}
-
 	TUniquePtr<uint8[]> Data;
-	if (NumberOfFrames > 1)
-	{
-		Data = LoadMultiFrameDICOM(Dataset, NumberOfFrames, VolumeInfo);
-	}
-	else
+	if (Record->NumberOfFrames > 1)
 	{
-		OFString SeriesInstanceUIDOfString;
-		if (Dataset->findAndGetOFString(DCM_SeriesInstanceUID, SeriesInstanceUIDOfString).bad())
+		DcmFileFormat Format;
+		if (Format.loadFile(TCHAR_TO_UTF8(*FilePath)).bad())
 		{
-			UE_LOG(LogDCMTK, Error, TEXT("Error getting Series Instance UID!"));
+			UE_LOG(LogDCMTK, Error, TEXT("Error loading DICOM image!"));
 			return nullptr;
 		}
-
-		Data = LoadSingleFrameDICOMFolder(FilePath, SeriesInstanceUIDOfString, VolumeInfo, bCalculateSliceThickness,
-			bVerifySliceThickness, bIgnoreIrregularThickness);
+		if (Progress)
+		{
+			Progress->TotalBytes = VolumeInfo.GetByteSize();
+			Progress->TotalSlices = Record->NumberOfFrames;
+		}
+		Data = LoadMultiFrameDICOM(Format.getDataset(), Record->NumberOfFrames, VolumeInfo, Progress);
+	}
+	else
+	{
+		Data = LoadSingleFrameDICOMFolder(FolderIndex, Record->SeriesInstanceUID, VolumeInfo, bCalculateSliceThickness,
+			bVerifySliceThickness, bIgnoreIrregularThickness, bParallelSliceDecode, MaxSliceDecodeWorkers, Progress);
 	}
 
 	if (Data != nullptr)
@@ -0,0 +1,348 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+#include "VolumeAsset/Loaders/DICOMFolderIndex.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "VolumeAsset/Loaders/DCMTKLoader.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+// DCMTK uses their own verify and check macros.
+#pragma push_macro("verify")
+#pragma push_macro("check")
+#undef verify
+#undef check
+
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+
+#pragma pop_macro("verify")
+#pragma pop_macro("check")
+
+#include <atomic>
+
+DECLARE_STATS_GROUP(TEXT("DICOM"), STATGROUP_DICOM, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Index Cache Hits"), STAT_DICOMIndexCacheHits, STATGROUP_DICOM);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Index Cache Misses"), STAT_DICOMIndexCacheMisses, STATGROUP_DICOM);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Index Cache Time Saved (s)"), STAT_DICOMIndexCacheTimeSaved, STATGROUP_DICOM);
+
+// Bump whenever the layout of FDICOMFileRecord serialization changes, old cache files get ignored.
+constexpr int32 DICOMIndexCacheVersion = 1;
+
+int64 FDICOMFileRecord::GetPixelDataByteSize() const
+{
+	return int64(Rows) * Columns * (BitsAllocated / 8) * SamplesPerPixel * FMath::Max(NumberOfFrames, 1);
+}
+
+template <typename T>
+void SerializeOptional(FArchive& Ar, TOptional<T>& Value)
+{
+	bool bIsSet = Value.IsSet();
+	Ar << bIsSet;
+	if (Ar.IsLoading())
+	{
+		Value.Reset();
+		if (bIsSet)
+		{
+			Ar << Value.Emplace();
+		}
+	}
+	else if (bIsSet)
+	{
+		Ar << Value.GetValue();
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FDICOMFileRecord& Record)
+{
+	Ar << Record.FileName;
+	Ar << Record.SeriesInstanceUID;
+	Ar << Record.InstanceNumber;
+	Ar << Record.NumberOfFrames;
+	Ar << Record.Rows;
+	Ar << Record.Columns;
+	Ar << Record.BitsAllocated;
+	Ar << Record.SamplesPerPixel;
+	Ar << Record.PixelRepresentation;
+	SerializeOptional(Ar, Record.PixelSpacing);
+	SerializeOptional(Ar, Record.SliceThickness);
+	SerializeOptional(Ar, Record.SliceLocation);
+	SerializeOptional(Ar, Record.ImagePositionPatient);
+	Ar << Record.PixelDataOffset;
+	Ar << Record.FileSize;
+	Ar << Record.ModificationTime;
+	return Ar;
+}
+
+// Native pixel data is stored as the last element of the file in practically all single-frame series. Check that the element
+// header right in front of where the data would start is the Pixel Data element with a matching length. If it is, the pixel
+// data can be read straight from the file without DCMTK having to parse the file again.
+int64 FindNativePixelDataOffset(const FString& FilePath, int64 PixelDataByteSize)
+{
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FilePath));
+	if (!FileHandle || PixelDataByteSize <= 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Explicit VR : Tag (4 bytes), VR (2 bytes), Reserved (2 bytes), Length (4 bytes).
+	// Implicit VR : Tag (4 bytes), Length (4 bytes).
+	constexpr int64 ElementHeaderSize = 12;
+	const int64 Offset = FileHandle->Size() - PixelDataByteSize;
+	if (Offset < ElementHeaderSize)
+	{
+		return INDEX_NONE;
+	}
+
+	uint8 ElementHeader[ElementHeaderSize];
+	if (!FileHandle->Seek(Offset - ElementHeaderSize) || !FileHandle->Read(ElementHeader, ElementHeaderSize))
+	{
+		return INDEX_NONE;
+	}
+
+	// (7FE0,0010) in little endian.
+	static const uint8 PixelDataTag[4] = {0xE0, 0x7F, 0x10, 0x00};
+	const bool bTagMatches = FMemory::Memcmp(ElementHeader, PixelDataTag, 4) == 0 ||	// Explicit VR
+							 FMemory::Memcmp(ElementHeader + 4, PixelDataTag, 4) == 0;	// Implicit VR
+	const uint32 Length = ElementHeader[8] | (ElementHeader[9] << 8) | (ElementHeader[10] << 16) | (uint32(ElementHeader[11]) << 24);
+
+	return (bTagMatches && Length == PixelDataByteSize) ? Offset : INDEX_NONE;
+}
+
+bool FDICOMFolderIndex::ReadFileRecord(const FString& FilePath, FDICOMFileRecord& OutRecord)
+{
+	// Stop parsing at the pixel data, we only care about the header here.
+	DcmFileFormat Format;
+	if (Format.loadFileUntilTag(TCHAR_TO_UTF8(*FilePath), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect,
+			DCM_PixelData)
+			.bad())
+	{
+		return false;
+	}
+
+	DcmDataset* Dataset = Format.getDataset();
+	OFString SeriesInstanceUIDOfString;
+	if (Dataset == nullptr || Dataset->findAndGetOFString(DCM_SeriesInstanceUID, SeriesInstanceUIDOfString).bad())
+	{
+		return false;
+	}
+
+	OutRecord.FileName = FPaths::GetCleanFilename(FilePath);
+	OutRecord.SeriesInstanceUID = FString(UTF8_TO_TCHAR(SeriesInstanceUIDOfString.c_str()));
+
+	Sint32 IntValue = 0;
+	if (Dataset->findAndGetSint32(DCM_InstanceNumber, IntValue).good())
+	{
+		OutRecord.InstanceNumber = IntValue;
+	}
+	if (Dataset->findAndGetSint32(DCM_NumberOfFrames, IntValue).good())
+	{
+		OutRecord.NumberOfFrames = IntValue;
+	}
+
+	Dataset->findAndGetUint16(DCM_Rows, OutRecord.Rows);
+	Dataset->findAndGetUint16(DCM_Columns, OutRecord.Columns);
+	Dataset->findAndGetUint16(DCM_BitsAllocated, OutRecord.BitsAllocated);
+	Dataset->findAndGetUint16(DCM_SamplesPerPixel, OutRecord.SamplesPerPixel);
+	Dataset->findAndGetUint16(DCM_PixelRepresentation, OutRecord.PixelRepresentation);
+
+	Float64 X = 0, Y = 0, Z = 0;
+	if (Dataset->findAndGetFloat64(DCM_PixelSpacing, X, 0).good())
+	{
+		// Pixel spacing with a single value is square.
+		if (Dataset->findAndGetFloat64(DCM_PixelSpacing, Y, 1).bad())
+		{
+			Y = X;
+		}
+		OutRecord.PixelSpacing = FVector2D(X, Y);
+	}
+	if (Dataset->findAndGetFloat64(DCM_SliceThickness, X).good())
+	{
+		OutRecord.SliceThickness = X;
+	}
+	if (Dataset->findAndGetFloat64(DCM_SliceLocation, X).good())
+	{
+		OutRecord.SliceLocation = X;
+	}
+	if (Dataset->findAndGetFloat64(DCM_ImagePositionPatient, X, 0).good() &&
+		Dataset->findAndGetFloat64(DCM_ImagePositionPatient, Y, 1).good() &&
+		Dataset->findAndGetFloat64(DCM_ImagePositionPatient, Z, 2).good())
+	{
+		OutRecord.ImagePositionPatient = FVector(X, Y, Z);
+	}
+
+	// Only uncompressed little endian data can be copied straight from the file.
+	const E_TransferSyntax TransferSyntax = Dataset->getOriginalXfer();
+	if (TransferSyntax == EXS_LittleEndianImplicit || TransferSyntax == EXS_LittleEndianExplicit)
+	{
+		OutRecord.PixelDataOffset = FindNativePixelDataOffset(FilePath, OutRecord.GetPixelDataByteSize());
+	}
+
+	return true;
+}
+
+FDICOMFolderIndex FDICOMFolderIndex::Build(const FString& FolderName, const FString& Extension, bool bUseCache /*= true*/)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FDICOMFolderIndex Index;
+	Index.FolderName = FolderName;
+	Index.Extension = Extension;
+
+	FDICOMFolderIndex CachedIndex;
+	TMap<FString, const FDICOMFileRecord*> CachedRecords;
+	if (bUseCache && LoadFromCache(FolderName, Extension, CachedIndex))
+	{
+		CachedRecords.Reserve(CachedIndex.Files.Num());
+		for (const FDICOMFileRecord& Record : CachedIndex.Files)
+		{
+			CachedRecords.Add(Record.FileName, &Record);
+		}
+	}
+
+	const TArray<FString> FilesInDir = IVolumeLoader::GetFilesInFolder(FolderName, Extension);
+	Index.Files.SetNum(FilesInDir.Num());
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	std::atomic<int32> CacheHits = 0;
+	std::atomic<int32> CacheMisses = 0;
+	std::atomic<uint64> ReadCycles = 0;
+
+	ParallelFor(FilesInDir.Num(),
+		[&](int32 FileIndex) {
+			const FString FilePath = FolderName / FilesInDir[FileIndex];
+			const FFileStatData StatData = PlatformFile.GetStatData(*FilePath);
+			FDICOMFileRecord& Record = Index.Files[FileIndex];
+
+			const FDICOMFileRecord* const* CachedRecord = CachedRecords.Find(FilesInDir[FileIndex]);
+			if (CachedRecord && (*CachedRecord)->FileSize == StatData.FileSize &&
+				(*CachedRecord)->ModificationTime == StatData.ModificationTime)
+			{
+				Record = **CachedRecord;
+				++CacheHits;
+				return;
+			}
+
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			ReadFileRecord(FilePath, Record);
+			ReadCycles += FPlatformTime::Cycles64() - StartCycles;
+			++CacheMisses;
+
+			// Unreadable files keep just their name, size and time, so that they're recognized as such next time.
+			Record.FileName = FilesInDir[FileIndex];
+			Record.FileSize = StatData.FileSize;
+			Record.ModificationTime = StatData.ModificationTime;
+		});
+
+	Index.CacheHits = CacheHits;
+	Index.CacheMisses = CacheMisses;
+	Index.AverageFileReadSeconds = Index.CacheMisses > 0
+									   ? FPlatformTime::ToSeconds64(ReadCycles) / Index.CacheMisses
+									   : CachedIndex.AverageFileReadSeconds;
+
+	// Save if any file got (re)read or some files were deleted since the last time.
+	if (bUseCache && (Index.CacheMisses > 0 || CachedIndex.Files.Num() != Index.Files.Num()))
+	{
+		Index.SaveToCache();
+	}
+
+	const double TimeSaved = Index.CacheHits * Index.AverageFileReadSeconds;
+	INC_DWORD_STAT_BY(STAT_DICOMIndexCacheHits, Index.CacheHits);
+	INC_DWORD_STAT_BY(STAT_DICOMIndexCacheMisses, Index.CacheMisses);
+	INC_FLOAT_STAT_BY(STAT_DICOMIndexCacheTimeSaved, TimeSaved);
+
+	UE_LOG(LogDCMTK, Log,
+		TEXT("Indexed %d DICOM files in %s in %.3f s. Cache hits : %d, misses : %d, estimated time saved : %.3f s."),
+		Index.Files.Num(), *FolderName, FPlatformTime::Seconds() - StartTime, Index.CacheHits, Index.CacheMisses, TimeSaved);
+
+	return Index;
+}
+
+FString FDICOMFolderIndex::GetCacheFilePath(const FString& FolderName, const FString& Extension)
+{
+	const FString Key = FPaths::ConvertRelativePathToFull(FolderName) + TEXT("|") + Extension;
+	return FPaths::ProjectSavedDir() / TEXT("DICOMIndexCache") / FMD5::HashAnsiString(*Key) + TEXT(".idx");
+}
+
+bool FDICOMFolderIndex::LoadFromCache(const FString& FolderName, const FString& Extension, FDICOMFolderIndex& OutIndex)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetCacheFilePath(FolderName, Extension), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	int32 Version = 0;
+	Reader << Version;
+	if (Version != DICOMIndexCacheVersion)
+	{
+		return false;
+	}
+
+	Reader << OutIndex.FolderName;
+	Reader << OutIndex.Extension;
+	Reader << OutIndex.AverageFileReadSeconds;
+	Reader << OutIndex.Files;
+
+	// Guards against hash collisions and truncated files.
+	if (Reader.IsError() || !OutIndex.IsIndexOf(FolderName, Extension))
+	{
+		UE_LOG(LogDCMTK, Warning, TEXT("Ignoring invalid DICOM index cache %s."), *GetCacheFilePath(FolderName, Extension));
+		OutIndex = FDICOMFolderIndex();
+		return false;
+	}
+	return true;
+}
+
+bool FDICOMFolderIndex::SaveToCache() const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+
+	int32 Version = DICOMIndexCacheVersion;
+	Writer << Version;
+	Writer << const_cast<FString&>(FolderName);
+	Writer << const_cast<FString&>(Extension);
+	Writer << const_cast<double&>(AverageFileReadSeconds);
+	Writer << const_cast<TArray<FDICOMFileRecord>&>(Files);
+
+	const FString CacheFilePath = GetCacheFilePath(FolderName, Extension);
+	if (!FFileHelper::SaveArrayToFile(Bytes, *CacheFilePath))
+	{
+		UE_LOG(LogDCMTK, Warning, TEXT("Failed saving DICOM index cache %s."), *CacheFilePath);
+		return false;
+	}
+	return true;
+}
+
+bool FDICOMFolderIndex::IsIndexOf(const FString& InFolderName, const FString& InExtension) const
+{
+	return FolderName == InFolderName && Extension == InExtension;
+}
+
+const FDICOMFileRecord* FDICOMFolderIndex::FindFile(const FString& FileName) const
+{
+	const FString CleanFileName = FPaths::GetCleanFilename(FileName);
+	return Files.FindByPredicate(
+		[&CleanFileName](const FDICOMFileRecord& Record) { return Record.IsValid() && Record.FileName == CleanFileName; });
+}
+
+TArray<const FDICOMFileRecord*> FDICOMFolderIndex::GetSeries(const FString& SeriesInstanceUID) const
+{
+	TArray<const FDICOMFileRecord*> Series;
+	for (const FDICOMFileRecord& Record : Files)
+	{
+		if (Record.IsValid() && Record.SeriesInstanceUID == SeriesInstanceUID)
+		{
+			Series.Add(&Record);
+		}
+	}
+	Series.Sort([](const FDICOMFileRecord& A, const FDICOMFileRecord& B) { return A.InstanceNumber < B.InstanceNumber; });
+	return Series;
+}
@@ -5,185 +5,599 @@
 
 #include "VolumeAsset/Loaders/MHDLoader.h"
 
+#include "Algo/Find.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
 #include "TextureUtilities.h"
-#include "sstream"
-#include "string"
 
-UMHDLoader* UMHDLoader::Get()
+#include <atomic>
+
+namespace
 {
-	// Maybe get a singleton going on here?
-	return NewObject<UMHDLoader>();
-}
+// MetaIO element types and the voxel formats they get loaded as. 64bit types and vector types aren't supported.
+struct FMetaIOElementType
+{
+	const TCHAR* Name;
+	EVolumeVoxelFormat Format;
+};
+
+const FMetaIOElementType MetaIOElementTypes[] = {
+	{TEXT("MET_CHAR"), EVolumeVoxelFormat::SignedChar},
+	{TEXT("MET_UCHAR"), EVolumeVoxelFormat::UnsignedChar},
+	{TEXT("MET_SHORT"), EVolumeVoxelFormat::SignedShort},
+	{TEXT("MET_USHORT"), EVolumeVoxelFormat::UnsignedShort},
+	{TEXT("MET_INT"), EVolumeVoxelFormat::SignedInt},
+	{TEXT("MET_UINT"), EVolumeVoxelFormat::UnsignedInt},
+	{TEXT("MET_FLOAT"), EVolumeVoxelFormat::Float},
+};
+
+enum class EMetaIOParseResult
+{
+	Parsed,
+	// The header continues past the bytes that were provided.
+	NeedMoreData,
+	Failed
+};
 
-FVolumeInfo UMHDLoader::ParseVolumeInfoFromHeader(FString FileName)
+FString MetaIOBytesToString(const uint8* Bytes, const int64 ByteCount)
 {
-	// #TODO UE probably has a nicer string parser than istringstream...
-	// And the way I'm doing this is the ugliest you could imagine.
-	// But hey, this is probably literally the first C++ code I ever wrote in Unreal, so I'm keeping it this way, so
-	// I can look at it and shed a tear of remembering the sweet, sweet days of yesteryear.
+	FUTF8ToTCHAR Converter(reinterpret_cast<const ANSICHAR*>(Bytes), static_cast<int32>(ByteCount));
+	return FString(Converter.Length(), Converter.Get());
+}
 
-	FString FileString = IVolumeLoader::ReadFileAsString(FileName);
+// Parses the first Count numbers of a MetaIO array value ("DimSize = 512 512 300"). Returns false if there are fewer of them or any
+// of them isn't a number.
+bool ParseMetaIONumbers(const TArray<FString>& Tokens, const int32 Count, TArray<double>& OutNumbers)
+{
+	if (Tokens.Num() < Count)
+	{
+		return false;
+	}
+	OutNumbers.SetNumUninitialized(Count);
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		TCHAR* End = nullptr;
+		OutNumbers[Index] = FCString::Strtod(*Tokens[Index], &End);
+		if (End == *Tokens[Index] || *End != 0 || !FMath::IsFinite(OutNumbers[Index]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	FVolumeInfo OutVolumeInfo;
-	OutVolumeInfo.bParseWasSuccessful = false;
+// Expands a slice file name pattern with a single printf-style integer conversion, e.g. "slice%03d.raw".
+bool FormatMetaIOSliceName(const FString& Pattern, const int32 Number, FString& OutName)
+{
+	const int32 Percent = Pattern.Find(TEXT("%"));
+	if (Percent == INDEX_NONE)
+	{
+		return false;
+	}
+	int32 Position = Percent + 1;
+	const bool bZeroPadded = Position < Pattern.Len() && Pattern[Position] == '0';
+	int32 Width = 0;
+	while (Position < Pattern.Len() && FChar::IsDigit(Pattern[Position]))
+	{
+		Width = FMath::Min(Width * 10 + (Pattern[Position] - '0'), 100);
+		Position++;
+	}
+	if (Position >= Pattern.Len() || Pattern[Position] != 'd' || Width > 32)
+	{
+		return false;
+	}
 
-	// #TODO stop being sentimental and use FConsole::Parse()
+	FString Digits = FString::FromInt(Number);
+	if (Digits.Len() < Width)
 	{
-		std::string MyStdString(TCHAR_TO_UTF8(*FileString));
-		std::istringstream inStream = std::istringstream(MyStdString);
+		Digits = FString::ChrN(Width - Digits.Len(), bZeroPadded ? '0' : ' ') + Digits;
+	}
+	OutName = Pattern.Left(Percent) + Digits + Pattern.Mid(Position + 1);
+	return true;
+}
 
-		std::string ReadWord;
+FString ResolveMetaIODataPath(const FString& HeaderPath, const FString& DataFile)
+{
+	return FPaths::ConvertRelativePathToFull(
+		FPaths::IsRelative(DataFile) ? FPaths::Combine(FPaths::GetPath(HeaderPath), DataFile) : DataFile);
+}
 
-		// Skip until we get to Dimensions.
-		while (inStream.good() && ReadWord != "DimSize")
+// Tokenizes a MetaIO header in a single pass over its lines. Every line is a "Key = Value" pair, keys can come in any order, except
+// ElementDataFile, which ends the header. For "ElementDataFile = LOCAL", the voxels start right after that line, for LIST, the
+// rest of the file lists the slice files.
+// If bEndOfFile is false, Bytes is only the start of the file and NeedMoreData gets returned if the header doesn't end within it.
+// Doesn't touch the disk, so HeaderSize = -1 isn't resolved to an offset.
+EMetaIOParseResult ParseMetaIOHeaderBytes(
+	const uint8* Bytes, const int64 ByteCount, const bool bEndOfFile, const FString& HeaderPath, FMHDHeader& OutHeader)
+{
+	OutHeader = FMHDHeader();
+	FVolumeInfo& Info = OutHeader.VolumeInfo;
+	Info.bParseWasSuccessful = false;
+
+	FString ObjectType;
+	FString ElementType;
+	int32 NDims = 0;
+	int32 ChannelCount = 1;
+	bool bBinaryData = true;
+	bool bBigEndian = false;
+	bool bHasCompressedData = false;
+	TArray<FString> DimSize, ElementSpacing, ElementSize, Offset, TransformMatrix;
+
+	bool bFoundDataFile = false;
+	TArray<FString> DataFileTokens;
+	TArray<FString> ListedSliceFiles;
+	int64 DataStart = 0;
+
+	int64 Position = 0;
+	while (Position < ByteCount && !bFoundDataFile)
+	{
+		int64 LineEnd = Position;
+		while (LineEnd < ByteCount && Bytes[LineEnd] != '\n')
 		{
-			inStream >> ReadWord;
+			LineEnd++;
 		}
-		// Should be at the "=" after DimSize now.
-		if (inStream.good())
+		if (LineEnd == ByteCount && !bEndOfFile)
 		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-			// Read the three values;
-			inStream >> OutVolumeInfo.Dimensions.X;
-			inStream >> OutVolumeInfo.Dimensions.Y;
-			inStream >> OutVolumeInfo.Dimensions.Z;
+			return EMetaIOParseResult::NeedMoreData;
 		}
-		else
+		const FString Line = MetaIOBytesToString(Bytes + Position, LineEnd - Position);
+		Position = FMath::Min(LineEnd + 1, ByteCount);
+
+		FString Key, Value;
+		if (!Line.Split(TEXT("="), &Key, &Value))
 		{
-			return OutVolumeInfo;
+			if (!Line.TrimStartAndEnd().IsEmpty())
+			{
+				UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed MetaIO header line \"%s\" in %s."), *Line, *HeaderPath);
+			}
+			continue;
 		}
+		Key.TrimStartAndEndInline();
+		Value.TrimStartAndEndInline();
 
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to spacing.
-		while (inStream.good() && ReadWord != "ElementSpacing" && ReadWord != "ElementSize")
+		// FString comparisons are case insensitive, which is a bit more lenient than MetaIO itself.
+		if (Key == TEXT("ElementDataFile"))
+		{
+			bFoundDataFile = true;
+			DataStart = Position;
+			Value.ParseIntoArrayWS(DataFileTokens);
+			if (DataFileTokens.Num() > 0 && DataFileTokens[0] == TEXT("LIST"))
+			{
+				// The slice files are listed on the lines that follow, up to the end of the file.
+				if (!bEndOfFile)
+				{
+					return EMetaIOParseResult::NeedMoreData;
+				}
+				MetaIOBytesToString(Bytes + Position, ByteCount - Position).ParseIntoArrayWS(ListedSliceFiles);
+			}
+			else if (DataFileTokens.Num() > 0 && DataFileTokens[0] != TEXT("LOCAL") && !Value.Contains(TEXT("%")))
+			{
+				// A single file name, which can contain spaces.
+				DataFileTokens = {Value};
+			}
+		}
+		else if (Key == TEXT("ObjectType"))
 		{
-			inStream >> ReadWord;
+			ObjectType = Value;
 		}
-		// Should be at the "=" after ElementSpacing/ElementSize now.
-		if (inStream.good())
+		else if (Key == TEXT("NDims"))
 		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-			// Read the three values;
-			inStream >> OutVolumeInfo.Spacing.X;
-			inStream >> OutVolumeInfo.Spacing.Y;
-			inStream >> OutVolumeInfo.Spacing.Z;
-
-			OutVolumeInfo.WorldDimensions = OutVolumeInfo.Spacing * FVector(OutVolumeInfo.Dimensions);
+			NDims = FCString::Atoi(*Value);
 		}
-		else
+		else if (Key == TEXT("DimSize"))
+		{
+			Value.ParseIntoArrayWS(DimSize);
+		}
+		else if (Key == TEXT("ElementSpacing"))
+		{
+			Value.ParseIntoArrayWS(ElementSpacing);
+		}
+		else if (Key == TEXT("ElementSize"))
+		{
+			Value.ParseIntoArrayWS(ElementSize);
+		}
+		else if (Key == TEXT("Offset") || Key == TEXT("Position") || Key == TEXT("Origin"))
+		{
+			Value.ParseIntoArrayWS(Offset);
+		}
+		else if (Key == TEXT("TransformMatrix") || Key == TEXT("Rotation") || Key == TEXT("Orientation"))
+		{
+			Value.ParseIntoArrayWS(TransformMatrix);
+		}
+		else if (Key == TEXT("ElementType"))
+		{
+			ElementType = Value;
+		}
+		else if (Key == TEXT("ElementNumberOfChannels"))
+		{
+			ChannelCount = FCString::Atoi(*Value);
+		}
+		else if (Key == TEXT("HeaderSize"))
 		{
-			return OutVolumeInfo;
+			OutHeader.HeaderSize = FCString::Atoi64(*Value);
 		}
+		else if (Key == TEXT("BinaryData"))
+		{
+			bBinaryData = FCString::ToBool(*Value);
+		}
+		else if (Key == TEXT("BinaryDataByteOrderMSB") || Key == TEXT("ElementByteOrderMSB"))
+		{
+			bBigEndian = FCString::ToBool(*Value);
+		}
+		else if (Key == TEXT("CompressedData"))
+		{
+			Info.bIsCompressed = FCString::ToBool(*Value);
+			bHasCompressedData = true;
+		}
+		else if (Key == TEXT("CompressedDataSize"))
+		{
+			Info.CompressedByteSize = FMath::Max<int64>(FCString::Atoi64(*Value), 0);
+		}
+	}
 
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "ElementType")
+	if (!bFoundDataFile)
+	{
+		if (!bEndOfFile)
 		{
-			inStream >> ReadWord;
+			return EMetaIOParseResult::NeedMoreData;
 		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has no ElementDataFile."), *HeaderPath);
+		return EMetaIOParseResult::Failed;
+	}
+
+	if (!ObjectType.IsEmpty() && ObjectType != TEXT("Image"))
+	{
+		UE_LOG(
+			LogVolumeLoader, Error, TEXT("MetaIO header %s describes a %s, only images are supported."), *HeaderPath, *ObjectType);
+		return EMetaIOParseResult::Failed;
+	}
+	if (NDims == 0)
+	{
+		NDims = DimSize.Num();
+	}
+	TArray<double> Numbers;
+	if ((NDims != 2 && NDims != 3) || !ParseMetaIONumbers(DimSize, NDims, Numbers))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has NDims %d with DimSize \"%s\", only 2D and 3D images are ")
+			TEXT("supported."), *HeaderPath, NDims, *FString::Join(DimSize, TEXT(" ")));
+		return EMetaIOParseResult::Failed;
+	}
+	Info.Dimensions = FIntVector(1);
+	for (int32 Axis = 0; Axis < NDims; Axis++)
+	{
+		if (Numbers[Axis] < 1 || Numbers[Axis] > MAX_int32 || Numbers[Axis] != FMath::FloorToDouble(Numbers[Axis]))
 		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
+			UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has invalid DimSize %s."), *HeaderPath, *DimSize[Axis]);
+			return EMetaIOParseResult::Failed;
+		}
+		Info.Dimensions[Axis] = static_cast<int32>(Numbers[Axis]);
+	}
 
-			inStream >> ReadWord;
-			if (ReadWord == "MET_UCHAR")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedChar;
-			}
-			else if (ReadWord == "MET_CHAR")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedChar;
-			}
+	const FMetaIOElementType* Type = Algo::FindByPredicate(
+		MetaIOElementTypes, [&ElementType](const FMetaIOElementType& Candidate) { return ElementType == Candidate.Name; });
+	if (!Type)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has unsupported ElementType \"%s\"."), *HeaderPath, *ElementType);
+		return EMetaIOParseResult::Failed;
+	}
+	Info.OriginalFormat = Type->Format;
+	Info.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(Info.OriginalFormat);
+	Info.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(Info.OriginalFormat);
+	// The byte order only matters for multi-byte voxels.
+	Info.bIsBigEndian = bBigEndian && Info.BytesPerVoxel > 1;
 
-			else if (ReadWord == "MET_USHORT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedShort;
-			}
-			else if (ReadWord == "MET_SHORT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedShort;
-			}
-			else if (ReadWord == "MET_UINT")
-			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::UnsignedInt;
-			}
-			else if (ReadWord == "MET_INT")
+	if (double(Info.Dimensions.X) * Info.Dimensions.Y * Info.Dimensions.Z * Info.BytesPerVoxel > double(MAX_int64 / 2))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s describes an impossibly large image."), *HeaderPath);
+		return EMetaIOParseResult::Failed;
+	}
+	if (ChannelCount != 1)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has %d channels, only single channel images are supported."),
+			*HeaderPath, ChannelCount);
+		return EMetaIOParseResult::Failed;
+	}
+	if (!bBinaryData)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has ASCII data, only binary data is supported."), *HeaderPath);
+		return EMetaIOParseResult::Failed;
+	}
+	if (OutHeader.HeaderSize < -1)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has invalid HeaderSize %lld."), *HeaderPath, OutHeader.HeaderSize);
+		return EMetaIOParseResult::Failed;
+	}
+	// CompressedDataSize is optional, CompressedData is what says whether the data is compressed. Old writers only wrote the size.
+	if (!bHasCompressedData)
+	{
+		Info.bIsCompressed = Info.CompressedByteSize > 0;
+	}
+
+	// Missing spacing, origin and orientation keep their defaults. ElementSize is the voxel size, only used if there's no spacing.
+	Info.Spacing = FVector(1, 1, 1);
+	const TArray<FString>& SpacingTokens = ElementSpacing.Num() > 0 ? ElementSpacing : ElementSize;
+	if (SpacingTokens.Num() > 0)
+	{
+		if (ParseMetaIONumbers(SpacingTokens, NDims, Numbers))
+		{
+			for (int32 Axis = 0; Axis < NDims; Axis++)
 			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::SignedInt;
+				Info.Spacing[Axis] = Numbers[Axis] > 0 ? Numbers[Axis] : 1.0;
 			}
-			else if (ReadWord == "MET_FLOAT")
+		}
+		else
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed MetaIO spacing \"%s\" in %s."),
+				*FString::Join(SpacingTokens, TEXT(" ")), *HeaderPath);
+		}
+	}
+	Info.WorldDimensions = Info.Spacing * FVector(Info.Dimensions);
+
+	if (Offset.Num() > 0)
+	{
+		if (ParseMetaIONumbers(Offset, NDims, Numbers))
+		{
+			for (int32 Axis = 0; Axis < NDims; Axis++)
 			{
-				OutVolumeInfo.OriginalFormat = EVolumeVoxelFormat::Float;
+				Info.Origin[Axis] = Numbers[Axis];
 			}
-			else
+		}
+		else
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed MetaIO offset \"%s\" in %s."),
+				*FString::Join(Offset, TEXT(" ")), *HeaderPath);
+		}
+	}
+
+	// MetaIO (and ITK) write the direction of every axis as a row of the matrix, in LPS - same as our Direction.
+	if (TransformMatrix.Num() > 0)
+	{
+		if (ParseMetaIONumbers(TransformMatrix, NDims * NDims, Numbers))
+		{
+			for (int32 Axis = 0; Axis < NDims; Axis++)
 			{
-				return OutVolumeInfo;
+				FVector AxisVector(0, 0, 0);
+				for (int32 Component = 0; Component < NDims; Component++)
+				{
+					AxisVector[Component] = Numbers[Axis * NDims + Component];
+				}
+				if (AxisVector.Normalize())
+				{
+					Info.Direction.SetAxis(Axis, AxisVector);
+				}
 			}
 		}
 		else
 		{
-			return OutVolumeInfo;
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed MetaIO TransformMatrix \"%s\" in %s."),
+				*FString::Join(TransformMatrix, TEXT(" ")), *HeaderPath);
 		}
+	}
 
-		OutVolumeInfo.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(OutVolumeInfo.OriginalFormat);
-		OutVolumeInfo.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(OutVolumeInfo.OriginalFormat);
+	// Where the voxels are: attached, in a single data file, or one slice per file.
+	if (DataFileTokens.Num() == 0)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has an empty ElementDataFile."), *HeaderPath);
+		return EMetaIOParseResult::Failed;
+	}
+	const FString& DataFile = DataFileTokens[0];
+	const bool bIsList = DataFile == TEXT("LIST");
+	const bool bIsPattern = DataFile.Contains(TEXT("%"));
+	if (bIsList || bIsPattern)
+	{
+		// "LIST 2D" says every file holds a 2D slice, which is the default for 3D images. Nothing else is supported.
+		const int32 FileDimensions = bIsList && DataFileTokens.Num() > 1 ? FCString::Atoi(*DataFileTokens[1]) : NDims - 1;
+		if (NDims != 3 || FileDimensions != 2 || Info.bIsCompressed)
+		{
+			UE_LOG(LogVolumeLoader, Error,
+				TEXT("MetaIO header %s splits its data into files in an unsupported way, only uncompressed 2D slices of a 3D ")
+				TEXT("image are supported."),
+				*HeaderPath);
+			return EMetaIOParseResult::Failed;
+		}
 
-		// Check for compressed data size tag.
+		if (bIsList)
+		{
+			OutHeader.SliceFilePaths = MoveTemp(ListedSliceFiles);
+		}
+		else
+		{
+			// "<pattern> <first> <last> <step>", e.g. "slice%03d.raw 1 300 1".
+			TArray<FString> RangeTokens(DataFileTokens.GetData() + 1, DataFileTokens.Num() - 1);
+			if (!ParseMetaIONumbers(RangeTokens, 3, Numbers) || Numbers[2] == 0 || (Numbers[1] - Numbers[0]) / Numbers[2] < 0 ||
+				(Numbers[1] - Numbers[0]) / Numbers[2] + 1 != Info.Dimensions.Z)
+			{
+				UE_LOG(LogVolumeLoader, Error,
+					TEXT("MetaIO header %s has a slice file pattern \"%s\" that doesn't match its DimSize."), *HeaderPath,
+					*FString::Join(DataFileTokens, TEXT(" ")));
+				return EMetaIOParseResult::Failed;
+			}
+			for (int32 Slice = 0; Slice < Info.Dimensions.Z; Slice++)
+			{
+				FString SliceFile;
+				if (!FormatMetaIOSliceName(DataFile, static_cast<int32>(Numbers[0] + Slice * Numbers[2]), SliceFile))
+				{
+					UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has an unsupported slice file pattern \"%s\"."),
+						*HeaderPath, *DataFile);
+					return EMetaIOParseResult::Failed;
+				}
+				OutHeader.SliceFilePaths.Add(MoveTemp(SliceFile));
+			}
+		}
 
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "CompressedDataSize")
+		if (OutHeader.SliceFilePaths.Num() != Info.Dimensions.Z)
 		{
-			inStream >> ReadWord;
+			UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s lists %d slice files for %d slices."), *HeaderPath,
+				OutHeader.SliceFilePaths.Num(), Info.Dimensions.Z);
+			return EMetaIOParseResult::Failed;
 		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
+		for (FString& SlicePath : OutHeader.SliceFilePaths)
+		{
+			SlicePath = ResolveMetaIODataPath(HeaderPath, SlicePath);
+		}
+		Info.DataFileName = FPaths::GetCleanFilename(OutHeader.SliceFilePaths[0]);
+		Info.DataFileOffset = 0;
+	}
+	else
+	{
+		const bool bIsLocal = DataFile == TEXT("LOCAL");
+		OutHeader.DataFilePath = bIsLocal ? HeaderPath : ResolveMetaIODataPath(HeaderPath, DataFile);
+		Info.DataFileName = FPaths::GetCleanFilename(OutHeader.DataFilePath);
+		// HeaderSize counts from the start of the data, which for attached data is the end of the header.
+		Info.DataFileOffset = (bIsLocal ? DataStart : 0) + FMath::Max<int64>(OutHeader.HeaderSize, 0);
+	}
+	return EMetaIOParseResult::Parsed;
+}
+
+// Reads the slices of a slice-per-file data set straight into their place in the volume. The slices are independent files, so
+// they get read in parallel.
+TUniquePtr<uint8[]> LoadMetaIOSliceFiles(const FMHDHeader& Header, FVolumeLoadProgress* Progress)
+{
+	const FVolumeInfo& Info = Header.VolumeInfo;
+	const int64 SliceByteSize = int64(Info.Dimensions.X) * Info.Dimensions.Y * Info.BytesPerVoxel;
+	if (Progress)
+	{
+		Progress->TotalBytes = Info.GetByteSize();
+	}
+
+	TUniquePtr<uint8[]> LoadedArray(new uint8[Info.GetByteSize()]);
+	std::atomic<int32> FailedSlices{0};
+	ParallelFor(Header.SliceFilePaths.Num(),
+		[&](int32 Slice)
 		{
-			OutVolumeInfo.bIsCompressed = true;
+			const FString& SlicePath = Header.SliceFilePaths[Slice];
+			TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*SlicePath));
+			const int64 FileSize = FileHandle ? FileHandle->Size() : 0;
+			const int64 SliceOffset = Header.HeaderSize == -1 ? FileSize - SliceByteSize : Header.HeaderSize;
+			if (!FileHandle || SliceOffset < 0 || SliceOffset + SliceByteSize > FileSize || !FileHandle->Seek(SliceOffset) ||
+				!FileHandle->Read(LoadedArray.Get() + Slice * SliceByteSize, SliceByteSize))
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO slice file %s is missing or too small."), *SlicePath);
+				FailedSlices++;
+				return;
+			}
+			if (Progress)
+			{
+				Progress->AddBytesRead(SliceByteSize);
+			}
+		});
+	return FailedSlices == 0 ? MoveTemp(LoadedArray) : nullptr;
+}
+}	 // namespace
+
+UMHDLoader* UMHDLoader::Get()
+{
+	// Maybe get a singleton going on here?
+	return NewObject<UMHDLoader>();
+}
 
-			// Get rid of equal sign.
-			inStream >> ReadWord;
+bool UMHDLoader::ParseHeader(const FString& FileName, FMHDHeader& OutHeader)
+{
+	OutHeader = FMHDHeader();
+	OutHeader.VolumeInfo.bParseWasSuccessful = false;
 
-			inStream >> OutVolumeInfo.CompressedByteSize;
-		}
+	// Same as the other loaders, accept paths relative to the content folder.
+	FString HeaderPath = FileName;
+	if (!FPaths::FileExists(HeaderPath))
+	{
+		HeaderPath = FPaths::ProjectContentDir() + FileName;
+	}
+	HeaderPath = FPaths::ConvertRelativePathToFull(HeaderPath);
+
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*HeaderPath));
+	if (!FileHandle)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO file %s could not be opened."), *HeaderPath);
+		return false;
+	}
 
-		// Go back to beginning
-		inStream = std::istringstream(MyStdString);
-		// Skip until we get to ElementType
-		while (inStream.good() && ReadWord != "ElementDataFile")
+	// Attached data can be gigabytes large, so only the first block gets read. Headers that don't fit into it (long slice lists)
+	// get read once more, up to MaxHeaderSize.
+	constexpr int64 FirstBlockSize = 64 * 1024;
+	constexpr int64 MaxHeaderSize = 16 * 1024 * 1024;
+	const int64 FileSize = FileHandle->Size();
+	TArray<uint8> HeaderBytes;
+	EMetaIOParseResult Result = EMetaIOParseResult::NeedMoreData;
+	for (int64 ReadSize = FirstBlockSize; Result == EMetaIOParseResult::NeedMoreData; ReadSize = MaxHeaderSize)
+	{
+		const int64 TotalSize = FMath::Min(ReadSize, FileSize);
+		const int32 OldNum = HeaderBytes.Num();
+		if (TotalSize <= OldNum)
 		{
-			inStream >> ReadWord;
+			UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s is larger than %lld bytes."), *HeaderPath, MaxHeaderSize);
+			return false;
 		}
-		// Should be at the "=" after ElementType now.
-		if (inStream.good())
+		HeaderBytes.AddUninitialized(static_cast<int32>(TotalSize - OldNum));
+		if (!FileHandle->Read(HeaderBytes.GetData() + OldNum, TotalSize - OldNum))
 		{
-			// Get rid of equal sign.
-			inStream >> ReadWord;
-
-			inStream >> ReadWord;
+			UE_LOG(LogVolumeLoader, Error, TEXT("Failed reading MetaIO file %s."), *HeaderPath);
+			return false;
 		}
-		else
+		Result = ParseMetaIOHeaderBytes(HeaderBytes.GetData(), HeaderBytes.Num(), TotalSize == FileSize, HeaderPath, OutHeader);
+	}
+	if (Result != EMetaIOParseResult::Parsed)
+	{
+		return false;
+	}
+
+	FVolumeInfo& Info = OutHeader.VolumeInfo;
+	if (!OutHeader.IsSliceList() && OutHeader.HeaderSize == -1)
+	{
+		// The data is at the very end of the file. For compressed data, that needs CompressedDataSize.
+		const int64 DataFileSize = OutHeader.DataFilePath == HeaderPath
+									   ? FileSize
+									   : FPlatformFileManager::Get().GetPlatformFile().FileSize(*OutHeader.DataFilePath);
+		const int64 DataSize = Info.bIsCompressed ? Info.CompressedByteSize : Info.GetByteSize();
+		Info.DataFileOffset = DataFileSize - DataSize;
+		if (DataSize <= 0 || Info.DataFileOffset < 0)
 		{
-			return OutVolumeInfo;
+			UE_LOG(LogVolumeLoader, Error, TEXT("MetaIO header %s has HeaderSize = -1, but the data size of %s isn't known."),
+				*HeaderPath, *OutHeader.DataFilePath);
+			return false;
 		}
-		OutVolumeInfo.DataFileName = FString(ReadWord.c_str());
-		OutVolumeInfo.bParseWasSuccessful = true;
-		// Return with constructor that sets success to true.
-		return OutVolumeInfo;
 	}
+	Info.bParseWasSuccessful = true;
+	return true;
+}
+
+bool UMHDLoader::ParseHeaderText(const FString& HeaderText, const FString& HeaderPath, FMHDHeader& OutHeader)
+{
+	const FTCHARToUTF8 HeaderUTF8(*HeaderText);
+	const bool bParsed = ParseMetaIOHeaderBytes(reinterpret_cast<const uint8*>(HeaderUTF8.Get()), HeaderUTF8.Length(), true,
+							 HeaderPath, OutHeader) == EMetaIOParseResult::Parsed;
+	OutHeader.VolumeInfo.bParseWasSuccessful = bParsed;
+	return bParsed;
+}
+
+FVolumeInfo UMHDLoader::ParseVolumeInfoFromHeader(FString FileName)
+{
+	FMHDHeader Header;
+	ParseHeader(FileName, Header);
+	return Header.VolumeInfo;
+}
+
+TUniquePtr<uint8[]> UMHDLoader::LoadAndConvertMHDData(const FMHDHeader& Header, FVolumeInfo& OutVolumeInfo, bool bNormalize,
+	bool bConvertToFloat, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	OutVolumeInfo = Header.VolumeInfo;
+	if (!Header.IsSliceList())
+	{
+		return LoadAndConvertData(FPaths::GetPath(Header.DataFilePath), OutVolumeInfo, bNormalize, bConvertToFloat, Progress);
+	}
+
+	TUniquePtr<uint8[]> LoadedArray = LoadMetaIOSliceFiles(Header, Progress);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
+	return ConvertData(MoveTemp(LoadedArray), OutVolumeInfo, bNormalize, bConvertToFloat);
 }
 
 UVolumeAsset* UMHDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
 {
-	FVolumeInfo VolumeInfo = ParseVolumeInfoFromHeader(FileName);
-	if (!VolumeInfo.bParseWasSuccessful)
+	FMHDHeader Header;
+	if (!ParseHeader(FileName, Header))
 	{
 		return nullptr;
 	}
@@ -198,15 +612,23 @@ UVolumeAsset* UMHDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize
 		return nullptr;
 	}
 
-	// Perform complete load and conversion of data.
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
-
-	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
-	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
+	// Convert straight from the memory mapped raw file into the texture if possible, otherwise load the data into memory first.
+	// Slices in separate files always get loaded.
+	FVolumeInfo VolumeInfo = Header.VolumeInfo;
+	if (Header.IsSliceList() ||
+		!LoadMappedDataIntoTransientTexture(
+			FPaths::GetPath(Header.DataFilePath), VolumeInfo, bNormalize, bConvertToFloat, OutAsset->DataTexture))
+	{
+		// Perform complete load and conversion of data.
+		TUniquePtr<uint8[]> LoadedArray = LoadAndConvertMHDData(Header, VolumeInfo, bNormalize, bConvertToFloat);
+		if (LoadedArray == nullptr)
+		{
+			return nullptr;
+		}
 
-	// Create the transient Volume texture.
-	UVolumeTextureToolkit::CreateVolumeTextureTransient(
-		OutAsset->DataTexture, PixelFormat, VolumeInfo.Dimensions, LoadedArray.Get());
+		// Create the transient Volume texture (or the bricks, for volumes too large for a single texture).
+		CreateTransientTextures(OutAsset, VolumeInfo, LoadedArray.Get());
+	}
 
 	// Check that the texture got created properly.
 	if (OutAsset->DataTexture)
@@ -220,11 +642,49 @@ UVolumeAsset* UMHDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize
 	}
 }
 
+TUniquePtr<uint8[]> UMHDLoader::LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+	FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	FMHDHeader Header;
+	if (!ParseHeader(FileName, Header))
+	{
+		OutVolumeInfo = Header.VolumeInfo;
+		return nullptr;
+	}
+	// Get valid package name and filepath.
+	FString FilePath;
+	GetValidPackageNameFromFileName(FileName, FilePath, OutVolumeName);
+
+	return LoadAndConvertMHDData(Header, OutVolumeInfo, bNormalize, bConvertToFloat, Progress);
+}
+
+FTexture2DMipMap* UMHDLoader::LoadMappedVolumeMip(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+	FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	// Slices in separate files always get loaded.
+	FMHDHeader Header;
+	if (!ParseHeader(FileName, Header) || Header.IsSliceList())
+	{
+		return nullptr;
+	}
+
+	FVolumeInfo VolumeInfo = Header.VolumeInfo;
+	FTexture2DMipMap* Mip =
+		LoadMappedDataIntoMip(FPaths::GetPath(Header.DataFilePath), VolumeInfo, bNormalize, bConvertToFloat, Progress);
+	if (Mip)
+	{
+		OutVolumeInfo = VolumeInfo;
+		FString FilePath;
+		GetValidPackageNameFromFileName(FileName, FilePath, OutVolumeName);
+	}
+	return Mip;
+}
+
 UVolumeAsset* UMHDLoader::CreatePersistentVolumeFromFile(
 	const FString& FileName, const FString& OutFolder, bool bNormalize /*= true*/)
 {
-	FVolumeInfo VolumeInfo = ParseVolumeInfoFromHeader(FileName);
-	if (!VolumeInfo.bParseWasSuccessful)
+	FMHDHeader Header;
+	if (!ParseHeader(FileName, Header))
 	{
 		return nullptr;
 	}
@@ -239,17 +699,15 @@ UVolumeAsset* UMHDLoader::CreatePersistentVolumeFromFile(
 		return nullptr;
 	}
 
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, false);
-	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
-
-	// Create the persistent volume texture.
-	FString VolumeTextureName = "VA_" + VolumeName + "_Data";
-	UVolumeTextureToolkit::CreateVolumeTextureAsset(
-		OutAsset->DataTexture, VolumeTextureName, OutFolder, PixelFormat, VolumeInfo.Dimensions, LoadedArray.Get(), true);
-	OutAsset->ImageInfo = VolumeInfo;
+	FVolumeInfo VolumeInfo;
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertMHDData(Header, VolumeInfo, bNormalize, false);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
 
-	// Check that the texture got created properly.
-	if (OutAsset->DataTexture)
+	// Create the persistent volume textures.
+	if (CreatePersistentTextures(OutAsset, VolumeName, OutFolder, VolumeInfo, LoadedArray.Get()))
 	{
 		OutAsset->ImageInfo = VolumeInfo;
 		return OutAsset;
@@ -263,8 +721,8 @@ UVolumeAsset* UMHDLoader::CreatePersistentVolumeFromFile(
 UVolumeAsset* UMHDLoader::CreateVolumeFromFileInExistingPackage(
 	FString FileName, UObject* ParentPackage, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
 {
-	FVolumeInfo VolumeInfo = ParseVolumeInfoFromHeader(FileName);
-	if (!VolumeInfo.bParseWasSuccessful)
+	FMHDHeader Header;
+	if (!ParseHeader(FileName, Header))
 	{
 		return nullptr;
 	}
@@ -280,7 +738,12 @@ UVolumeAsset* UMHDLoader::CreateVolumeFromFileInExistingPackage(
 	}
 
 	// Perform complete load and conversion of data.
-	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertData(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	FVolumeInfo VolumeInfo;
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertMHDData(Header, VolumeInfo, bNormalize, bConvertToFloat);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
 
 	// Get proper pixel format depending on what got saved into the MHDInfo during conversion.
 	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
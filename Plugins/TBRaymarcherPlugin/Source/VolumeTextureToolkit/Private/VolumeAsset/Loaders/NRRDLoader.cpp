@@ -0,0 +1,809 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "VolumeAsset/Loaders/NRRDLoader.h"
+
+#include "Algo/Find.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "TextureUtilities.h"
+#include "VoxelKernels.h"
+
+namespace
+{
+// Scalar type names allowed in the NRRD "type" field and what they get loaded as.
+struct FNRRDTypeName
+{
+	const TCHAR* Name;
+	EVolumeVoxelFormat Format;
+	ENRRDWideType WideType;
+};
+
+const FNRRDTypeName NRRDTypeNames[] = {
+	{TEXT("signed char"), EVolumeVoxelFormat::SignedChar, ENRRDWideType::None},
+	{TEXT("int8"), EVolumeVoxelFormat::SignedChar, ENRRDWideType::None},
+	{TEXT("int8_t"), EVolumeVoxelFormat::SignedChar, ENRRDWideType::None},
+	{TEXT("uchar"), EVolumeVoxelFormat::UnsignedChar, ENRRDWideType::None},
+	{TEXT("unsigned char"), EVolumeVoxelFormat::UnsignedChar, ENRRDWideType::None},
+	{TEXT("uint8"), EVolumeVoxelFormat::UnsignedChar, ENRRDWideType::None},
+	{TEXT("uint8_t"), EVolumeVoxelFormat::UnsignedChar, ENRRDWideType::None},
+	{TEXT("short"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("short int"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("signed short"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("signed short int"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("int16"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("int16_t"), EVolumeVoxelFormat::SignedShort, ENRRDWideType::None},
+	{TEXT("ushort"), EVolumeVoxelFormat::UnsignedShort, ENRRDWideType::None},
+	{TEXT("unsigned short"), EVolumeVoxelFormat::UnsignedShort, ENRRDWideType::None},
+	{TEXT("unsigned short int"), EVolumeVoxelFormat::UnsignedShort, ENRRDWideType::None},
+	{TEXT("uint16"), EVolumeVoxelFormat::UnsignedShort, ENRRDWideType::None},
+	{TEXT("uint16_t"), EVolumeVoxelFormat::UnsignedShort, ENRRDWideType::None},
+	{TEXT("int"), EVolumeVoxelFormat::SignedInt, ENRRDWideType::None},
+	{TEXT("signed int"), EVolumeVoxelFormat::SignedInt, ENRRDWideType::None},
+	{TEXT("int32"), EVolumeVoxelFormat::SignedInt, ENRRDWideType::None},
+	{TEXT("int32_t"), EVolumeVoxelFormat::SignedInt, ENRRDWideType::None},
+	{TEXT("uint"), EVolumeVoxelFormat::UnsignedInt, ENRRDWideType::None},
+	{TEXT("unsigned int"), EVolumeVoxelFormat::UnsignedInt, ENRRDWideType::None},
+	{TEXT("uint32"), EVolumeVoxelFormat::UnsignedInt, ENRRDWideType::None},
+	{TEXT("uint32_t"), EVolumeVoxelFormat::UnsignedInt, ENRRDWideType::None},
+	{TEXT("longlong"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("long long"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("long long int"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("signed long long"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("signed long long int"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("int64"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("int64_t"), EVolumeVoxelFormat::Float, ENRRDWideType::Int64},
+	{TEXT("ulonglong"), EVolumeVoxelFormat::Float, ENRRDWideType::UInt64},
+	{TEXT("unsigned long long"), EVolumeVoxelFormat::Float, ENRRDWideType::UInt64},
+	{TEXT("unsigned long long int"), EVolumeVoxelFormat::Float, ENRRDWideType::UInt64},
+	{TEXT("uint64"), EVolumeVoxelFormat::Float, ENRRDWideType::UInt64},
+	{TEXT("uint64_t"), EVolumeVoxelFormat::Float, ENRRDWideType::UInt64},
+	{TEXT("float"), EVolumeVoxelFormat::Float, ENRRDWideType::None},
+	{TEXT("double"), EVolumeVoxelFormat::Float, ENRRDWideType::Double},
+};
+
+// Reads the header part of an NRRD file, which ends at the first empty line (attached data follows it) or at the end of a detached
+// header. Attached data can be gigabytes large, so the file is read in blocks until the header end is found.
+// OutDataOffset is the offset right past the header.
+bool ReadNRRDHeaderText(const FString& FileName, FString& OutHeaderText, int64& OutDataOffset)
+{
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FileName));
+	if (!FileHandle)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("NRRD file %s could not be opened."), *FileName);
+		return false;
+	}
+
+	constexpr int32 BlockSize = 64 * 1024;
+	constexpr int32 MaxHeaderSize = 16 * 1024 * 1024;
+	const int64 FileSize = FileHandle->Size();
+
+	TArray<uint8> HeaderBytes;
+	int32 HeaderEnd = INDEX_NONE;
+	OutDataOffset = INDEX_NONE;
+	while (OutDataOffset == INDEX_NONE && HeaderBytes.Num() < MaxHeaderSize)
+	{
+		const int32 ReadSize = static_cast<int32>(FMath::Min<int64>(BlockSize, FileSize - HeaderBytes.Num()));
+		if (ReadSize <= 0)
+		{
+			break;
+		}
+		const int32 OldNum = HeaderBytes.Num();
+		HeaderBytes.AddUninitialized(ReadSize);
+		if (!FileHandle->Read(HeaderBytes.GetData() + OldNum, ReadSize))
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("Failed reading NRRD file %s."), *FileName);
+			return false;
+		}
+
+		// Look for an empty line, starting a bit back in case the line break got split between two blocks.
+		for (int32 Index = FMath::Max(OldNum - 2, 0); Index + 1 < HeaderBytes.Num(); Index++)
+		{
+			if (HeaderBytes[Index] != '\n')
+			{
+				continue;
+			}
+			if (HeaderBytes[Index + 1] == '\n')
+			{
+				HeaderEnd = Index + 1;
+				OutDataOffset = Index + 2;
+				break;
+			}
+			if (HeaderBytes[Index + 1] == '\r' && Index + 2 < HeaderBytes.Num() && HeaderBytes[Index + 2] == '\n')
+			{
+				HeaderEnd = Index + 1;
+				OutDataOffset = Index + 3;
+				break;
+			}
+		}
+	}
+
+	if (OutDataOffset == INDEX_NONE)
+	{
+		// No empty line, so the whole file is a detached header.
+		HeaderEnd = HeaderBytes.Num();
+		OutDataOffset = HeaderBytes.Num();
+	}
+
+	FUTF8ToTCHAR Converter(reinterpret_cast<const ANSICHAR*>(HeaderBytes.GetData()), HeaderEnd);
+	OutHeaderText = FString(Converter.Length(), Converter.Get());
+	return true;
+}
+
+// Implements NRRD "line skip" - returns the offset past the first LineCount lines following StartOffset in the provided file.
+bool SkipNRRDLines(const FString& FileName, const int64 StartOffset, int32 LineCount, int64& OutOffset)
+{
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FileName));
+	if (!FileHandle || !FileHandle->Seek(StartOffset))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("NRRD data file %s could not be opened."), *FileName);
+		return false;
+	}
+
+	TArray<uint8> Block;
+	Block.SetNumUninitialized(64 * 1024);
+	const int64 FileSize = FileHandle->Size();
+	OutOffset = StartOffset;
+	while (LineCount > 0)
+	{
+		const int64 ReadSize = FMath::Min<int64>(Block.Num(), FileSize - OutOffset);
+		if (ReadSize <= 0 || !FileHandle->Read(Block.GetData(), ReadSize))
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("NRRD data file %s ended before all skipped lines were read."), *FileName);
+			return false;
+		}
+		for (int64 Index = 0; Index < ReadSize && LineCount > 0; Index++, OutOffset++)
+		{
+			if (Block[Index] == '\n')
+			{
+				LineCount--;
+			}
+		}
+	}
+	return true;
+}
+
+// Parses a "(x,y,z)" NRRD vector, e.g. the "space origin" field.
+bool ParseNRRDVector(const FString& Value, FVector& OutVector)
+{
+	const FString Trimmed = Value.TrimStartAndEnd();
+	if (!Trimmed.StartsWith(TEXT("(")) || !Trimmed.EndsWith(TEXT(")")))
+	{
+		return false;
+	}
+	TArray<FString> Components;
+	Trimmed.Mid(1, Trimmed.Len() - 2).ParseIntoArray(Components, TEXT(","));
+	if (Components.Num() != 3)
+	{
+		return false;
+	}
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		OutVector[Axis] = FCString::Atod(*Components[Axis].TrimStartAndEnd());
+	}
+	return true;
+}
+
+// Parses the "space directions" field - one "(x,y,z)" vector or "none" per axis. The spacing of every axis is the length of its
+// vector, the direction of the axis is the normalized vector.
+bool ParseNRRDSpaceDirections(const FString& Value, FVector& OutSpacing, FMatrix& OutDirection)
+{
+	const FString Compact = Value.Replace(TEXT(" "), TEXT("")).Replace(TEXT("\t"), TEXT(""));
+	int32 Axis = 0;
+	int32 Position = 0;
+	while (Position < Compact.Len() && Axis < 3)
+	{
+		if (Compact.Mid(Position, 4) == TEXT("none"))
+		{
+			Position += 4;
+			Axis++;
+			continue;
+		}
+
+		const int32 VectorEnd = Compact.Find(TEXT(")"), ESearchCase::CaseSensitive, ESearchDir::FromStart, Position);
+		if (Compact[Position] != '(' || VectorEnd == INDEX_NONE)
+		{
+			return false;
+		}
+
+		FVector AxisVector;
+		if (!ParseNRRDVector(Compact.Mid(Position, VectorEnd - Position + 1), AxisVector))
+		{
+			return false;
+		}
+		const double Length = AxisVector.Size();
+		if (Length > 0)
+		{
+			OutSpacing[Axis] = Length;
+			OutDirection.SetAxis(Axis, AxisVector / Length);
+		}
+
+		Position = VectorEnd + 1;
+		Axis++;
+	}
+	return Axis == 3;
+}
+
+// Parses a "pyramid level <N>:=<data file> <X> <Y> <Z>" key/value pair written by dicom_to_nrrd.py. Returns false if Key isn't a
+// pyramid level.
+bool ParseNRRDPyramidLevel(const FString& Key, const FString& Value, const FString& HeaderPath, FNRRDPyramidLevel& OutLevel)
+{
+	const FString LevelPrefix = TEXT("pyramid level ");
+	if (!Key.StartsWith(LevelPrefix))
+	{
+		return false;
+	}
+
+	const int32 LevelNumber = FCString::Atoi(*Key.RightChop(LevelPrefix.Len()));
+	TArray<FString> Tokens;
+	Value.ParseIntoArrayWS(Tokens);
+	if (LevelNumber < 1 || LevelNumber > 30 || Tokens.Num() != 4)
+	{
+		UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed NRRD pyramid level \"%s:=%s\" in %s."), *Key, *Value, *HeaderPath);
+		return false;
+	}
+
+	OutLevel.Factor = 1 << LevelNumber;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		OutLevel.Dimensions[Axis] = FCString::Atoi(*Tokens[Axis + 1]);
+		if (OutLevel.Dimensions[Axis] <= 0)
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring NRRD pyramid level %d with invalid size in %s."), LevelNumber, *HeaderPath);
+			return false;
+		}
+	}
+	OutLevel.DataFilePath = FPaths::IsRelative(Tokens[0]) ? FPaths::Combine(FPaths::GetPath(HeaderPath), Tokens[0]) : Tokens[0];
+	OutLevel.DataFilePath = FPaths::ConvertRelativePathToFull(OutLevel.DataFilePath);
+	return true;
+}
+
+// Narrows 64bit voxels to float in place, leaving the floats in the first half of the array. Big-endian voxels get swapped on the
+// way, the floats are always in the native byte order.
+template <typename WideType>
+void NarrowToFloat(uint8* Data, const int64 VoxelCount, const bool bSwapBytes)
+{
+	// The floats overwrite the front of the array, so go block by block through a buffer - that way a float never overwrites a
+	// wide voxel that wasn't read yet, no matter how the compiler orders the loop.
+	constexpr int64 BlockSize = 4096;
+	float Block[BlockSize];
+	const WideType* InArray = reinterpret_cast<const WideType*>(Data);
+	for (int64 BlockStart = 0; BlockStart < VoxelCount; BlockStart += BlockSize)
+	{
+		const int64 BlockVoxelCount = FMath::Min(BlockSize, VoxelCount - BlockStart);
+		for (int64 Index = 0; Index < BlockVoxelCount; Index++)
+		{
+			const WideType Value = InArray[BlockStart + Index];
+			Block[Index] = static_cast<float>(bSwapBytes ? VoxelKernels::SwapVoxelBytes(Value) : Value);
+		}
+		FMemory::Memcpy(reinterpret_cast<float*>(Data) + BlockStart, Block, BlockVoxelCount * sizeof(float));
+	}
+}
+}	 // namespace
+
+int32 FNRRDHeader::GetFileBytesPerVoxel() const
+{
+	return WideType != ENRRDWideType::None ? 8 : FVolumeInfo::VoxelFormatByteSize(VolumeInfo.OriginalFormat);
+}
+
+FNRRDHeader FNRRDHeader::GetPyramidLevelHeader(const int32 LevelIndex) const
+{
+	check(PyramidLevels.IsValidIndex(LevelIndex));
+	const FNRRDPyramidLevel& Level = PyramidLevels[LevelIndex];
+
+	FNRRDHeader LevelHeader = *this;
+	LevelHeader.PyramidLevels.Empty();
+	LevelHeader.DataFilePath = Level.DataFilePath;
+
+	FVolumeInfo& Info = LevelHeader.VolumeInfo;
+	Info.Dimensions = Level.Dimensions;
+	Info.Spacing = VolumeInfo.Spacing * Level.Factor;
+	Info.WorldDimensions = Info.Spacing * FVector(Info.Dimensions);
+	// The first level voxel covers Factor^3 full resolution voxels, so its center is a bit further along every axis.
+	Info.Origin = VolumeInfo.Origin + VolumeInfo.Direction.TransformVector(VolumeInfo.Spacing * (Level.Factor - 1) * 0.5);
+	Info.DataFileName = FPaths::GetCleanFilename(Level.DataFilePath);
+	Info.DataFileOffset = 0;
+	Info.bIsCompressed = false;
+	Info.CompressedByteSize = 0;
+	return LevelHeader;
+}
+
+UNRRDLoader* UNRRDLoader::Get()
+{
+	return NewObject<UNRRDLoader>();
+}
+
+bool UNRRDLoader::ParseHeader(const FString& FileName, FNRRDHeader& OutHeader)
+{
+	OutHeader = FNRRDHeader();
+	FVolumeInfo& Info = OutHeader.VolumeInfo;
+	Info.bParseWasSuccessful = false;
+
+	// Same as the other loaders, accept paths relative to the content folder.
+	FString HeaderPath = FileName;
+	if (!FPaths::FileExists(HeaderPath))
+	{
+		HeaderPath = FPaths::ProjectContentDir() + FileName;
+	}
+	HeaderPath = FPaths::ConvertRelativePathToFull(HeaderPath);
+
+	FString HeaderText;
+	int64 DataOffset = 0;
+	if (!ReadNRRDHeaderText(HeaderPath, HeaderText, DataOffset))
+	{
+		return false;
+	}
+
+	TArray<FString> Lines;
+	HeaderText.ParseIntoArrayLines(Lines, /*bCullEmpty=*/false);
+	if (Lines.Num() == 0 || !Lines[0].StartsWith(TEXT("NRRD")))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("File %s is not a valid NRRD (missing NRRD000x magic)."), *HeaderPath);
+		return false;
+	}
+
+	bool bHasType = false;
+	int32 Dimension = 0;
+	TArray<FString> Sizes;
+	FString DataFile;
+	bool bBigEndian = false;
+	int32 LineSkip = 0;
+	int64 ByteSkip = 0;
+	bool bRASSpace = false;
+	Info.Spacing = FVector(1, 1, 1);
+
+	for (int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+	{
+		const FString& Line = Lines[LineIndex];
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
+		{
+			continue;
+		}
+
+		// Key/value pairs ("key:=value"). Only pyramid levels are of any use to us.
+		FString Key, KeyValue;
+		if (Line.Split(TEXT(":="), &Key, &KeyValue))
+		{
+			FNRRDPyramidLevel Level;
+			if (ParseNRRDPyramidLevel(Key.TrimStartAndEnd().ToLower(), KeyValue.TrimStartAndEnd(), HeaderPath, Level))
+			{
+				OutHeader.PyramidLevels.Add(MoveTemp(Level));
+			}
+			continue;
+		}
+
+		FString Field, Value;
+		if (!Line.Split(TEXT(":"), &Field, &Value))
+		{
+			UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed NRRD header line \"%s\" in %s."), *Line, *HeaderPath);
+			continue;
+		}
+		Field = Field.TrimStartAndEnd().ToLower();
+		Value = Value.TrimStartAndEnd();
+
+		if (Field == TEXT("type"))
+		{
+			const FNRRDTypeName* TypeName = Algo::FindByPredicate(
+				NRRDTypeNames, [&Value](const FNRRDTypeName& Type) { return Value.Equals(Type.Name, ESearchCase::IgnoreCase); });
+			if (!TypeName)
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("Unsupported NRRD type \"%s\" in %s."), *Value, *HeaderPath);
+				return false;
+			}
+			Info.OriginalFormat = TypeName->Format;
+			OutHeader.WideType = TypeName->WideType;
+			bHasType = true;
+		}
+		else if (Field == TEXT("dimension"))
+		{
+			Dimension = FCString::Atoi(*Value);
+		}
+		else if (Field == TEXT("sizes"))
+		{
+			Value.ParseIntoArrayWS(Sizes);
+		}
+		else if (Field == TEXT("spacings"))
+		{
+			TArray<FString> Spacings;
+			Value.ParseIntoArrayWS(Spacings);
+			for (int32 Axis = 0; Axis < FMath::Min(Spacings.Num(), 3); Axis++)
+			{
+				const double Spacing = FCString::Atod(*Spacings[Axis]);
+				// Axes without spacing say "nan".
+				if (Spacing > 0)
+				{
+					Info.Spacing[Axis] = Spacing;
+				}
+			}
+		}
+		else if (Field == TEXT("space directions"))
+		{
+			if (!ParseNRRDSpaceDirections(Value, Info.Spacing, Info.Direction))
+			{
+				UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed NRRD space directions \"%s\" in %s."), *Value,
+					*HeaderPath);
+			}
+		}
+		else if (Field == TEXT("space origin"))
+		{
+			if (!ParseNRRDVector(Value, Info.Origin))
+			{
+				UE_LOG(LogVolumeLoader, Warning, TEXT("Ignoring malformed NRRD space origin \"%s\" in %s."), *Value, *HeaderPath);
+			}
+		}
+		else if (Field == TEXT("space"))
+		{
+			const FString Space = Value.ToLower();
+			bRASSpace = Space == TEXT("right-anterior-superior") || Space == TEXT("ras");
+		}
+		else if (Field == TEXT("encoding"))
+		{
+			if (Value == TEXT("gzip") || Value == TEXT("gz"))
+			{
+				// The whole rest of the data file is the gzip stream.
+				Info.bIsCompressed = true;
+				Info.CompressedByteSize = 0;
+			}
+			else if (Value != TEXT("raw"))
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("Unsupported NRRD encoding \"%s\" in %s, only raw and gzip are supported."),
+					*Value, *HeaderPath);
+				return false;
+			}
+		}
+		else if (Field == TEXT("endian"))
+		{
+			bBigEndian = Value == TEXT("big");
+		}
+		else if (Field == TEXT("data file") || Field == TEXT("datafile"))
+		{
+			TArray<FString> Tokens;
+			Value.ParseIntoArrayWS(Tokens);
+			if (Tokens.Num() != 1 || Value.Contains(TEXT("%")))
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("NRRD data split into multiple files is not supported (%s)."), *HeaderPath);
+				return false;
+			}
+			DataFile = Value;
+		}
+		else if (Field == TEXT("line skip") || Field == TEXT("lineskip"))
+		{
+			LineSkip = FCString::Atoi(*Value);
+		}
+		else if (Field == TEXT("byte skip") || Field == TEXT("byteskip"))
+		{
+			ByteSkip = FCString::Atoi64(*Value);
+		}
+	}
+
+	if (!bHasType)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("NRRD %s is missing the type field."), *HeaderPath);
+		return false;
+	}
+	if (Dimension != 3 || Sizes.Num() != 3)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("NRRD %s has dimension %d with %d sizes. Only 3D volumes are supported."), *HeaderPath,
+			Dimension, Sizes.Num());
+		return false;
+	}
+
+	// Sizes are listed from the fastest to the slowest axis, same as our X, Y, Z.
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const int64 Size = FCString::Atoi64(*Sizes[Axis]);
+		if (Size <= 0 || Size > MAX_int32)
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("NRRD %s has invalid size %s."), *HeaderPath, *Sizes[Axis]);
+			return false;
+		}
+		Info.Dimensions[Axis] = static_cast<int32>(Size);
+	}
+	Info.WorldDimensions = Info.Spacing * FVector(Info.Dimensions);
+	Info.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(Info.OriginalFormat);
+
+	// Keep orientation in LPS like DICOM (and ITK), RAS flips the first two axes.
+	if (bRASSpace)
+	{
+		const FMatrix RASToLPS = FScaleMatrix(FVector(-1, -1, 1));
+		Info.Origin = RASToLPS.TransformVector(Info.Origin);
+		Info.Direction = Info.Direction * RASToLPS;
+	}
+	Info.bIsSigned = FVolumeInfo::IsVoxelFormatSigned(Info.OriginalFormat);
+
+	// The byte order only matters for multi-byte voxels, "endian" can be left out (or be anything) for 8bit data.
+	Info.bIsBigEndian = bBigEndian && OutHeader.GetFileBytesPerVoxel() > 1;
+
+	// Without a data file, the data is attached right after the header.
+	if (DataFile.IsEmpty())
+	{
+		OutHeader.DataFilePath = HeaderPath;
+	}
+	else
+	{
+		OutHeader.DataFilePath = FPaths::IsRelative(DataFile) ? FPaths::Combine(FPaths::GetPath(HeaderPath), DataFile) : DataFile;
+		OutHeader.DataFilePath = FPaths::ConvertRelativePathToFull(OutHeader.DataFilePath);
+		DataOffset = 0;
+	}
+
+	if (LineSkip > 0 && !SkipNRRDLines(OutHeader.DataFilePath, DataOffset, LineSkip, DataOffset))
+	{
+		return false;
+	}
+
+	if (ByteSkip != 0)
+	{
+		// Byte skip applies to the decompressed data, which we inflate straight into the volume.
+		if (Info.bIsCompressed)
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("NRRD %s uses byte skip with gzip encoding, which is not supported."), *HeaderPath);
+			return false;
+		}
+		if (ByteSkip == -1)
+		{
+			// The data is at the very end of the file.
+			const int64 FileSize = FPlatformFileManager::Get().GetPlatformFile().FileSize(*OutHeader.DataFilePath);
+			DataOffset = FileSize - Info.GetTotalVoxels() * OutHeader.GetFileBytesPerVoxel();
+		}
+		else
+		{
+			DataOffset += ByteSkip;
+		}
+		if (ByteSkip < -1 || DataOffset < 0)
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("NRRD %s has invalid byte skip %lld."), *HeaderPath, ByteSkip);
+			return false;
+		}
+	}
+
+	Info.DataFileName = FPaths::GetCleanFilename(OutHeader.DataFilePath);
+	Info.DataFileOffset = DataOffset;
+	Info.bParseWasSuccessful = true;
+
+	OutHeader.PyramidLevels.Sort([](const FNRRDPyramidLevel& A, const FNRRDPyramidLevel& B) { return A.Factor < B.Factor; });
+	return true;
+}
+
+FVolumeInfo UNRRDLoader::ParseVolumeInfoFromHeader(FString FileName)
+{
+	FNRRDHeader Header;
+	ParseHeader(FileName, Header);
+	return Header.VolumeInfo;
+}
+
+TUniquePtr<uint8[]> UNRRDLoader::LoadAndConvertNRRDData(const FNRRDHeader& Header, FVolumeInfo& OutVolumeInfo, bool bNormalize,
+	bool bConvertToFloat, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	const FString DataFolder = FPaths::GetPath(Header.DataFilePath);
+	OutVolumeInfo = Header.VolumeInfo;
+	if (Header.WideType == ENRRDWideType::None)
+	{
+		return LoadAndConvertData(DataFolder, OutVolumeInfo, bNormalize, bConvertToFloat, Progress);
+	}
+
+	// Load the 64bit voxels, narrow them to float in place and convert those like any other float volume.
+	FVolumeInfo WideInfo = OutVolumeInfo;
+	WideInfo.BytesPerVoxel = Header.GetFileBytesPerVoxel();
+	if (Progress)
+	{
+		Progress->TotalBytes = WideInfo.GetByteSize();
+	}
+	TUniquePtr<uint8[]> LoadedArray = LoadRawDataFileFromInfo(DataFolder, WideInfo, Progress);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
+
+	switch (Header.WideType)
+	{
+		case ENRRDWideType::Double:
+			NarrowToFloat<double>(LoadedArray.Get(), OutVolumeInfo.GetTotalVoxels(), Header.VolumeInfo.bIsBigEndian);
+			break;
+		case ENRRDWideType::Int64:
+			NarrowToFloat<int64>(LoadedArray.Get(), OutVolumeInfo.GetTotalVoxels(), Header.VolumeInfo.bIsBigEndian);
+			break;
+		case ENRRDWideType::UInt64:
+			NarrowToFloat<uint64>(LoadedArray.Get(), OutVolumeInfo.GetTotalVoxels(), Header.VolumeInfo.bIsBigEndian);
+			break;
+		default:
+			break;
+	}
+	OutVolumeInfo.bIsBigEndian = false;
+	ShrinkArray(LoadedArray, OutVolumeInfo.GetByteSize());
+	return ConvertData(MoveTemp(LoadedArray), OutVolumeInfo, bNormalize, bConvertToFloat);
+}
+
+UVolumeAsset* UNRRDLoader::CreateVolumeFromFile(FString FileName, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
+{
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header))
+	{
+		return nullptr;
+	}
+	// Get valid package name and filepath.
+	FString FilePath, VolumeName;
+	GetValidPackageNameFromFileName(FileName, FilePath, VolumeName);
+
+	return CreateTransientVolumeFromHeader(Header, VolumeName, bNormalize, bConvertToFloat);
+}
+
+UVolumeAsset* UNRRDLoader::CreatePreviewVolumeFromFile(
+	const FString& FileName, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
+{
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header) || Header.PyramidLevels.Num() == 0)
+	{
+		return nullptr;
+	}
+	FString FilePath, VolumeName;
+	GetValidPackageNameFromFileName(FileName, FilePath, VolumeName);
+
+	const FNRRDHeader PreviewHeader = Header.GetPyramidLevelHeader(Header.PyramidLevels.Num() - 1);
+	UE_LOG(LogVolumeLoader, Log, TEXT("Loading 1/%d resolution preview of %s from %s."), Header.PyramidLevels.Last().Factor,
+		*FileName, *PreviewHeader.VolumeInfo.DataFileName);
+	return CreateTransientVolumeFromHeader(PreviewHeader, VolumeName + TEXT("_Preview"), bNormalize, bConvertToFloat);
+}
+
+UVolumeAsset* UNRRDLoader::CreateTransientVolumeFromHeader(
+	const FNRRDHeader& Header, const FString& VolumeName, bool bNormalize, bool bConvertToFloat)
+{
+	// Create the transient volume asset.
+	UVolumeAsset* OutAsset = UVolumeAsset::CreateTransient(VolumeName);
+	if (!OutAsset)
+	{
+		return nullptr;
+	}
+
+	// Convert straight from the memory mapped raw file into the texture if possible, otherwise load the data into memory first.
+	// 64bit voxels have to be narrowed before the conversion, so they always get loaded.
+	FVolumeInfo VolumeInfo = Header.VolumeInfo;
+	if (Header.WideType != ENRRDWideType::None ||
+		!LoadMappedDataIntoTransientTexture(
+			FPaths::GetPath(Header.DataFilePath), VolumeInfo, bNormalize, bConvertToFloat, OutAsset->DataTexture))
+	{
+		// Perform complete load and conversion of data.
+		TUniquePtr<uint8[]> LoadedArray = LoadAndConvertNRRDData(Header, VolumeInfo, bNormalize, bConvertToFloat);
+		if (LoadedArray == nullptr)
+		{
+			return nullptr;
+		}
+
+		// Create the transient Volume texture (or the bricks, for volumes too large for a single texture).
+		CreateTransientTextures(OutAsset, VolumeInfo, LoadedArray.Get());
+	}
+
+	// Check that the texture got created properly.
+	if (OutAsset->DataTexture)
+	{
+		OutAsset->ImageInfo = VolumeInfo;
+		return OutAsset;
+	}
+	else
+	{
+		return nullptr;
+	}
+}
+
+TUniquePtr<uint8[]> UNRRDLoader::LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+	FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header))
+	{
+		OutVolumeInfo = Header.VolumeInfo;
+		return nullptr;
+	}
+	FString FilePath;
+	GetValidPackageNameFromFileName(FileName, FilePath, OutVolumeName);
+
+	return LoadAndConvertNRRDData(Header, OutVolumeInfo, bNormalize, bConvertToFloat, Progress);
+}
+
+FTexture2DMipMap* UNRRDLoader::LoadMappedVolumeMip(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+	FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	// 64bit voxels have to be narrowed before the conversion, so they always get loaded.
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header) || Header.WideType != ENRRDWideType::None)
+	{
+		return nullptr;
+	}
+
+	FVolumeInfo VolumeInfo = Header.VolumeInfo;
+	FTexture2DMipMap* Mip =
+		LoadMappedDataIntoMip(FPaths::GetPath(Header.DataFilePath), VolumeInfo, bNormalize, bConvertToFloat, Progress);
+	if (Mip)
+	{
+		OutVolumeInfo = VolumeInfo;
+		FString FilePath;
+		GetValidPackageNameFromFileName(FileName, FilePath, OutVolumeName);
+	}
+	return Mip;
+}
+
+UVolumeAsset* UNRRDLoader::CreatePersistentVolumeFromFile(
+	const FString& FileName, const FString& OutFolder, bool bNormalize /*= true*/)
+{
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header))
+	{
+		return nullptr;
+	}
+	// Get valid package name and filepath.
+	FString FilePath, VolumeName;
+	GetValidPackageNameFromFileName(FileName, FilePath, VolumeName);
+
+	// Create persistent volume asset.
+	UVolumeAsset* OutAsset = UVolumeAsset::CreatePersistent(OutFolder, VolumeName);
+	if (!OutAsset)
+	{
+		return nullptr;
+	}
+
+	FVolumeInfo VolumeInfo;
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertNRRDData(Header, VolumeInfo, bNormalize, false);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Create the persistent volume textures.
+	if (CreatePersistentTextures(OutAsset, VolumeName, OutFolder, VolumeInfo, LoadedArray.Get()))
+	{
+		OutAsset->ImageInfo = VolumeInfo;
+		return OutAsset;
+	}
+	else
+	{
+		return nullptr;
+	}
+}
+
+UVolumeAsset* UNRRDLoader::CreateVolumeFromFileInExistingPackage(
+	FString FileName, UObject* ParentPackage, bool bNormalize /*= true*/, bool bConvertToFloat /*= true*/)
+{
+	FNRRDHeader Header;
+	if (!ParseHeader(FileName, Header))
+	{
+		return nullptr;
+	}
+	// Get valid package name and filepath.
+	FString FilePath, VolumeName;
+	GetValidPackageNameFromFileName(FileName, FilePath, VolumeName);
+
+	// Create the volume asset.
+	UVolumeAsset* OutAsset = NewObject<UVolumeAsset>(ParentPackage, FName("VA_" + VolumeName), RF_Standalone | RF_Public);
+	if (!OutAsset)
+	{
+		return nullptr;
+	}
+
+	// Perform complete load and conversion of data.
+	FVolumeInfo VolumeInfo;
+	TUniquePtr<uint8[]> LoadedArray = LoadAndConvertNRRDData(Header, VolumeInfo, bNormalize, bConvertToFloat);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Get proper pixel format depending on what got saved into the VolumeInfo during conversion.
+	EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
+
+	// Create the Volume texture.
+	OutAsset->DataTexture =
+		NewObject<UVolumeTexture>(ParentPackage, FName("VA_" + VolumeName + "_Data"), RF_Public | RF_Standalone);
+
+	UVolumeTextureToolkit::SetupVolumeTexture(
+		OutAsset->DataTexture, PixelFormat, VolumeInfo.Dimensions, LoadedArray.Get(), !bConvertToFloat);
+
+	// Check that the texture got created properly.
+	if (OutAsset->DataTexture)
+	{
+		OutAsset->ImageInfo = VolumeInfo;
+		return OutAsset;
+	}
+	else
+	{
+		return nullptr;
+	}
+}
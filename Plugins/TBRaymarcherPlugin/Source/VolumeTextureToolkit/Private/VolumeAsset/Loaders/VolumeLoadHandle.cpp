@@ -0,0 +1,71 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "VolumeAsset/Loaders/VolumeLoadHandle.h"
+
+#include "Async/Async.h"
+#include "VolumeAsset/VolumeAsset.h"
+
+void FVolumeLoadProgress::AddBytesRead(const int64 Bytes)
+{
+	BytesRead += Bytes;
+	if (OnUpdated)
+	{
+		OnUpdated();
+	}
+}
+
+void FVolumeLoadProgress::AddSlicesDecoded(const int32 Slices)
+{
+	SlicesDecoded += Slices;
+	if (OnUpdated)
+	{
+		OnUpdated();
+	}
+}
+
+float FVolumeLoadProgress::GetFraction() const
+{
+	if (TotalSlices > 0)
+	{
+		return FMath::Clamp(float(SlicesDecoded) / TotalSlices, 0.0f, 1.0f);
+	}
+	if (TotalBytes > 0)
+	{
+		return FMath::Clamp(float(double(BytesRead) / TotalBytes), 0.0f, 1.0f);
+	}
+	return 0.0f;
+}
+
+FVolumeLoadHandle::FVolumeLoadHandle()
+{
+	// The handle owns the progress, so it always outlives the callback.
+	Progress.OnUpdated = [this]() { NotifyProgress(); };
+}
+
+void FVolumeLoadHandle::NotifyProgress()
+{
+	if (bProgressNotificationPending.exchange(true))
+	{
+		return;
+	}
+
+	AsyncTask(ENamedThreads::GameThread,
+		[This = AsShared()]()
+		{
+			This->bProgressNotificationPending = false;
+			if (!This->bFinished)
+			{
+				This->OnProgress.ExecuteIfBound(This->Progress);
+			}
+		});
+}
+
+void FVolumeLoadHandle::Finish(UVolumeAsset* InLoadedAsset)
+{
+	check(IsInGameThread());
+	LoadedAsset = InLoadedAsset;
+	bFinished = true;
+	Loader.Reset();
+	OnFinished.ExecuteIfBound(InLoadedAsset);
+}
@@ -5,26 +5,148 @@
 
 #include "VolumeAsset/Loaders/VolumeLoader.h"
 
+#include "Async/Async.h"
 #include "HAL/FileManagerGeneric.h"
 #include "Logging/LogMacros.h"
 #include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
 #include "TextureUtilities.h"
+#include "VolumeAsset/VolumeConversionStage.h"
+
+#include <Tasks/Task.h>
 
 DEFINE_LOG_CATEGORY(LogVolumeLoader)
 
-TUniquePtr<uint8[]> IVolumeLoader::LoadRawDataFileFromInfo(const FString& FilePath, const FVolumeInfo& Info)
+// Logs the process' peak physical memory and how much it grew while this object was alive.
+struct FScopedPeakMemoryLog
+{
+	const TCHAR* Label;
+	const uint64 PeakBefore;
+
+	explicit FScopedPeakMemoryLog(const TCHAR* InLabel) : Label(InLabel), PeakBefore(FPlatformMemory::GetStats().PeakUsedPhysical)
+	{
+	}
+
+	~FScopedPeakMemoryLog()
+	{
+		const uint64 PeakAfter = FPlatformMemory::GetStats().PeakUsedPhysical;
+		UE_LOG(LogVolumeLoader, Log, TEXT("%s : peak physical memory %.1f MB before, %.1f MB after (+%.1f MB)."), Label,
+			PeakBefore / (1024.0 * 1024.0), PeakAfter / (1024.0 * 1024.0), (PeakAfter - PeakBefore) / (1024.0 * 1024.0));
+	}
+};
+
+TSharedRef<FVolumeLoadHandle> IVolumeLoader::CreateVolumeFromFileAsync(const FString& FileName, bool bNormalize /*= true*/,
+	bool bConvertToFloat /*= true*/, FOnVolumeLoadProgress OnProgress /*= {}*/, FOnVolumeLoadFinished OnFinished /*= {}*/)
+{
+	check(IsInGameThread());
+
+	TSharedRef<FVolumeLoadHandle> Handle = MakeShared<FVolumeLoadHandle>();
+	Handle->OnProgress = MoveTemp(OnProgress);
+	Handle->OnFinished = MoveTemp(OnFinished);
+	Handle->Loader.Reset(_getUObject());
+
+	UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[this, Handle, FileName, bNormalize, bConvertToFloat]()
+		{
+			FVolumeInfo VolumeInfo;
+			FString VolumeName;
+
+			// Convert straight from the memory mapped file into the mip if the loader can, otherwise load the converted data into
+			// memory first.
+			FTexture2DMipMap* Mip =
+				LoadMappedVolumeMip(FileName, bNormalize, bConvertToFloat, VolumeInfo, VolumeName, &Handle->Progress);
+			TUniquePtr<uint8[]> LoadedArray;
+			if (!Mip)
+			{
+				LoadedArray = LoadVolumeData(FileName, bNormalize, bConvertToFloat, VolumeInfo, VolumeName, &Handle->Progress);
+			}
+
+			// Fill the mips here as well, so that the game thread doesn't have to copy the whole volume. Volumes too large for a
+			// single texture get their bricks built here too, then get downsampled in place for the DataTexture.
+			const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
+			FVolumeBrickLayout BrickLayout;
+			FTexture2DMipMap* AtlasMip = nullptr;
+			FIntVector TextureDimensions = VolumeInfo.Dimensions;
+			if (!Mip && LoadedArray)
+			{
+				if (!FVolumeBrickLayout::NeedsBricking(TextureDimensions))
+				{
+					Mip = UVolumeTextureToolkit::CreateVolumeMip(PixelFormat, TextureDimensions, LoadedArray.Get());
+				}
+				else if (UVolumeTextureToolkit::CreateBrickedVolumeMips(
+							 LoadedArray.Get(), TextureDimensions, PixelFormat, BrickLayout, AtlasMip))
+				{
+					UVolumeTextureToolkit::DownsampleDataTo2K(LoadedArray.Get(), TextureDimensions, PixelFormat);
+					Mip = UVolumeTextureToolkit::CreateVolumeMip(PixelFormat, TextureDimensions, LoadedArray.Get());
+				}
+				else
+				{
+					UE_LOG(LogVolumeLoader, Error,
+						TEXT("%s volume %s is too large for a single volume texture and couldn't be split into bricks."),
+						*TextureDimensions.ToString(), *FileName);
+				}
+				LoadedArray.Reset();
+			}
+			else if (!Mip)
+			{
+				UE_LOG(LogVolumeLoader, Error, TEXT("Asynchronous load of volume %s failed."), *FileName);
+			}
+
+			AsyncTask(ENamedThreads::GameThread,
+				[Handle, Mip, AtlasMip, PixelFormat, TextureDimensions, BrickLayout = MoveTemp(BrickLayout),
+					VolumeInfo = MoveTemp(VolumeInfo), VolumeName = MoveTemp(VolumeName)]()
+				{
+					UVolumeAsset* OutAsset = Mip ? UVolumeAsset::CreateTransient(VolumeName) : nullptr;
+					if (OutAsset)
+					{
+						OutAsset->DataTexture =
+							UVolumeTextureToolkit::CreateVolumeTextureTransientFromMip(PixelFormat, TextureDimensions, Mip);
+						if (AtlasMip)
+						{
+							OutAsset->BrickAtlasTexture = UVolumeTextureToolkit::CreateVolumeTextureTransientFromMip(
+								PixelFormat, BrickLayout.GetAtlasDimensions(), AtlasMip);
+							OutAsset->BrickLayout = BrickLayout;
+						}
+						OutAsset->ImageInfo = VolumeInfo;
+					}
+					else
+					{
+						delete Mip;
+						delete AtlasMip;
+					}
+					Handle->Finish(OutAsset);
+				});
+		});
+
+	return Handle;
+}
+
+TUniquePtr<uint8[]> IVolumeLoader::LoadRawDataFileFromInfo(
+	const FString& FilePath, const FVolumeInfo& Info, FVolumeLoadProgress* Progress /*= nullptr*/)
 {
 	if (Info.bIsCompressed)
 	{
 		// #TODO potentially implement support for other compression formats.
-		return TUniquePtr<uint8[]>(UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(
-			FilePath + "/" + Info.DataFileName, Info.GetByteSize(), Info.CompressedByteSize));
+		// Inflated slabs are only needed for progress reporting.
+		constexpr int64 ProgressSlabByteSize = 16 * 1024 * 1024;
+		TFunction<void(const uint8*, int64, int64)> OnSlabInflated;
+		if (Progress)
+		{
+			OnSlabInflated = [Progress](const uint8* SlabData, int64 SlabOffset, int64 SlabSize) { Progress->AddBytesRead(SlabSize); };
+		}
+		return TUniquePtr<uint8[]>(UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(FilePath + "/" + Info.DataFileName,
+			Info.GetByteSize(), Info.CompressedByteSize, Progress ? ProgressSlabByteSize : 0, MoveTemp(OnSlabInflated),
+			Info.DataFileOffset));
 	}
 	else
 	{
-		return TUniquePtr<uint8[]>(
-			UVolumeTextureToolkit::LoadRawFileIntoArray(FilePath + "/" + Info.DataFileName, Info.GetByteSize()));
+		TFunction<void(int64)> OnBytesRead;
+		if (Progress)
+		{
+			OnBytesRead = [Progress](int64 BytesRead) { Progress->AddBytesRead(BytesRead); };
+		}
+		return TUniquePtr<uint8[]>(UVolumeTextureToolkit::LoadRawFileIntoArray(
+			FilePath + "/" + Info.DataFileName, Info.GetByteSize(), MoveTemp(OnBytesRead), Info.DataFileOffset));
 	}
 }
 
@@ -85,44 +207,230 @@ void IVolumeLoader::GetValidPackageNameFromFolderName(const FString& FullPath, F
 	OutPackageName.ReplaceCharInline(' ', '_');
 }
 
+namespace
+{
+// Returns true if ConvertData actually has to touch the voxel values.
+bool NeedsConversion(const FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+{
+	return bNormalize || VolumeInfo.bIsBigEndian || (bConvertToFloat && VolumeInfo.OriginalFormat != EVolumeVoxelFormat::Float);
+}
+
+// Compressed data gets inflated slab by slab. The value range of every slab gets computed as soon as the slab is inflated, so once
+// the whole file is inflated, only the normalization (and histogram) pass is left.
+TUniquePtr<uint8[]> LoadCompressedAndNormalize(const FString& FilePath, FVolumeInfo& VolumeInfo, FVolumeLoadProgress* Progress)
+{
+	constexpr int64 SlicesPerSlab = 16;
+	const int64 ByteSize = VolumeInfo.GetByteSize();
+	const int64 SlabByteSize =
+		FMath::Max<int64>(int64(VolumeInfo.Dimensions.X) * VolumeInfo.Dimensions.Y * VolumeInfo.BytesPerVoxel * SlicesPerSlab, 1);
+	const int32 NumSlabs = static_cast<int32>(FMath::DivideAndRoundUp(ByteSize, SlabByteSize));
+
+	TArray<float> SlabMins, SlabMaxs;
+	SlabMins.Init(TNumericLimits<float>::Max(), NumSlabs);
+	SlabMaxs.Init(TNumericLimits<float>::Lowest(), NumSlabs);
+
+	TUniquePtr<uint8[]> LoadedArray(UVolumeTextureToolkit::LoadZLibCompressedFileIntoArray(FilePath + "/" + VolumeInfo.DataFileName,
+		ByteSize, VolumeInfo.CompressedByteSize, SlabByteSize,
+		[&](const uint8* SlabData, int64 SlabOffset, int64 SlabSize)
+		{
+			const int32 SlabIndex = static_cast<int32>(SlabOffset / SlabByteSize);
+			UVolumeTextureToolkit::FindMinMaxByFormat(VolumeInfo.OriginalFormat, SlabData, SlabSize, SlabMins[SlabIndex],
+				SlabMaxs[SlabIndex], VolumeInfo.bIsBigEndian);
+			if (Progress)
+			{
+				Progress->AddBytesRead(SlabSize);
+			}
+		},
+		VolumeInfo.DataFileOffset));
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
+
+	VolumeInfo.MinValue = FMath::Min(SlabMins);
+	VolumeInfo.MaxValue = FMath::Max(SlabMaxs);
+
+	// Normalized voxels are never larger than the original ones, so normalize in place.
+	FVolumeConversionStage::RunWithKnownRange(LoadedArray.Get(), LoadedArray.Get(), VolumeInfo, true, false);
+	if (VolumeInfo.GetByteSize() < ByteSize)
+	{
+		IVolumeLoader::ShrinkArray(LoadedArray, VolumeInfo.GetByteSize());
+	}
+	return LoadedArray;
+}
+}	 // namespace
+
 TUniquePtr<uint8[]> IVolumeLoader::LoadAndConvertData(
-	FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+	FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat, FVolumeLoadProgress* Progress /*= nullptr*/)
 {
+	FScopedPeakMemoryLog PeakMemoryLog(TEXT("LoadAndConvertData"));
+	if (Progress)
+	{
+		Progress->TotalBytes = VolumeInfo.GetByteSize();
+	}
+
+	// The conversion needs a new array anyway, so read straight from a memory mapped file instead of loading a copy first.
+	const EVolumeVoxelFormat ConvertedFormat = GetConvertedFormat(VolumeInfo.OriginalFormat, bNormalize, bConvertToFloat);
+	FMappedRawFile MappedFile;
+	if (NeedsConversion(VolumeInfo, bNormalize, bConvertToFloat) && !VolumeInfo.bIsCompressed &&
+		UVolumeTextureToolkit::MapRawFile(
+			FilePath + "/" + VolumeInfo.DataFileName, VolumeInfo.GetByteSize(), MappedFile, VolumeInfo.DataFileOffset))
+	{
+		TUniquePtr<uint8[]> ConvertedArray(
+			new uint8[VolumeInfo.GetTotalVoxels() * FVolumeInfo::VoxelFormatByteSize(ConvertedFormat)]);
+		// The mapped file gets read while it's being converted, so there's no finer progress to report.
+		ConvertDataInto(MappedFile.GetData(), ConvertedArray.Get(), VolumeInfo, bNormalize, bConvertToFloat);
+		if (Progress)
+		{
+			Progress->AddBytesRead(VolumeInfo.GetByteSize());
+		}
+		return ConvertedArray;
+	}
+
+	if (bNormalize && VolumeInfo.bIsCompressed)
+	{
+		return LoadCompressedAndNormalize(FilePath, VolumeInfo, Progress);
+	}
+
 	// Load raw data.
-	TUniquePtr<uint8[]> LoadedArray = LoadRawDataFileFromInfo(FilePath, VolumeInfo);
+	TUniquePtr<uint8[]> LoadedArray = LoadRawDataFileFromInfo(FilePath, VolumeInfo, Progress);
+	if (LoadedArray == nullptr)
+	{
+		return nullptr;
+	}
 	LoadedArray = ConvertData(MoveTemp(LoadedArray), VolumeInfo, bNormalize, bConvertToFloat);
 	return LoadedArray;
 }
 
 TUniquePtr<uint8[]> IVolumeLoader::ConvertData(TUniquePtr<uint8[]>&& LoadedArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
 {
-	VolumeInfo.bIsNormalized = bNormalize;
-	if (bNormalize)
-	{
-		// We want to normalize and cap at G16, perform that normalization.
-		LoadedArray = TUniquePtr<uint8[]>(UVolumeTextureToolkit::NormalizeArrayByFormat(
-			VolumeInfo.OriginalFormat, LoadedArray.Get(), VolumeInfo.GetByteSize(), VolumeInfo.MinValue, VolumeInfo.MaxValue));
+	const EVolumeVoxelFormat ConvertedFormat = GetConvertedFormat(VolumeInfo.OriginalFormat, bNormalize, bConvertToFloat);
+	const int64 LoadedByteSize = VolumeInfo.GetByteSize();
+	const int64 ConvertedByteSize = VolumeInfo.GetTotalVoxels() * FVolumeInfo::VoxelFormatByteSize(ConvertedFormat);
 
-		if (VolumeInfo.BytesPerVoxel > 1)
-		{
-			VolumeInfo.BytesPerVoxel = 2;
-			VolumeInfo.ActualFormat = EVolumeVoxelFormat::UnsignedShort;
-		}
-		else
+	// Conversions that don't make the voxels larger (int16 -> uint16, float -> uint16, int32 -> float...) happen in place, so that
+	// we never hold two copies of the volume. Also covers the case where nothing needs to be converted.
+	if (ConvertedByteSize <= LoadedByteSize)
+	{
+		ConvertDataInto(LoadedArray.Get(), LoadedArray.Get(), VolumeInfo, bNormalize, bConvertToFloat);
+		if (ConvertedByteSize < LoadedByteSize)
 		{
-			VolumeInfo.ActualFormat = EVolumeVoxelFormat::UnsignedChar;
+			ShrinkArray(LoadedArray, ConvertedByteSize);
 		}
+		return MoveTemp(LoadedArray);
+	}
+
+	TUniquePtr<uint8[]> ConvertedArray(new uint8[ConvertedByteSize]);
+	ConvertDataInto(LoadedArray.Get(), ConvertedArray.Get(), VolumeInfo, bNormalize, bConvertToFloat);
+	return ConvertedArray;
+}
+
+void IVolumeLoader::ConvertDataInto(
+	const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+{
+	FVolumeConversionStage::Run(InArray, OutArray, VolumeInfo, bNormalize, bConvertToFloat);
+}
+
+void IVolumeLoader::ShrinkArray(TUniquePtr<uint8[]>& Array, const int64 NewByteSize)
+{
+	// Global new/delete in UE modules are routed through FMemory (see REPLACEMENT_OPERATOR_NEW_AND_DELETE) and uint8[] has no
+	// array cookie, so arrays allocated with new[] can be reallocated through FMemory.
+	Array.Reset(static_cast<uint8*>(FMemory::Realloc(Array.Release(), NewByteSize)));
+}
+
+EVolumeVoxelFormat IVolumeLoader::GetConvertedFormat(EVolumeVoxelFormat OriginalFormat, bool bNormalize, bool bConvertToFloat)
+{
+	if (bNormalize)
+	{
+		// Normalized data is capped at G16.
+		return FVolumeInfo::VoxelFormatByteSize(OriginalFormat) > 1 ? EVolumeVoxelFormat::UnsignedShort
+																	 : EVolumeVoxelFormat::UnsignedChar;
 	}
-	else if (bConvertToFloat && VolumeInfo.OriginalFormat != EVolumeVoxelFormat::Float)
+	else if (bConvertToFloat)
 	{
-		float* ConvertedArray =
-			UVolumeTextureToolkit::ConvertArrayToFloat(VolumeInfo.OriginalFormat, LoadedArray.Get(), VolumeInfo.GetTotalVoxels());
-		LoadedArray = TUniquePtr<uint8[]>(reinterpret_cast<uint8*>(ConvertedArray));
-		VolumeInfo.ActualFormat = EVolumeVoxelFormat::Float;
+		return EVolumeVoxelFormat::Float;
 	}
-	else
+	return OriginalFormat;
+}
+
+bool IVolumeLoader::CreateTransientTextures(UVolumeAsset* OutAsset, const FVolumeInfo& VolumeInfo, uint8* Data)
+{
+	const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
+	if (!FVolumeBrickLayout::NeedsBricking(VolumeInfo.Dimensions))
 	{
-		VolumeInfo.ActualFormat = VolumeInfo.OriginalFormat;
+		return UVolumeTextureToolkit::CreateVolumeTextureTransient(
+			OutAsset->DataTexture, PixelFormat, VolumeInfo.Dimensions, Data);
 	}
-	return LoadedArray;
+	if (Data && UVolumeTextureToolkit::CreateBrickedVolumeTransient(OutAsset, PixelFormat, VolumeInfo.Dimensions, Data))
+	{
+		return true;
+	}
+	UE_LOG(LogVolumeLoader, Error, TEXT("%s volume is too large for a single volume texture and couldn't be split into bricks."),
+		*VolumeInfo.Dimensions.ToString());
+	return false;
+}
+
+bool IVolumeLoader::CreatePersistentTextures(
+	UVolumeAsset* OutAsset, const FString& VolumeName, const FString& OutFolder, const FVolumeInfo& VolumeInfo, uint8* Data)
+{
+	const EPixelFormat PixelFormat = FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat);
+	const FString DataTextureName = "VA_" + VolumeName + "_Data";
+	if (!FVolumeBrickLayout::NeedsBricking(VolumeInfo.Dimensions))
+	{
+		FIntVector Dimensions = VolumeInfo.Dimensions;
+		return UVolumeTextureToolkit::CreateVolumeTextureAsset(
+			OutAsset->DataTexture, DataTextureName, OutFolder, PixelFormat, Dimensions, Data, true);
+	}
+	const FString AtlasTextureName = "VA_" + VolumeName + "_Bricks";
+	if (Data && UVolumeTextureToolkit::CreateBrickedVolumeAsset(OutAsset, DataTextureName, AtlasTextureName, OutFolder,
+					PixelFormat, VolumeInfo.Dimensions, Data))
+	{
+		return true;
+	}
+	UE_LOG(LogVolumeLoader, Error, TEXT("%s volume is too large for a single volume texture and couldn't be split into bricks."),
+		*VolumeInfo.Dimensions.ToString());
+	return false;
+}
+
+bool IVolumeLoader::LoadMappedDataIntoTransientTexture(
+	const FString& FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat, UVolumeTexture*& OutTexture)
+{
+	FTexture2DMipMap* Mip = LoadMappedDataIntoMip(FilePath, VolumeInfo, bNormalize, bConvertToFloat);
+	if (!Mip)
+	{
+		return false;
+	}
+
+	OutTexture = UVolumeTextureToolkit::CreateVolumeTextureTransientFromMip(
+		FVolumeInfo::VoxelFormatToPixelFormat(VolumeInfo.ActualFormat), VolumeInfo.Dimensions, Mip);
+	return true;
+}
+
+FTexture2DMipMap* IVolumeLoader::LoadMappedDataIntoMip(const FString& FilePath, FVolumeInfo& VolumeInfo, bool bNormalize,
+	bool bConvertToFloat, FVolumeLoadProgress* Progress /*= nullptr*/)
+{
+	FScopedPeakMemoryLog PeakMemoryLog(TEXT("LoadMappedDataIntoMip"));
+
+	FMappedRawFile MappedFile;
+	if (VolumeInfo.bIsCompressed || FVolumeBrickLayout::NeedsBricking(VolumeInfo.Dimensions) ||
+		!UVolumeTextureToolkit::MapRawFile(
+			FilePath + "/" + VolumeInfo.DataFileName, VolumeInfo.GetByteSize(), MappedFile, VolumeInfo.DataFileOffset))
+	{
+		return nullptr;
+	}
+
+	const EPixelFormat PixelFormat =
+		FVolumeInfo::VoxelFormatToPixelFormat(GetConvertedFormat(VolumeInfo.OriginalFormat, bNormalize, bConvertToFloat));
+	if (Progress)
+	{
+		Progress->TotalBytes = VolumeInfo.GetByteSize();
+	}
+	FTexture2DMipMap* Mip = UVolumeTextureToolkit::CreateVolumeMip(PixelFormat, VolumeInfo.Dimensions,
+		[&](uint8* MipData) { ConvertDataInto(MappedFile.GetData(), MipData, VolumeInfo, bNormalize, bConvertToFloat); });
+	// The mapped file gets read while it's being converted, so there's no finer progress to report.
+	if (Progress)
+	{
+		Progress->AddBytesRead(VolumeInfo.GetByteSize());
+	}
+	return Mip;
 }
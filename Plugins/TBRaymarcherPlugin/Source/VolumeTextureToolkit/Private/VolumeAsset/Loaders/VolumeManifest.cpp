@@ -0,0 +1,169 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+#include "VolumeAsset/Loaders/VolumeManifest.h"
+
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+
+namespace
+{
+/// Reads an array of numbers. Returns false if the field is missing, isn't an array of numbers or has a different length than
+/// OutValues.
+bool ReadNumberArray(const FJsonObject& Object, const FString& Field, TArrayView<double> OutValues)
+{
+	const TArray<TSharedPtr<FJsonValue>>* Values;
+	if (!Object.TryGetArrayField(Field, Values) || Values->Num() != OutValues.Num())
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < OutValues.Num(); Index++)
+	{
+		if (!(*Values)[Index].IsValid() || !(*Values)[Index]->TryGetNumber(OutValues[Index]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ReadFloat(const FJsonObject& Object, const FString& Field, float& OutValue)
+{
+	double Value;
+	if (!Object.TryGetNumberField(Field, Value))
+	{
+		return false;
+	}
+	OutValue = static_cast<float>(Value);
+	return true;
+}
+
+/// Reads the histogram summary of a series (see summarize_histogram in dicom_to_nrrd.py).
+bool ReadHistogram(const FJsonObject& Histogram, FVolumeManifestSeries& OutSeries)
+{
+	const TSharedPtr<FJsonObject>* Percentiles;
+	double Range[2];
+	const TArray<TSharedPtr<FJsonValue>>* Counts;
+	if (!ReadFloat(Histogram, TEXT("mean"), OutSeries.MeanValue) ||
+		!Histogram.TryGetObjectField(TEXT("percentiles"), Percentiles) ||
+		!ReadFloat(**Percentiles, TEXT("0.5"), OutSeries.LowPercentileValue) ||
+		!ReadFloat(**Percentiles, TEXT("50"), OutSeries.MedianValue) ||
+		!ReadFloat(**Percentiles, TEXT("99.5"), OutSeries.HighPercentileValue) ||
+		!ReadNumberArray(Histogram, TEXT("range"), Range) || !Histogram.TryGetArrayField(TEXT("counts"), Counts))
+	{
+		return false;
+	}
+	OutSeries.HistogramMin = static_cast<float>(Range[0]);
+	OutSeries.HistogramMax = static_cast<float>(Range[1]);
+
+	OutSeries.HistogramCounts.Reset(Counts->Num());
+	for (const TSharedPtr<FJsonValue>& Count : *Counts)
+	{
+		double Value;
+		if (!Count.IsValid() || !Count->TryGetNumber(Value))
+		{
+			return false;
+		}
+		OutSeries.HistogramCounts.Add(static_cast<int64>(Value));
+	}
+	return true;
+}
+
+/// Reads the fields a converted series has. Series that failed to convert only have the ones read by ReadSeries.
+bool ReadConvertedSeries(const FJsonObject& Object, FVolumeManifestSeries& OutSeries)
+{
+	double Dimensions[3];
+	double Spacing[3];
+	double Origin[3];
+	const TSharedPtr<FJsonObject>* Histogram;
+	if (!ReadNumberArray(Object, TEXT("dimensions"), Dimensions) || !ReadNumberArray(Object, TEXT("spacing"), Spacing) ||
+		!ReadNumberArray(Object, TEXT("origin"), Origin) || !ReadFloat(Object, TEXT("min"), OutSeries.MinValue) ||
+		!ReadFloat(Object, TEXT("max"), OutSeries.MaxValue) || !Object.TryGetObjectField(TEXT("histogram"), Histogram))
+	{
+		return false;
+	}
+	OutSeries.Dimensions =
+		FIntVector(static_cast<int32>(Dimensions[0]), static_cast<int32>(Dimensions[1]), static_cast<int32>(Dimensions[2]));
+	OutSeries.Spacing = FVector(Spacing[0], Spacing[1], Spacing[2]);
+	OutSeries.Origin = FVector(Origin[0], Origin[1], Origin[2]);
+	return ReadHistogram(**Histogram, OutSeries);
+}
+
+bool ReadSeries(const FJsonObject& Object, const FString& ManifestFolder, FVolumeManifestSeries& OutSeries)
+{
+	FString HeaderFileName;
+	FString DataFileName;
+	if (!Object.TryGetStringField(TEXT("uid"), OutSeries.SeriesInstanceUID) ||
+		!Object.TryGetStringField(TEXT("nhdr"), HeaderFileName) || !Object.TryGetStringField(TEXT("raw"), DataFileName))
+	{
+		return false;
+	}
+	OutSeries.HeaderFilePath = FPaths::ConvertRelativePathToFull(ManifestFolder, HeaderFileName);
+	OutSeries.DataFilePath = FPaths::ConvertRelativePathToFull(ManifestFolder, DataFileName);
+
+	if (Object.TryGetStringField(TEXT("error"), OutSeries.Error))
+	{
+		return true;
+	}
+	return ReadConvertedSeries(Object, OutSeries);
+}
+}	 // namespace
+
+bool FVolumeManifest::Read(const FString& ManifestPath, FVolumeManifest& OutManifest)
+{
+	FString Text;
+	if (!FFileHelper::LoadFileToString(Text, *ManifestPath))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Reading volume manifest %s failed."), *ManifestPath);
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Root;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root.IsValid())
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Volume manifest %s isn't valid JSON."), *ManifestPath);
+		return false;
+	}
+
+	int32 Version;
+	if (!Root->TryGetNumberField(TEXT("version"), Version) || Version != SupportedVersion)
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Volume manifest %s has an unsupported version, expected %d."), *ManifestPath,
+			SupportedVersion);
+		return false;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* SeriesValues;
+	if (!Root->TryGetArrayField(TEXT("series"), SeriesValues))
+	{
+		UE_LOG(LogVolumeLoader, Error, TEXT("Volume manifest %s has no series."), *ManifestPath);
+		return false;
+	}
+
+	OutManifest = FVolumeManifest();
+	Root->TryGetStringField(TEXT("source"), OutManifest.SourceFolder);
+	const FString ManifestFolder = FPaths::GetPath(FPaths::ConvertRelativePathToFull(ManifestPath));
+	for (const TSharedPtr<FJsonValue>& SeriesValue : *SeriesValues)
+	{
+		FVolumeManifestSeries Series;
+		const TSharedPtr<FJsonObject>* SeriesObject;
+		if (!SeriesValue.IsValid() || !SeriesValue->TryGetObject(SeriesObject) ||
+			!ReadSeries(**SeriesObject, ManifestFolder, Series))
+		{
+			UE_LOG(LogVolumeLoader, Error, TEXT("Series %d of volume manifest %s is malformed."), OutManifest.Series.Num(),
+				*ManifestPath);
+			return false;
+		}
+		OutManifest.Series.Add(MoveTemp(Series));
+	}
+	return true;
+}
+
+const FVolumeManifestSeries* FVolumeManifest::FindSeries(const FString& SeriesInstanceUID) const
+{
+	return Series.FindByPredicate([&SeriesInstanceUID](const FVolumeManifestSeries& InSeries)
+		{ return InSeries.SeriesInstanceUID == SeriesInstanceUID; });
+}
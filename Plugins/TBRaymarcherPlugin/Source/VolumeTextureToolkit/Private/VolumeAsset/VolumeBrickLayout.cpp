@@ -0,0 +1,322 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "VolumeAsset/VolumeBrickLayout.h"
+
+#include "Async/ParallelFor.h"
+#include "TextureUtilities.h"
+
+namespace
+{
+// Finds the value range of the interior of a brick, with voxels of type T. The range gets multiplied by Scale.
+template <typename T>
+void FindBrickRange(const uint8* VolumeData, const FIntVector& VolumeDimensions, const FIntVector& Origin,
+	const FIntVector& Extent, float Scale, float& OutMin, float& OutMax)
+{
+	const T* Voxels = reinterpret_cast<const T*>(VolumeData);
+	T Min = std::numeric_limits<T>::max();
+	T Max = std::numeric_limits<T>::lowest();
+	for (int32 Z = Origin.Z; Z < Origin.Z + Extent.Z; Z++)
+	{
+		for (int32 Y = Origin.Y; Y < Origin.Y + Extent.Y; Y++)
+		{
+			const T* Row = Voxels + (int64(Z) * VolumeDimensions.Y + Y) * VolumeDimensions.X;
+			for (int32 X = Origin.X; X < Origin.X + Extent.X; X++)
+			{
+				Min = FMath::Min(Min, Row[X]);
+				Max = FMath::Max(Max, Row[X]);
+			}
+		}
+	}
+	OutMin = static_cast<float>(Min) * Scale;
+	OutMax = static_cast<float>(Max) * Scale;
+}
+}	 // namespace
+
+FVolumeBrickLayout::FVolumeBrickLayout(const FIntVector& InVolumeDimensions, int32 InBrickSize /*= DefaultBrickSize*/)
+	: VolumeDimensions(InVolumeDimensions), BrickSize(InBrickSize)
+{
+	check(BrickSize > 0);
+	BrickCounts = FIntVector(FMath::DivideAndRoundUp(VolumeDimensions.X, BrickSize),
+		FMath::DivideAndRoundUp(VolumeDimensions.Y, BrickSize), FMath::DivideAndRoundUp(VolumeDimensions.Z, BrickSize));
+	BrickToSlot.Init(INDEX_NONE, GetBrickCount());
+}
+
+bool FVolumeBrickLayout::NeedsBricking(const FIntVector& Dimensions)
+{
+	return Dimensions.X > MaxTextureSize || Dimensions.Y > MaxTextureSize || Dimensions.Z > MaxTextureSize;
+}
+
+FIntVector FVolumeBrickLayout::GetBrickCoordinates(const FIntVector& Voxel) const
+{
+	return FIntVector(FMath::Clamp(Voxel.X / BrickSize, 0, BrickCounts.X - 1),
+		FMath::Clamp(Voxel.Y / BrickSize, 0, BrickCounts.Y - 1), FMath::Clamp(Voxel.Z / BrickSize, 0, BrickCounts.Z - 1));
+}
+
+int32 FVolumeBrickLayout::GetBrickIndex(const FIntVector& BrickCoordinates) const
+{
+	return (BrickCoordinates.Z * BrickCounts.Y + BrickCoordinates.Y) * BrickCounts.X + BrickCoordinates.X;
+}
+
+FIntVector FVolumeBrickLayout::GetBrickCoordinatesFromIndex(int32 BrickIndex) const
+{
+	return FIntVector(BrickIndex % BrickCounts.X, (BrickIndex / BrickCounts.X) % BrickCounts.Y,
+		BrickIndex / (BrickCounts.X * BrickCounts.Y));
+}
+
+FIntVector FVolumeBrickLayout::GetBrickOrigin(int32 BrickIndex) const
+{
+	return GetBrickCoordinatesFromIndex(BrickIndex) * BrickSize;
+}
+
+FIntVector FVolumeBrickLayout::GetBrickExtent(int32 BrickIndex) const
+{
+	const FIntVector Origin = GetBrickOrigin(BrickIndex);
+	return FIntVector(FMath::Min(BrickSize, VolumeDimensions.X - Origin.X), FMath::Min(BrickSize, VolumeDimensions.Y - Origin.Y),
+		FMath::Min(BrickSize, VolumeDimensions.Z - Origin.Z));
+}
+
+FIntVector FVolumeBrickLayout::GetSlotOrigin(int32 Slot) const
+{
+	return FIntVector(Slot % SlotCounts.X, (Slot / SlotCounts.X) % SlotCounts.Y, Slot / (SlotCounts.X * SlotCounts.Y)) *
+		   GetPaddedBrickSize();
+}
+
+int32 FVolumeBrickLayout::GetHeaderSlotCount() const
+{
+	const int64 PaddedSize = GetPaddedBrickSize();
+	return int32(FMath::DivideAndRoundUp(GetHeaderVoxelCount(), PaddedSize * PaddedSize * PaddedSize));
+}
+
+FIntVector FVolumeBrickLayout::GetHeaderVoxel(int64 Index) const
+{
+	const int32 PaddedSize = GetPaddedBrickSize();
+	const int64 SlotVoxels = int64(PaddedSize) * PaddedSize * PaddedSize;
+	const int32 InSlot = int32(Index % SlotVoxels);
+	return GetSlotOrigin(int32(Index / SlotVoxels)) +
+		   FIntVector(InSlot % PaddedSize, (InSlot / PaddedSize) % PaddedSize, InSlot / (PaddedSize * PaddedSize));
+}
+
+FIntVector FVolumeBrickLayout::GetAtlasDimensions() const
+{
+	return SlotCounts * GetPaddedBrickSize();
+}
+
+bool FVolumeBrickLayout::VolumeToAtlas(const FIntVector& Voxel, FIntVector& OutAtlasVoxel) const
+{
+	const int32 BrickIndex = GetBrickIndex(GetBrickCoordinates(Voxel));
+	const int32 Slot = BrickToSlot[BrickIndex];
+	if (Slot == INDEX_NONE)
+	{
+		return false;
+	}
+	OutAtlasVoxel = GetSlotOrigin(Slot) + FIntVector(Apron) + (Voxel - GetBrickOrigin(BrickIndex));
+	return true;
+}
+
+void FVolumeBrickLayout::ComputeBrickRanges(const uint8* VolumeData, EPixelFormat PixelFormat)
+{
+	BrickMinValues.SetNumUninitialized(GetBrickCount());
+	BrickMaxValues.SetNumUninitialized(GetBrickCount());
+	ParallelFor(GetBrickCount(),
+		[&](int32 BrickIndex)
+		{
+			const FIntVector Origin = GetBrickOrigin(BrickIndex);
+			const FIntVector Extent = GetBrickExtent(BrickIndex);
+			float& OutMin = BrickMinValues[BrickIndex];
+			float& OutMax = BrickMaxValues[BrickIndex];
+			switch (PixelFormat)
+			{
+				case PF_G8:
+					FindBrickRange<uint8>(VolumeData, VolumeDimensions, Origin, Extent, 1.0f / MAX_uint8, OutMin, OutMax);
+					break;
+				case PF_G16:
+					FindBrickRange<uint16>(VolumeData, VolumeDimensions, Origin, Extent, 1.0f / MAX_uint16, OutMin, OutMax);
+					break;
+				case PF_R32_SINT:
+					FindBrickRange<int32>(VolumeData, VolumeDimensions, Origin, Extent, 1.0f, OutMin, OutMax);
+					break;
+				case PF_R32_FLOAT:
+					FindBrickRange<float>(VolumeData, VolumeDimensions, Origin, Extent, 1.0f, OutMin, OutMax);
+					break;
+				default:
+					// Unknown formats make every brick look non-empty.
+					OutMin = TNumericLimits<float>::Lowest();
+					OutMax = TNumericLimits<float>::Max();
+			}
+		});
+}
+
+bool FVolumeBrickLayout::AssignSlots(TFunctionRef<bool(int32 BrickIndex)> IsResident)
+{
+	TArray<int32> ResidentBricks;
+	for (int32 BrickIndex = 0; BrickIndex < GetBrickCount(); BrickIndex++)
+	{
+		if (IsResident(BrickIndex))
+		{
+			ResidentBricks.Add(BrickIndex);
+		}
+	}
+
+	// Pick the slot counts with the fewest slots to spare, so that the atlas isn't (much) larger than the resident bricks. Filling
+	// whole rows and layers first would waste up to a layer of slots - a lot with large volumes, the atlas holds gigabytes then.
+	// Among equally tight layouts, the most even one is kept. Slot numbers have to fit into the header.
+	const int32 MaxSlotsPerAxis = MaxTextureSize / GetPaddedBrickSize();
+	const int32 HeaderSlots = GetHeaderSlotCount();
+	const int32 SlotCount = ResidentBricks.Num() + HeaderSlots;
+	FIntVector NewSlotCounts = FIntVector::ZeroValue;
+	int64 NewTotalSlots = MAX_int64;
+	for (int32 X = 1; X <= MaxSlotsPerAxis; X++)
+	{
+		for (int32 Y = 1; Y <= MaxSlotsPerAxis; Y++)
+		{
+			const int32 Z = FMath::DivideAndRoundUp(SlotCount, X * Y);
+			const int64 TotalSlots = int64(X) * Y * Z;
+			const bool bTighter = TotalSlots < NewTotalSlots ||
+								  (TotalSlots == NewTotalSlots && FMath::Max3(X, Y, Z) < NewSlotCounts.GetMax());
+			if (Z <= MaxSlotsPerAxis && TotalSlots <= MaxHeaderNumber + 1 && bTighter)
+			{
+				NewSlotCounts = FIntVector(X, Y, Z);
+				NewTotalSlots = TotalSlots;
+			}
+			if (Z == 1)
+			{
+				// Larger Y only adds slots.
+				break;
+			}
+		}
+	}
+	if (NewTotalSlots == MAX_int64)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("%d bricks of %d^3 voxels don't fit into a %d^3 brick atlas."), ResidentBricks.Num(),
+			GetPaddedBrickSize(), MaxTextureSize);
+		return false;
+	}
+
+	SlotCounts = NewSlotCounts;
+	SlotToBrick.Init(INDEX_NONE, HeaderSlots);
+	SlotToBrick.Append(ResidentBricks);
+	BrickToSlot.Init(INDEX_NONE, GetBrickCount());
+	for (int32 Slot = HeaderSlots; Slot < SlotToBrick.Num(); Slot++)
+	{
+		BrickToSlot[SlotToBrick[Slot]] = Slot;
+	}
+	return true;
+}
+
+bool FVolumeBrickLayout::AssignNonEmptySlots()
+{
+	check(BrickMaxValues.Num() == GetBrickCount());
+	const float VolumeMin = FMath::Min(BrickMinValues);
+	return AssignSlots([this, VolumeMin](int32 BrickIndex) { return BrickMaxValues[BrickIndex] > VolumeMin; });
+}
+
+void FVolumeBrickLayout::CopyBricksToAtlas(const uint8* VolumeData, uint8* AtlasData, int32 BytesPerVoxel) const
+{
+	const FIntVector AtlasDimensions = GetAtlasDimensions();
+	const int32 PaddedSize = GetPaddedBrickSize();
+	ParallelFor(SlotToBrick.Num(),
+		[&](int32 Slot)
+		{
+			const int32 BrickIndex = SlotToBrick[Slot];
+			if (BrickIndex == INDEX_NONE)
+			{
+				return;
+			}
+			const FIntVector Origin = GetBrickOrigin(BrickIndex);
+			const FIntVector Extent = GetBrickExtent(BrickIndex);
+			const FIntVector SlotOrigin = GetSlotOrigin(Slot);
+
+			// Bricks cut short by the far border of the volume only fill their extent plus the apron, the rest of the slot stays
+			// zero. Apron voxels outside of the volume are clamped to its border.
+			const int32 RowVoxels = FMath::Min(Extent.X + 2 * Apron, PaddedSize);
+			for (int32 Z = 0; Z < FMath::Min(Extent.Z + 2 * Apron, PaddedSize); Z++)
+			{
+				const int32 SourceZ = FMath::Clamp(Origin.Z + Z - Apron, 0, VolumeDimensions.Z - 1);
+				for (int32 Y = 0; Y < FMath::Min(Extent.Y + 2 * Apron, PaddedSize); Y++)
+				{
+					const int32 SourceY = FMath::Clamp(Origin.Y + Y - Apron, 0, VolumeDimensions.Y - 1);
+					const uint8* SourceRow =
+						VolumeData + (int64(SourceZ) * VolumeDimensions.Y + SourceY) * VolumeDimensions.X * BytesPerVoxel;
+					const int64 AtlasRowStart =
+						(int64(SlotOrigin.Z + Z) * AtlasDimensions.Y + SlotOrigin.Y + Y) * AtlasDimensions.X + SlotOrigin.X;
+					uint8* AtlasRow = AtlasData + AtlasRowStart * BytesPerVoxel;
+
+					// Interior of the row in one go, the apron voxels one by one.
+					FMemory::Memcpy(AtlasRow + Apron * BytesPerVoxel, SourceRow + Origin.X * BytesPerVoxel,
+						Extent.X * BytesPerVoxel);
+					for (int32 X = 0; X < RowVoxels; X++)
+					{
+						if (X >= Apron && X < Apron + Extent.X)
+						{
+							continue;
+						}
+						const int32 SourceX = FMath::Clamp(Origin.X + X - Apron, 0, VolumeDimensions.X - 1);
+						FMemory::Memcpy(AtlasRow + X * BytesPerVoxel, SourceRow + SourceX * BytesPerVoxel, BytesPerVoxel);
+					}
+				}
+			}
+		});
+}
+
+bool FVolumeBrickLayout::WriteAtlasHeader(uint8* AtlasData, EPixelFormat PixelFormat) const
+{
+	// Floats get the same unit as G16, then they hold the same numbers.
+	float Unit = 1.0f / MAX_uint16;
+	if (PixelFormat == PF_G8)
+	{
+		Unit = 1.0f / MAX_uint8;
+	}
+	else if (PixelFormat != PF_G16 && PixelFormat != PF_R32_FLOAT)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("Brick atlases of pixel format %s can't hold a header."),
+			GetPixelFormatString(PixelFormat));
+		return false;
+	}
+	if (VolumeDimensions.GetMax() > MaxHeaderNumber)
+	{
+		UE_LOG(LogTextureUtils, Error, TEXT("A %s volume is too large for the brick atlas header."), *VolumeDimensions.ToString());
+		return false;
+	}
+	const int32 Base = FMath::RoundToInt32(1.0f / Unit) + 1;
+
+	const FIntVector AtlasDimensions = GetAtlasDimensions();
+	auto WriteVoxel = [&](int64 Index, float Value)
+	{
+		const FIntVector Voxel = GetHeaderVoxel(Index);
+		const int64 Offset = (int64(Voxel.Z) * AtlasDimensions.Y + Voxel.Y) * AtlasDimensions.X + Voxel.X;
+		switch (PixelFormat)
+		{
+			case PF_G8:
+				AtlasData[Offset] = static_cast<uint8>(FMath::RoundToInt32(FMath::Clamp(Value, 0.0f, 1.0f) * MAX_uint8));
+				break;
+			case PF_G16:
+				reinterpret_cast<uint16*>(AtlasData)[Offset] =
+					static_cast<uint16>(FMath::RoundToInt32(FMath::Clamp(Value, 0.0f, 1.0f) * MAX_uint16));
+				break;
+			default:
+				reinterpret_cast<float*>(AtlasData)[Offset] = Value;
+		}
+	};
+	auto WriteNumber = [&](int64 Index, int32 Number)
+	{
+		check(Number >= 0 && Number <= MaxHeaderNumber);
+		WriteVoxel(Index, (Number % Base) * Unit);
+		WriteVoxel(Index + 1, (Number / Base) * Unit);
+	};
+
+	WriteVoxel(HeaderUnit, Unit);
+	WriteNumber(HeaderPaddedBrickSize, GetPaddedBrickSize());
+	WriteNumber(HeaderBrickSize, BrickSize);
+	WriteNumber(HeaderVolumeDimensions, VolumeDimensions.X);
+	WriteNumber(HeaderVolumeDimensions + 2, VolumeDimensions.Y);
+	WriteNumber(HeaderVolumeDimensions + 4, VolumeDimensions.Z);
+	for (int32 BrickIndex = 0; BrickIndex < GetBrickCount(); BrickIndex++)
+	{
+		const int64 Entry = HeaderBricks + int64(HeaderVoxelsPerBrick) * BrickIndex;
+		const int32 Slot = BrickToSlot[BrickIndex];
+		WriteNumber(Entry, Slot == INDEX_NONE ? 0 : Slot);
+		WriteVoxel(Entry + 2, BrickMinValues.IsValidIndex(BrickIndex) ? BrickMinValues[BrickIndex] : 0.0f);
+	}
+	return true;
+}
@@ -0,0 +1,99 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "VolumeAsset/VolumeConversionStage.h"
+
+#include "VolumeAsset/Loaders/VolumeLoader.h"
+#include "VoxelKernels.h"
+
+void FVolumeConversionStage::Run(
+	const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+{
+	VoxelKernels::FindMinMax(VolumeInfo.OriginalFormat, InArray, VolumeInfo.GetTotalVoxels(), VolumeInfo.MinValue,
+		VolumeInfo.MaxValue, VolumeInfo.bIsBigEndian);
+	RunWithKnownRange(InArray, OutArray, VolumeInfo, bNormalize, bConvertToFloat);
+}
+
+void FVolumeConversionStage::RunWithKnownRange(
+	const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat)
+{
+	const int64 VoxelCount = VolumeInfo.GetTotalVoxels();
+	// Empty (or all NaN) volumes leave the range at max/lowest, use an empty range instead so that nothing divides by infinity.
+	if (VolumeInfo.MinValue > VolumeInfo.MaxValue)
+	{
+		VolumeInfo.MinValue = VolumeInfo.MaxValue = 0.0f;
+	}
+
+	VolumeInfo.Histogram.SetNumZeroed(HistogramBinCount);
+	if (bNormalize)
+	{
+		// We want to normalize and cap at G16, perform that normalization.
+		VoxelKernels::Normalize(VolumeInfo.OriginalFormat, InArray, VoxelCount, OutArray, VolumeInfo.MinValue,
+			VolumeInfo.MaxValue, VolumeInfo.Histogram, VolumeInfo.bIsBigEndian);
+	}
+	else if (bConvertToFloat)
+	{
+		VoxelKernels::ConvertToFloat(VolumeInfo.OriginalFormat, InArray, VoxelCount, reinterpret_cast<float*>(OutArray),
+			VolumeInfo.Histogram, VolumeInfo.MinValue, VolumeInfo.MaxValue, VolumeInfo.bIsBigEndian);
+	}
+	else
+	{
+		if (VolumeInfo.bIsBigEndian)
+		{
+			VoxelKernels::SwapBytes(VolumeInfo.OriginalFormat, InArray, VoxelCount, OutArray);
+		}
+		else if (InArray != OutArray)
+		{
+			FMemory::Memcpy(OutArray, InArray, VolumeInfo.GetByteSize());
+		}
+		VoxelKernels::AccumulateHistogram(
+			VolumeInfo.OriginalFormat, OutArray, VoxelCount, VolumeInfo.MinValue, VolumeInfo.MaxValue, VolumeInfo.Histogram);
+	}
+
+	ComputePercentiles(VolumeInfo.Histogram, VolumeInfo.MinValue, VolumeInfo.MaxValue, VolumeInfo.LowPercentileValue,
+		VolumeInfo.HighPercentileValue);
+
+	VolumeInfo.bIsNormalized = bNormalize;
+	VolumeInfo.ActualFormat = IVolumeLoader::GetConvertedFormat(VolumeInfo.OriginalFormat, bNormalize, bConvertToFloat);
+	VolumeInfo.BytesPerVoxel = FVolumeInfo::VoxelFormatByteSize(VolumeInfo.ActualFormat);
+
+	// Window the freshly loaded volume to the percentiles, so outliers don't squash everything else into a few TF texels.
+	VolumeInfo.DefaultWindowingParameters = VolumeInfo.GetPercentileWindowingParameters();
+}
+
+void FVolumeConversionStage::ComputePercentiles(
+	const TArray<int64>& Histogram, const float Min, const float Max, float& OutLow, float& OutHigh)
+{
+	OutLow = Min;
+	OutHigh = Max;
+
+	int64 TotalCount = 0;
+	for (const int64 Count : Histogram)
+	{
+		TotalCount += Count;
+	}
+	if (TotalCount == 0)
+	{
+		return;
+	}
+
+	const double BinWidth = (double(Max) - Min) / Histogram.Num();
+	const double LowCount = LowPercentile * double(TotalCount);
+	const double HighCount = HighPercentile * double(TotalCount);
+	bool bFoundLow = false;
+	int64 CumulativeCount = 0;
+	for (int32 Bin = 0; Bin < Histogram.Num(); Bin++)
+	{
+		CumulativeCount += Histogram[Bin];
+		if (!bFoundLow && CumulativeCount > LowCount)
+		{
+			OutLow = static_cast<float>(Min + Bin * BinWidth);
+			bFoundLow = true;
+		}
+		if (CumulativeCount >= HighCount)
+		{
+			OutHigh = FMath::Min(static_cast<float>(Min + (Bin + 1) * BinWidth), Max);
+			return;
+		}
+	}
+}
@@ -7,12 +7,12 @@
 
 int64 FVolumeInfo::GetByteSize() const
 {
-	return Dimensions.X * Dimensions.Y * Dimensions.Z * BytesPerVoxel;
+	return GetTotalVoxels() * BytesPerVoxel;
 }
 
 int64 FVolumeInfo::GetTotalVoxels() const
 {
-	return Dimensions.X * Dimensions.Y * Dimensions.Z;
+	return (int64) Dimensions.X * Dimensions.Y * Dimensions.Z;
 }
 
 float FVolumeInfo::NormalizeValue(float InValue)
@@ -54,6 +54,33 @@ float FVolumeInfo::DenormalizeRange(float InRange)
 	return (InRange * (MaxValue - MinValue));
 }
 
+bool FVolumeInfo::HasHistogram() const
+{
+	return Histogram.Num() > 0;
+}
+
+FWindowingParameters FVolumeInfo::GetPercentileWindowingParameters() const
+{
+	// Nothing to window to in volumes loaded before the histogram existed, or with a single value.
+	if (!HasHistogram() || !(HighPercentileValue > LowPercentileValue))
+	{
+		return DefaultWindowingParameters;
+	}
+
+	float Low = LowPercentileValue;
+	float High = HighPercentileValue;
+	if (bIsNormalized)
+	{
+		Low = (Low - MinValue) / (MaxValue - MinValue);
+		High = (High - MinValue) / (MaxValue - MinValue);
+	}
+
+	FWindowingParameters Parameters = DefaultWindowingParameters;
+	Parameters.Center = (Low + High) / 2;
+	Parameters.Width = High - Low;
+	return Parameters;
+}
+
 int32 FVolumeInfo::VoxelFormatByteSize(EVolumeVoxelFormat InFormat)
 {
 	switch (InFormat)
@@ -133,9 +160,12 @@ void FVolumeInfo::UpdateMinMaxSliceNumber(int SliceNumber)
 FString FVolumeInfo::ToString() const
 {
 	FString text = "File name " + DataFileName + " details:" + "\nDimensions = " + Dimensions.ToString() +
-				   "\nSpacing : " + Spacing.ToString() + "\nWorld Size MM : " + Dimensions.ToString() +
+				   "\nSpacing : " + Spacing.ToString() + "\nWorld Size MM : " + WorldDimensions.ToString() +
+				   "\nOrigin : " + Origin.ToString() + "\nDirection : " + Direction.GetScaledAxis(EAxis::X).ToString() + " " +
+				   Direction.GetScaledAxis(EAxis::Y).ToString() + " " + Direction.GetScaledAxis(EAxis::Z).ToString() +
 				   "\nDefault window center : " + FString::SanitizeFloat(DefaultWindowingParameters.Center) +
 				   "\nDefault window width : " + FString::SanitizeFloat(DefaultWindowingParameters.Width) + "\nOriginal Range : [" +
-				   FString::SanitizeFloat(MinValue) + " - " + FString::SanitizeFloat(MaxValue) + "]";
+				   FString::SanitizeFloat(MinValue) + " - " + FString::SanitizeFloat(MaxValue) + "]" + "\nPercentile Range : [" +
+				   FString::SanitizeFloat(LowPercentileValue) + " - " + FString::SanitizeFloat(HighPercentileValue) + "]";
 	return text;
 }
@@ -10,6 +10,7 @@
 #include "TextureUtilities.h"
 #include "VolumeAsset/Loaders/DCMTKLoader.h"
 #include "VolumeAsset/Loaders/MHDLoader.h"
+#include "VolumeAsset/Loaders/NRRDLoader.h"
 #include "VolumeAsset/VolumeAsset.h"
 
 bool UVolumeTextureToolkitBPLibrary::CreateVolumeTextureAsset(UVolumeTexture*& OutTexture, FString AssetName, FString FolderName,
@@ -21,29 +22,10 @@ bool UVolumeTextureToolkitBPLibrary::CreateVolumeTextureAsset(UVolumeTexture*& O
 
 UVolumeAsset* UVolumeTextureToolkitBPLibrary::LoadVolumeFromFileDialog(const bool& bNormalize)
 {
-	// Get best window for file picker dialog.
-	TSharedPtr<SWindow> ParentWindow = FSlateApplication::Get().FindBestParentWindowForDialogs(TSharedPtr<SWindow>());
-	const void* ParentWindowHandle = (ParentWindow.IsValid() && ParentWindow->GetNativeWindow().IsValid())
-										 ? ParentWindow->GetNativeWindow()->GetOSWindowHandle()
-										 : nullptr;
-
-	TArray<FString> FileNames;
-	// Open the file picker for Volume files.
-	bool Success = FDesktopPlatformModule::Get()->OpenFileDialog(
-		ParentWindowHandle, "Select volumetric file", "", "", ".mhd;.dcm", 0, FileNames);
-	if (FileNames.Num() > 0)
+	FString FileName;
+	if (OpenVolumeFileDialog(FileName))
 	{
-		FString FileName = FileNames[0];
-		IVolumeLoader* Loader = nullptr;
-		if (FileName.EndsWith(".mhd"))
-		{
-			Loader = UMHDLoader::Get();
-		}
-		else
-		{
-			Loader = UDCMTKLoader::Get();
-		}
-		UVolumeAsset* OutAsset = Loader->CreateVolumeFromFile(FileName, bNormalize, !bNormalize);
+		UVolumeAsset* OutAsset = GetLoaderForFile(FileName)->CreateVolumeFromFile(FileName, bNormalize, !bNormalize);
 
 		if (OutAsset)
 		{
@@ -60,9 +42,40 @@ UVolumeAsset* UVolumeTextureToolkitBPLibrary::LoadVolumeFromFileDialog(const boo
 			UE_LOG(LogTemp, Error, TEXT("Creating Volume asset from filename %s failed."), *FileName);
 		}
 	}
-	else
+	return nullptr;
+}
+
+bool UVolumeTextureToolkitBPLibrary::OpenVolumeFileDialog(FString& OutFileName)
+{
+	// Get best window for file picker dialog.
+	TSharedPtr<SWindow> ParentWindow = FSlateApplication::Get().FindBestParentWindowForDialogs(TSharedPtr<SWindow>());
+	const void* ParentWindowHandle = (ParentWindow.IsValid() && ParentWindow->GetNativeWindow().IsValid())
+										 ? ParentWindow->GetNativeWindow()->GetOSWindowHandle()
+										 : nullptr;
+
+	TArray<FString> FileNames;
+	// Open the file picker for Volume files.
+	bool Success = FDesktopPlatformModule::Get()->OpenFileDialog(
+		ParentWindowHandle, "Select volumetric file", "", "", ".mhd;.dcm;.nrrd;.nhdr", 0, FileNames);
+	if (FileNames.Num() > 0)
+	{
+		OutFileName = FileNames[0];
+		return true;
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("Loading of Volume file cancelled. Dialog creation failed or no file was selected."));
+	return false;
+}
+
+IVolumeLoader* UVolumeTextureToolkitBPLibrary::GetLoaderForFile(const FString& FileName)
+{
+	if (FileName.EndsWith(".mhd"))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Loading of Volume file cancelled. Dialog creation failed or no file was selected."));
+		return UMHDLoader::Get();
 	}
-	return nullptr;
+	if (FileName.EndsWith(".nrrd") || FileName.EndsWith(".nhdr"))
+	{
+		return UNRRDLoader::Get();
+	}
+	return UDCMTKLoader::Get();
 }
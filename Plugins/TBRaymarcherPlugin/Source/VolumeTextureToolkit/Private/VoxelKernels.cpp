@@ -0,0 +1,702 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#include "VoxelKernels.h"
+
+#include "Async/ParallelFor.h"
+#include "Misc/ScopeLock.h"
+
+#include <limits>
+
+// SSE4.1 is needed for the 8bit signed, 16bit unsigned and 32bit min/max and for packing to uint16 (the byte shuffle used for
+// swapping is SSSE3, which every SSE4.1 CPU has too). Without it, the plain loops get used (and auto-vectorized by the compiler
+// where possible).
+#define VOXEL_KERNELS_SSE4 (PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_ALWAYS_HAS_SSE4_1)
+
+#if VOXEL_KERNELS_SSE4
+#include <smmintrin.h>
+#endif
+
+namespace
+{
+// Number of voxels processed by a single ParallelFor task. Large enough to keep the scheduling overhead negligible, small enough
+// to balance well on volumes of a few MB.
+constexpr int64 ChunkElementCount = 1 << 20;
+
+// Size of the buffer byte swapped voxels get written to. Small enough to stay in L1 until the kernel reads the voxels back.
+constexpr int64 SwapBlockByteSize = 16 * 1024;
+
+int32 GetNumChunks(const int64 ElementCount)
+{
+	return static_cast<int32>(FMath::DivideAndRoundUp(ElementCount, ChunkElementCount));
+}
+
+/// Calls Body(ChunkIndex, ChunkStart, ChunkElementCount) for every chunk of the array in parallel.
+/// When an array gets converted in place into a type ShrinkFactor times smaller, the output of chunk K overwrites the input of
+/// chunk K / ShrinkFactor. The chunks then get processed in waves [0, 1), [1, ShrinkFactor), [ShrinkFactor, ShrinkFactor^2)...
+/// so that every wave only overwrites the input of chunks finished by the previous waves.
+template <typename FunctionType>
+void ParallelForChunks(const int64 ElementCount, const FunctionType& Body, const int32 ShrinkFactor = 1)
+{
+	const int32 NumChunks = GetNumChunks(ElementCount);
+	const auto RunChunks = [&](const int32 FirstChunk, const int32 EndChunk)
+	{
+		ParallelFor(
+			EndChunk - FirstChunk,
+			[&](int32 WaveIndex)
+			{
+				const int32 ChunkIndex = FirstChunk + WaveIndex;
+				const int64 ChunkStart = int64(ChunkIndex) * ChunkElementCount;
+				Body(ChunkIndex, ChunkStart, FMath::Min(ChunkElementCount, ElementCount - ChunkStart));
+			},
+			EndChunk - FirstChunk > 1 ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+	};
+
+	if (ShrinkFactor <= 1)
+	{
+		RunChunks(0, NumChunks);
+		return;
+	}
+
+	for (int32 WaveStart = 0, WaveEnd = 1; WaveStart < NumChunks; WaveStart = WaveEnd, WaveEnd *= ShrinkFactor)
+	{
+		RunChunks(WaveStart, FMath::Min(WaveEnd, NumChunks));
+	}
+}
+
+/// Returns the ShrinkFactor for ParallelForChunks.
+template <typename InType, typename OutType>
+int32 GetShrinkFactor(const uint8* InArray, const uint8* OutArray)
+{
+	return InArray == OutArray ? static_cast<int32>(sizeof(InType) / sizeof(OutType)) : 1;
+}
+
+/// Copies Count voxels from In to Out with their bytes swapped, 16 bytes at a time.
+template <typename T>
+void SwapBytesBlock(const T* In, T* Out, const int64 Count)
+{
+	int64 Index = 0;
+#if VOXEL_KERNELS_SSE4
+	if constexpr (sizeof(T) == 2 || sizeof(T) == 4)
+	{
+		const __m128i ShuffleMask = sizeof(T) == 2
+										? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+										: _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		constexpr int64 Lanes = 16 / sizeof(T);
+		for (; Index + Lanes <= Count; Index += Lanes)
+		{
+			const __m128i Value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(In + Index));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + Index), _mm_shuffle_epi8(Value, ShuffleMask));
+		}
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		Out[Index] = VoxelKernels::SwapVoxelBytes(In[Index]);
+	}
+}
+
+/// Calls Body(BlockData, BlockStart, BlockCount) for the Count voxels at Data. Without swapping, that's a single call on Data
+/// itself. With it, the voxels get swapped into a small buffer one block at a time and Body reads them from there while they're
+/// still in L1, so the swap doesn't need its own pass over the data. Body may overwrite the voxels at Data it already got.
+template <typename T, typename FunctionType>
+FORCEINLINE void ForEachVoxelBlock(const T* Data, const int64 Count, const bool bSwapBytes, const FunctionType& Body)
+{
+	if (sizeof(T) == 1 || !bSwapBytes)
+	{
+		Body(Data, 0, Count);
+		return;
+	}
+
+	constexpr int64 BlockElementCount = SwapBlockByteSize / sizeof(T);
+	T Block[BlockElementCount];
+	for (int64 BlockStart = 0; BlockStart < Count; BlockStart += BlockElementCount)
+	{
+		const int64 BlockCount = FMath::Min(BlockElementCount, Count - BlockStart);
+		SwapBytesBlock(Data + BlockStart, Block, BlockCount);
+		Body(Block, BlockStart, BlockCount);
+	}
+}
+
+/// Normalizes a single value exactly like UVolumeTextureToolkit::NormalizeArrayWithRange does.
+template <typename OutType>
+FORCEINLINE OutType NormalizeValue(const float Value, const float InMin, const float InMax)
+{
+	const OutType OutMin = std::numeric_limits<OutType>::min();
+	const OutType OutMax = std::numeric_limits<OutType>::max();
+
+	const float Normalized = (Value - InMin) / (InMax - InMin);
+	return static_cast<OutType>(OutMin + (Normalized * (OutMax - OutMin)));
+}
+
+/// Histogram filled by all chunks of a kernel. Every chunk counts its voxels into its own bins first and only takes the lock to add
+/// them up once it's done. Does nothing if no histogram was requested.
+struct FSharedHistogram
+{
+	FSharedHistogram(const TArrayView<int64> InBins, const float InMin, const float InMax)
+		: Bins(InBins), Min(InMin), Scale(InMax > InMin ? InBins.Num() / (InMax - InMin) : 0.0f)
+	{
+	}
+
+	/// Counts Count values of the (converted) data, which map to the bins linearly from [Min, Max].
+	template <typename T>
+	void AccumulateChunk(const T* Data, const int64 Count)
+	{
+		if (Bins.Num() == 0)
+		{
+			return;
+		}
+
+		const int32 LastBin = Bins.Num() - 1;
+		TArray<uint32> ChunkBins;
+		ChunkBins.SetNumZeroed(Bins.Num());
+		for (int64 Index = 0; Index < Count; Index++)
+		{
+			// NaNs convert to INT_MIN and land in the first bin, together with everything below Min.
+			const int32 Bin = static_cast<int32>((static_cast<float>(Data[Index]) - Min) * Scale);
+			ChunkBins[FMath::Clamp(Bin, 0, LastBin)]++;
+		}
+
+		FScopeLock Lock(&CriticalSection);
+		for (int32 Bin = 0; Bin <= LastBin; Bin++)
+		{
+			Bins[Bin] += ChunkBins[Bin];
+		}
+	}
+
+	TArrayView<int64> Bins;
+	float Min;
+	float Scale;
+	FCriticalSection CriticalSection;
+};
+
+#if VOXEL_KERNELS_SSE4
+/// Per-type SSE operations used by the min/max reduction. Min and Max take the new values as the first argument, so that
+/// _mm_min_ps/_mm_max_ps skip NaNs the same way the scalar comparisons do.
+template <typename T>
+struct TSimdMinMax;
+
+template <>
+struct TSimdMinMax<uint8>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const uint8* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const uint8 Value) { return _mm_set1_epi8(static_cast<char>(Value)); }
+	static void Store(uint8* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epu8(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epu8(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<int8>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const int8* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const int8 Value) { return _mm_set1_epi8(Value); }
+	static void Store(int8* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epi8(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epi8(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<uint16>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const uint16* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const uint16 Value) { return _mm_set1_epi16(static_cast<short>(Value)); }
+	static void Store(uint16* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epu16(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epu16(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<int16>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const int16* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const int16 Value) { return _mm_set1_epi16(Value); }
+	static void Store(int16* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epi16(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epi16(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<uint32>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const uint32* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const uint32 Value) { return _mm_set1_epi32(static_cast<int>(Value)); }
+	static void Store(uint32* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epu32(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epu32(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<int32>
+{
+	using RegisterType = __m128i;
+	static RegisterType Load(const int32* Data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)); }
+	static RegisterType Set(const int32 Value) { return _mm_set1_epi32(Value); }
+	static void Store(int32* Data, const RegisterType Register) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Data), Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_epi32(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_epi32(Value, Current); }
+};
+
+template <>
+struct TSimdMinMax<float>
+{
+	using RegisterType = __m128;
+	static RegisterType Load(const float* Data) { return _mm_loadu_ps(Data); }
+	static RegisterType Set(const float Value) { return _mm_set1_ps(Value); }
+	static void Store(float* Data, const RegisterType Register) { _mm_storeu_ps(Data, Register); }
+	static RegisterType Min(const RegisterType Value, const RegisterType Current) { return _mm_min_ps(Value, Current); }
+	static RegisterType Max(const RegisterType Value, const RegisterType Current) { return _mm_max_ps(Value, Current); }
+};
+
+/// Loads 4 voxels and converts them to float, rounding the same way a scalar static_cast<float> does.
+FORCEINLINE __m128 LoadAsFloat(const float* Data)
+{
+	return _mm_loadu_ps(Data);
+}
+
+FORCEINLINE __m128 LoadAsFloat(const int32* Data)
+{
+	return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Data)));
+}
+
+FORCEINLINE __m128 LoadAsFloat(const uint32* Data)
+{
+	// SSE can only convert signed ints. Both 16bit halves convert exactly and the high half times 65536 is still exact, so the
+	// only rounding happens in the final addition - same as in a scalar uint32 -> float conversion.
+	const __m128i Value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data));
+	const __m128 High = _mm_cvtepi32_ps(_mm_srli_epi32(Value, 16));
+	const __m128 Low = _mm_cvtepi32_ps(_mm_and_si128(Value, _mm_set1_epi32(0xFFFF)));
+	return _mm_add_ps(_mm_mul_ps(High, _mm_set1_ps(65536.0f)), Low);
+}
+FORCEINLINE __m128 LoadAsFloat(const uint8* Data)
+{
+	int32 Packed;
+	FMemory::Memcpy(&Packed, Data, sizeof(Packed));
+	return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(Packed)));
+}
+
+FORCEINLINE __m128 LoadAsFloat(const int8* Data)
+{
+	int32 Packed;
+	FMemory::Memcpy(&Packed, Data, sizeof(Packed));
+	return _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(Packed)));
+}
+
+FORCEINLINE __m128 LoadAsFloat(const uint16* Data)
+{
+	return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Data))));
+}
+
+FORCEINLINE __m128 LoadAsFloat(const int16* Data)
+{
+	return _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Data))));
+}
+#endif
+
+/// Finds the min/max of a single chunk, combined with the incoming InOutMin/InOutMax.
+template <typename T>
+void FindMinMaxChunk(const T* Data, const int64 Count, T& InOutMin, T& InOutMax)
+{
+	T Min = InOutMin;
+	T Max = InOutMax;
+	int64 Index = 0;
+
+#if VOXEL_KERNELS_SSE4
+	using FSimd = TSimdMinMax<T>;
+	constexpr int64 Lanes = sizeof(typename FSimd::RegisterType) / sizeof(T);
+	if (Count >= Lanes)
+	{
+		typename FSimd::RegisterType MinRegister = FSimd::Set(Min);
+		typename FSimd::RegisterType MaxRegister = FSimd::Set(Max);
+		for (; Index + Lanes <= Count; Index += Lanes)
+		{
+			const typename FSimd::RegisterType Value = FSimd::Load(Data + Index);
+			MinRegister = FSimd::Min(Value, MinRegister);
+			MaxRegister = FSimd::Max(Value, MaxRegister);
+		}
+
+		T LaneMins[Lanes];
+		T LaneMaxs[Lanes];
+		FSimd::Store(LaneMins, MinRegister);
+		FSimd::Store(LaneMaxs, MaxRegister);
+		for (int64 Lane = 0; Lane < Lanes; Lane++)
+		{
+			Min = LaneMins[Lane] < Min ? LaneMins[Lane] : Min;
+			Max = LaneMaxs[Lane] > Max ? LaneMaxs[Lane] : Max;
+		}
+	}
+#endif
+
+	for (; Index < Count; Index++)
+	{
+		if (Data[Index] < Min)
+		{
+			Min = Data[Index];
+		}
+		if (Data[Index] > Max)
+		{
+			Max = Data[Index];
+		}
+	}
+
+	InOutMin = Min;
+	InOutMax = Max;
+}
+
+template <typename T>
+void FindMinMaxTyped(const uint8* InArray, const int64 ElementCount, float& OutMin, float& OutMax, const bool bSwapBytes)
+{
+	const T* Data = reinterpret_cast<const T*>(InArray);
+
+	TArray<T> ChunkMins;
+	TArray<T> ChunkMaxs;
+	ChunkMins.Init(std::numeric_limits<T>::max(), GetNumChunks(ElementCount));
+	ChunkMaxs.Init(std::numeric_limits<T>::lowest(), GetNumChunks(ElementCount));
+
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			ForEachVoxelBlock(Data + ChunkStart, ChunkCount, bSwapBytes,
+				[&](const T* Block, int64 BlockStart, int64 BlockCount)
+				{ FindMinMaxChunk<T>(Block, BlockCount, ChunkMins[ChunkIndex], ChunkMaxs[ChunkIndex]); });
+		});
+
+	T Min = std::numeric_limits<T>::max();
+	T Max = std::numeric_limits<T>::lowest();
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunkMins.Num(); ChunkIndex++)
+	{
+		Min = ChunkMins[ChunkIndex] < Min ? ChunkMins[ChunkIndex] : Min;
+		Max = ChunkMaxs[ChunkIndex] > Max ? ChunkMaxs[ChunkIndex] : Max;
+	}
+
+	OutMin = (float) Min;
+	OutMax = (float) Max;
+}
+
+/// Normalizes 8 and 16bit types through a table with the normalized value of every possible input value. The table is filled
+/// by the scalar code, so the results are identical to it, while the per-voxel work is reduced to a single lookup.
+/// Byte swapping is done by the table as well - every entry holds the value for its index with swapped bytes.
+template <typename InType, typename OutType>
+void NormalizeWithLookupTable(const uint8* InArray, const int64 ElementCount, uint8* OutArray, const float InMin,
+	const float InMax, FSharedHistogram& Histogram, const bool bSwapBytes)
+{
+	static_assert(sizeof(InType) <= 2, "Lookup tables are only used for 8 and 16bit types.");
+	constexpr int32 Lowest = std::numeric_limits<InType>::lowest();
+	constexpr int32 TableSize = 1 << (8 * sizeof(InType));
+
+	TArray<OutType> LookupTable;
+	LookupTable.SetNumUninitialized(TableSize);
+	for (int32 TableIndex = 0; TableIndex < TableSize; TableIndex++)
+	{
+		// Values outside of the range are never in the data when the range comes from FindMinMax. Clamp them anyway, so that
+		// the float -> int conversion of their (unused) entries stays defined.
+		const InType StoredValue = static_cast<InType>(TableIndex + Lowest);
+		const InType ActualValue = bSwapBytes ? VoxelKernels::SwapVoxelBytes(StoredValue) : StoredValue;
+		const float Value = FMath::Clamp(static_cast<float>(ActualValue), InMin, InMax);
+		LookupTable[TableIndex] = NormalizeValue<OutType>(Value, InMin, InMax);
+	}
+
+	const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+	OutType* OutCastArray = reinterpret_cast<OutType*>(OutArray);
+	const OutType* Table = LookupTable.GetData();
+
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			const int64 ChunkEnd = ChunkStart + ChunkCount;
+			for (int64 Index = ChunkStart; Index < ChunkEnd; Index++)
+			{
+				OutCastArray[Index] = Table[static_cast<int32>(InCastArray[Index]) - Lowest];
+			}
+			Histogram.AccumulateChunk(OutCastArray + ChunkStart, ChunkCount);
+		},
+		GetShrinkFactor<InType, OutType>(InArray, OutArray));
+}
+
+/// Normalizes 32bit types to uint16. The SSE path does the same float operations as the scalar code, in the same order, only 8
+/// voxels at a time. The division is kept (rather than multiplying by a reciprocal), because the reciprocal rounds differently
+/// and would change some of the results by 1.
+/// Works in place as well - within a chunk, every store only overwrites voxels that were already loaded.
+template <typename InType>
+void NormalizeToUInt16(const uint8* InArray, const int64 ElementCount, uint8* OutArray, const float InMin, const float InMax,
+	FSharedHistogram& Histogram, const bool bSwapBytes)
+{
+	const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+	uint16* OutCastArray = reinterpret_cast<uint16*>(OutArray);
+
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			ForEachVoxelBlock(InCastArray + ChunkStart, ChunkCount, bSwapBytes,
+				[&](const InType* Block, int64 BlockStart, int64 BlockCount)
+				{
+					uint16* Out = OutCastArray + ChunkStart + BlockStart;
+					int64 Index = 0;
+#if VOXEL_KERNELS_SSE4
+					const __m128 MinRegister = _mm_set1_ps(InMin);
+					const __m128 RangeRegister = _mm_set1_ps(InMax - InMin);
+					const __m128 OutRangeRegister = _mm_set1_ps(static_cast<float>(MAX_uint16));
+					for (; Index + 8 <= BlockCount; Index += 8)
+					{
+						const __m128 Low = _mm_mul_ps(
+							_mm_div_ps(_mm_sub_ps(LoadAsFloat(Block + Index), MinRegister), RangeRegister), OutRangeRegister);
+						const __m128 High = _mm_mul_ps(
+							_mm_div_ps(_mm_sub_ps(LoadAsFloat(Block + Index + 4), MinRegister), RangeRegister), OutRangeRegister);
+						// Truncates like the scalar float -> uint16 cast. All values are within [0, 65535], so packing never
+						// saturates.
+						_mm_storeu_si128(
+							reinterpret_cast<__m128i*>(Out + Index), _mm_packus_epi32(_mm_cvttps_epi32(Low), _mm_cvttps_epi32(High)));
+					}
+#endif
+					for (; Index < BlockCount; Index++)
+					{
+						Out[Index] = NormalizeValue<uint16>(static_cast<float>(Block[Index]), InMin, InMax);
+					}
+				});
+			Histogram.AccumulateChunk(OutCastArray + ChunkStart, ChunkCount);
+		},
+		GetShrinkFactor<InType, uint16>(InArray, OutArray));
+}
+
+/// Handles the empty and constant (zero range) arrays, for which the normalization formula divides by zero.
+template <typename OutType>
+bool HandleDegenerateRange(
+	const int64 ElementCount, uint8* OutArray, const float InMin, const float InMax, const TArrayView<int64> OutHistogram)
+{
+	if (ElementCount <= 0)
+	{
+		return true;
+	}
+	if (InMin == InMax)
+	{
+		FMemory::Memzero(OutArray, ElementCount * sizeof(OutType));
+		if (OutHistogram.Num() > 0)
+		{
+			OutHistogram[0] += ElementCount;
+		}
+		return true;
+	}
+	return false;
+}
+
+/// Converts to float 4 voxels at a time. Works in place for 32bit types, every voxel is loaded before it's overwritten.
+template <typename InType>
+void ConvertToFloatTyped(
+	const uint8* InArray, const int64 ElementCount, float* OutArray, FSharedHistogram& Histogram, const bool bSwapBytes)
+{
+	const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			ForEachVoxelBlock(InCastArray + ChunkStart, ChunkCount, bSwapBytes,
+				[&](const InType* Block, int64 BlockStart, int64 BlockCount)
+				{
+					float* Out = OutArray + ChunkStart + BlockStart;
+					int64 Index = 0;
+#if VOXEL_KERNELS_SSE4
+					for (; Index + 4 <= BlockCount; Index += 4)
+					{
+						_mm_storeu_ps(Out + Index, LoadAsFloat(Block + Index));
+					}
+#endif
+					for (; Index < BlockCount; Index++)
+					{
+						Out[Index] = static_cast<float>(Block[Index]);
+					}
+				});
+			Histogram.AccumulateChunk(OutArray + ChunkStart, ChunkCount);
+		});
+}
+
+template <typename T>
+void SwapBytesTyped(const uint8* InArray, const int64 ElementCount, uint8* OutArray)
+{
+	const T* InCastArray = reinterpret_cast<const T*>(InArray);
+	T* OutCastArray = reinterpret_cast<T*>(OutArray);
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			SwapBytesBlock(InCastArray + ChunkStart, OutCastArray + ChunkStart, ChunkCount);
+		});
+}
+
+template <typename T>
+void AccumulateHistogramTyped(const uint8* InArray, const int64 ElementCount, FSharedHistogram& Histogram)
+{
+	const T* InCastArray = reinterpret_cast<const T*>(InArray);
+	ParallelForChunks(ElementCount,
+		[&](int32 ChunkIndex, int64 ChunkStart, int64 ChunkCount)
+		{
+			Histogram.AccumulateChunk(InCastArray + ChunkStart, ChunkCount);
+		});
+}
+}	 // namespace
+
+void VoxelKernels::FindMinMax(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ElementCount,
+	float& OutMin, float& OutMax, const bool bSwapBytes)
+{
+	switch (VoxelFormat)
+	{
+		case EVolumeVoxelFormat::UnsignedChar:
+			return FindMinMaxTyped<uint8>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::SignedChar:
+			return FindMinMaxTyped<int8>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::UnsignedShort:
+			return FindMinMaxTyped<uint16>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::SignedShort:
+			return FindMinMaxTyped<int16>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::UnsignedInt:
+			return FindMinMaxTyped<uint32>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::SignedInt:
+			return FindMinMaxTyped<int32>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		case EVolumeVoxelFormat::Float:
+			return FindMinMaxTyped<float>(InArray, ElementCount, OutMin, OutMax, bSwapBytes);
+		default:
+			ensure(false);
+	}
+}
+
+void VoxelKernels::Normalize(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ElementCount,
+	uint8* OutArray, const float InMin, const float InMax, const TArrayView<int64> OutHistogram, const bool bSwapBytes)
+{
+	// The histogram counts the normalized values, whose full range corresponds to [InMin, InMax].
+	const bool bIs8Bit = VoxelFormat == EVolumeVoxelFormat::UnsignedChar || VoxelFormat == EVolumeVoxelFormat::SignedChar;
+	FSharedHistogram Histogram(OutHistogram, 0.0f, bIs8Bit ? MAX_uint8 : MAX_uint16);
+
+	switch (VoxelFormat)
+	{
+		case EVolumeVoxelFormat::UnsignedChar:
+			if (!HandleDegenerateRange<uint8>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeWithLookupTable<uint8, uint8>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::SignedChar:
+			if (!HandleDegenerateRange<uint8>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeWithLookupTable<int8, uint8>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::UnsignedShort:
+			if (!HandleDegenerateRange<uint16>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeWithLookupTable<uint16, uint16>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::SignedShort:
+			if (!HandleDegenerateRange<uint16>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeWithLookupTable<int16, uint16>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::UnsignedInt:
+			if (!HandleDegenerateRange<uint16>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeToUInt16<uint32>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::SignedInt:
+			if (!HandleDegenerateRange<uint16>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeToUInt16<int32>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		case EVolumeVoxelFormat::Float:
+			if (!HandleDegenerateRange<uint16>(ElementCount, OutArray, InMin, InMax, OutHistogram))
+			{
+				NormalizeToUInt16<float>(InArray, ElementCount, OutArray, InMin, InMax, Histogram, bSwapBytes);
+			}
+			return;
+		default:
+			ensure(false);
+	}
+}
+
+void VoxelKernels::ConvertToFloat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ElementCount,
+	float* OutArray, const TArrayView<int64> OutHistogram, const float HistogramMin, const float HistogramMax, const bool bSwapBytes)
+{
+	FSharedHistogram Histogram(OutHistogram, HistogramMin, HistogramMax);
+
+	switch (VoxelFormat)
+	{
+		case EVolumeVoxelFormat::UnsignedChar:
+			return ConvertToFloatTyped<uint8>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::SignedChar:
+			return ConvertToFloatTyped<int8>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::UnsignedShort:
+			return ConvertToFloatTyped<uint16>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::SignedShort:
+			return ConvertToFloatTyped<int16>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::UnsignedInt:
+			return ConvertToFloatTyped<uint32>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::SignedInt:
+			return ConvertToFloatTyped<int32>(InArray, ElementCount, OutArray, Histogram, bSwapBytes);
+		case EVolumeVoxelFormat::Float:
+			if (bSwapBytes)
+			{
+				return ConvertToFloatTyped<float>(InArray, ElementCount, OutArray, Histogram, true);
+			}
+			if (reinterpret_cast<const uint8*>(OutArray) != InArray)
+			{
+				FMemory::Memcpy(OutArray, InArray, ElementCount * sizeof(float));
+			}
+			return AccumulateHistogramTyped<float>(InArray, ElementCount, Histogram);
+		default:
+			ensure(false);
+	}
+}
+
+void VoxelKernels::SwapBytes(
+	const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ElementCount, uint8* OutArray)
+{
+	switch (VoxelFormat)
+	{
+		case EVolumeVoxelFormat::UnsignedChar:
+		case EVolumeVoxelFormat::SignedChar:
+			if (OutArray != InArray)
+			{
+				FMemory::Memcpy(OutArray, InArray, ElementCount);
+			}
+			return;
+		case EVolumeVoxelFormat::UnsignedShort:
+		case EVolumeVoxelFormat::SignedShort:
+			return SwapBytesTyped<uint16>(InArray, ElementCount, OutArray);
+		case EVolumeVoxelFormat::UnsignedInt:
+		case EVolumeVoxelFormat::SignedInt:
+		case EVolumeVoxelFormat::Float:
+			return SwapBytesTyped<uint32>(InArray, ElementCount, OutArray);
+		default:
+			ensure(false);
+	}
+}
+
+void VoxelKernels::AccumulateHistogram(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ElementCount,
+	const float Min, const float Max, const TArrayView<int64> OutHistogram)
+{
+	FSharedHistogram Histogram(OutHistogram, Min, Max);
+	switch (VoxelFormat)
+	{
+		case EVolumeVoxelFormat::UnsignedChar:
+			return AccumulateHistogramTyped<uint8>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::SignedChar:
+			return AccumulateHistogramTyped<int8>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::UnsignedShort:
+			return AccumulateHistogramTyped<uint16>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::SignedShort:
+			return AccumulateHistogramTyped<int16>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::UnsignedInt:
+			return AccumulateHistogramTyped<uint32>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::SignedInt:
+			return AccumulateHistogramTyped<int32>(InArray, ElementCount, Histogram);
+		case EVolumeVoxelFormat::Float:
+			return AccumulateHistogramTyped<float>(InArray, ElementCount, Histogram);
+		default:
+			ensure(false);
+	}
+}
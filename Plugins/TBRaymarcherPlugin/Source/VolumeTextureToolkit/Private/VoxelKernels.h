@@ -0,0 +1,79 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+// Vectorized, parallel kernels used by the UVolumeTextureToolkit *ByFormat functions.
+// They produce exactly the same output as the serial scalar templates in TextureUtilities.h.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ByteSwap.h"
+#include "VolumeAsset/VolumeInfo.h"
+
+#include <type_traits>
+
+// All kernels taking bSwapBytes can read voxels stored in the opposite byte order (e.g. big-endian files). The voxels get swapped
+// block by block into a small buffer right before they're processed, so no extra pass over the data is needed.
+
+namespace VoxelKernels
+{
+/// Returns the voxel with its bytes in the opposite order.
+template <typename T>
+FORCEINLINE T SwapVoxelBytes(const T Value)
+{
+	static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported voxel size.");
+	if constexpr (sizeof(T) == 1)
+	{
+		return Value;
+	}
+	else
+	{
+		using FBitsType = std::conditional_t<sizeof(T) == 2, uint16, std::conditional_t<sizeof(T) == 4, uint32, uint64>>;
+		FBitsType Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(T));
+		if constexpr (sizeof(T) == 2)
+		{
+			Bits = BYTESWAP_ORDER16(Bits);
+		}
+		else if constexpr (sizeof(T) == 4)
+		{
+			Bits = BYTESWAP_ORDER32(Bits);
+		}
+		else
+		{
+			Bits = BYTESWAP_ORDER64(Bits);
+		}
+		T Swapped;
+		FMemory::Memcpy(&Swapped, &Bits, sizeof(T));
+		return Swapped;
+	}
+}
+
+/// Parallel min/max reduction over ElementCount voxels of the provided format. Leaves OutMin/OutMax at float max/lowest if the
+/// array is empty (or only contains NaNs).
+void FindMinMax(EVolumeVoxelFormat VoxelFormat, const uint8* InArray, int64 ElementCount, float& OutMin, float& OutMax,
+	bool bSwapBytes = false);
+
+/// Parallel normalization of ElementCount voxels from the [InMin, InMax] range to the full range of the output type (uint8 for
+/// 8bit formats, uint16 otherwise). If InMin == InMax, all voxels are normalized to 0.
+/// InArray and OutArray can be the same array, in which case the normalized voxels are packed at its beginning.
+/// If OutHistogram isn't empty, every normalized voxel also gets counted into it, with the bins evenly spanning [InMin, InMax].
+/// Each chunk is counted right after it's normalized, while it's still in cache.
+void Normalize(EVolumeVoxelFormat VoxelFormat, const uint8* InArray, int64 ElementCount, uint8* OutArray, float InMin, float InMax,
+	TArrayView<int64> OutHistogram = {}, bool bSwapBytes = false);
+
+/// Parallel conversion of ElementCount voxels of the provided format to float. Float input just gets copied.
+/// InArray and OutArray can be the same array for 32bit formats.
+/// If OutHistogram isn't empty, the converted voxels also get counted into it, with the bins evenly spanning
+/// [HistogramMin, HistogramMax].
+void ConvertToFloat(EVolumeVoxelFormat VoxelFormat, const uint8* InArray, int64 ElementCount, float* OutArray,
+	TArrayView<int64> OutHistogram = {}, float HistogramMin = 0.0f, float HistogramMax = 0.0f, bool bSwapBytes = false);
+
+/// Parallel copy of ElementCount voxels with their bytes swapped. InArray and OutArray can be the same array.
+void SwapBytes(EVolumeVoxelFormat VoxelFormat, const uint8* InArray, int64 ElementCount, uint8* OutArray);
+
+/// Parallel count of ElementCount voxels into OutHistogram, with the bins evenly spanning [Min, Max]. Values outside of the range
+/// go into the first/last bin. If Min == Max, all voxels go into the first bin.
+void AccumulateHistogram(EVolumeVoxelFormat VoxelFormat, const uint8* InArray, int64 ElementCount, float Min, float Max,
+	TArrayView<int64> OutHistogram);
+}	 // namespace VoxelKernels
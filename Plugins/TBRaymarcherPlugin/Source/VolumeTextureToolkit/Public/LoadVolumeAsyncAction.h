@@ -0,0 +1,52 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "VolumeAsset/Loaders/VolumeLoadHandle.h"
+
+#include "LoadVolumeAsyncAction.generated.h"
+
+class UVolumeAsset;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FLoadVolumeProgressPin, float, Progress);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FLoadVolumeFinishedPin, UVolumeAsset*, VolumeAsset);
+
+/**
+ * Blueprint latent node loading a volume asynchronously (see IVolumeLoader::CreateVolumeFromFileAsync), so that the game keeps
+ * running while the file is read and converted.
+ */
+UCLASS()
+class VOLUMETEXTURETOOLKIT_API ULoadVolumeAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+public:
+	/** Called whenever the load advanced, with the loaded fraction in [0, 1].*/
+	UPROPERTY(BlueprintAssignable)
+	FLoadVolumeProgressPin OnProgress;
+
+	/** Called when the volume got loaded.*/
+	UPROPERTY(BlueprintAssignable)
+	FLoadVolumeFinishedPin OnVolumeLoaded;
+
+	/** Called if the volume couldn't be loaded.*/
+	UPROPERTY(BlueprintAssignable)
+	FLoadVolumeFinishedPin OnFailed;
+
+	/** Loads a volume from the provided MHD or DICOM file on a worker thread. If bNormalize is false, the volume is converted to
+	 * float.*/
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject",
+									 Keywords = "Load Volume DICOM MHD Async"),
+		Category = "VolumeTextureToolkit")
+	static ULoadVolumeAsyncAction* LoadVolumeFromFileAsync(UObject* WorldContextObject, const FString& FileName, bool bNormalize);
+
+	virtual void Activate() override;
+
+private:
+	FString FileName;
+
+	bool bNormalize = true;
+
+	TSharedPtr<FVolumeLoadHandle> Handle;
+};
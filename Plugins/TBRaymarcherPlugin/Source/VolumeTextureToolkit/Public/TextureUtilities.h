@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "Async/MappedFileHandle.h"
 #include "CoreMinimal.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Engine/VolumeTexture.h"
@@ -24,6 +25,30 @@
 class UTextureRenderTargetVolume;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTextureUtils, All, All);
+
+/** Read-only memory mapping of a whole RAW file. The data stays mapped for as long as this object lives. */
+struct VOLUMETEXTURETOOLKIT_API FMappedRawFile
+{
+	// Declared in this order so that the region gets unmapped before the handle gets closed.
+	TUniquePtr<IMappedFileHandle> Handle;
+	TUniquePtr<IMappedFileRegion> Region;
+
+	bool IsValid() const
+	{
+		return Region.IsValid();
+	}
+
+	const uint8* GetData() const
+	{
+		return Region ? Region->GetMappedPtr() : nullptr;
+	}
+
+	int64 GetSize() const
+	{
+		return Region ? Region->GetMappedSize() : 0;
+	}
+};
+
 class VOLUMETEXTURETOOLKIT_API UVolumeTextureToolkit
 {
 public:
@@ -37,13 +62,50 @@ public:
 	static void CreateVolumeTextureMip(
 		UVolumeTexture*& OutTexture, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData = nullptr);
 
-	/** Hacky fix to loading large volumes - crop the data to 2048 */
-	static void CropDataTo2K(uint8* BulkData, FIntVector& Dimensions, EPixelFormat PixelFormat);
+	/** Creates the volume texture 0th mip and lets FillMip write the voxel data straight into the locked mip bulk data. Use this
+	 * to convert data into the texture without an intermediate array.*/
+	static void CreateVolumeTextureMip(UVolumeTexture*& OutTexture, EPixelFormat PixelFormat, FIntVector Dimensions,
+		TFunctionRef<void(uint8* MipData)> FillMip);
+
+	/** Allocates a volume texture mip and lets FillMip write the voxel data into its locked bulk data. Doesn't touch any texture,
+	 * so it can run on any thread. Add the mip to the texture's platform data afterwards, on the game thread.*/
+	static FTexture2DMipMap* CreateVolumeMip(
+		EPixelFormat PixelFormat, FIntVector Dimensions, TFunctionRef<void(uint8* MipData)> FillMip);
+
+	/** Allocates a volume texture mip and copies BulkData into it (or zeroes it if BulkData is null). Can run on any thread.*/
+	static FTexture2DMipMap* CreateVolumeMip(EPixelFormat PixelFormat, FIntVector Dimensions, const uint8* BulkData);
+
+	/** Creates a transient Volume Texture around a mip made by CreateVolumeMip. Takes ownership of the mip.*/
+	static UVolumeTexture* CreateVolumeTextureTransientFromMip(
+		EPixelFormat PixelFormat, FIntVector Dimensions, FTexture2DMipMap* Mip, bool ShouldUpdateResource = true);
+
+	/** Volume textures can't be larger than 2048 in any dimension. Downsamples the data in place by taking every n-th voxel along
+	 * every axis that's too large, so that the whole extent of the volume is kept. Updates Dimensions to the new size.*/
+	static void DownsampleDataTo2K(uint8* BulkData, FIntVector& Dimensions, EPixelFormat PixelFormat);
+
+	/** Splits a volume too large for a single volume texture into bricks (see FVolumeBrickLayout) and creates the mip of the brick
+	 * atlas, header included. Only bricks that aren't all background are made resident. Doesn't touch any UObjects, so it can run
+	 * on any thread. Returns false if the bricks don't fit into an atlas or the pixel format can't hold the header.*/
+	static bool CreateBrickedVolumeMips(const uint8* BulkData, FIntVector Dimensions, EPixelFormat PixelFormat,
+		FVolumeBrickLayout& OutLayout, FTexture2DMipMap*& OutAtlasMip);
+
+	/** Creates the transient textures of a volume too large for a single volume texture - the brick atlas with the full resolution
+	 * data and a DataTexture downsampled to fit (its dimensions are used for the light volume, and it's the fallback of volumes
+	 * that can't be bricked). BulkData gets downsampled in place.*/
+	static bool CreateBrickedVolumeTransient(
+		UVolumeAsset* OutAsset, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData);
+
+	/** Same as CreateBrickedVolumeTransient, but creates persistent texture assets named DataTextureName and AtlasTextureName in
+	 * FolderName, so that the bricks get saved with the volume asset. BulkData gets downsampled in place.*/
+	static bool CreateBrickedVolumeAsset(UVolumeAsset* OutAsset, const FString& DataTextureName, const FString& AtlasTextureName,
+		const FString& FolderName, EPixelFormat PixelFormat, FIntVector Dimensions, uint8* BulkData);
+
 	
 	/** Creates a Volume Texture asset with the given name, pixel format and
 	  dimensions and fills it with the bulk data provided. It can be set to be
 	  persistent and can also be immediately saved to disk.
 	  Returns a reference to the created texture in the CreatedTexture param.
+	  Fails for volumes larger than 2048 in any dimension, see CreateBrickedVolumeAsset.
 	*/
 	static bool CreateVolumeTextureAsset(UVolumeTexture*& OutTexture, const FString& AssetName, const FString& FolderName,
 		EPixelFormat PixelFormat, FIntVector& Dimensions, uint8* BulkData = nullptr, bool IsPersistent = false,
@@ -63,18 +125,34 @@ public:
 	static bool Create2DTextureTransient(UTexture2D*& OutTexture, EPixelFormat PixelFormat, FIntPoint Dimensions,
 		uint8* BulkData = nullptr, TextureAddress TilingX = TA_Clamp, TextureAddress TilingY = TA_Clamp);
 
-	/** Creates a transient Volume Texture (no asset name, cannot be saved)*/
+	/** Creates a transient Volume Texture (no asset name, cannot be saved). Fails for volumes larger than 2048 in any dimension,
+	 * see CreateBrickedVolumeTransient.*/
 	static bool CreateVolumeTextureTransient(UVolumeTexture*& OutTexture, EPixelFormat PixelFormat, FIntVector Dimensions,
 		uint8* BulkData = nullptr, bool ShouldUpdateResource = true);
 
 	/** Loads a RAW file into a newly allocated uint8* array. Loads the given number
-	 * of bytes. Don't forget to delete[] after storing the data somewhere.*/
-	static uint8* LoadRawFileIntoArray(const FString FileName, const int64 ByteSize);
-
-	/** Loads a zlib compressed RAW file into a newly allocated uint8* array. The array will be BytesToLoad long, while we read
-	 * CompressedBytes amount of bytes. Don't forget to delete[] after storing the data somewhere.*/
-	static uint8* LoadZLibCompressedFileIntoArray(
-		const FString FileName, const int64 UncompressedByteSize, const int64 CompressedByteSize);
+	 * of bytes, starting FileOffset bytes into the file. Don't forget to delete[] after storing the data somewhere.
+	 * If OnBytesRead is provided, the file is read in blocks and OnBytesRead gets called with the size of every block read.
+	 * Returns nullptr if the file can't be opened, is too small or can't be read completely.*/
+	static uint8* LoadRawFileIntoArray(const FString FileName, const int64 ByteSize,
+		TFunction<void(int64 BytesRead)> OnBytesRead = nullptr, const int64 FileOffset = 0);
+
+	/** Memory maps ByteSize bytes of a RAW file, starting FileOffset bytes into it, instead of reading them into memory. Same path
+	 * resolution and size checks as LoadRawFileIntoArray. Returns false if the file can't be mapped.*/
+	static bool MapRawFile(
+		const FString& FileName, const int64 ByteSize, FMappedRawFile& OutMappedFile, const int64 FileOffset = 0);
+
+	/** Loads a zlib or gzip compressed RAW file into a newly allocated uint8* array. The array will be UncompressedByteSize long,
+	 * while we read CompressedByteSize amount of bytes starting at FileOffset (or the rest of the file if CompressedByteSize is 0,
+	 * MetaIO doesn't require it to be known).
+	 * The file is read and inflated in fixed-size chunks, so only a single chunk of compressed data is in memory at any time.
+	 * If OnSlabInflated is provided, it gets called on a worker thread for every SlabByteSize-long piece of the output as soon as
+	 * it's fully inflated, while the rest of the file keeps inflating. All calls are finished when this function returns.
+	 * Don't forget to delete[] after storing the data somewhere.*/
+	static uint8* LoadZLibCompressedFileIntoArray(const FString FileName, const int64 UncompressedByteSize,
+		const int64 CompressedByteSize, const int64 SlabByteSize = 0,
+		TFunction<void(const uint8* SlabData, int64 SlabOffset, int64 SlabSize)> OnSlabInflated = nullptr,
+		const int64 FileOffset = 0);
 
 	/** Normalizes an array InArray to maximum G16 type. If the InType is 8bit, normalizes to G8. Creates a new array, user is
 	   responsible for deleting that. The type of data going in is determined by a Format name used in .mhd files - e.g.
@@ -82,6 +160,21 @@ public:
 	static uint8* NormalizeArrayByFormat(const EVolumeVoxelFormat VoxelFormat, uint8* InArray, const int64 ArrayByteSize,
 		float& OutOriginalMin, float& OutOriginalMax);
 
+	/** Finds the minimum and maximum value of an array of voxels of the provided format. If bSwapBytes is true, the voxels are
+	   stored in the opposite byte order (e.g. big-endian).*/
+	static void FindMinMaxByFormat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ArrayByteSize,
+		float& OutMin, float& OutMax, const bool bSwapBytes = false);
+
+	/** Normalizes an array from the already known [InMin, InMax] range into OutArray. Output types are the same as in
+	 * NormalizeArrayByFormat. OutArray can be the same as InArray to normalize in place.*/
+	static void NormalizeArrayByFormatWithRange(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray,
+		const int64 ArrayByteSize, uint8* OutArray, const float InMin, const float InMax);
+
+	/** Same as NormalizeArrayByFormat above, but writes the normalized values into OutArray, which has to be large enough to hold
+	 * them (2 bytes per voxel, 1 byte for 8bit formats). OutArray can be the same as InArray to normalize in place.*/
+	static void NormalizeArrayByFormat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, const int64 ArrayByteSize,
+		uint8* OutArray, float& OutOriginalMin, float& OutOriginalMax);
+
 	/** Loads a RAW file into a newly created Volume Texture Asset. Will output error log messages
 	 * and return if unsuccessful.
 	 * @param RawFileName is supposed to be the absolute path of where the raw file can be found.
@@ -101,19 +194,19 @@ public:
 	static void LoadRawIntoVolumeTextureAsset(FString RawFileName, UVolumeTexture* inTexture, FIntVector Dimensions,
 		uint32 BytexPerVoxel, EPixelFormat OutPixelFormat, bool Persistent);
 
-	/** Converts an array to an array normalized on the range of the OutType, based on the minimum and maximum values
-		found in the InArray, when cast to the type InType.*/
-	template <typename InType, typename OutType>
-	static uint8* ConvertArrayToNormalizedArray(
-		uint8* InArray, unsigned long ByteSize, float& OutOriginalMin, float& OutOriginalMax)
+	/** Finds the minimum and maximum values in InArray when cast to the type InType.
+	 * This and the following templates are the serial scalar reference implementations. The *ByFormat functions above use
+	 * vectorized, parallel kernels that produce exactly the same results.*/
+	template <typename InType>
+	static void FindMinMax(const uint8* InArray, int64 ByteSize, float& OutMin, float& OutMax)
 	{
-		InType* InCastArray = reinterpret_cast<InType*>(InArray);
-		const unsigned long ElementCount = ByteSize / sizeof(InType);
+		const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+		const int64 ElementCount = ByteSize / sizeof(InType);
 
 		InType InMin = std::numeric_limits<InType>::max();
-		InType InMax = std::numeric_limits<InType>::min();
+		InType InMax = std::numeric_limits<InType>::lowest();
 
-		for (unsigned long i = 0; i < ElementCount; i++)
+		for (int64 i = 0; i < ElementCount; i++)
 		{
 			if (InCastArray[i] < InMin)
 			{
@@ -125,7 +218,17 @@ public:
 			}
 		}
 
-		OutType* OutArray = new OutType[ElementCount];
+		OutMin = (float) InMin;
+		OutMax = (float) InMax;
+	}
+
+	/** Normalizes InArray from the [InMin, InMax] range to the full range of the OutType, writing the result into OutArray.*/
+	template <typename InType, typename OutType>
+	static void NormalizeArrayWithRange(const uint8* InArray, uint8* OutArray, int64 ByteSize, float InMin, float InMax)
+	{
+		const InType* InCastArray = reinterpret_cast<const InType*>(InArray);
+		OutType* OutCastArray = reinterpret_cast<OutType*>(OutArray);
+		const int64 ElementCount = ByteSize / sizeof(InType);
 
 		// Normalize all values to the full range of the OutType.
 		//
@@ -137,51 +240,73 @@ public:
 		OutType OutMin = std::numeric_limits<OutType>::min();
 		OutType OutMax = std::numeric_limits<OutType>::max();
 
-		// #TODO this could use a ParallelFor
-		for (unsigned long i = 0; i < ElementCount; i++)
+		for (int64 i = 0; i < ElementCount; i++)
 		{
-			float Normalized = ((float) InCastArray[i] - InMin) / ((float) InMax - InMin);
-			OutArray[i] = OutMin + (Normalized * (OutMax - OutMin));
+			float Normalized = ((float) InCastArray[i] - InMin) / (InMax - InMin);
+			OutCastArray[i] = OutMin + (Normalized * (OutMax - OutMin));
 		}
+	}
 
-		// Output the original min and max.
-		OutOriginalMin = (float) InMin;
-		OutOriginalMax = (float) InMax;
+	/** Converts an array to an array normalized on the range of the OutType, based on the minimum and maximum values
+		found in the InArray, when cast to the type InType. Writes the result into OutArray.*/
+	template <typename InType, typename OutType>
+	static void ConvertArrayToNormalizedArray(
+		const uint8* InArray, uint8* OutArray, int64 ByteSize, float& OutOriginalMin, float& OutOriginalMax)
+	{
+		FindMinMax<InType>(InArray, ByteSize, OutOriginalMin, OutOriginalMax);
+		NormalizeArrayWithRange<InType, OutType>(InArray, OutArray, ByteSize, OutOriginalMin, OutOriginalMax);
+	}
 
+	/** Converts an array to an array normalized on the range of the OutType, based on the minimum and maximum values
+		found in the InArray, when cast to the type InType.*/
+	template <typename InType, typename OutType>
+	static uint8* ConvertArrayToNormalizedArray(
+		uint8* InArray, unsigned long ByteSize, float& OutOriginalMin, float& OutOriginalMax)
+	{
+		OutType* OutArray = new OutType[ByteSize / sizeof(InType)];
+		ConvertArrayToNormalizedArray<InType, OutType>(
+			InArray, reinterpret_cast<uint8*>(OutArray), ByteSize, OutOriginalMin, OutOriginalMax);
 		return reinterpret_cast<uint8*>(OutArray);
 	}
 
-	/// Function to convert from arbitrary type T of data to float.
+	/// Function to convert from arbitrary type T of data to float. Writes the result into OutData.
 	/// Used when you want to keep the original values and use FLOAT_32 texture.
+	/// Serial-per-chunk reference implementation, ConvertArrayToFloat uses a vectorized kernel with the same results.
 	template <class T>
-	static float* ConvertArrayToFloatTemplated(uint8* Data, int32 VoxelCount)
+	static void ConvertArrayToFloatTemplated(const uint8* Data, float* NewData, int64 VoxelCount)
 	{
-		T* TypedData = reinterpret_cast<T*>(Data);
-		float* NewData = new float[VoxelCount];
-
-		const int32 NumWorkerThreads = FTaskGraphInterface::Get().GetNumWorkerThreads();
-		int32 NumVoxelsPerThread = VoxelCount / NumWorkerThreads;
-		int32 NumVoxelsLeftOver = VoxelCount % NumWorkerThreads;
+		const T* TypedData = reinterpret_cast<const T*>(Data);
 
-		ParallelFor(NumWorkerThreads, [&](int32 ThreadId) {
-			int32 index = 0;
-			for (int32 i = 0; i < NumVoxelsPerThread; i++)
+		constexpr int64 VoxelsPerTask = 1 << 20;
+		ParallelFor(static_cast<int32>(FMath::DivideAndRoundUp(VoxelCount, VoxelsPerTask)),
+			[&](int32 TaskIndex)
 			{
-				index = (NumVoxelsPerThread * ThreadId) + i;
-				NewData[index] = static_cast<float>(TypedData[index]);
-			}
-		});
+				const int64 Start = TaskIndex * VoxelsPerTask;
+				const int64 End = FMath::Min(Start + VoxelsPerTask, VoxelCount);
+				for (int64 Index = Start; Index < End; Index++)
+				{
+					NewData[Index] = static_cast<float>(TypedData[Index]);
+				}
+			});
+	};
 
-		// Finish the leftovers
-		for (int32 index = NumWorkerThreads * NumVoxelsPerThread; index < VoxelCount; index++)
-		{
-			NewData[index] = static_cast<float>(TypedData[index]);
-		}
+	/// Function to convert from arbitrary type T of data to float.
+	/// Used when you want to keep the original values and use FLOAT_32 texture.
+	template <class T>
+	static float* ConvertArrayToFloatTemplated(uint8* Data, int64 VoxelCount)
+	{
+		float* NewData = new float[VoxelCount];
+		ConvertArrayToFloatTemplated<T>(Data, NewData, VoxelCount);
 		return NewData;
 	};
 
+	/// Converts InArray to a newly allocated float array. Returns nullptr for unsupported formats.
 	static float* ConvertArrayToFloat(const EVolumeVoxelFormat VoxelFormat, uint8* InArray, uint64 VoxelCount);
 
+	/// Converts InArray to float, writing the result into OutArray. Returns false for unsupported formats.
+	/// For 32bit formats, OutArray can be the same as InArray to convert in place.
+	static bool ConvertArrayToFloat(const EVolumeVoxelFormat VoxelFormat, const uint8* InArray, uint64 VoxelCount, float* OutArray);
+
 	/** Tells you which source format to use for a texture's source according to the
 	 * Pixel format. */
 	static ETextureSourceFormat PixelFormatToSourceFormat(EPixelFormat PixelFormat);
@@ -2,6 +2,7 @@
 // Licensed under MIT license - See License.txt for details.
 #pragma once
 
+#include "VolumeAsset/Loaders/DICOMFolderIndex.h"
 #include "VolumeAsset/Loaders/VolumeLoader.h"
 
 #include "DCMTKLoader.generated.h"
@@ -37,6 +38,16 @@ public:
 	/// Set the pixel spacing in the volume info ignoring the values of the DICOM file. Default is false.
 	bool bSetPixelSpacingY : 1;
 
+	/// Decode the slices of single-frame DICOM folders in parallel. Default is true.
+	bool bParallelSliceDecode : 1;
+
+	/// Keep the header index of DICOM folders in the project's Saved folder, so that re-opening an unchanged series skips
+	/// parsing the file headers. Default is true.
+	bool bUseFolderIndexCache : 1;
+
+	/// Upper limit on the number of workers used when decoding slices in parallel. 0 means use all worker threads.
+	int32 MaxSliceDecodeWorkers = 0;
+
 	/// The distance between pixels in mm in the x direction. Default is 1.0f.
 	float DefaultPixelSpacingX = 1.0f;
 
@@ -60,7 +71,26 @@ public:
 	virtual UVolumeAsset* CreateVolumeFromFileInExistingPackage(
 		FString FileName, UObject* ParentPackage, bool bNormalize = true, bool bConvertToFloat = true) override;
 
-	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat) override;
+	virtual TUniquePtr<uint8[]> LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) override;
+
+	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat,
+		FVolumeLoadProgress* Progress = nullptr) override;
 
 	static void DumpFileStructure(const FString& FileName);
+
+	/// Loads the pixel data of all single-frame files of the series in the indexed folder into a volume of VolumeInfo (as parsed
+	/// by ParseVolumeInfoFromHeader). Slices get decoded on up to MaxDecodeWorkers workers if bParallelDecode is set (0 means
+	/// all worker threads). Returns nullptr if any slice fails to load or the slice thickness check fails.
+	static TUniquePtr<uint8[]> LoadSingleFrameDICOMFolder(const FDICOMFolderIndex& FolderIndex, const FString& SeriesInstanceUID,
+		FVolumeInfo& VolumeInfo, bool bCalculateSliceThickness, bool bVerifySliceThickness, bool bIgnoreIrregularThickness,
+		bool bParallelDecode, int32 MaxDecodeWorkers, FVolumeLoadProgress* Progress = nullptr);
+
+	/// Returns the header index of the DICOM files in the folder. Only gets rebuilt when a different folder is requested.
+	const FDICOMFolderIndex& GetFolderIndex(const FString& FolderName, const FString& Extension);
+
+private:
+	/// Index of the last folder this loader read. Shared between parsing the header and loading the data, so that every file
+	/// header only gets read once per load.
+	FDICOMFolderIndex FolderIndex;
 };
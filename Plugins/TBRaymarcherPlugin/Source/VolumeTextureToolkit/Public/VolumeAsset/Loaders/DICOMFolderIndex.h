@@ -0,0 +1,105 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+#pragma once
+
+#include "CoreMinimal.h"
+
+/// Header values of a single DICOM file needed to assemble a volume. Read without loading the pixel data.
+struct VOLUMETEXTURETOOLKIT_API FDICOMFileRecord
+{
+	/// File name relative to the indexed folder, including extension.
+	FString FileName;
+
+	FString SeriesInstanceUID;
+
+	/// INDEX_NONE if the file has no (valid) Instance Number.
+	int32 InstanceNumber = INDEX_NONE;
+
+	int32 NumberOfFrames = 1;
+
+	// 0 if the tag is missing.
+	uint16 Rows = 0;
+	uint16 Columns = 0;
+	uint16 BitsAllocated = 0;
+	uint16 SamplesPerPixel = 0;
+
+	uint16 PixelRepresentation = 0;
+
+	/// Pixel spacing in mm (X = columns, Y = rows).
+	TOptional<FVector2D> PixelSpacing;
+
+	TOptional<double> SliceThickness;
+
+	TOptional<double> SliceLocation;
+
+	TOptional<FVector> ImagePositionPatient;
+
+	/// Offset of the uncompressed little-endian pixel data inside the file. INDEX_NONE if the pixel data is encapsulated
+	/// (compressed) or couldn't be located, in which case it needs to be decoded through DCMTK.
+	int64 PixelDataOffset = INDEX_NONE;
+
+	/// Size and modification time of the file when the record was read. Used to invalidate cached records.
+	int64 FileSize = INDEX_NONE;
+	FDateTime ModificationTime;
+
+	/// Returns true if the file was readable as DICOM. Unreadable files are still indexed (and cached), so that they don't get
+	/// re-read every time the folder is opened.
+	bool IsValid() const
+	{
+		return !SeriesInstanceUID.IsEmpty();
+	}
+
+	/// Returns the size of the pixel data of all frames in bytes.
+	int64 GetPixelDataByteSize() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FDICOMFileRecord& Record);
+};
+
+/// Index of all DICOM files in a folder, built with a single header-only pass over the files.
+/// Used both for parsing the volume info and for loading the pixel data, so that every file header only gets read once.
+struct VOLUMETEXTURETOOLKIT_API FDICOMFolderIndex
+{
+	/// Folder the index was built from.
+	FString FolderName;
+
+	/// Extension of the files that were indexed.
+	FString Extension;
+
+	/// One record per file in the folder.
+	TArray<FDICOMFileRecord> Files;
+
+	/// Average time it took to read a single file header. Used to estimate the time saved by the cache.
+	double AverageFileReadSeconds = 0.0;
+
+	/// Number of records taken from the on-disk cache / read from the files when this index was built.
+	int32 CacheHits = 0;
+	int32 CacheMisses = 0;
+
+	/// Reads the headers of all files with the provided extension in the folder. Stops parsing every file at the Pixel Data
+	/// element, so the pixel data never gets loaded.
+	/// If bUseCache is true, records of files whose size and modification time didn't change are taken from the index cache in
+	/// the project's Saved folder and only new or modified files get read. The cache is updated afterwards.
+	static FDICOMFolderIndex Build(const FString& FolderName, const FString& Extension, bool bUseCache = true);
+
+	/// Reads the header values of a single file. Returns false if the file isn't a readable DICOM file with a Series Instance UID.
+	static bool ReadFileRecord(const FString& FilePath, FDICOMFileRecord& OutRecord);
+
+	/// Returns true if this index was built from the provided folder and extension.
+	bool IsIndexOf(const FString& InFolderName, const FString& InExtension) const;
+
+	/// Returns the path of the cache file used for the provided folder.
+	static FString GetCacheFilePath(const FString& FolderName, const FString& Extension);
+
+	/// Loads a previously saved index of the provided folder. Returns false if there is no (valid) cache file.
+	static bool LoadFromCache(const FString& FolderName, const FString& Extension, FDICOMFolderIndex& OutIndex);
+
+	/// Saves this index into the cache file of its folder.
+	bool SaveToCache() const;
+
+	/// Returns the record of the file with the provided name (either a full path or a file name within the folder). Returns
+	/// nullptr if the file isn't indexed or isn't a readable DICOM file.
+	const FDICOMFileRecord* FindFile(const FString& FileName) const;
+
+	/// Returns all records with the provided Series Instance UID, sorted by their instance number.
+	TArray<const FDICOMFileRecord*> GetSeries(const FString& SeriesInstanceUID) const;
+};
@@ -7,8 +7,34 @@
 #include "VolumeLoader.h"
 
 #include "MHDLoader.generated.h"
+
+/// Everything UMHDLoader needs to know about a MetaIO (.mhd or .mha) file.
+struct VOLUMETEXTURETOOLKIT_API FMHDHeader
+{
+	// Dimensions, spacing, orientation, voxel format and byte order of the volume and where in the data file the voxels start.
+	FVolumeInfo VolumeInfo;
+
+	// Full path of the data file. Same as the header file for "ElementDataFile = LOCAL". Empty for slice-per-file data.
+	FString DataFilePath;
+
+	// Full paths of the slice files in Z order, for "ElementDataFile = LIST" or a file name pattern. Every file holds one XY slice.
+	TArray<FString> SliceFilePaths;
+
+	// Bytes to skip at the start of every data file ("HeaderSize"). -1 means the voxels are at the very end of the file.
+	// Already applied to VolumeInfo.DataFileOffset by UMHDLoader::ParseHeader, slice files apply it one by one while loading.
+	int64 HeaderSize = 0;
+
+	bool IsSliceList() const
+	{
+		return SliceFilePaths.Num() > 0;
+	}
+};
+
 /**
  * IVolumeLoader specialized for reading MHD files. (https://itk.org/Wiki/ITK/MetaIO/Documentation)
+ * The header is read in a single pass, keys can come in any order. Supports detached data files, data attached to the header
+ * ("ElementDataFile = LOCAL", .mha), slice-per-file data sets ("ElementDataFile = LIST" or a file name pattern, loaded in
+ * parallel), zlib compression, HeaderSize, either byte order and the Offset and TransformMatrix orientation keys.
  */
 UCLASS()
 class VOLUMETEXTURETOOLKIT_API UMHDLoader : public UObject, public IVolumeLoader
@@ -19,6 +45,14 @@ public:
 	// methods.
 	static UMHDLoader* Get();
 
+	// Parses the header of the provided .mhd or .mha file. Only reads the header, even if the data is attached.
+	// Returns false and logs the reason if the file isn't a 2D or 3D MetaIO image this loader can read.
+	static bool ParseHeader(const FString& FileName, FMHDHeader& OutHeader);
+
+	// Parses header text that has already been read. HeaderPath is where the header would be, it's only used to resolve relative
+	// data file names, nothing is read from disk - so "HeaderSize = -1" isn't resolved to a data offset.
+	static bool ParseHeaderText(const FString& HeaderText, const FString& HeaderPath, FMHDHeader& OutHeader);
+
 	// Returns a FVolumeInfo without actually creating a volume from the file. Useful for getting info about a volume before loading
 	// it.
 	virtual FVolumeInfo ParseVolumeInfoFromHeader(FString FileName) override;
@@ -34,4 +68,17 @@ public:
 	// calls.
 	virtual UVolumeAsset* CreateVolumeFromFileInExistingPackage(
 		FString FileName, UObject* ParentPackage, bool bNormalize = true, bool bConvertToFloat = true) override;
+
+	// Parses the header and loads the converted data without creating any UObjects. Used by CreateVolumeFromFileAsync.
+	virtual TUniquePtr<uint8[]> LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) override;
+
+	// Parses the header and converts the memory mapped data file straight into a texture mip. Used by CreateVolumeFromFileAsync.
+	virtual FTexture2DMipMap* LoadMappedVolumeMip(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) override;
+
+	// Loads the data described by a parsed header and converts it the same way LoadAndConvertData does. Slice files get read in
+	// parallel. Fills OutVolumeInfo with the info of the converted volume.
+	TUniquePtr<uint8[]> LoadAndConvertMHDData(const FMHDHeader& Header, FVolumeInfo& OutVolumeInfo, bool bNormalize,
+		bool bConvertToFloat, FVolumeLoadProgress* Progress = nullptr);
 };
\ No newline at end of file
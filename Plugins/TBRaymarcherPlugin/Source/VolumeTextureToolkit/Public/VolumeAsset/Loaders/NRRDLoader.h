@@ -0,0 +1,114 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "VolumeLoader.h"
+
+#include "NRRDLoader.generated.h"
+
+/// 64bit NRRD scalar types. Volume textures can't hold these, so UNRRDLoader narrows them to float while loading.
+enum class ENRRDWideType : uint8
+{
+	None,
+	Double,
+	Int64,
+	UInt64
+};
+
+/// Downsampled level of a volume, written next to the full resolution data by the DICOM converter (dicom_to_nrrd.py --pyramid).
+/// Referenced from the header by a "pyramid level <N>:=<data file> <X> <Y> <Z>" key/value line. The level data file has the same
+/// type, encoding and byte order as the full resolution one, every level has half the resolution of the previous one.
+struct VOLUMETEXTURETOOLKIT_API FNRRDPyramidLevel
+{
+	// How many times smaller than the full resolution volume the level is along every axis (2 for level 1, 4 for level 2...).
+	int32 Factor = 1;
+
+	FIntVector Dimensions = FIntVector::ZeroValue;
+
+	// Full path of the level data file.
+	FString DataFilePath;
+};
+
+/// Everything UNRRDLoader needs to know about an NRRD file.
+struct VOLUMETEXTURETOOLKIT_API FNRRDHeader
+{
+	// Dimensions, spacing, voxel format and byte order of the volume and where in the data file the voxels start.
+	// For 64bit types, OriginalFormat is Float, as that's what the voxels get narrowed to.
+	FVolumeInfo VolumeInfo;
+
+	// Set if the data file contains 64bit voxels.
+	ENRRDWideType WideType = ENRRDWideType::None;
+
+	// Full path of the data file. Same as the header file for NRRDs with attached data.
+	FString DataFilePath;
+
+	// Downsampled levels listed in the header, from the finest to the coarsest.
+	TArray<FNRRDPyramidLevel> PyramidLevels;
+
+	// Returns the header describing the provided pyramid level as a volume of its own. World dimensions stay (roughly) the same, as
+	// the spacing grows by the level factor.
+	FNRRDHeader GetPyramidLevelHeader(int32 LevelIndex) const;
+
+	// Returns the size of a voxel as stored in the data file.
+	int32 GetFileBytesPerVoxel() const;
+};
+
+/**
+ * IVolumeLoader specialized for reading NRRD files (http://teem.sourceforge.net/nrrd/format.html).
+ * Supports attached (.nrrd) and detached (.nhdr) headers, raw and gzip encodings, all scalar types and "line skip" and
+ * "byte skip", in either byte order. Spacing is read from "space directions" or "spacings". Downsampled pyramid levels listed in
+ * the header can be loaded as a quick preview (CreatePreviewVolumeFromFile).
+ */
+UCLASS()
+class VOLUMETEXTURETOOLKIT_API UNRRDLoader : public UObject, public IVolumeLoader
+{
+	GENERATED_BODY()
+public:
+	// Getter for a dummy non-static object. Useful to have non-static so all loaders can use the same interface with virtual
+	// methods.
+	static UNRRDLoader* Get();
+
+	// Parses the header of the provided .nrrd or .nhdr file. Only reads the header, even if the data is attached.
+	// Returns false and logs the reason if the file isn't a 3D NRRD this loader can read.
+	static bool ParseHeader(const FString& FileName, FNRRDHeader& OutHeader);
+
+	// Returns a FVolumeInfo without actually creating a volume from the file. Useful for getting info about a volume before loading
+	// it.
+	virtual FVolumeInfo ParseVolumeInfoFromHeader(FString FileName) override;
+
+	// Creates a full transient volume asset from the provided data file.
+	virtual UVolumeAsset* CreateVolumeFromFile(FString FileName, bool bNormalize = true, bool bConvertToFloat = true) override;
+
+	// Creates a transient volume asset from the coarsest pyramid level listed in the header. Returns nullptr for files without
+	// pyramid levels.
+	virtual UVolumeAsset* CreatePreviewVolumeFromFile(
+		const FString& FileName, bool bNormalize = true, bool bConvertToFloat = true) override;
+
+	// Creates a full persistent volume asset from the provided data file.
+	virtual UVolumeAsset* CreatePersistentVolumeFromFile(
+		const FString& FileName, const FString& OutFolder, bool bNormalize = true) override;
+
+	// Creates a full volume asset from the provided FileName. Gets saved into the ParentPackage package. Used in File Factory
+	// calls.
+	virtual UVolumeAsset* CreateVolumeFromFileInExistingPackage(
+		FString FileName, UObject* ParentPackage, bool bNormalize = true, bool bConvertToFloat = true) override;
+
+	// Parses the header and loads the converted data without creating any UObjects. Used by CreateVolumeFromFileAsync.
+	virtual TUniquePtr<uint8[]> LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) override;
+
+	// Parses the header and converts the memory mapped data file straight into a texture mip. Used by CreateVolumeFromFileAsync.
+	virtual FTexture2DMipMap* LoadMappedVolumeMip(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) override;
+
+	// Loads the data described by a parsed header and converts it the same way LoadAndConvertData does. 64bit voxels get
+	// narrowed to float first. Fills OutVolumeInfo with the info of the converted volume.
+	TUniquePtr<uint8[]> LoadAndConvertNRRDData(const FNRRDHeader& Header, FVolumeInfo& OutVolumeInfo, bool bNormalize,
+		bool bConvertToFloat, FVolumeLoadProgress* Progress = nullptr);
+
+private:
+	// Creates a transient volume asset named VolumeName from the data described by a parsed header.
+	UVolumeAsset* CreateTransientVolumeFromHeader(
+		const FNRRDHeader& Header, const FString& VolumeName, bool bNormalize, bool bConvertToFloat);
+};
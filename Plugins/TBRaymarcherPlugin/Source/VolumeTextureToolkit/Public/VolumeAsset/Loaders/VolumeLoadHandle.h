@@ -0,0 +1,79 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/StrongObjectPtr.h"
+
+#include <atomic>
+
+class UVolumeAsset;
+
+/// Progress of a single volume load. Loaders update it from whatever threads they run on, it can be read from any thread.
+struct VOLUMETEXTURETOOLKIT_API FVolumeLoadProgress
+{
+	/// Bytes of voxel data read from disk (or inflated, for compressed files) so far, out of TotalBytes.
+	std::atomic<int64> BytesRead{0};
+	std::atomic<int64> TotalBytes{0};
+
+	/// Slices decoded so far, out of TotalSlices. Only used by loaders that decode slice by slice (DICOM), 0 otherwise.
+	std::atomic<int32> SlicesDecoded{0};
+	std::atomic<int32> TotalSlices{0};
+
+	/// Called after every update, on the thread that made it.
+	TFunction<void()> OnUpdated;
+
+	void AddBytesRead(int64 Bytes);
+
+	void AddSlicesDecoded(int32 Slices);
+
+	/// Returns how much of the load is done, in [0, 1]. Goes by slices for loaders decoding slices, by bytes otherwise.
+	float GetFraction() const;
+};
+
+DECLARE_DELEGATE_OneParam(FOnVolumeLoadProgress, const FVolumeLoadProgress& /*Progress*/);
+DECLARE_DELEGATE_OneParam(FOnVolumeLoadFinished, UVolumeAsset* /*LoadedAsset*/);
+
+/// Handle of a load started with IVolumeLoader::CreateVolumeFromFileAsync. Both delegates are always called on the game thread.
+struct VOLUMETEXTURETOOLKIT_API FVolumeLoadHandle : public TSharedFromThis<FVolumeLoadHandle>
+{
+	FVolumeLoadHandle();
+
+	/// Progress of the load. Updated from the worker threads, so it can be polled instead of binding OnProgress.
+	FVolumeLoadProgress Progress;
+
+	/// Called on the game thread when the progress changed. Updates made while a call is pending get merged into one call.
+	FOnVolumeLoadProgress OnProgress;
+
+	/// Called on the game thread once the asset got created, with nullptr if the load failed.
+	FOnVolumeLoadFinished OnFinished;
+
+	/// Returns true once the load is finished and OnFinished was called.
+	bool IsFinished() const
+	{
+		return bFinished;
+	}
+
+	/// Returns the loaded asset. Null while loading and after a failed load.
+	UVolumeAsset* GetLoadedAsset() const
+	{
+		return LoadedAsset.Get();
+	}
+
+	/// Called from any thread when Progress changes. Schedules an OnProgress call on the game thread, unless one is pending.
+	void NotifyProgress();
+
+	/// Called on the game thread when the load is done. Releases the loader and calls OnFinished.
+	void Finish(UVolumeAsset* InLoadedAsset);
+
+	/// Keeps the loader object alive while its worker runs, loaders are usually created just for a single load.
+	TStrongObjectPtr<UObject> Loader;
+
+private:
+	TWeakObjectPtr<UVolumeAsset> LoadedAsset;
+
+	std::atomic<bool> bProgressNotificationPending{false};
+
+	bool bFinished = false;
+};
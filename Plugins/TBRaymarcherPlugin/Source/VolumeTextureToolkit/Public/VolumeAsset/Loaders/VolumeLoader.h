@@ -8,6 +8,7 @@
 #include "CoreMinimal.h"
 #include "VolumeAsset/VolumeAsset.h"
 #include "VolumeAsset/VolumeInfo.h"
+#include "VolumeLoadHandle.h"
 
 #include "VolumeLoader.generated.h"
 
@@ -33,6 +34,13 @@ public:
 	// Creates a full volume asset from the provided data file.
 	virtual UVolumeAsset* CreateVolumeFromFile(FString FileName, bool bNormalize = true, bool bConvertToFloat = true) = 0;
 
+	// Creates a small transient volume from a downsampled version of the data stored in the file, if the format has one. Meant
+	// to be shown right away while the full volume loads (e.g. with CreateVolumeFromFileAsync). Returns nullptr by default.
+	virtual UVolumeAsset* CreatePreviewVolumeFromFile(const FString& FileName, bool bNormalize = true, bool bConvertToFloat = true)
+	{
+		return nullptr;
+	}
+
 	// Creates a full persistent volume asset from the provided data file.
 	virtual UVolumeAsset* CreatePersistentVolumeFromFile(
 		const FString& FileName, const FString& OutFolder, bool bNormalize = true) = 0;
@@ -42,9 +50,30 @@ public:
 	virtual UVolumeAsset* CreateVolumeFromFileInExistingPackage(
 		FString FileName, UObject* ParentPackage, bool bNormalize = true, bool bConvertToFloat = true) = 0;
 
+	// Parses the header of the provided file and loads and converts its voxel data, without touching any UObjects, so that it can
+	// run on a worker thread. Fills in OutVolumeInfo and the name the asset should get. Returns nullptr if the load failed.
+	virtual TUniquePtr<uint8[]> LoadVolumeData(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr) = 0;
+
+	// Same as LoadVolumeData, but converts the data straight from the memory mapped file into a new texture mip (see
+	// LoadMappedDataIntoMip). Returns nullptr if the format or file can't be loaded this way, then LoadVolumeData has to be used.
+	// Returns nullptr by default.
+	virtual FTexture2DMipMap* LoadMappedVolumeMip(const FString& FileName, bool bNormalize, bool bConvertToFloat,
+		FVolumeInfo& OutVolumeInfo, FString& OutVolumeName, FVolumeLoadProgress* Progress = nullptr)
+	{
+		return nullptr;
+	}
+
+	// Asynchronous variant of CreateVolumeFromFile. Reading and converting the data (LoadMappedVolumeMip or LoadVolumeData) and
+	// filling the texture mip run on a worker thread, only creating the transient asset and texture and UpdateResource are done on
+	// the game thread. The delegates of the returned handle get called on the game thread. Must be called from the game thread.
+	TSharedRef<FVolumeLoadHandle> CreateVolumeFromFileAsync(const FString& FileName, bool bNormalize = true,
+		bool bConvertToFloat = true, FOnVolumeLoadProgress OnProgress = {}, FOnVolumeLoadFinished OnFinished = {});
+
 	// Loads the raw bytes from the file specified in Info. Detects if file is compressed and loads returns a new uint8 array.
 	// Don't forget to delete[] after using.
-	static TUniquePtr<uint8[]> LoadRawDataFileFromInfo(const FString& FilePath, const FVolumeInfo& Info);
+	static TUniquePtr<uint8[]> LoadRawDataFileFromInfo(
+		const FString& FilePath, const FVolumeInfo& Info, FVolumeLoadProgress* Progress = nullptr);
 
 	// Tries to read the provided FileName as a file either in absolute path or relative to game folder.
 	static FString ReadFileAsString(const FString& FileName);
@@ -64,10 +93,48 @@ public:
 
 	// Loads the raw data specified in the VolumeInfo and converts it so that it's useable with our raymarching materials.
 	// This means either converting it to U8 or U16 and normalizing or a conversion to Float.
-	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+	// If Progress is provided, it gets updated as the data is read.
+	virtual TUniquePtr<uint8[]> LoadAndConvertData(FString FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat,
+		FVolumeLoadProgress* Progress = nullptr);
 	
 	// Converts raw data read from a Volume file so that it's useable by our materials.
 	// if bNormalize is true, the data gets normalized to 0.0 to 1.0 range and gets saved as a G8 or G16 texture later in the process.
 	// if bConvertToFloat is true, the data gets converted to float and gets saved as a R32_Float texture later in the process.
+	// If the converted voxels aren't larger than the loaded ones, the conversion happens in place and the returned array is the
+	// (shrunk) LoadedArray.
 	static TUniquePtr<uint8[]> ConvertData(TUniquePtr<uint8[]>&& LoadedArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	// Same conversion as ConvertData, but reads from InArray and writes into OutArray, which has to be large enough to hold the
+	// converted volume (see GetConvertedFormat). Updates the VolumeInfo the same way ConvertData does, including the value range,
+	// histogram and percentiles (see FVolumeConversionStage).
+	// InArray and OutArray can be the same array if the converted voxels aren't larger than the original ones.
+	static void ConvertDataInto(
+		const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	// Gives the unused tail of an array that shrank (e.g. got converted in place into smaller voxels) back to the allocator.
+	static void ShrinkArray(TUniquePtr<uint8[]>& Array, const int64 NewByteSize);
+
+	// Returns the voxel format the data will have after ConvertData with the provided flags.
+	static EVolumeVoxelFormat GetConvertedFormat(EVolumeVoxelFormat OriginalFormat, bool bNormalize, bool bConvertToFloat);
+
+	// Creates the transient textures of OutAsset from voxel data converted into VolumeInfo.ActualFormat. Volumes too large for a
+	// single volume texture get split into bricks (see UVolumeTextureToolkit::CreateBrickedVolumeTransient), which downsamples
+	// Data in place. Returns false if they can't be split into bricks.
+	static bool CreateTransientTextures(UVolumeAsset* OutAsset, const FVolumeInfo& VolumeInfo, uint8* Data);
+
+	// Same as CreateTransientTextures, but creates persistent texture assets "VA_<VolumeName>_Data" (and "VA_<VolumeName>_Bricks"
+	// for bricked volumes) in OutFolder, see UVolumeTextureToolkit::CreateBrickedVolumeAsset.
+	static bool CreatePersistentTextures(
+		UVolumeAsset* OutAsset, const FString& VolumeName, const FString& OutFolder, const FVolumeInfo& VolumeInfo, uint8* Data);
+
+	// Memory maps the uncompressed raw file specified in VolumeInfo and converts it straight into the mip of a new transient volume
+	// texture, so that the voxel data only gets copied once (into the mip). Returns false if the file can't be mapped or the
+	// volume needs to be split into bricks, in which case the caller should fall back to LoadAndConvertData.
+	static bool LoadMappedDataIntoTransientTexture(
+		const FString& FilePath, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat, UVolumeTexture*& OutTexture);
+
+	// Same as LoadMappedDataIntoTransientTexture, but only creates the mip (see UVolumeTextureToolkit::CreateVolumeMip), so that
+	// it can run on any thread. Returns nullptr in the same cases LoadMappedDataIntoTransientTexture returns false.
+	static FTexture2DMipMap* LoadMappedDataIntoMip(const FString& FilePath, FVolumeInfo& VolumeInfo, bool bNormalize,
+		bool bConvertToFloat, FVolumeLoadProgress* Progress = nullptr);
 };
\ No newline at end of file
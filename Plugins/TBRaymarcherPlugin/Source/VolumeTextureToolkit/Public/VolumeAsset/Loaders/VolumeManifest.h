@@ -0,0 +1,64 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+#pragma once
+
+#include "CoreMinimal.h"
+
+/// A single series listed in a volume manifest.
+struct VOLUMETEXTURETOOLKIT_API FVolumeManifestSeries
+{
+	FString SeriesInstanceUID;
+
+	/// Full paths of the .nhdr header (loadable with UNRRDLoader) and the .raw data file of the series.
+	FString HeaderFilePath;
+	FString DataFilePath;
+
+	/// Reason the series failed to convert. Empty if it converted, only the UID and the file paths are set otherwise.
+	FString Error;
+
+	FIntVector Dimensions = FIntVector::ZeroValue;
+
+	/// Spacing and origin in mm.
+	FVector Spacing = FVector::ZeroVector;
+	FVector Origin = FVector::ZeroVector;
+
+	/// Statistics of the voxel values (HU for CT).
+	float MinValue = 0;
+	float MaxValue = 0;
+	float MeanValue = 0;
+	float LowPercentileValue = 0;
+	float MedianValue = 0;
+	float HighPercentileValue = 0;
+
+	/// Coarse histogram, with the bins evenly spanning [HistogramMin, HistogramMax].
+	float HistogramMin = 0;
+	float HistogramMax = 0;
+	TArray<int64> HistogramCounts;
+
+	/// Returns true if the series was converted.
+	bool IsValid() const
+	{
+		return Error.IsEmpty();
+	}
+};
+
+/// Manifest written by Tools/ITKConverter/dicom_to_nrrd.py --batch next to the converted series. Lists the series with their
+/// dimensions and value statistics, so they can be listed and windowed without reading any of the data files.
+struct VOLUMETEXTURETOOLKIT_API FVolumeManifest
+{
+	/// Version of the manifest format this reader understands.
+	static constexpr int32 SupportedVersion = 1;
+
+	/// Folder the series were converted from.
+	FString SourceFolder;
+
+	/// All series, including the ones that failed to convert.
+	TArray<FVolumeManifestSeries> Series;
+
+	/// Reads the manifest file. File paths of the series get resolved relative to the manifest's folder.
+	/// Returns false if the file can't be read, isn't valid JSON or has an unsupported version.
+	static bool Read(const FString& ManifestPath, FVolumeManifest& OutManifest);
+
+	/// Returns the series with the provided Series Instance UID, nullptr if there is none.
+	const FVolumeManifestSeries* FindSeries(const FString& SeriesInstanceUID) const;
+};
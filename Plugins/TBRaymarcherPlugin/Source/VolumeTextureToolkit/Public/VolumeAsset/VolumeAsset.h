@@ -8,6 +8,7 @@
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
 #include "WindowingParameters.h"
+#include "VolumeBrickLayout.h"
 #include "VolumeInfo.h"
 
 #include "VolumeAsset.Generated.h"
@@ -39,6 +40,22 @@ public:
 	UPROPERTY(EditAnywhere)
 	FVolumeInfo ImageInfo;
 
+	/// Full resolution data of volumes too large for a single volume texture, split into bricks (see FVolumeBrickLayout). Starts
+	/// with a header telling where every brick is (see FVolumeBrickLayout::WriteAtlasHeader). Null for all other volumes.
+	/// DataTexture of bricked volumes holds a downsampled version of the volume. Saved with persistent volume assets.
+	UPROPERTY(VisibleAnywhere)
+	UVolumeTexture* BrickAtlasTexture = nullptr;
+
+	/// Layout of the bricks in BrickAtlasTexture.
+	UPROPERTY(VisibleAnywhere)
+	FVolumeBrickLayout BrickLayout;
+
+	/// Returns true if the full resolution data is in the brick atlas.
+	bool IsBricked() const
+	{
+		return BrickAtlasTexture != nullptr;
+	}
+
 	static UVolumeAsset* CreateTransient(FString Name);
 
 	static UVolumeAsset* CreatePersistent(FString SaveFolder, const FString SaveName);
@@ -0,0 +1,162 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+#include "VolumeBrickLayout.generated.h"
+
+/// Layout of a volume split into bricks, for volumes that don't fit into a single volume texture (2048 in any dimension).
+/// The volume is cut into a grid of BrickSize^3 bricks. Every resident brick gets a slot in a brick atlas - a volume texture
+/// packed with bricks, each padded with an Apron of voxels copied from its neighbours (clamped at the volume border), so that
+/// trilinear sampling never has to look into a different brick. The first slots of the atlas hold a header with the layout and
+/// the indirection table telling where every brick is (see WriteAtlasHeader), so shaders and materials only need the atlas (see
+/// BrickedSampling.usf).
+/// Bricks are indexed X-fastest, same as voxels. Atlas slots are, too.
+USTRUCT(BlueprintType)
+struct VOLUMETEXTURETOOLKIT_API FVolumeBrickLayout
+{
+	GENERATED_BODY()
+
+	/// Largest size of a volume texture in any dimension.
+	static constexpr int32 MaxTextureSize = 2048;
+
+	/// Voxels copied from the neighbouring bricks on every side of a brick.
+	static constexpr int32 Apron = 1;
+
+	/// Brick size that makes the padded bricks 64^3.
+	static constexpr int32 DefaultBrickSize = 62;
+
+	/// Atlas header fields, in header voxels (see WriteAtlasHeader). Have to be the same as in BrickedSampling.usf.
+	static constexpr int32 HeaderUnit = 0;
+	static constexpr int32 HeaderPaddedBrickSize = 1;
+	static constexpr int32 HeaderBrickSize = 3;
+	static constexpr int32 HeaderVolumeDimensions = 5;
+	static constexpr int32 HeaderBricks = 11;
+	static constexpr int32 HeaderVoxelsPerBrick = 3;
+
+	/// Largest number the header can hold, two digits of an 8 bit atlas.
+	static constexpr int32 MaxHeaderNumber = MAX_uint16;
+
+	/// Dimensions of the whole volume.
+	UPROPERTY(VisibleAnywhere, Category = "Brick Layout")
+	FIntVector VolumeDimensions = FIntVector::ZeroValue;
+
+	/// Number of voxels along every side of a brick, without the apron.
+	UPROPERTY(VisibleAnywhere, Category = "Brick Layout")
+	int32 BrickSize = DefaultBrickSize;
+
+	/// Number of bricks along every axis. Bricks on the far borders of the volume can be cut short.
+	UPROPERTY(VisibleAnywhere, Category = "Brick Layout")
+	FIntVector BrickCounts = FIntVector::ZeroValue;
+
+	/// Number of brick slots along every axis of the atlas.
+	UPROPERTY(VisibleAnywhere, Category = "Brick Layout")
+	FIntVector SlotCounts = FIntVector::ZeroValue;
+
+	/// Atlas slot of every brick, INDEX_NONE for bricks that aren't resident.
+	UPROPERTY()
+	TArray<int32> BrickToSlot;
+
+	/// Brick stored in every atlas slot, INDEX_NONE for the header slots.
+	UPROPERTY()
+	TArray<int32> SlotToBrick;
+
+	/// Value range of every brick (without the apron), as the material samples it - G8 and G16 data is normalized to [0, 1].
+	/// Filled by ComputeBrickRanges.
+	UPROPERTY()
+	TArray<float> BrickMinValues;
+
+	UPROPERTY()
+	TArray<float> BrickMaxValues;
+
+	FVolumeBrickLayout() = default;
+
+	FVolumeBrickLayout(const FIntVector& InVolumeDimensions, int32 InBrickSize = DefaultBrickSize);
+
+	/// Returns true if a volume of these dimensions doesn't fit into a single volume texture.
+	static bool NeedsBricking(const FIntVector& Dimensions);
+
+	bool IsValid() const
+	{
+		return BrickCounts.X > 0 && BrickCounts.Y > 0 && BrickCounts.Z > 0;
+	}
+
+	/// Size of a brick slot in the atlas, including the apron.
+	int32 GetPaddedBrickSize() const
+	{
+		return BrickSize + 2 * Apron;
+	}
+
+	int32 GetBrickCount() const
+	{
+		return BrickCounts.X * BrickCounts.Y * BrickCounts.Z;
+	}
+
+	int32 GetResidentBrickCount() const
+	{
+		return FMath::Max(SlotToBrick.Num() - GetHeaderSlotCount(), 0);
+	}
+
+	/// Number of voxels of the atlas header - the layout and an entry for every brick.
+	int64 GetHeaderVoxelCount() const
+	{
+		return HeaderBricks + int64(HeaderVoxelsPerBrick) * GetBrickCount();
+	}
+
+	/// Number of atlas slots at the start of the atlas holding the header instead of bricks.
+	int32 GetHeaderSlotCount() const;
+
+	/// Returns the atlas voxel holding the header voxel. The header fills its slots X-fastest, slot by slot.
+	FIntVector GetHeaderVoxel(int64 Index) const;
+
+	/// Returns the coordinates of the brick containing the provided voxel.
+	FIntVector GetBrickCoordinates(const FIntVector& Voxel) const;
+
+	int32 GetBrickIndex(const FIntVector& BrickCoordinates) const;
+
+	FIntVector GetBrickCoordinatesFromIndex(int32 BrickIndex) const;
+
+	/// Returns the first voxel of the brick in the volume.
+	FIntVector GetBrickOrigin(int32 BrickIndex) const;
+
+	/// Returns the number of voxels of the volume in the brick along every axis (less than BrickSize on the far borders).
+	FIntVector GetBrickExtent(int32 BrickIndex) const;
+
+	/// Returns the first atlas voxel of the slot, i.e. the first voxel of the apron.
+	FIntVector GetSlotOrigin(int32 Slot) const;
+
+	/// Dimensions of the atlas texture with all slots assigned by AssignSlots.
+	FIntVector GetAtlasDimensions() const;
+
+	/// Finds where the provided voxel of the volume is stored in the atlas. Returns false if its brick isn't resident.
+	bool VolumeToAtlas(const FIntVector& Voxel, FIntVector& OutAtlasVoxel) const;
+
+	/// Computes BrickMinValues and BrickMaxValues from volume data of the provided pixel format (G8, G16, R32 float or R32 int).
+	void ComputeBrickRanges(const uint8* VolumeData, EPixelFormat PixelFormat);
+
+	/// Gives every brick for which IsResident returns true an atlas slot after the header slots and lays the slots out so that
+	/// the atlas fits into a volume texture with as few unused slots as possible. Returns false (and assigns nothing) if the
+	/// bricks don't fit.
+	bool AssignSlots(TFunctionRef<bool(int32 BrickIndex)> IsResident);
+
+	/// Assigns slots to all bricks containing any value above the minimum of the volume - bricks that are all background don't
+	/// need to be resident. Needs ComputeBrickRanges to be called first.
+	bool AssignNonEmptySlots();
+
+	/// Copies every resident brick including its apron from VolumeData into its slot in AtlasData, which has to be of
+	/// GetAtlasDimensions() and is expected to be zeroed.
+	void CopyBricksToAtlas(const uint8* VolumeData, uint8* AtlasData, int32 BytesPerVoxel) const;
+
+	/// Writes the header into the header slots of AtlasData, which has to be of GetAtlasDimensions() and PixelFormat (G8, G16 or
+	/// R32 float, returns false for the rest). The header is stored in the atlas format, so that it survives being sampled as
+	/// the volume - voxels get the values the texture returns for them, i.e. G8 and G16 are normalized to [0, 1]:
+	/// - HeaderUnit holds the unit, the smallest step of the format (1/255 for G8, 1/65535 for G16 and floats).
+	/// - Numbers are two digits of (1 / unit + 1), low one first, every digit stored as a multiple of the unit.
+	/// - HeaderPaddedBrickSize, HeaderBrickSize and HeaderVolumeDimensions (XYZ) hold numbers.
+	/// - Every brick (in brick index order) has an entry of HeaderVoxelsPerBrick voxels from HeaderBricks on - the number of its
+	///   slot, or 0 if it isn't resident, then the value of all its voxels (its minimum if ComputeBrickRanges was called).
+	bool WriteAtlasHeader(uint8* AtlasData, EPixelFormat PixelFormat) const;
+};
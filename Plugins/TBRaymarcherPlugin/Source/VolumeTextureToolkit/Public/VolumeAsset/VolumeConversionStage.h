@@ -0,0 +1,38 @@
+// Copyright 2021 Tomas Bartipan and Technical University of Munich.
+// Licensed under MIT license - See License.txt for details.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VolumeInfo.h"
+
+/// Pipeline stage converting loaded voxels into the format the volume texture gets created with (normalized G8/G16 or float),
+/// which also gathers the statistics of the original values on the way - the value range, a histogram and the percentiles used
+/// for automatic windowing. Everything gets stored on the FVolumeInfo, so nothing has to scan the volume again after load.
+/// All loaders run it through IVolumeLoader::ConvertData, other code loading raw voxels can call it directly.
+struct VOLUMETEXTURETOOLKIT_API FVolumeConversionStage
+{
+	/// Number of bins of FVolumeInfo::Histogram.
+	static constexpr int32 HistogramBinCount = 4096;
+
+	/// Fractions of voxels below FVolumeInfo::LowPercentileValue and FVolumeInfo::HighPercentileValue.
+	static constexpr float LowPercentile = 0.005f;
+	static constexpr float HighPercentile = 0.995f;
+
+	/// Converts the voxels of VolumeInfo.OriginalFormat from InArray into OutArray and fills in MinValue, MaxValue, Histogram, the
+	/// percentiles, bIsNormalized, ActualFormat and BytesPerVoxel of VolumeInfo. DefaultWindowingParameters get set to the
+	/// percentile window (see FVolumeInfo::GetPercentileWindowingParameters).
+	/// Normalization needs the value range before it can write the first voxel, so this takes two sweeps over the data - a
+	/// min/max reduction, then the conversion, which counts every chunk into the histogram right after converting it.
+	/// InArray and OutArray can be the same array if the converted voxels aren't larger than the original ones.
+	static void Run(const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	/// Same as Run, but takes VolumeInfo.MinValue and MaxValue as already computed by the caller (e.g. while the data was being
+	/// inflated), so only the conversion sweep is left.
+	static void RunWithKnownRange(
+		const uint8* InArray, uint8* OutArray, FVolumeInfo& VolumeInfo, bool bNormalize, bool bConvertToFloat);
+
+	/// Returns the values below which LowPercentile and HighPercentile of the voxels counted in the histogram are. Bins are
+	/// assumed to evenly span [Min, Max]. The low percentile is the lower edge of its bin, the high one the upper edge.
+	static void ComputePercentiles(const TArray<int64>& Histogram, float Min, float Max, float& OutLow, float& OutHigh);
+};
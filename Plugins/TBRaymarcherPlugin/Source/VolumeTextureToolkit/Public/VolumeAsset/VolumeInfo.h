@@ -86,6 +86,15 @@ public:
 	UPROPERTY(VisibleAnywhere)
 	FVector WorldDimensions = FVector(0,0,0);
 
+	// Position of the center of the first voxel in mm, in the LPS patient space DICOMs use. Zero if the file doesn't say.
+	UPROPERTY(VisibleAnywhere)
+	FVector Origin = FVector(0,0,0);
+
+	// Unit directions of the X, Y and Z voxel axes in the LPS patient space, as the X, Y and Z axes of the matrix. Identity if the
+	// file doesn't say.
+	UPROPERTY(VisibleAnywhere)
+	FMatrix Direction = FMatrix::Identity;
+
 	// Default windowing parameters used when this volume is loaded.
 	UPROPERTY(EditAnywhere)
 	FWindowingParameters DefaultWindowingParameters;
@@ -102,9 +111,30 @@ public:
 	UPROPERTY(VisibleAnywhere)
 	float MaxValue = 3000;
 
+	// Histogram of the original values, with bins evenly spanning [MinValue, MaxValue]. Filled in by FVolumeConversionStage when
+	// the volume is loaded, empty for volumes loaded before it existed.
+	UPROPERTY(VisibleAnywhere)
+	TArray<int64> Histogram;
+
+	// 0.5th and 99.5th percentile of the original values, taken from the histogram. Unlike MinValue and MaxValue, these ignore the
+	// few outlier voxels (e.g. metal in CT), so they make a better automatic window.
+	UPROPERTY(VisibleAnywhere)
+	float LowPercentileValue = -1000;
+
+	UPROPERTY(VisibleAnywhere)
+	float HighPercentileValue = 3000;
+
 	bool bIsCompressed = false;
 
-	int32 CompressedByteSize = 0;
+	// Size of the compressed data file. 0 if unknown (e.g. MHD files without CompressedDataSize).
+	int64 CompressedByteSize = 0;
+
+	// Offset of the voxel data in the data file, e.g. past a header attached to the data.
+	int64 DataFileOffset = 0;
+
+	// True if multi-byte voxels in the data file are stored most significant byte first. FVolumeConversionStage swaps them to
+	// the native order while converting.
+	bool bIsBigEndian = false;
 
 	// Returns the number of bytes needed to store this Volume.
 	int64 GetByteSize() const;
@@ -138,6 +168,14 @@ public:
 	/// Converts a [0,1] normalized range to the range of the original data (e.g. 1 will get converted to (MaxValue - MinValue))
 	float DenormalizeRange(float InRange);
 
+	/// Returns true if the histogram and percentiles were computed when the volume was loaded.
+	bool HasHistogram() const;
+
+	/// Returns windowing parameters spanning [LowPercentileValue, HighPercentileValue], normalized the same way as the data.
+	/// Cutoffs are taken from DefaultWindowingParameters. Returns DefaultWindowingParameters if there's no histogram or the
+	/// percentiles are equal.
+	FWindowingParameters GetPercentileWindowingParameters() const;
+
 	static int32 VoxelFormatByteSize(EVolumeVoxelFormat InFormat);
 
 	static bool IsVoxelFormatSigned(EVolumeVoxelFormat InFormat);
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "Kismet/BlueprintFunctionLibrary.h"
+#include "VolumeAsset/Loaders/VolumeLoader.h"
 
 #include "VolumeTextureToolkitBPLibrary.generated.h"
 
@@ -25,6 +26,13 @@ public:
 
 	/** Pops up a file dialog prompting the user to select a file to load a volume from. Loads the volume with the appropriate
 	 * IVolumeLoader.*/
-	UFUNCTION(BlueprintCallable, meta = (Keywords = "Load Volume DICOM MHD"), Category = "VolumeTextureToolkit")
+	UFUNCTION(BlueprintCallable, meta = (Keywords = "Load Volume DICOM MHD NRRD"), Category = "VolumeTextureToolkit")
 	static UVolumeAsset* LoadVolumeFromFileDialog(const bool& bNormalize);
+
+	/** Pops up a file dialog prompting the user to select a volume file. Returns false if no file was selected.*/
+	UFUNCTION(BlueprintCallable, meta = (Keywords = "Volume DICOM MHD NRRD File Dialog"), Category = "VolumeTextureToolkit")
+	static bool OpenVolumeFileDialog(FString& OutFileName);
+
+	/** Returns a loader able to load the provided file, based on its extension.*/
+	static IVolumeLoader* GetLoaderForFile(const FString& FileName);
 };
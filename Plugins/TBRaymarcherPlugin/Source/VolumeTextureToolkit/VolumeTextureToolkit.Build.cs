@@ -30,6 +30,7 @@ public class VolumeTextureToolkit : ModuleRules
 			new string[]
 			{
 				"CoreUObject",
+				"Json",
 				"Slate",
 				"SlateCore",
 			}
@@ -12,6 +12,7 @@
 #include "Runtime/Slate/Public/Widgets/Notifications/SNotificationList.h"
 #include "VolumeAsset/Loaders/DCMTKLoader.h"
 #include "VolumeAsset/Loaders/MHDLoader.h"
+#include "VolumeAsset/Loaders/NRRDLoader.h"
 #include "VolumeAsset/VolumeAsset.h"
 #include "VolumeImporter.h"
 
@@ -23,6 +24,8 @@ UVolumeAssetFactory::UVolumeAssetFactory(const FObjectInitializer& ObjectInitial
 	Formats.Add(FString(TEXT(";")) + NSLOCTEXT("UMHDVolumeTextureFactory", "FormatAny", "No Extension File").ToString());
 	Formats.Add(FString(TEXT("mhd;")) + NSLOCTEXT("UMHDVolumeTextureFactory", "FormatMhd", ".mhd File").ToString());
 	Formats.Add(FString(TEXT("dcm;")) + NSLOCTEXT("UMHDVolumeTextureFactory", "FormatDicom", ".dcm File").ToString());
+	Formats.Add(FString(TEXT("nrrd;")) + NSLOCTEXT("UMHDVolumeTextureFactory", "FormatNrrd", ".nrrd File").ToString());
+	Formats.Add(FString(TEXT("nhdr;")) + NSLOCTEXT("UMHDVolumeTextureFactory", "FormatNhdr", ".nhdr File").ToString());
 
 	SupportedClass = UVolumeAsset::StaticClass();
 	bCreateNew = false;
@@ -50,6 +53,10 @@ UObject* UVolumeAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
 	{
 		VolumeImporterWindow->LoaderType = EVolumeImporterLoaderType::MHD;
 	}
+	else if (ExtensionPart.Equals(TEXT("nrrd")) || ExtensionPart.Equals(TEXT("nhdr")))
+	{
+		VolumeImporterWindow->LoaderType = EVolumeImporterLoaderType::NRRD;
+	}
 	else
 	{
 		VolumeImporterWindow->LoaderType = EVolumeImporterLoaderType::DICOM;
@@ -68,6 +75,10 @@ UObject* UVolumeAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
 	{
 		Loader = UMHDLoader::Get();
 	}
+	else if (VolumeImporterWindow->LoaderType == EVolumeImporterLoaderType::NRRD)
+	{
+		Loader = UNRRDLoader::Get();
+	}
 	else
 	{
 		UDCMTKLoader* DCMTKLoader = UDCMTKLoader::Get();
@@ -92,6 +92,9 @@ void SVolumeImporterWindow::Construct(const FArguments& InArgs)
 				+ SSegmentedControl<EVolumeImporterLoaderType>::Slot(EVolumeImporterLoaderType::MHD)
 				.Text(LOCTEXT("LoaderTypeMHD", "MHD"))
 				.ToolTip(LOCTEXT("LoaderTypeMHD", "MHD format."))
+				+ SSegmentedControl<EVolumeImporterLoaderType>::Slot(EVolumeImporterLoaderType::NRRD)
+				.Text(LOCTEXT("LoaderTypeNRRD", "NRRD"))
+				.ToolTip(LOCTEXT("LoaderTypeNRRDTooltip", "NRRD format, attached (.nrrd) or detached (.nhdr) header."))
 			]
 
 			+ SVerticalBox::Slot()
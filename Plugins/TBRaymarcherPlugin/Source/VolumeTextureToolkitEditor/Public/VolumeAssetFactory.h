@@ -11,7 +11,8 @@
 #include "VolumeAssetFactory.generated.h"
 
 /**
- * Implements a factory for creating volume texture assets by drag'n'dropping .mhd and .dcm files into the content browser.
+ * Implements a factory for creating volume texture assets by drag'n'dropping .mhd, .dcm, .nrrd and .nhdr files into the content
+ * browser.
  */
 UCLASS(hidecategories = Object)
 class UVolumeAssetFactory
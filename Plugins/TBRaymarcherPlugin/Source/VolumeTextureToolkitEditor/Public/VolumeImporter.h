@@ -8,6 +8,7 @@ enum class EVolumeImporterLoaderType : int8
 {
 	MHD,
 	DICOM,
+	NRRD,
 };
 
 enum class EVolumeImporterThicknessOperation : int8
@@ -7,10 +7,12 @@
 
 #include "Actor/RaymarchVolume.h"
 #include "Engine/VolumeTexture.h"
-#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
 #include "Logging/LogMacros.h"
-#include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
+#include "Tasks/Task.h"
+#include "TextureUtilities.h"
+#include "VolumeAsset/Loaders/NRRDLoader.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogVMVolumeManager, Log, All);
 
@@ -72,14 +74,19 @@ void AVMVolumeManager::LoadNRRDIntensity()
 		return;
 	}
 
-	TArray<uint8> RawBytes;
-	if (!LoadRawDataAndComputeMinMax(Header, RawBytes))
+	const double StartTime = FPlatformTime::Seconds();
+	const uint64 PeakMemoryBefore = FPlatformMemory::GetStats().PeakUsedPhysical;
+
+	UVolumeTexture* VolumeTex = nullptr;
+	if (Header.bIsRawInt16)
 	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to load RAW data for NRRD: %s"), *AbsHeaderPath);
-		return;
+		VolumeTex = StreamRawIntoVolumeTexture(Header);
+	}
+	else
+	{
+		VolumeTex = LoadThroughNRRDLoader(AbsHeaderPath, Header);
 	}
 
-	UVolumeTexture* VolumeTex = CreateVolumeTextureFromRaw(Header, RawBytes);
 	if (!VolumeTex)
 	{
 		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to create UVolumeTexture from NRRD: %s"), *AbsHeaderPath);
@@ -92,8 +99,11 @@ void AVMVolumeManager::LoadNRRDIntensity()
 
 	ApplyToRaymarchVolume(VolumeTex, Header);
 
-	UE_LOG(LogVMVolumeManager, Log, TEXT("Loaded NRRD '%s' -> %dx%dx%d, min=%d, max=%d"), *AbsHeaderPath, Header.SizeX,
-		Header.SizeY, Header.SizeZ, Header.MinValue, Header.MaxValue);
+	const uint64 PeakMemoryAfter = FPlatformMemory::GetStats().PeakUsedPhysical;
+	UE_LOG(LogVMVolumeManager, Log,
+		TEXT("Loaded NRRD '%s' -> %dx%dx%d, min=%d, max=%d in %.3f s, peak physical memory %.1f MB (+%.1f MB)"), *AbsHeaderPath,
+		Header.SizeX, Header.SizeY, Header.SizeZ, Header.MinValue, Header.MaxValue, FPlatformTime::Seconds() - StartTime,
+		PeakMemoryAfter / (1024.0 * 1024.0), (PeakMemoryAfter - PeakMemoryBefore) / (1024.0 * 1024.0));
 }
 
 // -------------------------------------------------------------------------
@@ -102,200 +112,57 @@ void AVMVolumeManager::LoadNRRDIntensity()
 
 bool AVMVolumeManager::ParseNRRDHeader(const FString& HeaderFilePath, FVMNRRDHeader& OutHeader) const
 {
-	FString FileText;
-	if (!FFileHelper::LoadFileToString(FileText, *HeaderFilePath))
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to read NRRD header file: %s"), *HeaderFilePath);
-		return false;
-	}
-
-	TArray<FString> Lines;
-	FileText.ParseIntoArrayLines(Lines, /*bCullEmpty=*/false);
-
-	if (Lines.Num() == 0 || !Lines[0].StartsWith(TEXT("NRRD")))
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("File '%s' is not a valid NRRD (missing NRRD000x magic)."), *HeaderFilePath);
-		return false;
-	}
-
-	int32 Sizes[3] = {0, 0, 0};
-	FString DataFileRel;
-	bool bLittleEndian = true;
-
-	for (const FString& RawLine : Lines)
-	{
-		const FString Line = RawLine.TrimStartAndEnd();
-
-		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
-		{
-			continue;
-		}
-
-		if (Line.StartsWith(TEXT("type:")))
-		{
-			const FString Value = Line.Mid(5).TrimStartAndEnd();
-			if (!Value.Equals(TEXT("short"), ESearchCase::IgnoreCase))
-			{
-				UE_LOG(LogVMVolumeManager, Warning, TEXT("NRRD type '%s' in '%s' is not 'short'. Loader assumes int16."), *Value,
-					*HeaderFilePath);
-			}
-		}
-		else if (Line.StartsWith(TEXT("dimension:")))
-		{
-			const FString Value = Line.Mid(10).TrimStartAndEnd();
-			const int32 Dim = FCString::Atoi(*Value);
-			if (Dim != 3)
-			{
-				UE_LOG(LogVMVolumeManager, Error, TEXT("NRRD dimension %d in '%s' is not 3. Only 3D volumes are supported."), Dim,
-					*HeaderFilePath);
-				return false;
-			}
-		}
-		else if (Line.StartsWith(TEXT("sizes:")))
-		{
-			// Example: sizes: 195 512 512 (Z Y X)
-			const FString Value = Line.Mid(6).TrimStartAndEnd();
-			TArray<FString> Tokens;
-			Value.ParseIntoArray(Tokens, TEXT(" "), true);
-
-			if (Tokens.Num() != 3)
-			{
-				UE_LOG(LogVMVolumeManager, Error, TEXT("NRRD 'sizes' must have 3 entries in '%s'. Found: %d"), *HeaderFilePath,
-					Tokens.Num());
-				return false;
-			}
-
-			Sizes[0] = FCString::Atoi(*Tokens[0]);	  // Z
-			Sizes[1] = FCString::Atoi(*Tokens[1]);	  // Y
-			Sizes[2] = FCString::Atoi(*Tokens[2]);	  // X
-		}
-		else if (Line.StartsWith(TEXT("endian:")))
-		{
-			const FString Value = Line.Mid(7).TrimStartAndEnd();
-			bLittleEndian = !Value.Equals(TEXT("big"), ESearchCase::IgnoreCase);
-		}
-		else if (Line.StartsWith(TEXT("data file:")))
-		{
-			// Example: data file: patient1.raw
-			const FString Value = Line.Mid(10).TrimStartAndEnd();
-			DataFileRel = Value;
-		}
-	}
-
-	if (Sizes[0] <= 0 || Sizes[1] <= 0 || Sizes[2] <= 0)
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("NRRD '%s' has invalid sizes: %d %d %d"), *HeaderFilePath, Sizes[0], Sizes[1],
-			Sizes[2]);
-		return false;
-	}
-
-	if (DataFileRel.IsEmpty())
+	// Same parser the editor importer uses, so every encoding, type and header layout it understands works here too.
+	FNRRDHeader NRRDHeader;
+	if (!UNRRDLoader::ParseHeader(HeaderFilePath, NRRDHeader))
 	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("NRRD '%s' missing 'data file' entry."), *HeaderFilePath);
 		return false;
 	}
 
-	OutHeader.SizeZ = Sizes[0];
-	OutHeader.SizeY = Sizes[1];
-	OutHeader.SizeX = Sizes[2];
-	OutHeader.BytesPerVoxel = 2;
-	OutHeader.bLittleEndian = bLittleEndian;
-
-	const FString HeaderDir = FPaths::GetPath(HeaderFilePath);
-	OutHeader.RawFilePath = FPaths::ConvertRelativePathToFull(FPaths::Combine(HeaderDir, DataFileRel));
+	const FVolumeInfo& Info = NRRDHeader.VolumeInfo;
+	OutHeader.SizeX = Info.Dimensions.X;
+	OutHeader.SizeY = Info.Dimensions.Y;
+	OutHeader.SizeZ = Info.Dimensions.Z;
+	OutHeader.Spacing = Info.Spacing;
+	OutHeader.WorldDimensions = Info.WorldDimensions;
+	OutHeader.Origin = Info.Origin;
+	OutHeader.BytesPerVoxel = NRRDHeader.GetFileBytesPerVoxel();
+	OutHeader.bLittleEndian = !Info.bIsBigEndian;
+	OutHeader.RawFilePath = NRRDHeader.DataFilePath;
+	OutHeader.bIsRawInt16 = Info.OriginalFormat == EVolumeVoxelFormat::SignedShort && !Info.bIsCompressed &&
+							Info.DataFileOffset == 0 && OutHeader.bLittleEndian;
 
 	return true;
 }
 
 // -------------------------------------------------------------------------
-// RAW loading + min/max
+// RAW streaming + min/max
 // -------------------------------------------------------------------------
 
-bool AVMVolumeManager::LoadRawDataAndComputeMinMax(FVMNRRDHeader& InOutHeader, TArray<uint8>& OutRawBytes) const
+UVolumeTexture* AVMVolumeManager::StreamRawIntoVolumeTexture(FVMNRRDHeader& InOutHeader)
 {
-	if (!FPaths::FileExists(InOutHeader.RawFilePath))
+	if (InOutHeader.SizeX <= 0 || InOutHeader.SizeY <= 0 || InOutHeader.SizeZ <= 0)
 	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("NRRD RAW file not found: %s"), *InOutHeader.RawFilePath);
-		return false;
+		UE_LOG(LogVMVolumeManager, Error, TEXT("Invalid volume sizes: %d x %d x %d"), InOutHeader.SizeX, InOutHeader.SizeY,
+			InOutHeader.SizeZ);
+		return nullptr;
 	}
 
 	const int64 ExpectedBytes = static_cast<int64>(InOutHeader.SizeX) * static_cast<int64>(InOutHeader.SizeY) *
-								static_cast<int64>(InOutHeader.SizeZ) * static_cast<int64>(InOutHeader.BytesPerVoxel);
+								static_cast<int64>(InOutHeader.SizeZ) * sizeof(int16);
 
-	int64 ActualSize = IFileManager::Get().FileSize(*InOutHeader.RawFilePath);
-	if (ActualSize != ExpectedBytes)
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*InOutHeader.RawFilePath));
+	if (!FileHandle)
 	{
-		UE_LOG(LogVMVolumeManager, Warning, TEXT("RAW file size mismatch for '%s': expected %lld bytes, got %lld bytes."),
-			*InOutHeader.RawFilePath, ExpectedBytes, ActualSize);
-	}
-
-	if (!FFileHelper::LoadFileToArray(OutRawBytes, *InOutHeader.RawFilePath))
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to read RAW file: %s"), *InOutHeader.RawFilePath);
-		return false;
-	}
-
-	// Clamp or pad to expected bytes
-	if (OutRawBytes.Num() < ExpectedBytes)
-	{
-		UE_LOG(LogVMVolumeManager, Warning, TEXT("RAW file '%s' is smaller than expected (%d < %lld). Zero-padding."),
-			*InOutHeader.RawFilePath, OutRawBytes.Num(), ExpectedBytes);
-		OutRawBytes.SetNumZeroed(ExpectedBytes);
-	}
-	else if (OutRawBytes.Num() > ExpectedBytes)
-	{
-		OutRawBytes.SetNum(ExpectedBytes);
-	}
-
-	// Interpret as int16
-	if (OutRawBytes.Num() <= 0)
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("RAW data empty after load."));
-		return false;
-	}
-
-	const int16* DataPtr = reinterpret_cast<const int16*>(OutRawBytes.GetData());
-	const int32 NumSamples = OutRawBytes.Num() / 2;
-	if (NumSamples <= 0)
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("RAW data has no 16-bit samples."));
-		return false;
-	}
-
-	int16 MinVal = DataPtr[0];
-	int16 MaxVal = DataPtr[0];
-
-	for (int32 i = 1; i < NumSamples; ++i)
-	{
-		const int16 V = DataPtr[i];
-		if (V < MinVal)
-			MinVal = V;
-		if (V > MaxVal)
-			MaxVal = V;
-	}
-
-	InOutHeader.MinValue = MinVal;
-	InOutHeader.MaxValue = MaxVal;
-
-	return true;
-}
-
-// -------------------------------------------------------------------------
-// UVolumeTexture creation (UE 5.4-safe)
-// -------------------------------------------------------------------------
-
-UVolumeTexture* AVMVolumeManager::CreateVolumeTextureFromRaw(const FVMNRRDHeader& Header, const TArray<uint8>& RawBytes)
-{
-	if (Header.SizeX <= 0 || Header.SizeY <= 0 || Header.SizeZ <= 0)
-	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("Invalid volume sizes: %d x %d x %d"), Header.SizeX, Header.SizeY, Header.SizeZ);
+		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to open NRRD RAW file: %s"), *InOutHeader.RawFilePath);
 		return nullptr;
 	}
 
-	if (RawBytes.Num() <= 0)
+	const int64 ActualSize = FileHandle->Size();
+	if (ActualSize != ExpectedBytes)
 	{
-		UE_LOG(LogVMVolumeManager, Error, TEXT("Empty RAW data."));
-		return nullptr;
+		UE_LOG(LogVMVolumeManager, Warning, TEXT("RAW file size mismatch for '%s': expected %lld bytes, got %lld bytes."),
+			*InOutHeader.RawFilePath, ExpectedBytes, ActualSize);
 	}
 
 	// Create transient VolumeTexture
@@ -314,9 +181,9 @@ UVolumeTexture* AVMVolumeManager::CreateVolumeTextureFromRaw(const FVMNRRDHeader
 	VolumeTex->NeverStream = true;
 	VolumeTex->Filter = TF_Bilinear;
 
-	// Initialize the source with one G16 mip
-	VolumeTex->Source.Init(Header.SizeX, Header.SizeY, Header.SizeZ,
-		/*NumSlices=*/1, TSF_G16);
+	// Initialize the source with one G16 mip of SizeZ slices. Without initial data, the mip is left uninitialized - every byte
+	// gets either read from the file or zero-filled below.
+	VolumeTex->Source.Init(InOutHeader.SizeX, InOutHeader.SizeY, InOutHeader.SizeZ, /*NumMips=*/1, TSF_G16);
 
 	uint8* DestData = VolumeTex->Source.LockMip(0);
 	if (!DestData)
@@ -324,32 +191,96 @@ UVolumeTexture* AVMVolumeManager::CreateVolumeTextureFromRaw(const FVMNRRDHeader
 		UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to lock VolumeTexture mip 0."));
 		return nullptr;
 	}
+	// Every offset below is 64bit, but make sure the engine agrees on the mip size before writing gigabytes into it.
+	if (VolumeTex->Source.CalcMipSize(0) != ExpectedBytes)
+	{
+		UE_LOG(LogVMVolumeManager, Error, TEXT("VolumeTexture mip 0 holds %lld bytes, the volume needs %lld."),
+			VolumeTex->Source.CalcMipSize(0), ExpectedBytes);
+		VolumeTex->Source.UnlockMip(0);
+		return nullptr;
+	}
 
-	const int64 ExpectedBytes =
-		static_cast<int64>(Header.SizeX) * static_cast<int64>(Header.SizeY) * static_cast<int64>(Header.SizeZ) * sizeof(uint16);
+	// Read slabs of whole slices into the mip. As soon as a slab is in, a task finds its min/max while the next one is read.
+	constexpr int64 SlicesPerSlab = 16;
+	const int64 SlabBytes = static_cast<int64>(InOutHeader.SizeX) * static_cast<int64>(InOutHeader.SizeY) * sizeof(int16) *
+							SlicesPerSlab;
+	const int64 BytesToRead = FMath::Min(ExpectedBytes, ActualSize);
+	const int32 NumSlabs = static_cast<int32>(FMath::DivideAndRoundUp(BytesToRead, SlabBytes));
+
+	TArray<float> SlabMins, SlabMaxs;
+	SlabMins.Init(TNumericLimits<float>::Max(), NumSlabs);
+	SlabMaxs.Init(TNumericLimits<float>::Lowest(), NumSlabs);
+	TArray<UE::Tasks::FTask> SlabTasks;
+	SlabTasks.Reserve(NumSlabs);
+
+	bool bReadSucceeded = true;
+	for (int32 SlabIndex = 0; SlabIndex < NumSlabs; SlabIndex++)
+	{
+		const int64 SlabStart = SlabIndex * SlabBytes;
+		const int64 SlabSize = FMath::Min(SlabBytes, BytesToRead - SlabStart);
+		uint8* SlabData = DestData + SlabStart;
+		if (!FileHandle->Read(SlabData, SlabSize))
+		{
+			UE_LOG(LogVMVolumeManager, Error, TEXT("Failed to read RAW file: %s"), *InOutHeader.RawFilePath);
+			bReadSucceeded = false;
+			break;
+		}
+
+		SlabTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[SlabData, SlabSize, &SlabMin = SlabMins[SlabIndex], &SlabMax = SlabMaxs[SlabIndex]]()
+			{
+				UVolumeTextureToolkit::FindMinMaxByFormat(EVolumeVoxelFormat::SignedShort, SlabData, SlabSize, SlabMin, SlabMax);
+			}));
+	}
+	// The tasks write into the mip and the slab arrays, they must be done before any of those goes away.
+	UE::Tasks::Wait(SlabTasks);
 
-	const int64 CopyBytes = FMath::Min<int64>(ExpectedBytes, RawBytes.Num());
-	if (CopyBytes > 0)
+	if (!bReadSucceeded)
 	{
-		FMemory::Memcpy(DestData, RawBytes.GetData(), static_cast<SIZE_T>(CopyBytes));
+		VolumeTex->Source.UnlockMip(0);
+		return nullptr;
 	}
 
 	// Zero-fill any remainder
-	if (CopyBytes < ExpectedBytes)
+	if (BytesToRead < ExpectedBytes)
 	{
-		const int64 Remaining = ExpectedBytes - CopyBytes;
-		FMemory::Memset(DestData + CopyBytes, 0, static_cast<SIZE_T>(Remaining));
-		UE_LOG(LogVMVolumeManager, Warning, TEXT("CreateVolumeTextureFromRaw: zero-filled %lld trailing bytes."), Remaining);
+		const int64 Remaining = ExpectedBytes - BytesToRead;
+		FMemory::Memzero(DestData + BytesToRead, Remaining);
+		UE_LOG(LogVMVolumeManager, Warning, TEXT("RAW file '%s' is smaller than expected (%lld < %lld). Zero-padding."),
+			*InOutHeader.RawFilePath, BytesToRead, ExpectedBytes);
+		// The padding is part of the volume, so it counts towards the range.
+		SlabMins.Add(0.0f);
+		SlabMaxs.Add(0.0f);
 	}
 
 	VolumeTex->Source.UnlockMip(0);
 
+	InOutHeader.MinValue = FMath::FloorToInt32(FMath::Min(SlabMins));
+	InOutHeader.MaxValue = FMath::CeilToInt32(FMath::Max(SlabMaxs));
+
 	// Create RHI resource
 	VolumeTex->UpdateResource();
 
 	return VolumeTex;
 }
 
+// -------------------------------------------------------------------------
+// Everything else (gzip, other types, attached headers)
+// -------------------------------------------------------------------------
+
+UVolumeTexture* AVMVolumeManager::LoadThroughNRRDLoader(const FString& HeaderFilePath, FVMNRRDHeader& InOutHeader)
+{
+	UVolumeAsset* VolumeAsset = UNRRDLoader::Get()->CreateVolumeFromFile(HeaderFilePath, false, true);
+	if (!VolumeAsset)
+	{
+		return nullptr;
+	}
+
+	InOutHeader.MinValue = FMath::FloorToInt32(VolumeAsset->ImageInfo.MinValue);
+	InOutHeader.MaxValue = FMath::CeilToInt32(VolumeAsset->ImageInfo.MaxValue);
+	return VolumeAsset->DataTexture;
+}
+
 // -------------------------------------------------------------------------
 // Hook into Raymarcher (no internals touched)
 // -------------------------------------------------------------------------
@@ -377,9 +308,12 @@ void AVMVolumeManager::ApplyToRaymarchVolume(UVolumeTexture* VolumeTexture, cons
 	//   - Use 'Set Members in BasicRaymarchRenderingResources' on RaymarchResources
 	//   - Assign the correct field (e.g. DataVolumeTextureRef / IntensityTexture / etc.)
 	//   - Then call TargetRaymarchVolume->SetAllMaterialParameters() from Blueprint.
+	// The mesh scale is public API though, so anisotropic volumes don't render as a unit cube.
+	TargetRaymarchVolume->SetVolumeWorldDimensions(Header.WorldDimensions);
 
 	UE_LOG(LogVMVolumeManager, Log,
-		TEXT("ApplyToRaymarchVolume: Texture '%s' ready (%dx%dx%d, min=%d, max=%d). "
+		TEXT("ApplyToRaymarchVolume: Texture '%s' ready (%dx%dx%d, spacing %s mm, min=%d, max=%d). "
 			 "Wire it in Blueprint via GetLoadedVolumeTexture()."),
-		*VolumeTexture->GetName(), Header.SizeX, Header.SizeY, Header.SizeZ, Header.MinValue, Header.MaxValue);
+		*VolumeTexture->GetName(), Header.SizeX, Header.SizeY, Header.SizeZ, *Header.Spacing.ToString(), Header.MinValue,
+		Header.MaxValue);
 }
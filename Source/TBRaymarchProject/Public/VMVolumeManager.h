@@ -2,9 +2,11 @@
 // VoluMatrix runtime NRRD loader.
 //
 // This actor:
-//   - Reads a simple 3D NRRD header (.nhdr)
-//   - Loads the associated .raw file (16-bit signed intensity)
-//   - Builds a transient UVolumeTexture (PF_G16)
+//   - Reads a 3D NRRD header (.nhdr / .nrrd) through UNRRDLoader
+//   - Streams the associated .raw file (16-bit signed intensity) slab by slab
+//     straight into the texture, or loads any other NRRD (gzip, other types)
+//     through UNRRDLoader as float
+//   - Builds a transient UVolumeTexture (PF_G16 or PF_R32_FLOAT)
 //   - Exposes the resulting texture to Blueprint
 //   - Optionally logs min/max so you can pick window/width
 
@@ -19,13 +21,14 @@ class ARaymarchVolume;
 class UVolumeTexture;
 
 /**
- * Minimal parsed NRRD header info.
- * Assumptions (must match dicom_to_nrrd.py):
+ * Parsed NRRD header info.
+ * The fast path expects what dicom_to_nrrd.py writes:
  *  - type: short
  *  - dimension: 3
  *  - encoding: raw
  *  - endian: little
- *  - sizes: Z Y X  (converter writes in that order)
+ *  - sizes: X Y Z  (fastest axis first, as the NRRD standard says)
+ * Anything else gets loaded through UNRRDLoader.
  */
 USTRUCT(BlueprintType)
 struct FVMNRRDHeader
@@ -34,11 +37,23 @@ struct FVMNRRDHeader
 
 	// Texture dimensions in Unreal terms (VolumeTexture expects X,Y,Z)
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
-	int32 SizeX = 0;	// columns (Nrrd axis 2)
+	int32 SizeX = 0;	// columns (Nrrd axis 0)
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
 	int32 SizeY = 0;	// rows    (Nrrd axis 1)
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
-	int32 SizeZ = 0;	// slices  (Nrrd axis 0)
+	int32 SizeZ = 0;	// slices  (Nrrd axis 2)
+
+	// Voxel size in mm, from "space directions" or "spacings" (1 if the header has neither)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
+	FVector Spacing = FVector(1, 1, 1);
+
+	// Size of the whole volume in mm (Size * Spacing), what the raymarched mesh gets scaled to
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
+	FVector WorldDimensions = FVector::ZeroVector;
+
+	// Center of the first voxel in mm, LPS patient space ("space origin")
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
+	FVector Origin = FVector::ZeroVector;
 
 	// Full absolute path to the raw file
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
@@ -52,7 +67,12 @@ struct FVMNRRDHeader
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
 	bool bLittleEndian = true;
 
-	// Intensity range computed from RAW
+	// True if the data is a separate, uncompressed little-endian int16 file, which gets uploaded as-is.
+	// Everything else gets loaded through UNRRDLoader.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
+	bool bIsRawInt16 = true;
+
+	// Intensity range computed while streaming the RAW
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
 	int32 MinValue = 0;
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "VoluMatrix")
@@ -114,15 +134,18 @@ private:
 
 	// --- Internal helpers ---
 
-	/** Parse minimal 3D NRRD header from disk into FVMNRRDHeader. */
+	/** Parse 3D NRRD header from disk into FVMNRRDHeader (via UNRRDLoader). */
 	bool ParseNRRDHeader(const FString& HeaderFilePath, FVMNRRDHeader& OutHeader) const;
 
-	/** Load RAW file, compute min/max, write back to OutHeader. */
-	bool LoadRawDataAndComputeMinMax(FVMNRRDHeader& InOutHeader, TArray<uint8>& OutRawBytes) const;
+	/** Loads any NRRD that isn't raw int16 through UNRRDLoader as a float texture, fills in the min/max of OutHeader. */
+	UVolumeTexture* LoadThroughNRRDLoader(const FString& HeaderFilePath, FVMNRRDHeader& InOutHeader);
 
-	/** Create a PF_G16 UVolumeTexture from raw bytes. */
-	UVolumeTexture* CreateVolumeTextureFromRaw(const FVMNRRDHeader& Header, const TArray<uint8>& RawBytes);
+	/**
+	 * Creates a PF_G16 UVolumeTexture and reads the RAW file slab by slab directly into its locked source mip. The min/max of
+	 * every slab is computed on a worker while the next one is read, and written back to InOutHeader.
+	 */
+	UVolumeTexture* StreamRawIntoVolumeTexture(FVMNRRDHeader& InOutHeader);
 
-	/** Just log and sanity-check; no direct RaymarchResources access here. */
+	/** Scales TargetRaymarchVolume to the volume size in mm and logs; no direct RaymarchResources access here. */
 	void ApplyToRaymarchVolume(UVolumeTexture* VolumeTexture, const FVMNRRDHeader& Header);
 };
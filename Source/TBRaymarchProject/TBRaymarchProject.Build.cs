@@ -19,7 +19,9 @@ public class TBRaymarchProject : ModuleRules
                 "RenderCore",
                 "RHI",
                 // Needed to use ARaymarchVolume
-                "Raymarcher"
+                "Raymarcher",
+                // Needed to use UNRRDLoader
+                "VolumeTextureToolkit"
             });
 
         PrivateDependencyModuleNames.AddRange(
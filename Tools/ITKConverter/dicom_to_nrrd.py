@@ -1,18 +1,28 @@
+import argparse
+import json
 import os
-import sys
+import time
+from concurrent.futures import ProcessPoolExecutor, ThreadPoolExecutor, as_completed
+
 import numpy as np
 import itk
 
+# Typical CT HU range the intensities get clipped to.
+HU_MIN = -1024
+HU_MAX = 3071
+
+# Bins of the coarse histogram stored in the batch manifest.
+MANIFEST_HISTOGRAM_BINS = 64
+
+# Number of downsampled levels (1/2, 1/4, 1/8) written with --pyramid.
+PYRAMID_LEVELS = 3
+PYRAMID_REDUCTIONS = ("mean", "min", "max")
+
 
-def load_dicom_series(dicom_dir: str):
+def get_series_file_names(dicom_dir: str):
     """
-    Load the FIRST DICOM series from the given folder
-    using ITK + GDCM. Returns a 3D ITK Image with signed short pixels.
+    Return the sorted file names of the FIRST DICOM series in the given folder.
     """
-    pixel_type = itk.ctype("signed short")
-    image_type = itk.Image[pixel_type, 3]
-
-    reader = itk.ImageSeriesReader[image_type].New()
     names = itk.GDCMSeriesFileNames.New()
     names.SetDirectory(dicom_dir)
 
@@ -27,16 +37,51 @@ def load_dicom_series(dicom_dir: str):
     chosen_uid = series_uids[0]
     file_list = names.GetFileNames(chosen_uid)
     print(f"Using series [0]: {chosen_uid} — {len(file_list)} slices")
+    return list(file_list)
+
+
+def find_all_series(root_dir: str):
+    """
+    Walk the whole directory tree and return [(series_uid, sorted file names)]
+    for every DICOM series in it.
+    """
+    names = itk.GDCMSeriesFileNames.New()
+    names.SetRecursive(True)
+    names.SetDirectory(root_dir)
+    return [(str(uid), list(names.GetFileNames(uid))) for uid in names.GetSeriesUIDs()]
 
-    reader.SetFileNames(file_list)
+
+def create_series_reader(threads: int):
+    """
+    Create an ITK series reader for signed short 3D images. ITK's multi-threaded
+    filters use `threads` work units (0 keeps ITK's default of one per core).
+    """
+    pixel_type = itk.ctype("signed short")
+    image_type = itk.Image[pixel_type, 3]
+
+    if threads > 0:
+        itk.MultiThreaderBase.SetGlobalDefaultNumberOfThreads(threads)
+    reader = itk.ImageSeriesReader[image_type].New()
+    if threads > 0:
+        reader.SetNumberOfWorkUnits(threads)
+    return reader
+
+
+def load_dicom_series(dicom_dir: str, threads: int = 0):
+    """
+    Load the FIRST DICOM series from the given folder
+    using ITK + GDCM. Returns a 3D ITK Image with signed short pixels.
+    """
+    reader = create_series_reader(threads)
+    reader.SetFileNames(get_series_file_names(dicom_dir))
     reader.Update()
     return reader.GetOutput()
 
 
-def apply_hu_scaling(image):
+def read_rescale(image):
     """
-    Apply RescaleSlope and RescaleIntercept to convert raw DICOM
-    values to CT Hounsfield Units (HU). Output is int16.
+    Return (slope, intercept) from the DICOM meta data of the image,
+    (1, 0) if they can't be found.
     """
     slope = 1.0
     intercept = 0.0
@@ -53,6 +98,15 @@ def apply_hu_scaling(image):
                 intercept = float(val)
     except Exception as e:
         print("Warning: could not read RescaleSlope/Intercept:", e)
+    return slope, intercept
+
+
+def apply_hu_scaling(image):
+    """
+    Apply RescaleSlope and RescaleIntercept to convert raw DICOM
+    values to CT Hounsfield Units (HU). Output is int16.
+    """
+    slope, intercept = read_rescale(image)
 
     # ITK → NumPy (shape: [z, y, x])
     arr = itk.GetArrayFromImage(image).astype(np.float32)
@@ -61,7 +115,7 @@ def apply_hu_scaling(image):
     hu = arr * slope + intercept
 
     # Clip to a typical CT HU range and convert to int16
-    hu = np.clip(hu, -1024, 3071).astype(np.int16)
+    hu = np.clip(hu, HU_MIN, HU_MAX).astype(np.int16)
 
     # NumPy → ITK (preserve orientation info)
     out = itk.GetImageFromArray(hu)
@@ -69,75 +123,457 @@ def apply_hu_scaling(image):
     return out
 
 
-def write_nrrd_raw(image, nhdr_path, raw_path):
+def rescale_slab_in_place(slab, slope: float, intercept: float):
     """
-    Write a simple, Slicer-compatible NRRD+RAW pair.
+    Convert a slab of raw int16 values ([z, y, x] NumPy view) to HU clipped to
+    [HU_MIN, HU_MAX] in place. Gives the same values as apply_hu_scaling.
 
-    - No 'space', 'space directions', or 'spacings' fields.
-    - Only essential header fields.
-    - sizes are written as X Y Z, matching NumPy's [z, y, x] layout.
+    Integer rescales (the usual slope 1) are clipped and shifted in int16
+    directly. Anything else goes through a single float32 slice at a time.
+    """
+    if slope == 1.0 and intercept == int(intercept):
+        # Clip before shifting, so that the shift can't overflow int16.
+        low = int(max(HU_MIN - intercept, np.iinfo(np.int16).min))
+        high = int(min(HU_MAX - intercept, np.iinfo(np.int16).max))
+        np.clip(slab, low, high, out=slab)
+        slab += np.int16(intercept)
+        return
+
+    scratch = np.empty(slab.shape[1:], dtype=np.float32)
+    for z in range(slab.shape[0]):
+        np.multiply(slab[z], slope, out=scratch)
+        scratch += intercept
+        np.clip(scratch, HU_MIN, HU_MAX, out=scratch)
+        # Truncates like astype(np.int16) does.
+        slab[z] = scratch
+
+
+def reduce_by_two(arr, reduction: str):
+    """
+    Halve every axis of a [z, y, x] int16 array, combining each 2x2x2 block
+    with reduction ("mean", "min" or "max"). Odd sizes repeat the last
+    slice/row/column, so the result has ceil(size / 2) voxels per axis.
+    """
+    padding = [(0, size % 2) for size in arr.shape]
+    if any(pad for _, pad in padding):
+        arr = np.pad(arr, padding, mode="edge")
+    nz, ny, nx = arr.shape
+    blocks = arr.reshape(nz // 2, 2, ny // 2, 2, nx // 2, 2)
+    if reduction == "min":
+        return blocks.min(axis=(1, 3, 5))
+    if reduction == "max":
+        return blocks.max(axis=(1, 3, 5))
+    # Mean rounded to the nearest integer (half up).
+    sums = blocks.sum(axis=(1, 3, 5), dtype=np.int32)
+    return np.floor_divide(sums + 4, 8).astype(np.int16)
+
+
+class PyramidWriter:
+    """
+    Writes the downsampled levels of a volume to <raw>_l1.raw, <raw>_l2.raw...
+    Gets the full resolution volume slab by slab, in order. Slabs must have a
+    multiple of 2^levels slices (except the last one), so that every level is
+    the same as if the whole volume was reduced at once.
     """
-    # ITK → NumPy
-    arr = itk.GetArrayFromImage(image).astype(np.int16)
-    nz, ny, nx = arr.shape  # [z, y, x]
 
-    # Write raw data
-    with open(raw_path, "wb") as f:
-        arr.tofile(f)
+    def __init__(self, raw_path: str, levels: int, reduction: str):
+        base, _ = os.path.splitext(raw_path)
+        self.reduction = reduction
+        self.paths = [f"{base}_l{level}.raw" for level in range(1, levels + 1)]
+        self.files = [open(path, "wb") for path in self.paths]
+        self.sizes = [[0, 0, 0] for _ in self.paths]  # X Y Z
+
+    def add_slab(self, slab):
+        for level_file, size in zip(self.files, self.sizes):
+            slab = reduce_by_two(slab, self.reduction)
+            slab.tofile(level_file)
+            size[0], size[1] = slab.shape[2], slab.shape[1]
+            size[2] += slab.shape[0]
+
+    def close(self):
+        for level_file in self.files:
+            level_file.close()
+
+    def header_lines(self):
+        """
+        NRRD key/value lines referencing the levels. Every level is a RAW file
+        of the same type and endianness as the full resolution data, with
+        2^level times the spacing.
+        """
+        lines = [f"pyramid reduction:={self.reduction}"] if self.paths else []
+        for level, (path, size) in enumerate(zip(self.paths, self.sizes), start=1):
+            lines.append(f"pyramid level {level}:={os.path.basename(path)} {size[0]} {size[1]} {size[2]}")
+        return lines
+
+    def manifest_entries(self):
+        return [
+            {"level": level, "raw": os.path.basename(path), "dimensions": list(size)}
+            for level, (path, size) in enumerate(zip(self.paths, self.sizes), start=1)
+        ]
+
+
+def image_geometry(image):
+    """
+    Spacing, origin and direction cosines of an ITK image, in the LPS patient
+    space ITK reads DICOMs into. direction[i] is the unit vector of voxel axis i.
+    """
+    direction = itk.array_from_matrix(image.GetDirection())
+    return {
+        "spacing": [float(value) for value in image.GetSpacing()],
+        "origin": [float(value) for value in image.GetOrigin()],
+        # ITK stores the axes as columns.
+        "direction": [[float(value) for value in direction[:, axis]] for axis in range(3)],
+    }
 
+
+def format_nrrd_vector(vector):
+    return "(" + ",".join(f"{value:.10g}" for value in vector) + ")"
+
+
+def write_nrrd_header(nhdr_path, raw_path, nx: int, ny: int, nz: int, geometry, extra_lines=()):
+    """
+    Write a simple, Slicer-compatible NRRD header for an int16 RAW file.
+
+    - Orientation as 'space', 'space directions' (axis direction times
+      spacing) and 'space origin', taken from geometry (see image_geometry).
+    - Only essential header fields, plus extra_lines (e.g. pyramid levels).
+    - sizes are written as X Y Z, matching NumPy's [z, y, x] layout.
+    """
+    space_directions = [
+        [component * spacing for component in axis]
+        for axis, spacing in zip(geometry["direction"], geometry["spacing"])
+    ]
     # NRRD header (minimal but valid)
     header_lines = [
         "NRRD0005",
-        "# VoluMatrix intensity volume (simple, no orientation)",
+        "# VoluMatrix intensity volume",
         "type: short",
         "dimension: 3",
+        "space: left-posterior-superior",
         # NRRD standard is sizes in X Y Z order
         f"sizes: {nx} {ny} {nz}",
+        "space directions: " + " ".join(format_nrrd_vector(axis) for axis in space_directions),
+        "kinds: domain domain domain",
         "encoding: raw",
         "endian: little",
+        f"space origin: {format_nrrd_vector(geometry['origin'])}",
+        *extra_lines,
         f"data file: {os.path.basename(raw_path)}",
     ]
 
     with open(nhdr_path, "w") as f:
         f.write("\n".join(header_lines) + "\n")
 
+
+def write_nrrd_raw(image, nhdr_path, raw_path, pyramid_levels: int = 0, pyramid_reduction: str = "mean"):
+    """
+    Write a simple, Slicer-compatible NRRD+RAW pair, plus pyramid_levels
+    downsampled levels.
+    """
+    # ITK → NumPy
+    arr = itk.GetArrayFromImage(image).astype(np.int16)
+    nz, ny, nx = arr.shape  # [z, y, x]
+
+    # Write raw data
+    with open(raw_path, "wb") as f:
+        arr.tofile(f)
+
+    pyramid = PyramidWriter(raw_path, pyramid_levels, pyramid_reduction)
+    pyramid.add_slab(arr)
+    pyramid.close()
+
+    write_nrrd_header(nhdr_path, raw_path, nx, ny, nz, image_geometry(image), pyramid.header_lines())
+
     print("\nWrote NRRD:")
     print(f"  nhdr: {nhdr_path}")
     print(f"  raw : {raw_path}")
     print(f"  sizes (X Y Z): {nx} {ny} {nz}")
 
 
-def main():
-    if len(sys.argv) != 3:
-        print("Usage:")
-        print("  python dicom_to_nrrd.py <dicom_folder> <output_base>")
-        print("Example:")
-        print(r"  python dicom_to_nrrd.py D:\Data\CT_01 .\output\patient1")
-        sys.exit(1)
+def summarize_histogram(histogram):
+    """
+    Summarize a histogram with one bin per HU in [HU_MIN, HU_MAX] for the
+    manifest: mean, a few percentiles and MANIFEST_HISTOGRAM_BINS coarse bins.
+    """
+    total = int(histogram.sum())
+    values = np.arange(HU_MIN, HU_MAX + 1)
+    cumulative = np.cumsum(histogram)
+
+    def percentile(fraction: float):
+        return int(values[np.searchsorted(cumulative, fraction * total, side="right").clip(max=len(values) - 1)])
+
+    return {
+        "mean": float((histogram * values).sum() / total) if total else 0.0,
+        "percentiles": {"0.5": percentile(0.005), "50": percentile(0.5), "99.5": percentile(0.995)},
+        "range": [HU_MIN, HU_MAX],
+        "counts": [int(count) for count in histogram.reshape(MANIFEST_HISTOGRAM_BINS, -1).sum(axis=1)],
+    }
+
+
+def convert_chunked(
+    file_list,
+    nhdr_path: str,
+    raw_path: str,
+    memory_mb: int,
+    threads: int,
+    pyramid_levels: int = 0,
+    pyramid_reduction: str = "mean",
+):
+    """
+    Convert a DICOM series slab by slab, so that peak memory stays within
+    about memory_mb no matter how many slices the series has.
+
+    Every slab is read with the series reader, rescaled to HU in place and
+    appended to the RAW file (and reduced into the pyramid levels). The next
+    slab is read while the current one is being converted and written, so
+    about three slabs fit into the budget.
+    Returns the dimensions, geometry (spacing, origin, direction), min/max,
+    histogram summary and pyramid levels.
+    """
+    # The first slice tells the slice size, and the rescale of the series.
+    reader = create_series_reader(threads)
+    reader.SetFileNames(file_list[:1])
+    reader.Update()
+    first_slice = reader.GetOutput()
+    slope, intercept = read_rescale(first_slice)
+    nx, ny = (int(size) for size in first_slice.GetLargestPossibleRegion().GetSize()[:2])
+
+    slice_bytes = nx * ny * np.dtype(np.int16).itemsize
+    slab_slices = max(1, (memory_mb * 1024 * 1024) // (3 * slice_bytes))
+    # Every pyramid level needs slabs it can halve without leftovers.
+    pyramid_alignment = 2**pyramid_levels
+    slab_slices = max(pyramid_alignment, slab_slices // pyramid_alignment * pyramid_alignment)
+    print(f"Slab size: {slab_slices} slices ({slab_slices * slice_bytes / (1024 * 1024):.1f} MB)")
+
+    def read_slab(first: int):
+        slab_reader = create_series_reader(threads)
+        slab_reader.SetFileNames(file_list[first:first + slab_slices])
+        slab_reader.Update()
+        return slab_reader.GetOutput()
+
+    start_time = time.perf_counter()
+    nz = 0
+    geometry = None
+    histogram = np.zeros(HU_MAX - HU_MIN + 1, dtype=np.int64)
+    pyramid = PyramidWriter(raw_path, pyramid_levels, pyramid_reduction)
+    with open(raw_path, "wb") as raw_file, ThreadPoolExecutor(max_workers=1) as prefetcher:
+        next_slab = prefetcher.submit(read_slab, 0)
+        for first in range(0, len(file_list), slab_slices):
+            image = next_slab.result()
+            if first + slab_slices < len(file_list):
+                next_slab = prefetcher.submit(read_slab, first + slab_slices)
+
+            # View into the ITK image, no copy (shape: [z, y, x]).
+            slab = itk.array_view_from_image(image)
+            if slab.shape[1:] != (ny, nx):
+                raise RuntimeError(f"Slices {first}+ are {slab.shape[2]}x{slab.shape[1]}, expected {nx}x{ny}")
+            rescale_slab_in_place(slab, slope, intercept)
+            slab.tofile(raw_file)
+            pyramid.add_slab(slab)
+            # All values are clipped to [HU_MIN, HU_MAX], so they index the histogram directly.
+            histogram += np.bincount((slab.ravel() - HU_MIN).astype(np.intp), minlength=len(histogram))
+            if geometry is None:
+                # The origin and direction of the volume are the ones of its first slab.
+                geometry = image_geometry(image)
+            elif nz == 1:
+                # The z spacing comes from the slice positions, a slab of a single slice doesn't have one.
+                origin = np.array(image_geometry(image)["origin"])
+                geometry["spacing"][2] = float(np.linalg.norm(origin - np.array(geometry["origin"])))
+            nz += slab.shape[0]
+            del slab, image
+
+            elapsed = time.perf_counter() - start_time
+            print(f"  {nz}/{len(file_list)} slices, {nz / elapsed:.1f} slices/sec")
+
+    pyramid.close()
+    write_nrrd_header(nhdr_path, raw_path, nx, ny, nz, geometry, pyramid.header_lines())
+
+    print("\nWrote NRRD:")
+    print(f"  nhdr: {nhdr_path}")
+    print(f"  raw : {raw_path}")
+    print(f"  sizes (X Y Z): {nx} {ny} {nz}")
+
+    occupied = np.nonzero(histogram)[0]
+    return {
+        "dimensions": [nx, ny, nz],
+        **geometry,
+        "min": int(occupied[0]) + HU_MIN if len(occupied) else 0,
+        "max": int(occupied[-1]) + HU_MIN if len(occupied) else 0,
+        "histogram": summarize_histogram(histogram),
+        "pyramid": pyramid.manifest_entries(),
+    }
 
-    dicom_dir = sys.argv[1]
-    out_base = sys.argv[2]
+
+def convert_series_job(
+    series_uid: str, file_list, out_base: str, memory_mb: int, threads: int, pyramid_levels: int, pyramid_reduction: str
+):
+    """
+    Batch worker: convert one series (in its own process) and return its manifest entry.
+    """
+    nhdr_path = out_base + ".nhdr"
+    raw_path = out_base + ".raw"
+    entry = {"uid": series_uid, "nhdr": os.path.basename(nhdr_path), "raw": os.path.basename(raw_path)}
+    start_time = time.perf_counter()
+    try:
+        entry.update(
+            convert_chunked(file_list, nhdr_path, raw_path, memory_mb, threads, pyramid_levels, pyramid_reduction)
+        )
+    except Exception as e:
+        entry["error"] = str(e)
+    entry["seconds"] = round(time.perf_counter() - start_time, 2)
+    return entry
+
+
+def convert_batch(
+    root_dir: str, out_dir: str, memory_mb: int, threads: int, workers: int, pyramid_levels: int, pyramid_reduction: str
+):
+    """
+    Convert every series under root_dir in parallel worker processes. Writes
+    one .nhdr/.raw per series into out_dir plus manifest.json describing all of
+    them, so the volumes can be listed without reading any RAW data.
+    Returns the number of slices converted.
+    """
+    all_series = find_all_series(root_dir)
+    if len(all_series) == 0:
+        raise RuntimeError(f"No DICOM series found under: {root_dir}")
+    print(f"Found {len(all_series)} series, converting with {workers} workers")
+
+    os.makedirs(out_dir, exist_ok=True)
+    if threads <= 0:
+        # Share the cores between the workers instead of every worker using all of them.
+        threads = max(1, (os.cpu_count() or 1) // workers)
+    entries = []
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        jobs = [
+            pool.submit(
+                convert_series_job,
+                uid,
+                file_list,
+                os.path.join(out_dir, f"series_{index:03d}"),
+                memory_mb,
+                threads,
+                pyramid_levels,
+                pyramid_reduction,
+            )
+            for index, (uid, file_list) in enumerate(all_series)
+        ]
+        for job in as_completed(jobs):
+            entry = job.result()
+            entries.append(entry)
+            status = f"FAILED: {entry['error']}" if "error" in entry else "{}x{}x{}".format(*entry["dimensions"])
+            print(f"  [{len(entries)}/{len(jobs)}] {entry['uid']} -> {entry['nhdr']} {status} ({entry['seconds']} s)")
+
+    entries.sort(key=lambda entry: entry["nhdr"])
+    manifest_path = os.path.join(out_dir, "manifest.json")
+    # Read by FVolumeManifest (VolumeTextureToolkit), keep its SupportedVersion in sync with "version".
+    with open(manifest_path, "w") as f:
+        json.dump({"version": 1, "source": os.path.abspath(root_dir), "series": entries}, f, indent=2)
+    print(f"\nWrote manifest: {manifest_path}")
+
+    failed = sum("error" in entry for entry in entries)
+    if failed:
+        print(f"Warning: {failed} of {len(entries)} series failed to convert")
+    return sum(entry["dimensions"][2] for entry in entries if "error" not in entry)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert the first DICOM series in a folder (or every series in a tree with --batch) to VoluMatrix "
+        "NRRDs (.nhdr + .raw) in HU.",
+        epilog="Examples:\n"
+        r"  python dicom_to_nrrd.py D:\Data\CT_01 .\output\patient1 --chunked" "\n"
+        r"  python dicom_to_nrrd.py D:\Data\Study .\output\study --batch",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+    )
+    parser.add_argument("dicom_folder", help="folder containing the DICOM series (root of the study tree with --batch)")
+    parser.add_argument(
+        "output_base", help="output path without extension, .nhdr and .raw get appended (output folder with --batch)"
+    )
+    parser.add_argument(
+        "--batch",
+        action="store_true",
+        help="convert every series in the dicom_folder tree in parallel (chunked) and write a manifest.json",
+    )
+    parser.add_argument(
+        "--workers",
+        type=int,
+        default=max(1, (os.cpu_count() or 2) // 2),
+        help="batch worker processes (default: half the cores)",
+    )
+    parser.add_argument(
+        "--chunked",
+        action="store_true",
+        help="convert slab by slab within --memory-mb instead of the whole volume at once",
+    )
+    parser.add_argument(
+        "--memory-mb",
+        type=int,
+        default=512,
+        help="memory budget of the chunked conversion, per worker with --batch (default 512)",
+    )
+    parser.add_argument("--threads", type=int, default=0, help="ITK reader threads (default: one per core)")
+    parser.add_argument(
+        "--pyramid",
+        action="store_true",
+        help="also write 1/2, 1/4 and 1/8 resolution levels, referenced from the header, for quick previews",
+    )
+    parser.add_argument(
+        "--pyramid-reduction",
+        choices=PYRAMID_REDUCTIONS,
+        default="mean",
+        help="how 2x2x2 voxels get combined into one pyramid voxel (default mean)",
+    )
+    args = parser.parse_args()
+    pyramid_levels = PYRAMID_LEVELS if args.pyramid else 0
+
+    dicom_dir = args.dicom_folder
+    out_base = args.output_base
 
     if not os.path.isdir(dicom_dir):
         raise RuntimeError(f"Invalid DICOM folder: {dicom_dir}")
 
+    start_time = time.perf_counter()
+    if args.batch:
+        print("=== Converting every DICOM series in the tree ===")
+        num_slices = convert_batch(
+            dicom_dir, out_base, args.memory_mb, args.threads, args.workers, pyramid_levels, args.pyramid_reduction
+        )
+        elapsed = time.perf_counter() - start_time
+        print(f"=== DONE: {num_slices} slices in {elapsed:.1f} s ({num_slices / elapsed:.1f} slices/sec) ===")
+        return
+
     out_dir = os.path.dirname(out_base)
     if out_dir and not os.path.exists(out_dir):
         os.makedirs(out_dir, exist_ok=True)
 
-    print("=== Loading DICOM ===")
-    img = load_dicom_series(dicom_dir)
-
-    print("=== Applying HU scaling ===")
-    img_hu = apply_hu_scaling(img)
-
     nhdr_path = out_base + ".nhdr"
     raw_path = out_base + ".raw"
 
-    print("=== Writing NRRD ===")
-    write_nrrd_raw(img_hu, nhdr_path, raw_path)
-
-    print("=== DONE ===")
+    if args.chunked:
+        print("=== Converting DICOM slab by slab ===")
+        stats = convert_chunked(
+            get_series_file_names(dicom_dir),
+            nhdr_path,
+            raw_path,
+            args.memory_mb,
+            args.threads,
+            pyramid_levels,
+            args.pyramid_reduction,
+        )
+        num_slices = stats["dimensions"][2]
+    else:
+        print("=== Loading DICOM ===")
+        img = load_dicom_series(dicom_dir, args.threads)
+        num_slices = int(img.GetLargestPossibleRegion().GetSize()[2])
+
+        print("=== Applying HU scaling ===")
+        img_hu = apply_hu_scaling(img)
+
+        print("=== Writing NRRD ===")
+        write_nrrd_raw(img_hu, nhdr_path, raw_path, pyramid_levels, args.pyramid_reduction)
+
+    elapsed = time.perf_counter() - start_time
+    print(f"=== DONE: {num_slices} slices in {elapsed:.1f} s ({num_slices / elapsed:.1f} slices/sec) ===")
 
 
 if __name__ == "__main__":